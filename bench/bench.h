@@ -0,0 +1,40 @@
+/**
+ * @file    bench.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Timing and result reporting shared by the benchmarks.
+ *
+ * @details Every result is one JSON object on its own line on stdout, so
+ *          `make bench` output can be saved and diffed against an earlier
+ *          run to catch regressions.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <time.h>
+
+static inline double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief   Reports @p iterations runs of one case that took @p elapsed
+ *          seconds and processed @p bytes per run (0 if not meaningful).
+ */
+static inline void bench_report(const char *bench, const char *name, const char *variant,
+                                long iterations, double elapsed, size_t bytes)
+{
+    printf("{\"bench\":\"%s\",\"case\":\"%s\",\"variant\":\"%s\",\"iterations\":%ld,"
+           "\"ns_per_op\":%.2f",
+           bench, name, variant, iterations, elapsed * 1e9 / iterations);
+    if (bytes > 0) printf(",\"mb_per_s\":%.1f", bytes * iterations / elapsed / 1e6);
+    printf("}\n");
+    fflush(stdout);
+}
+
+#endif
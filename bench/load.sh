@@ -0,0 +1,64 @@
+#!/bin/sh
+# Load test: starts cserver and a loadgen backend in a scratch directory and
+# runs the static, proxied and keep-alive workloads against them, one JSON
+# line per workload on stdout.
+#
+# Usage: bench/load.sh path/to/cserver path/to/loadgen
+# Environment: BENCH_DURATION (seconds per workload, default 5),
+#              BENCH_WORKERS (default 2), BENCH_PORT (default 18081),
+#              BENCH_BACKEND_PORT (default 18000), BENCH_RATE (open loop
+#              requests per second, default 20000)
+
+set -e
+
+CSERVER=$(realpath "$1")
+LOADGEN=$(realpath "$2")
+DURATION=${BENCH_DURATION:-5}
+WORKERS=${BENCH_WORKERS:-2}
+PORT=${BENCH_PORT:-18081}
+BACKEND_PORT=${BENCH_BACKEND_PORT:-18000}
+RATE=${BENCH_RATE:-20000}
+
+DIR=$(mktemp -d)
+PIDS=""
+cleanup()
+{
+    [ -n "$PIDS" ] && kill $PIDS 2>/dev/null
+    wait 2>/dev/null
+    rm -rf "$DIR"
+}
+trap cleanup EXIT INT TERM
+
+mkdir -p "$DIR/static"
+printf '<!doctype html><html><head><title>bench</title></head><body>%s</body></html>\n' \
+    "$(head -c 600 /dev/zero | tr '\0' 'x')" > "$DIR/static/index.html"
+cat > "$DIR/cserver.ini" <<EOF
+port=$PORT
+root=./
+static_dir=./static
+backend=127.0.0.1:$BACKEND_PORT
+workers=$WORKERS
+log_level=error
+access_log=off
+EOF
+
+"$LOADGEN" -s "$BACKEND_PORT" &
+PIDS="$!"
+(cd "$DIR" && exec "$CSERVER" > cserver.log 2>&1) &
+PIDS="$PIDS $!"
+
+# Wait for the listener
+i=0
+until "$LOADGEN" -c 1 -t 1 -d 0.05 -n probe "127.0.0.1:$PORT" /static/index.html >/dev/null 2>&1
+do
+    i=$((i + 1))
+    [ $i -ge 50 ] && { echo "cserver did not start" >&2; cat "$DIR/cserver.log" >&2; exit 1; }
+    sleep 0.1
+done
+
+TARGET="127.0.0.1:$PORT"
+"$LOADGEN" -n static-keepalive -c 64 -d "$DURATION" "$TARGET" /static/index.html
+"$LOADGEN" -n static-close -c 16 -k 0 -d "$DURATION" "$TARGET" /static/index.html
+"$LOADGEN" -n proxy-keepalive -c 64 -d "$DURATION" "$TARGET" /api/items
+"$LOADGEN" -n static-keepalive -c 64 -r "$RATE" -d "$DURATION" "$TARGET" /static/index.html
+"$LOADGEN" -n proxy-keepalive -c 64 -r "$RATE" -d "$DURATION" "$TARGET" /api/items
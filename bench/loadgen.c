@@ -0,0 +1,631 @@
+/**
+ * @file    loadgen.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   HTTP/1.1 load generator, and a trivial backend to proxy to.
+ *
+ * @details Every thread drives its share of the connections from its own
+ *          epoll instance. Closed loop (the default) sends the next request
+ *          on a connection as soon as its response is complete, so it
+ *          measures throughput. Open loop (-r) issues requests at a fixed
+ *          rate whether or not responses keep up, and takes each latency
+ *          from when the request was due, not when a connection got free
+ *          to send it, so a stalled server can't hide its queueing delay.
+ *
+ *          Latencies go into log-linear histograms (3% precision) and the
+ *          summary is one JSON line, like the other benchmarks.
+ *
+ *          Usage: loadgen [-c conns] [-t threads] [-d seconds] [-r rate]
+ *                         [-k 0|1] [-n name] host:port path
+ *                 loadgen -s port   (answer every request with a small 200)
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LAT_SUB_BITS 5 // 32 buckets per power of two, ~3% error
+#define LAT_MAX_BITS 32
+#define LAT_BUCKETS ((LAT_MAX_BITS - LAT_SUB_BITS + 1) << LAT_SUB_BITS)
+#define RESPONSE_BUFFER 65536 // responses larger than this are read in pieces
+#define MAX_EVENTS 256
+
+typedef struct Options
+{
+    int connections; // across all threads
+    int threads;
+    double duration; // seconds
+    double rate;     // requests per second across all threads, 0 = closed loop
+    int keep_alive;  // reuse connections, otherwise one request per connection
+    const char *name;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    char request[1024];
+    size_t request_len;
+} Options;
+
+typedef struct Client
+{
+    int fd;
+    int connecting;      // connect() still in progress
+    int busy;            // a request is outstanding
+    uint64_t started_ns; // when that request was sent, or due in open loop
+    size_t sent;         // request bytes written so far
+    char *buf;           // response bytes read so far
+    size_t len;
+    size_t head_len;     // 0 until the response head is complete
+    size_t expected;     // offset in buf the response ends at
+    int until_eof;       // no Content-Length, the body ends with the connection
+    int close_after;     // the server closes after this response
+    int writing;         // EPOLLOUT is registered
+} Client;
+
+typedef struct Thread
+{
+    pthread_t thread;
+    const Options *opts;
+    int epoll_fd;
+    Client *clients;
+    int client_count;
+    double rate;        // this thread's share of opts->rate
+    uint64_t requests;  // responses received
+    uint64_t errors;    // connect, read or framing failures
+    uint64_t issued;    // open loop: requests that have come due
+    uint64_t sent;      // open loop: of those, requests sent
+    uint64_t start_ns;
+    uint64_t counts[LAT_BUCKETS];
+} Thread;
+
+static uint64_t now_ns(void);
+static void *thread_main(void *arg);
+static int client_connect(Thread *t, Client *c);
+static void client_close(Thread *t, Client *c);
+static void client_send(Thread *t, Client *c, uint64_t started_ns);
+static void client_flush(Thread *t, Client *c);
+static void client_read(Thread *t, Client *c);
+static void client_watch(Thread *t, Client *c, int writing);
+static void client_done(Thread *t, Client *c);
+static int response_framed(Client *c);
+static unsigned latency_bucket(uint64_t us);
+static uint64_t latency_bucket_max(unsigned bucket);
+static uint64_t latency_quantile(const uint64_t *counts, uint64_t total, double q);
+static int serve(int port);
+static int parse_target(Options *opts, const char *target);
+
+int main(int argc, char **argv)
+{
+    Options opts = {.connections = 64, .threads = 2, .duration = 5, .keep_alive = 1,
+                    .name = "load"};
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:t:d:r:k:n:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c': opts.connections = atoi(optarg); break;
+        case 't': opts.threads = atoi(optarg); break;
+        case 'd': opts.duration = atof(optarg); break;
+        case 'r': opts.rate = atof(optarg); break;
+        case 'k': opts.keep_alive = atoi(optarg); break;
+        case 'n': opts.name = optarg; break;
+        case 's': return serve(atoi(optarg));
+        default:
+            fprintf(stderr, "usage: %s [-c conns] [-t threads] [-d seconds] [-r rate] [-k 0|1] "
+                            "[-n name] host:port path\n       %s -s port\n",
+                    argv[0], argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind != 2 || parse_target(&opts, argv[optind]) < 0)
+    {
+        fprintf(stderr, "%s: need a reachable host:port and a path\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (opts.threads < 1) opts.threads = 1;
+    if (opts.connections < opts.threads) opts.connections = opts.threads;
+
+    int n = snprintf(opts.request, sizeof(opts.request),
+                     "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: cserver-loadgen\r\n%s\r\n",
+                     argv[optind + 1], argv[optind],
+                     opts.keep_alive ? "" : "Connection: close\r\n");
+    if (n < 0 || (size_t)n >= sizeof(opts.request)) return EXIT_FAILURE;
+    opts.request_len = (size_t)n;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    Thread *threads = calloc(opts.threads, sizeof(Thread));
+    if (!threads) return EXIT_FAILURE;
+    for (int i = 0; i < opts.threads; i++)
+    {
+        threads[i].opts         = &opts;
+        threads[i].client_count = opts.connections / opts.threads +
+                                  (i < opts.connections % opts.threads);
+        threads[i].rate         = opts.rate / opts.threads;
+        if (pthread_create(&threads[i].thread, NULL, thread_main, &threads[i]) != 0)
+            return EXIT_FAILURE;
+    }
+
+    uint64_t counts[LAT_BUCKETS] = {0};
+    uint64_t requests = 0, errors = 0;
+    for (int i = 0; i < opts.threads; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+        requests += threads[i].requests;
+        errors += threads[i].errors;
+        for (unsigned b = 0; b < LAT_BUCKETS; b++)
+            counts[b] += threads[i].counts[b];
+    }
+
+    printf("{\"bench\":\"load\",\"case\":\"%s\",\"variant\":\"%s\",\"connections\":%d,"
+           "\"threads\":%d,\"duration_s\":%.1f,\"rate\":%.0f,\"requests\":%" PRIu64
+           ",\"errors\":%" PRIu64 ",\"rps\":%.0f,\"p50_us\":%" PRIu64 ",\"p99_us\":%" PRIu64
+           ",\"p999_us\":%" PRIu64 "}\n",
+           opts.name, opts.rate > 0 ? "open" : "closed", opts.connections, opts.threads,
+           opts.duration, opts.rate, requests, errors, requests / opts.duration,
+           latency_quantile(counts, requests, 0.5), latency_quantile(counts, requests, 0.99),
+           latency_quantile(counts, requests, 0.999));
+
+    free(threads);
+    return errors > requests / 100 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// ---------- UTILS ----------
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *thread_main(void *arg)
+{
+    Thread *t           = arg;
+    const Options *opts = t->opts;
+
+    t->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    t->clients  = calloc(t->client_count, sizeof(Client));
+    if (t->epoll_fd < 0 || !t->clients) return NULL;
+
+    t->start_ns      = now_ns();
+    uint64_t stop_ns = t->start_ns + (uint64_t)(opts->duration * 1e9);
+    for (int i = 0; i < t->client_count; i++)
+    {
+        t->clients[i].fd  = -1;
+        t->clients[i].buf = malloc(RESPONSE_BUFFER);
+        if (!t->clients[i].buf) return NULL;
+        client_connect(t, &t->clients[i]);
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (1)
+    {
+        uint64_t now = now_ns();
+        if (now >= stop_ns) break;
+
+        if (opts->rate > 0)
+        {
+            // Requests that came due, sent on whichever connections are free
+            t->issued = (uint64_t)((now - t->start_ns) / 1e9 * t->rate);
+            for (int i = 0; i < t->client_count && t->sent < t->issued; i++)
+            {
+                Client *c = &t->clients[i];
+                if (c->fd < 0 && client_connect(t, c) < 0) continue;
+                if (c->busy || c->connecting) continue;
+                client_send(t, c, t->start_ns + (uint64_t)(t->sent * 1e9 / t->rate));
+                t->sent++;
+            }
+        }
+
+        // Sleep until the next request is due, a millisecond late is a
+        // millisecond of made-up latency
+        uint64_t wait_ns = stop_ns - now;
+        if (opts->rate > 0)
+        {
+            uint64_t due = t->start_ns + (uint64_t)(t->sent * 1e9 / t->rate);
+            wait_ns      = t->sent < t->issued || due <= now ? 0 : due - now;
+        }
+        if (wait_ns > 100000000) wait_ns = 100000000;
+        struct timespec timeout = {(time_t)(wait_ns / 1000000000), (long)(wait_ns % 1000000000)};
+        int n = epoll_pwait2(t->epoll_fd, events, MAX_EVENTS, &timeout, NULL);
+        if (n < 0 && errno == ENOSYS) n = epoll_wait(t->epoll_fd, events, MAX_EVENTS, 1);
+        for (int i = 0; i < n; i++)
+        {
+            Client *c = events[i].data.ptr;
+            if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & EPOLLIN))
+            {
+                t->errors++;
+                client_close(t, c);
+                continue;
+            }
+            if (c->connecting && (events[i].events & EPOLLOUT))
+            {
+                int err       = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0)
+                {
+                    t->errors++;
+                    client_close(t, c);
+                    continue;
+                }
+                c->connecting = 0;
+                if (opts->rate == 0 && !c->busy)
+                    client_send(t, c, now_ns());
+                else
+                    client_watch(t, c, c->busy && c->sent < opts->request_len);
+            }
+            if (c->fd >= 0 && c->busy && c->sent < opts->request_len) client_flush(t, c);
+            if (c->fd >= 0 && (events[i].events & EPOLLIN)) client_read(t, c);
+        }
+
+        // Closed loop: connections closed by a response start over right away
+        if (opts->rate == 0)
+        {
+            for (int i = 0; i < t->client_count; i++)
+            {
+                if (t->clients[i].fd < 0) client_connect(t, &t->clients[i]);
+            }
+        }
+    }
+
+    for (int i = 0; i < t->client_count; i++)
+    {
+        if (t->clients[i].fd >= 0) close(t->clients[i].fd);
+        free(t->clients[i].buf);
+    }
+    free(t->clients);
+    close(t->epoll_fd);
+    return NULL;
+}
+
+/**
+ * @returns 0 once connect() is under way, -1 if it failed outright.
+ */
+static int client_connect(Thread *t, Client *c)
+{
+    const Options *opts = t->opts;
+
+    c->fd = socket(opts->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd < 0)
+    {
+        t->errors++;
+        return -1;
+    }
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    c->connecting = 1;
+    c->busy       = 0;
+    c->len        = 0;
+    c->writing    = 1;
+    if (connect(c->fd, (const struct sockaddr *)&opts->addr, opts->addr_len) < 0 &&
+        errno != EINPROGRESS)
+    {
+        t->errors++;
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT, .data.ptr = c};
+    epoll_ctl(t->epoll_fd, EPOLL_CTL_ADD, c->fd, &ev);
+    return 0;
+}
+
+static void client_close(Thread *t, Client *c)
+{
+    (void)t;
+    if (c->fd >= 0) close(c->fd); // also drops it from the epoll set
+    c->fd   = -1;
+    c->busy = 0;
+}
+
+static void client_send(Thread *t, Client *c, uint64_t started_ns)
+{
+    c->busy       = 1;
+    c->started_ns = started_ns;
+    c->sent       = 0;
+    c->len        = 0;
+    c->head_len   = 0;
+    client_flush(t, c);
+}
+
+static void client_flush(Thread *t, Client *c)
+{
+    const Options *opts = t->opts;
+
+    while (c->sent < opts->request_len)
+    {
+        ssize_t n = send(c->fd, opts->request + c->sent, opts->request_len - c->sent, 0);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                client_watch(t, c, 1);
+                return;
+            }
+            t->errors++;
+            client_close(t, c);
+            return;
+        }
+        c->sent += (size_t)n;
+    }
+    client_watch(t, c, 0);
+}
+
+/**
+ * @brief   Keeps EPOLLOUT registered only while connecting or while the
+ *          request doesn't fit the socket buffer.
+ */
+static void client_watch(Thread *t, Client *c, int writing)
+{
+    if (c->writing == writing) return;
+    struct epoll_event ev = {.events = EPOLLIN | (writing ? EPOLLOUT : 0), .data.ptr = c};
+    epoll_ctl(t->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->writing = writing;
+}
+
+static void client_read(Thread *t, Client *c)
+{
+    const Options *opts = t->opts;
+
+    while (1)
+    {
+        // Bodies larger than the buffer are only counted, not kept
+        if (c->len == RESPONSE_BUFFER)
+        {
+            if (c->head_len == 0)
+            {
+                t->errors++; // head too large
+                client_close(t, c);
+                return;
+            }
+            c->expected -= c->len - c->head_len;
+            c->len = c->head_len;
+        }
+
+        ssize_t n = recv(c->fd, c->buf + c->len, RESPONSE_BUFFER - c->len, 0);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR) continue;
+            t->errors++;
+            client_close(t, c);
+            return;
+        }
+        if (n == 0)
+        {
+            // Fine between requests or as the end of a body without a length
+            if (c->busy && c->head_len > 0 && c->until_eof)
+                client_done(t, c);
+            else if (c->busy)
+                t->errors++;
+            client_close(t, c);
+            return;
+        }
+        if (!c->busy)
+        {
+            t->errors++; // bytes nobody asked for
+            client_close(t, c);
+            return;
+        }
+
+        c->len += (size_t)n;
+        int framed = response_framed(c);
+        if (framed < 0)
+        {
+            t->errors++;
+            client_close(t, c);
+            return;
+        }
+        if (!framed) continue;
+
+        client_done(t, c);
+        if (c->close_after || !opts->keep_alive)
+        {
+            client_close(t, c);
+            return;
+        }
+        if (opts->rate == 0) client_send(t, c, now_ns());
+        return;
+    }
+}
+
+static void client_done(Thread *t, Client *c)
+{
+    uint64_t us = (now_ns() - c->started_ns) / 1000;
+    t->counts[latency_bucket(us)]++;
+    t->requests++;
+    c->busy = 0;
+}
+
+/**
+ * @returns 1 once the whole response is in, 0 if more is expected, -1 if
+ *          it can't be framed.
+ */
+static int response_framed(Client *c)
+{
+    if (c->head_len == 0)
+    {
+        char *end = memmem(c->buf, c->len, "\r\n\r\n", 4);
+        if (!end) return 0;
+        c->head_len    = (size_t)(end + 4 - c->buf);
+        c->expected    = c->head_len;
+        c->until_eof   = 1;
+        c->close_after = 0;
+
+        for (char *line = memchr(c->buf, '\n', c->head_len); line && line < end;
+             line       = memchr(line + 1, '\n', end - line))
+        {
+            if (strncasecmp(line + 1, "Content-Length:", 15) == 0)
+            {
+                c->expected += strtoull(line + 16, NULL, 10);
+                c->until_eof = 0;
+            }
+            else if (strncasecmp(line + 1, "Connection: close", 17) == 0)
+                c->close_after = 1;
+            else if (strncasecmp(line + 1, "Transfer-Encoding:", 18) == 0)
+                return -1; // not needed for the benchmark workloads
+        }
+        const char *status = c->buf + 9; // after "HTTP/1.1 "
+        if (c->len > 12 && (strncmp(status, "204", 3) == 0 || strncmp(status, "304", 3) == 0))
+            c->until_eof = 0;
+    }
+    return !c->until_eof && c->len >= c->expected;
+}
+
+static unsigned latency_bucket(uint64_t us)
+{
+    if (us < (1u << LAT_SUB_BITS)) return (unsigned)us;
+
+    unsigned msb = 63 - __builtin_clzll(us);
+    if (msb >= LAT_MAX_BITS) return LAT_BUCKETS - 1;
+
+    unsigned shift = msb - LAT_SUB_BITS;
+    return ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) |
+           ((us >> shift) & ((1u << LAT_SUB_BITS) - 1));
+}
+
+static uint64_t latency_bucket_max(unsigned bucket)
+{
+    if (bucket < (1u << LAT_SUB_BITS)) return bucket;
+
+    unsigned msb   = (bucket >> LAT_SUB_BITS) + LAT_SUB_BITS - 1;
+    unsigned shift = msb - LAT_SUB_BITS;
+    uint64_t sub   = bucket & ((1u << LAT_SUB_BITS) - 1);
+    return ((((uint64_t)1 << LAT_SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+static uint64_t latency_quantile(const uint64_t *counts, uint64_t total, double q)
+{
+    if (total == 0) return 0;
+
+    uint64_t rank = (uint64_t)(q * (double)total);
+    if (rank >= total) rank = total - 1;
+
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < LAT_BUCKETS; b++)
+    {
+        seen += counts[b];
+        if (seen > rank) return latency_bucket_max(b);
+    }
+    return latency_bucket_max(LAT_BUCKETS - 1);
+}
+
+/**
+ * @brief   Backend for the proxied workloads: answers every complete
+ *          request head on a connection with the same small 200, until
+ *          killed. Requests must not have bodies.
+ */
+static int serve(int port)
+{
+    static const char response[] = "HTTP/1.1 200 OK\r\n"
+                                   "Content-Type: application/json\r\n"
+                                   "Content-Length: 27\r\n"
+                                   "\r\n"
+                                   "{\"status\":\"ok\",\"items\":[]}\n";
+
+    signal(SIGPIPE, SIG_IGN);
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one      = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    addr.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 4096) < 0)
+    {
+        perror("loadgen: backend");
+        return EXIT_FAILURE;
+    }
+
+    int epoll_fd          = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = listener};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener, &ev);
+
+    // Bytes of a partial "\r\n\r\n" carried over between reads, per fd
+    static unsigned char matched[65536];
+    struct epoll_event events[MAX_EVENTS];
+    char buf[16384];
+
+    while (1)
+    {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        for (int i = 0; i < n; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == listener)
+            {
+                int client;
+                while ((client = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    if (client >= (int)sizeof(matched))
+                    {
+                        close(client);
+                        continue;
+                    }
+                    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    matched[client]       = 0;
+                    struct epoll_event cev = {.events = EPOLLIN, .data.fd = client};
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &cev);
+                }
+                continue;
+            }
+
+            ssize_t len = recv(fd, buf, sizeof(buf), 0);
+            if (len <= 0)
+            {
+                if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+                close(fd);
+                continue;
+            }
+
+            // One response per request head; they are tiny, so send() won't block
+            static const char terminator[] = "\r\n\r\n";
+            for (ssize_t j = 0; j < len; j++)
+            {
+                if (buf[j] == terminator[matched[fd]])
+                    matched[fd]++;
+                else
+                    matched[fd] = buf[j] == '\r';
+                if (matched[fd] == 4)
+                {
+                    matched[fd] = 0;
+                    if (send(fd, response, sizeof(response) - 1, 0) < 0) break;
+                }
+            }
+        }
+    }
+}
+
+static int parse_target(Options *opts, const char *target)
+{
+    char host[256];
+    const char *colon = strrchr(target, ':');
+    if (!colon || (size_t)(colon - target) >= sizeof(host)) return -1;
+    memcpy(host, target, colon - target);
+    host[colon - target] = '\0';
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *res;
+    if (getaddrinfo(host, colon + 1, &hints, &res) != 0) return -1;
+    memcpy(&opts->addr, res->ai_addr, res->ai_addrlen);
+    opts->addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return 0;
+}
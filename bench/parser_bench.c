@@ -0,0 +1,136 @@
+/**
+ * @file    parser_bench.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Microbenchmark of the HTTP request parser backends.
+ *
+ * @details Parses the request corpus in a loop with every tokenizer
+ *          backend the CPU supports, with the one-shot parse_http_request(),
+ *          and with the previous memchr()/memmem() parser for reference.
+ *
+ *          Usage: parser_bench [iterations]
+ */
+
+#include "common.h"
+#include "http/parsers.h"
+#include "http/tokenizer.h"
+#include "bench.h"
+#include "corpus.h"
+
+typedef enum
+{
+    PARSER_INCREMENTAL, // parse_http_request_partial(), what the server runs
+    PARSER_ONESHOT,     // parse_http_request() on a complete request
+    PARSER_LEGACY       // memchr()/memmem() reference
+} ParserKind;
+
+/**
+ * @brief   The parser as it was before the tokenizer: memchr() per field and
+ *          a memmem() for every line end.
+ */
+static int legacy_parse(const char *data, size_t len, HTTPRequest *req)
+{
+    const char *ptr = data;
+    const char *end = data + len;
+
+    const char *space = memchr(ptr, ' ', end - ptr);
+    if (!space) return -1;
+    req->request_line.method     = (char *)ptr;
+    req->request_line.method_len = space - ptr;
+    ptr                          = space + 1;
+
+    space = memchr(ptr, ' ', end - ptr);
+    if (!space) return -1;
+    req->request_line.uri     = (char *)ptr;
+    req->request_line.uri_len = space - ptr;
+    ptr                       = space + 1;
+
+    const char *crlf = memmem(ptr, end - ptr, "\r\n", 2);
+    if (!crlf) return -1;
+    req->request_line.protocol     = (char *)ptr;
+    req->request_line.protocol_len = crlf - ptr;
+    ptr                            = crlf + 2;
+
+    req->header_count = 0;
+    while (ptr < end && memcmp(ptr, "\r\n", 2) != 0)
+    {
+        if (req->header_count >= MAX_HEADERS) return -1;
+        HTTPHeader *header = &req->headers[req->header_count];
+
+        const char *colon = memchr(ptr, ':', end - ptr);
+        if (!colon) return -1;
+        header->name     = (char *)ptr;
+        header->name_len = colon - ptr;
+        ptr              = colon + 1;
+        while (ptr < end && isspace(*ptr))
+            ptr++;
+
+        crlf = memmem(ptr, end - ptr, "\r\n", 2);
+        if (!crlf) return -1;
+        header->value     = (char *)ptr;
+        header->value_len = crlf - ptr;
+        ptr               = crlf + 2;
+        req->header_count++;
+    }
+    return 0;
+}
+
+static void run(const char *label, const BenchRequest *bench, long iterations, ParserKind kind)
+{
+    size_t len = strlen(bench->data);
+    char *data = malloc(len + 1);
+    HTTPHeader headers[MAX_HEADERS];
+    HTTPRequest req;
+    RequestParser parser;
+    long checksum = 0;
+
+    double start = bench_now();
+    for (long i = 0; i < iterations; i++)
+    {
+        // Chunked bodies are decoded in place, so every run gets a fresh copy
+        memcpy(data, bench->data, len + 1);
+        memset(&req, 0, sizeof(req));
+        req.headers = headers;
+
+        if (kind == PARSER_LEGACY)
+        {
+            if (legacy_parse(data, len, &req) < 0) abort();
+        }
+        else if (kind == PARSER_ONESHOT)
+        {
+            if (parse_http_request(data, len, &req) < 0) abort();
+        }
+        else
+        {
+            request_parser_init(&parser);
+            if (parse_http_request_partial(&parser, &req, data, len) != PARSE_DONE) abort();
+        }
+        checksum += req.header_count;
+    }
+    double elapsed = bench_now() - start;
+
+    if (checksum == 0) abort(); // keeps the loop from being optimized out
+    bench_report("parser", bench->name, label, iterations, elapsed, len);
+    free(data);
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    const char *backends[] = {"scalar", "sse4.2", "avx2"};
+
+    for (size_t r = 0; r < CORPUS_REQUESTS; r++)
+    {
+        run("legacy", &corpus_requests[r], iterations, PARSER_LEGACY);
+        for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+        {
+            if (tokenizer_select(backends[b]) < 0) continue;
+            char oneshot[32];
+            snprintf(oneshot, sizeof(oneshot), "%s-oneshot", backends[b]);
+            run(backends[b], &corpus_requests[r], iterations, PARSER_INCREMENTAL);
+            run(oneshot, &corpus_requests[r], iterations, PARSER_ONESHOT);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file    response_bench.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Microbenchmark of response serialization and MIME lookup.
+ *
+ * @details Builds the responses the server sends most, the way handlers do
+ *          it: in a connection arena that is reset after every response,
+ *          finished into the iovecs that are queued. The body is referenced,
+ *          so the "large" case costs the same as a small one. The static
+ *          file path, which only formats a head with
+ *          httpresponse_write_head(), is measured alongside. MIME types are
+ *          looked up for the path corpus.
+ *
+ *          Usage: response_bench [iterations]
+ */
+
+#include "common.h"
+#include "http/parsers.h"
+#include "http/response.h"
+#include "bench.h"
+
+typedef struct BenchResponse
+{
+    const char *name;
+    int status_code;
+    const char *phrase;
+    const char *content_type;
+    size_t body_len;
+    int extra_headers; // headers added on top of the framing ones
+} BenchResponse;
+
+static const BenchResponse responses[] = {
+    {"html", 200, "OK", "text/html", 150, 0},
+    {"api", 200, "OK", "application/json", 1024, 4},
+    {"error", 404, "Not Found", "text/html", 22, 0},
+    {"large", 200, "OK", "application/octet-stream", 65536, 1},
+};
+
+// Paths as static requests name them, the usual mix of a web page's assets
+static const char *corpus_paths[] = {
+    "./static/index.html",
+    "./static/assets/app.3f9c2b.js",
+    "./static/assets/vendor.91ac0e.js",
+    "./static/css/site.css",
+    "./static/img/logo.svg",
+    "./static/img/hero@2x.png",
+    "./static/img/avatar.jpg",
+    "./static/favicon.ico",
+    "./static/data/feed.json",
+    "./static/fonts/inter-var.woff2",
+    "./static/docs/manual.pdf",
+    "./static/README",
+};
+
+#define CORPUS_PATHS (sizeof(corpus_paths) / sizeof(corpus_paths[0]))
+
+static const char *extra_names[]  = {"Cache-Control", "X-Request-Id", "Vary", "Server"};
+static const char *extra_values[] = {"no-store", "4b9a2f6e-1c3d-4e5f-8a7b-9c0d1e2f3a4b",
+                                     "Accept-Encoding", "cserver"};
+
+static void run_serialize(const BenchResponse *bench, long iterations)
+{
+    Arena arena;
+    char *body = malloc(bench->body_len);
+    if (!body || arena_init(&arena, CONNECTION_ARENA_SIZE) < 0) abort();
+    memset(body, 'x', bench->body_len);
+
+    size_t total = 0;
+    double start = bench_now();
+    for (long i = 0; i < iterations; i++)
+    {
+        arena_reset(&arena);
+        HTTPResponse *res = response_builder(&arena, bench->status_code, bench->phrase, body,
+                                             bench->body_len, bench->content_type);
+        if (!res) abort();
+        for (int h = 0; h < bench->extra_headers; h++)
+            httpresponse_add_header(res, extra_names[h], extra_values[h]);
+
+        struct iovec iov[2];
+        int count = httpresponse_finish(res, iov);
+        if (count < 0) abort();
+        for (int v = 0; v < count; v++)
+            total += iov[v].iov_len;
+    }
+    double elapsed = bench_now() - start;
+
+    bench_report("response", bench->name, "finish", iterations, elapsed, total / iterations);
+    arena_destroy(&arena);
+    free(body);
+}
+
+static void run_write_head(long iterations)
+{
+    char head[512];
+    size_t total = 0;
+
+    double start = bench_now();
+    for (long i = 0; i < iterations; i++)
+    {
+        int len = httpresponse_write_head(head, sizeof(head), 200, "OK", "text/html",
+                                          (size_t)i & 0xffff,
+                                          "ETag: \"1a2b3c-4d5e-65f0a1b2\"\r\n"
+                                          "Last-Modified: Tue, 12 Mar 2024 08:15:42 GMT\r\n");
+        if (len < 0) abort();
+        total += len;
+    }
+    double elapsed = bench_now() - start;
+
+    bench_report("response", "static", "write_head", iterations, elapsed, total / iterations);
+}
+
+static void run_mime(long iterations)
+{
+    size_t checksum = 0;
+
+    double start = bench_now();
+    for (long i = 0; i < iterations; i++)
+        checksum += (uintptr_t)get_mime_type(corpus_paths[i % CORPUS_PATHS]);
+    double elapsed = bench_now() - start;
+
+    if (checksum == 0) abort(); // keeps the loop from being optimized out
+    bench_report("mime", "paths", "get_mime_type", iterations, elapsed, 0);
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+
+    for (size_t r = 0; r < sizeof(responses) / sizeof(responses[0]); r++)
+        run_serialize(&responses[r], iterations);
+    run_write_head(iterations);
+    run_mime(iterations * 10);
+
+    return EXIT_SUCCESS;
+}
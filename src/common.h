@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -27,6 +28,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/epoll.h>
+#include <sys/sendfile.h>
 
 #include "utils/logger.h"
 
@@ -35,13 +37,35 @@
 
 #define INITIAL_BUFFER_SIZE 4096
 #define MAX_EPOLL_EVENTS 1024
-#define MAX_CONNECTIONS 1000
+#define DEFAULT_MAX_CONNECTIONS 16384 // per worker
+#define DEFAULT_LISTEN_BACKLOG 4096
+#define DEFAULT_IDLE_TIMEOUT 60     // seconds
+#define DEFAULT_HEADER_TIMEOUT 15   // seconds
+#define DEFAULT_BODY_TIMEOUT 30     // seconds
+#define DEFAULT_SHUTDOWN_TIMEOUT 30 // seconds
+#define DEFAULT_MAX_BODY_SIZE (1024 * 1024 * 1024)
+#define DEFAULT_CLIENT_BUFFER_SIZE (64 * 1024)
+#define CACHE_LINE_SIZE 64
 #define MAX_HEADERS 50
+#define MAX_REQUEST_HEAD 16384 // request line and headers of one request
 #define MAX_BACKENDS 16
-#define INITIAL_RESPONSE_SIZE 4096
+#define MAX_ROUTES 64
+#define MAX_WORKERS 256
+#define DEFAULT_BACKEND "localhost:8000"
+#define DEFAULT_UPSTREAM_MAX_IDLE 32
+#define DEFAULT_UPSTREAM_IDLE_TIMEOUT 60
+#define DEFAULT_BACKEND_MAX_FAILS 3
+#define DEFAULT_BACKEND_FAIL_TIMEOUT 10
+#define DEFAULT_STATIC_CACHE_SIZE (64 * 1024 * 1024)
+#define DEFAULT_STATIC_CACHE_MAX_FILE (1024 * 1024)
+#define DEFAULT_STATIC_CACHE_REVALIDATE 1000
+#define DEFAULT_PROXY_CACHE_SIZE (32 * 1024 * 1024)
+#define DEFAULT_PROXY_CACHE_MAX_ENTRY (1024 * 1024)
+#define CONNECTION_ARENA_SIZE 8192 // request headers and responses of one connection
 
 #define DEFAULT_CONFIG_PATH "/home/voidp/Projects/samandar/1lang1server/cserver"
 #define BASE_DIR "./"
+#define CONFIG_FILE "cserver.ini" // read at startup and again on SIGHUP
 
 typedef enum
 {
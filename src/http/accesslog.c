@@ -0,0 +1,209 @@
+/**
+ * @file    accesslog.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Access log implementations.
+ *
+ * @details A record is built on the stack from what the connection already
+ *          holds, the request line still pointing into its buffer, and
+ *          handed to log_access(), so logging a request allocates nothing
+ *          and never waits for the disk. Sampling keeps the volume down on
+ *          busy servers; 5xx responses and aborted requests are always
+ *          logged since they are the ones worth looking at.
+ */
+
+#include "accesslog.h"
+#include "server.h"
+#include "utils/clock.h"
+
+#define JSON_TAIL_RESERVE 192 // bytes kept for the fields after the URI
+
+static int sampled(AccessLog *log);
+static size_t format_json(char *dst, size_t size, const Connection *conn, uint64_t total_us,
+                          int aborted);
+static size_t format_binary(char *dst, size_t size, const Connection *conn, uint64_t total_us,
+                            int aborted);
+static size_t json_escape(char *dst, size_t size, const char *src, size_t len);
+static uint64_t wall_time_ms(void);
+
+void accesslog_init(AccessLog *log, const Config *cfg, int seed)
+{
+    log->enabled   = cfg->access_log != NULL;
+    log->binary    = cfg->access_log_binary;
+    log->threshold = (uint64_t)(cfg->access_log_sample * 4294967296.0);
+    log->rng       = 2463534242u ^ ((uint32_t)seed * 2654435761u) ^ (uint32_t)monotonic_us();
+    if (log->rng == 0) log->rng = 1;
+}
+
+/**
+ * @brief   Logs the connection's current request, if there is one, and
+ *          marks it logged.
+ *
+ * @param   aborted  The connection is closed before the response was sent.
+ */
+void accesslog_request(Worker *self, Connection *conn, int aborted)
+{
+    AccessLog *log = &self->access_log;
+    if (conn->request_us == 0) return;
+
+    uint64_t total_us = monotonic_us() - conn->request_us;
+    conn->request_us  = 0;
+
+    if (!log->enabled) return;
+    if (!aborted && conn->status < 500 && !sampled(log)) return;
+
+    char record[LOG_LINE_MAX];
+    size_t len = log->binary ? format_binary(record, sizeof(record), conn, total_us, aborted)
+                             : format_json(record, sizeof(record), conn, total_us, aborted);
+    if (len > 0) log_access(record, len);
+}
+
+// ---------- UTILS ----------
+
+static int sampled(AccessLog *log)
+{
+    if (log->threshold > UINT32_MAX) return 1;
+
+    uint32_t x = log->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    log->rng = x;
+    return x < log->threshold;
+}
+
+/**
+ * @brief   One JSON object per line. A long URI is cut short rather than
+ *          losing the record.
+ *
+ * @returns Bytes written, 0 if the record didn't fit.
+ */
+static size_t format_json(char *dst, size_t size, const Connection *conn, uint64_t total_us,
+                          int aborted)
+{
+    static __thread time_t cached_sec = -1;
+    static __thread char cached_time[32];
+
+    const HTTPRequestLine *line = &conn->request.request_line;
+    uint64_t now_ms             = wall_time_ms();
+    time_t sec                  = (time_t)(now_ms / 1000);
+    if (sec != cached_sec)
+    {
+        struct tm t;
+        gmtime_r(&sec, &t);
+        strftime(cached_time, sizeof(cached_time), "%Y-%m-%dT%H:%M:%S", &t);
+        cached_sec = sec;
+    }
+
+    size_t len = (size_t)snprintf(dst, size, "{\"time\":\"%s.%03uZ\",\"method\":\"", cached_time,
+                                  (unsigned)(now_ms % 1000));
+    len += json_escape(dst + len, 16, line->method ? line->method : "",
+                       line->method ? line->method_len : 0);
+    len += (size_t)snprintf(dst + len, size - len, "\",\"uri\":\"");
+    len += json_escape(dst + len, size - len - JSON_TAIL_RESERVE, line->uri ? line->uri : "",
+                       line->uri ? line->uri_len : 0);
+
+    int n = snprintf(dst + len, size - len, "\",\"status\":%d,\"bytes\":%zu,", conn->status,
+                     conn->out.sent_bytes);
+    if (n < 0 || (size_t)n >= size - len) return 0;
+    len += n;
+
+    if (conn->backend)
+        n = snprintf(dst + len, size - len, "\"upstream\":\"%s:%s\",\"upstream_ms\":%.3f,",
+                     conn->backend->host, conn->backend->port, conn->upstream_us / 1000.0);
+    else
+        n = snprintf(dst + len, size - len, "\"upstream\":null,\"upstream_ms\":null,");
+    if (n < 0 || (size_t)n >= size - len) return 0;
+    len += n;
+
+    n = snprintf(dst + len, size - len, "\"total_ms\":%.3f%s}\n", total_us / 1000.0,
+                 aborted ? ",\"aborted\":true" : "");
+    if (n < 0 || (size_t)n >= size - len) return 0;
+    return len + n;
+}
+
+/**
+ * @returns Bytes written, 0 if the record didn't fit.
+ */
+static size_t format_binary(char *dst, size_t size, const Connection *conn, uint64_t total_us,
+                            int aborted)
+{
+    const HTTPRequestLine *line = &conn->request.request_line;
+    char upstream[NI_MAXHOST + NI_MAXSERV + 2];
+    size_t upstream_len = 0;
+    if (conn->backend)
+        upstream_len = (size_t)snprintf(upstream, sizeof(upstream), "%s:%s", conn->backend->host,
+                                        conn->backend->port);
+    if (upstream_len > UINT8_MAX) upstream_len = UINT8_MAX;
+
+    size_t method_len = 0;
+    if (line->method) method_len = line->method_len > UINT8_MAX ? UINT8_MAX : line->method_len;
+    size_t uri_len = line->uri ? line->uri_len : 0;
+    if (sizeof(AccessRecord) + method_len + uri_len + upstream_len > size)
+        uri_len = size - sizeof(AccessRecord) - method_len - upstream_len;
+
+    AccessRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.length       = (uint16_t)(sizeof(rec) + method_len + uri_len + upstream_len);
+    rec.status       = (uint16_t)conn->status;
+    rec.flags        = aborted ? ACCESS_ABORTED : 0;
+    rec.method_len   = (uint8_t)method_len;
+    rec.uri_len      = (uint16_t)uri_len;
+    rec.upstream_len = (uint8_t)upstream_len;
+    rec.time_ms      = wall_time_ms();
+    rec.bytes        = conn->out.sent_bytes;
+    rec.total_us     = total_us > UINT32_MAX ? UINT32_MAX : (uint32_t)total_us;
+    rec.upstream_us  = conn->upstream_us;
+
+    char *p = dst;
+    memcpy(p, &rec, sizeof(rec));
+    p += sizeof(rec);
+    memcpy(p, line->method, method_len);
+    p += method_len;
+    memcpy(p, line->uri, uri_len);
+    p += uri_len;
+    memcpy(p, upstream, upstream_len);
+    return rec.length;
+}
+
+/**
+ * @brief   Escapes as much of @p src as fits in @p size bytes for a JSON
+ *          string. Bytes outside printable ASCII become \\u00XX.
+ */
+static size_t json_escape(char *dst, size_t size, const char *src, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t out              = 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)src[i];
+        if (c == '"' || c == '\\')
+        {
+            if (out + 2 > size) break;
+            dst[out++] = '\\';
+            dst[out++] = (char)c;
+        }
+        else if (c < 0x20 || c >= 0x7f)
+        {
+            if (out + 6 > size) break;
+            memcpy(dst + out, "\\u00", 4);
+            dst[out + 4] = hex[c >> 4];
+            dst[out + 5] = hex[c & 15];
+            out += 6;
+        }
+        else
+        {
+            if (out + 1 > size) break;
+            dst[out++] = (char)c;
+        }
+    }
+    return out;
+}
+
+static uint64_t wall_time_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
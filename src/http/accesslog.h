@@ -0,0 +1,53 @@
+/**
+ * @file    accesslog.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   One record per request, as JSON lines or packed binary.
+ *
+ */
+
+#ifndef HTTPACCESSLOG_H
+#define HTTPACCESSLOG_H
+
+#include <stdint.h>
+#include "utils/config.h"
+
+#define ACCESS_ABORTED 0x01 // AccessRecord.flags: the client left before the response was sent
+
+/**
+ * @brief   Per-worker sampling state. Records go through the async logger.
+ */
+typedef struct AccessLog
+{
+    int enabled;        // access_log is configured
+    int binary;         // AccessRecord instead of JSON lines
+    uint64_t threshold; // a request is sampled if its random 32 bits are below this
+    uint32_t rng;       // xorshift32 state
+} AccessLog;
+
+/**
+ * @brief   Binary record layout, little-endian. The method, URI and
+ *          upstream ("host:port") bytes follow, without terminators.
+ */
+typedef struct __attribute__((packed)) AccessRecord
+{
+    uint16_t length;      // whole record, trailing strings included
+    uint16_t status;      // response status code
+    uint8_t flags;        // ACCESS_* bits
+    uint8_t method_len;   // bytes of method
+    uint16_t uri_len;     // bytes of uri
+    uint8_t upstream_len; // bytes of upstream, 0 if not proxied
+    uint8_t reserved[3];
+    uint64_t time_ms;     // wall clock when the response finished, Unix epoch
+    uint64_t bytes;       // response bytes sent to the client
+    uint32_t total_us;    // from the complete request to its last response byte
+    uint32_t upstream_us; // from handing the request to a backend to its last byte
+} AccessRecord;
+
+struct Worker;
+struct Connection;
+
+void accesslog_init(AccessLog *log, const Config *cfg, int seed);
+void accesslog_request(struct Worker *self, struct Connection *conn, int aborted);
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * @file    backend.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Proxy backend and keep-alive connection pool implementations.
+ *
+ * @details Idle connections are not registered in epoll. Their health is
+ *          checked with a non-blocking MSG_PEEK when they are handed out and
+ *          by backend_maintain(), which also enforces the idle timeout and
+ *          keeps min_idle connections warm.
+ */
+
+#include "backend.h"
+#include "utils/clock.h"
+
+static int backend_resolve(Backend *backend);
+static int idle_connection_alive(int fd);
+
+/**
+ * @brief   Parses a "host:port" spec and resolves it.
+ *
+ * A backend that doesn't resolve yet is kept and resolved again on first use.
+ *
+ * @returns OK, or -1 if the spec can't be parsed or memory runs out.
+ */
+int backend_init(Backend *backend, const char *spec, const Config *cfg)
+{
+    memset(backend, 0, sizeof(Backend));
+
+    const char *colon = strrchr(spec, ':');
+    size_t host_len   = colon ? (size_t)(colon - spec) : strlen(spec);
+    if (host_len == 0 || host_len >= sizeof(backend->host)) return -1;
+
+    memcpy(backend->host, spec, host_len);
+    backend->host[host_len] = '\0';
+    snprintf(backend->port, sizeof(backend->port), "%s", colon ? colon + 1 : "80");
+
+    backend->min_idle        = cfg->upstream_min_idle;
+    backend->max_idle        = cfg->upstream_max_idle;
+    backend->idle_timeout_ms = (uint64_t)cfg->upstream_idle_timeout * 1000;
+
+    if (backend->max_idle > 0)
+    {
+        backend->idle = calloc(backend->max_idle, sizeof(IdleConnection));
+        if (!backend->idle) return -1;
+    }
+
+    if (backend_resolve(backend) < 0)
+        LOG(WARNING, "Failed to resolve backend %s:%s, will retry.", backend->host,
+            backend->port);
+
+    return OK;
+}
+
+void backend_destroy(Backend *backend)
+{
+    for (int i = 0; i < backend->idle_count; i++)
+        close(backend->idle[i].fd);
+    free(backend->idle);
+    backend->idle       = NULL;
+    backend->idle_count = 0;
+}
+
+/**
+ * @brief   Takes over the idle connections and failure state of @p from, the
+ *          same backend in a config being replaced. Idle connections beyond
+ *          this pool's max_idle are closed.
+ */
+void backend_adopt(Backend *backend, Backend *from)
+{
+    for (int i = 0; i < from->idle_count; i++)
+    {
+        if (backend->idle_count < backend->max_idle)
+            backend->idle[backend->idle_count++] = from->idle[i];
+        else
+            close(from->idle[i].fd);
+    }
+    from->idle_count = 0;
+
+    backend->fails         = from->fails;
+    backend->ejected_until = from->ejected_until;
+}
+
+/**
+ * @brief   Starts a non-blocking TCP connect to the backend's cached address.
+ *
+ * @returns Socket fd whose connect() is in progress or done, -1 on failure.
+ */
+int connect_to_backend(Backend *backend)
+{
+    if (!backend->resolved && backend_resolve(backend) < 0) return -1;
+
+    int sock = socket(backend->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+    {
+        LOG(ERROR, "Failed to create socket while connecting to proxy backend.");
+        return -1;
+    }
+
+    if (connect(sock, (struct sockaddr *)&backend->addr, backend->addr_len) != 0 &&
+        errno != EINPROGRESS)
+    {
+        LOG(ERROR, "Failed to connect to proxy backend.");
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+/**
+ * @brief   Checks out a connection, reusing the most recently idled healthy
+ *          one before dialing a new one.
+ *
+ * @param   reused  Set to 1 when the fd came from the pool.
+ *
+ * @returns Socket fd, -1 if no connection could be made.
+ */
+int backend_acquire(Backend *backend, int *reused)
+{
+    while (backend->idle_count > 0)
+    {
+        IdleConnection idle = backend->idle[--backend->idle_count];
+        if (idle.healthy && idle_connection_alive(idle.fd))
+        {
+            backend->active++;
+            *reused = 1;
+            return idle.fd;
+        }
+        close(idle.fd);
+    }
+
+    int fd = connect_to_backend(backend);
+    if (fd < 0) return -1;
+
+    backend->active++;
+    *reused = 0;
+    return fd;
+}
+
+/**
+ * @brief   Returns a checked out connection. It is pooled only if the last
+ *          exchange left it reusable and the pool has room.
+ */
+void backend_release(Backend *backend, int fd, int reusable)
+{
+    if (backend->active > 0) backend->active--;
+
+    if (!reusable || backend->idle_count >= backend->max_idle)
+    {
+        close(fd);
+        return;
+    }
+
+    IdleConnection *idle = &backend->idle[backend->idle_count++];
+    idle->fd             = fd;
+    idle->healthy        = 1;
+    idle->idle_since     = monotonic_ms();
+}
+
+/**
+ * @brief   Drops expired and dead idle connections and tops the pool up to
+ *          min_idle.
+ */
+void backend_maintain(Backend *backend, uint64_t now)
+{
+    int kept = 0;
+    for (int i = 0; i < backend->idle_count; i++)
+    {
+        IdleConnection *idle = &backend->idle[i];
+        if (idle->healthy && !idle_connection_alive(idle->fd)) idle->healthy = 0;
+
+        if (!idle->healthy || now - idle->idle_since >= backend->idle_timeout_ms)
+        {
+            close(idle->fd);
+            continue;
+        }
+        backend->idle[kept++] = *idle;
+    }
+    backend->idle_count = kept;
+
+    while (backend->idle_count < backend->min_idle)
+    {
+        int fd = connect_to_backend(backend);
+        if (fd < 0) break;
+
+        IdleConnection *idle = &backend->idle[backend->idle_count++];
+        idle->fd             = fd;
+        idle->healthy        = 1;
+        idle->idle_since     = now;
+    }
+}
+
+// ---------- UTILS ----------
+
+static int backend_resolve(Backend *backend)
+{
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(backend->host, backend->port, &hints, &res) != 0) return -1;
+
+    memcpy(&backend->addr, res->ai_addr, res->ai_addrlen);
+    backend->addr_len = res->ai_addrlen;
+    backend->resolved = 1;
+
+    freeaddrinfo(res);
+    return OK;
+}
+
+/**
+ * @brief   An idle connection must have nothing to read: EOF or stray bytes
+ *          mean the backend closed it or the previous exchange was not
+ *          consumed fully.
+ */
+static int idle_connection_alive(int fd)
+{
+    char byte;
+    ssize_t n = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
@@ -0,0 +1,55 @@
+/**
+ * @file    backend.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Proxy backend with a keep-alive connection pool.
+ *
+ */
+
+#ifndef HTTPBACKEND_H
+#define HTTPBACKEND_H
+
+#include "common.h"
+#include "utils/config.h"
+
+typedef struct IdleConnection
+{
+    int fd;              // connected (or connecting) backend socket
+    int healthy;         // cleared once the backend is seen closing it
+    uint64_t idle_since; // monotonic ms when it was returned to the pool
+} IdleConnection;
+
+/**
+ * @brief   One `backend=host:port` entry. Every worker has its own copy, so
+ *          the pool needs no locking.
+ */
+typedef struct Backend
+{
+    char host[NI_MAXHOST];
+    char port[NI_MAXSERV];
+    struct sockaddr_storage addr; // resolved once, reused for every dial
+    socklen_t addr_len;
+    int resolved;
+
+    IdleConnection *idle; // idle keep-alive connections, most recent last
+    int idle_count;
+    int min_idle;
+    int max_idle;
+    uint64_t idle_timeout_ms;
+
+    size_t active; // connections currently checked out, i.e. outstanding requests
+
+    int fails;              // consecutive failed exchanges
+    uint64_t ejected_until; // monotonic ms until which the balancer skips it
+} Backend;
+
+int backend_init(Backend *backend, const char *spec, const Config *cfg);
+void backend_destroy(Backend *backend);
+void backend_adopt(Backend *backend, Backend *from);
+
+int connect_to_backend(Backend *backend);
+int backend_acquire(Backend *backend, int *reused);
+void backend_release(Backend *backend, int fd, int reusable);
+void backend_maintain(Backend *backend, uint64_t now);
+
+#endif
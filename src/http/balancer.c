@@ -0,0 +1,278 @@
+/**
+ * @file    balancer.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Backend selection policies and passive failure ejection.
+ *
+ * @details Every worker has its own Balancer over its own Backend copies, so
+ *          cursors and failure counters are per worker and need no locking.
+ *          A backend is ejected after max_fails consecutive failures and
+ *          skipped for fail_timeout. Once that passes it gets traffic again,
+ *          and a single further failure ejects it once more.
+ */
+
+#include "balancer.h"
+#include "utils/clock.h"
+
+static uint64_t hash_bytes(const char *data, size_t len);
+static int compare_ring_points(const void *a, const void *b);
+static int backend_usable(const Balancer *balancer, int idx, uint32_t exclude, uint64_t now,
+                          int ignore_ejection);
+static int pick_round_robin(Balancer *balancer, uint32_t exclude, uint64_t now,
+                            int ignore_ejection);
+static int pick_least_conn(Balancer *balancer, uint32_t exclude, uint64_t now,
+                           int ignore_ejection);
+static int pick_hash(Balancer *balancer, uint64_t hash, uint32_t exclude, uint64_t now,
+                     int ignore_ejection);
+
+/**
+ * @brief   Sets up the policy from config and builds the hash ring.
+ *
+ * @returns OK, or -1 on an unknown policy or allocation failure.
+ */
+int balancer_init(Balancer *balancer, Backend *backends, int backend_count, const Config *cfg)
+{
+    memset(balancer, 0, sizeof(Balancer));
+    balancer->backends        = backends;
+    balancer->backend_count   = backend_count;
+    balancer->max_fails       = cfg->backend_max_fails;
+    balancer->fail_timeout_ms = (uint64_t)cfg->backend_fail_timeout * 1000;
+
+    if (!cfg->balance || strcmp(cfg->balance, "round_robin") == 0)
+        balancer->policy = BALANCE_ROUND_ROBIN;
+    else if (strcmp(cfg->balance, "least_conn") == 0)
+        balancer->policy = BALANCE_LEAST_CONN;
+    else if (strcmp(cfg->balance, "hash") == 0)
+        balancer->policy = BALANCE_HASH;
+    else
+    {
+        LOG(ERROR, "Unknown balance policy '%s'.", cfg->balance);
+        return -1;
+    }
+
+    if (balancer->policy != BALANCE_HASH) return OK;
+
+    if (cfg->balance_key && strcasecmp(cfg->balance_key, "uri") != 0)
+    {
+        balancer->hash_header = strdup(cfg->balance_key);
+        if (!balancer->hash_header) return -1;
+    }
+
+    balancer->ring_size = (size_t)backend_count * BALANCER_RING_POINTS;
+    balancer->ring      = malloc(balancer->ring_size * sizeof(RingPoint));
+    if (!balancer->ring) return -1;
+
+    // Points depend only on host:port, so every worker (and every restart)
+    // builds the same ring and a key keeps landing on the same backend.
+    size_t n = 0;
+    for (int i = 0; i < backend_count; i++)
+    {
+        for (int j = 0; j < BALANCER_RING_POINTS; j++)
+        {
+            char point[NI_MAXHOST + NI_MAXSERV + 16];
+            int len = snprintf(point, sizeof(point), "%s:%s#%d", backends[i].host,
+                               backends[i].port, j);
+            balancer->ring[n].hash    = hash_bytes(point, len);
+            balancer->ring[n].backend = i;
+            n++;
+        }
+    }
+    qsort(balancer->ring, balancer->ring_size, sizeof(RingPoint), compare_ring_points);
+
+    return OK;
+}
+
+void balancer_destroy(Balancer *balancer)
+{
+    free(balancer->hash_header);
+    free(balancer->ring);
+    balancer->hash_header = NULL;
+    balancer->ring        = NULL;
+    balancer->ring_size   = 0;
+}
+
+/**
+ * @brief   Chooses the backend for a request.
+ *
+ * Ejected backends and those in @p exclude are skipped. If every remaining
+ * backend is ejected one is chosen anyway, ignoring ejection.
+ *
+ * @param   exclude  Bitmask of backends already tried for this request.
+ *
+ * @returns The chosen backend, NULL if every backend is excluded.
+ */
+Backend *balancer_pick(Balancer *balancer, const HTTPRequest *req, uint32_t exclude)
+{
+    uint64_t now = monotonic_ms();
+    uint64_t key = 0;
+
+    if (balancer->policy == BALANCE_HASH)
+    {
+        const char *data = req->request_line.uri;
+        size_t len       = req->request_line.uri_len;
+
+        if (balancer->hash_header)
+        {
+            size_t name_len = strlen(balancer->hash_header);
+            for (int i = 0; i < req->header_count; i++)
+            {
+                if (req->headers[i].name_len == name_len &&
+                    strncasecmp(req->headers[i].name, balancer->hash_header, name_len) == 0)
+                {
+                    data = req->headers[i].value;
+                    len  = req->headers[i].value_len;
+                    break;
+                }
+            }
+        }
+        key = hash_bytes(data, len);
+    }
+
+    for (int ignore_ejection = 0; ignore_ejection <= 1; ignore_ejection++)
+    {
+        int idx = -1;
+        switch (balancer->policy)
+        {
+        case BALANCE_ROUND_ROBIN:
+            idx = pick_round_robin(balancer, exclude, now, ignore_ejection);
+            break;
+        case BALANCE_LEAST_CONN:
+            idx = pick_least_conn(balancer, exclude, now, ignore_ejection);
+            break;
+        case BALANCE_HASH:
+            idx = pick_hash(balancer, key, exclude, now, ignore_ejection);
+            break;
+        }
+        if (idx >= 0) return &balancer->backends[idx];
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief   Records the outcome of an exchange with @p backend.
+ */
+void balancer_report(Balancer *balancer, Backend *backend, int success)
+{
+    if (success)
+    {
+        backend->fails         = 0;
+        backend->ejected_until = 0;
+        return;
+    }
+
+    backend->fails++;
+    if (balancer->max_fails > 0 && backend->fails >= balancer->max_fails)
+    {
+        if (backend->ejected_until == 0 || backend->ejected_until <= monotonic_ms())
+            LOG(WARNING, "Ejecting backend %s:%s after %d failures.", backend->host,
+                backend->port, backend->fails);
+        backend->ejected_until = monotonic_ms() + balancer->fail_timeout_ms;
+    }
+}
+
+/**
+ * @brief   Bit of @p backend in the exclude mask passed to balancer_pick().
+ */
+uint32_t balancer_mask(const Balancer *balancer, const Backend *backend)
+{
+    return 1u << (backend - balancer->backends);
+}
+
+// ---------- UTILS ----------
+
+/**
+ * @brief   FNV-1a followed by a 64-bit finalizer so nearby keys spread over
+ *          the whole ring.
+ */
+static uint64_t hash_bytes(const char *data, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static int compare_ring_points(const void *a, const void *b)
+{
+    uint64_t ha = ((const RingPoint *)a)->hash;
+    uint64_t hb = ((const RingPoint *)b)->hash;
+    return (ha > hb) - (ha < hb);
+}
+
+static int backend_usable(const Balancer *balancer, int idx, uint32_t exclude, uint64_t now,
+                          int ignore_ejection)
+{
+    if (exclude & (1u << idx)) return 0;
+    return ignore_ejection || balancer->backends[idx].ejected_until <= now;
+}
+
+static int pick_round_robin(Balancer *balancer, uint32_t exclude, uint64_t now,
+                            int ignore_ejection)
+{
+    for (int i = 0; i < balancer->backend_count; i++)
+    {
+        int idx = (balancer->next + i) % balancer->backend_count;
+        if (backend_usable(balancer, idx, exclude, now, ignore_ejection))
+        {
+            balancer->next = idx + 1;
+            return idx;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief   Fewest outstanding requests wins. Scanning starts at a rotating
+ *          offset so ties don't always go to the first backend.
+ */
+static int pick_least_conn(Balancer *balancer, uint32_t exclude, uint64_t now,
+                           int ignore_ejection)
+{
+    int best = -1;
+    for (int i = 0; i < balancer->backend_count; i++)
+    {
+        int idx = (balancer->next + i) % balancer->backend_count;
+        if (!backend_usable(balancer, idx, exclude, now, ignore_ejection)) continue;
+        if (best < 0 || balancer->backends[idx].active < balancer->backends[best].active)
+            best = idx;
+    }
+    balancer->next++;
+    return best;
+}
+
+/**
+ * @brief   First usable backend clockwise from the key's position on the
+ *          ring.
+ */
+static int pick_hash(Balancer *balancer, uint64_t hash, uint32_t exclude, uint64_t now,
+                     int ignore_ejection)
+{
+    if (balancer->ring_size == 0) return -1;
+
+    size_t lo = 0, hi = balancer->ring_size;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (balancer->ring[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (size_t i = 0; i < balancer->ring_size; i++)
+    {
+        int idx = balancer->ring[(lo + i) % balancer->ring_size].backend;
+        if (backend_usable(balancer, idx, exclude, now, ignore_ejection)) return idx;
+    }
+    return -1;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file    balancer.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Backend selection policies and passive failure ejection.
+ *
+ */
+
+#ifndef HTTPBALANCER_H
+#define HTTPBALANCER_H
+
+#include "backend.h"
+#include "request.h"
+
+#define BALANCER_RING_POINTS 160 // virtual nodes per backend on the hash ring
+
+typedef enum
+{
+    BALANCE_ROUND_ROBIN,
+    BALANCE_LEAST_CONN,
+    BALANCE_HASH
+} BalancePolicy;
+
+typedef struct RingPoint
+{
+    uint64_t hash;
+    int backend; // index into Balancer.backends
+} RingPoint;
+
+typedef struct Balancer
+{
+    BalancePolicy policy;
+    char *hash_header; // header hashed by BALANCE_HASH, NULL hashes the URI
+
+    Backend *backends; // borrowed from the worker
+    int backend_count;
+    size_t next; // round-robin cursor
+
+    RingPoint *ring; // consistent hash ring, sorted by hash
+    size_t ring_size;
+
+    int max_fails;            // consecutive failures before ejection, 0 disables it
+    uint64_t fail_timeout_ms; // how long an ejected backend is skipped
+} Balancer;
+
+int balancer_init(Balancer *balancer, Backend *backends, int backend_count, const Config *cfg);
+void balancer_destroy(Balancer *balancer);
+
+Backend *balancer_pick(Balancer *balancer, const HTTPRequest *req, uint32_t exclude);
+void balancer_report(Balancer *balancer, Backend *backend, int success);
+uint32_t balancer_mask(const Balancer *balancer, const Backend *backend);
+
+#endif
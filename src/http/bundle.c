@@ -0,0 +1,549 @@
+/**
+ * @file    bundle.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Static asset bundle implementations.
+ *
+ * @details cserver-pack reads a directory once and stores every file in it
+ *          as a ready 200 response, head and body, with br and gzip variants
+ *          for text: .br / .gz siblings, or a gzipped copy made while
+ *          packing. The heads, ETags and MIME types are the ones serving the
+ *          same files from disk would produce.
+ *
+ *          The server maps the bundle read-only. A lookup is one hash probe,
+ *          the response is queued by reference into the mapping, and the
+ *          page cache keeps it warm across restarts. A new bundle is written
+ *          next to the old one and renamed over it, so a mapping in use is
+ *          never modified; a reload maps the new one.
+ */
+
+#include <dirent.h>
+#include <sys/mman.h>
+#include "bundle.h"
+#include "parsers.h"
+#include "static.h"
+
+_Static_assert(BUNDLE_ETAG_SIZE == STATIC_ETAG_SIZE, "bundle ETags are static ETags");
+
+/**
+ * @brief   State of one cserver-pack run.
+ */
+typedef struct Packer
+{
+    int fd;              // output, written sequentially
+    uint64_t pos;        // bytes written so far
+    struct stat skip[2]; // the output and the bundle it replaces, never packed
+    char **paths;        // request paths of the files found, "/" + path from the root
+    size_t count;        // entries in paths
+    size_t capacity;     // allocated entries of paths
+    BundleFile *files;   // one per path, in the same order
+} Packer;
+
+static int bundle_check(const Bundle *bundle);
+static int bundle_in_bounds(const Bundle *bundle, uint64_t offset, uint64_t len);
+static int pack_collect(Packer *packer, const char *dir);
+static int pack_add_path(Packer *packer, const char *path);
+static int pack_file(Packer *packer, BundleFile *file, const char *path);
+static int pack_variant(Packer *packer, BundleVariant *variant, const char *mime, int encoding,
+                        int vary, const char *body, size_t len, const struct stat *st,
+                        int transformed);
+static int pack_index(Packer *packer, BundleHeader *header, const char *prefix);
+static int pack_write(Packer *packer, const void *data, size_t len);
+static int pack_align(Packer *packer);
+static char *read_file(const char *path, struct stat *st);
+static int compare_paths(const void *a, const void *b);
+static uint64_t hash_path(const char *path, size_t len);
+
+/**
+ * @brief   Maps the bundle at @p path. @p bundle stays unmapped on failure.
+ *
+ * @returns OK, -1 if the file can't be mapped or isn't a bundle of this
+ *          version.
+ */
+int bundle_open(Bundle *bundle, const char *path)
+{
+    memset(bundle, 0, sizeof(*bundle));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG(ERROR, "Failed to open static bundle %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(BundleHeader))
+    {
+        LOG(ERROR, "%s is not a static bundle.", path);
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file
+    if (map == MAP_FAILED)
+    {
+        LOG(ERROR, "Failed to map static bundle %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    bundle->map     = map;
+    bundle->size    = st.st_size;
+    bundle->header  = map;
+    bundle->files   = (const BundleFile *)(bundle->map + bundle->header->files);
+    bundle->buckets = (const uint32_t *)(bundle->map + bundle->header->buckets);
+    if (bundle_check(bundle) < 0)
+    {
+        LOG(ERROR, "%s is not a static bundle of version %d.", path, BUNDLE_VERSION);
+        bundle_close(bundle);
+        return -1;
+    }
+
+    // Start reading it in now rather than on first requests
+    madvise(map, bundle->size, MADV_WILLNEED);
+    LOG(INFO, "Mapped static bundle %s, %u files.", path, bundle->header->file_count);
+    return OK;
+}
+
+void bundle_close(Bundle *bundle)
+{
+    if (bundle->map) munmap((void *)bundle->map, bundle->size);
+    memset(bundle, 0, sizeof(*bundle));
+}
+
+/**
+ * @brief   Whether @p path is below the directory the bundle was packed
+ *          from. The bundle has every file there, others come from disk.
+ */
+int bundle_covers(const Bundle *bundle, const char *path, size_t len)
+{
+    if (!bundle->map) return 0;
+
+    size_t prefix_len = bundle->header->prefix_len;
+    return len > prefix_len && path[prefix_len] == '/' &&
+           memcmp(path, bundle->map + bundle->header->prefix, prefix_len) == 0;
+}
+
+/**
+ * @returns The file with request path @p path, NULL if there is none.
+ */
+const BundleFile *bundle_lookup(const Bundle *bundle, const char *path, size_t len)
+{
+    uint64_t hash = hash_path(path, len);
+    uint32_t mask = bundle->header->bucket_count - 1;
+
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        uint32_t index = bundle->buckets[i];
+        if (index == 0) return NULL;
+
+        const BundleFile *file = &bundle->files[index - 1];
+        if (file->hash == hash && file->path_len == len &&
+            memcmp(bundle->map + file->path, path, len) == 0)
+            return file;
+    }
+}
+
+/**
+ * @brief   Packs every regular file below @p dir into a bundle at @p output.
+ *
+ * @p dir is relative to the directory the server runs in, its files get
+ * the request paths they have there: "static/app.js" is "/static/app.js".
+ * Symbolic links to files are followed, to directories not. The bundle is
+ * written to "<output>.tmp" and renamed to @p output when complete.
+ *
+ * @returns OK, -1 on error.
+ */
+int bundle_pack(const char *dir, const char *output)
+{
+    // "./static/" packs as "static", "." as the whole root
+    while (dir[0] == '.' && dir[1] == '/')
+        dir += 2;
+    char prefix[PATH_MAX];
+    int prefix_len = snprintf(prefix, sizeof(prefix), "%s", strcmp(dir, ".") == 0 ? "" : dir);
+    while (prefix_len > 0 && prefix[prefix_len - 1] == '/')
+        prefix[--prefix_len] = '\0';
+    if (prefix_len < 0 || dir[0] == '/' || strstr(prefix, ".."))
+    {
+        LOG(ERROR, "%s has to be a directory below the server root.", dir);
+        return -1;
+    }
+
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", output);
+
+    Packer packer;
+    memset(&packer, 0, sizeof(packer));
+    packer.fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (packer.fd < 0)
+    {
+        LOG(ERROR, "Failed to create %s: %s", tmp, strerror(errno));
+        return -1;
+    }
+    fstat(packer.fd, &packer.skip[0]);
+    if (stat(output, &packer.skip[1]) < 0) packer.skip[1] = packer.skip[0];
+
+    int status = -1;
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    if (pack_write(&packer, &header, sizeof(header)) < 0 ||
+        pack_collect(&packer, prefix_len ? prefix : ".") < 0)
+        goto out;
+
+    qsort(packer.paths, packer.count, sizeof(char *), compare_paths);
+    packer.files = calloc(packer.count ? packer.count : 1, sizeof(BundleFile));
+    if (!packer.files) goto out;
+    for (size_t i = 0; i < packer.count; i++)
+    {
+        if (pack_file(&packer, &packer.files[i], packer.paths[i]) < 0) goto out;
+    }
+
+    char request_prefix[PATH_MAX + 1] = "";
+    if (prefix_len) snprintf(request_prefix, sizeof(request_prefix), "/%s", prefix);
+    if (pack_index(&packer, &header, request_prefix) < 0 ||
+        pwrite(packer.fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+        goto out;
+    if (rename(tmp, output) < 0)
+    {
+        LOG(ERROR, "Failed to rename %s to %s: %s", tmp, output, strerror(errno));
+        goto out;
+    }
+
+    LOG(INFO, "Packed %zu files from %s into %s (%llu bytes).", packer.count,
+        prefix_len ? prefix : ".", output, (unsigned long long)packer.pos);
+    status = OK;
+
+out:
+    close(packer.fd);
+    if (status < 0) unlink(tmp);
+    for (size_t i = 0; i < packer.count; i++)
+        free(packer.paths[i]);
+    free(packer.paths);
+    free(packer.files);
+    return status;
+}
+
+// ---------- UTILS ----------
+
+/**
+ * @brief   Checks that everything the header and file table point at lies
+ *          inside the mapping, so lookups need no checks.
+ */
+static int bundle_check(const Bundle *bundle)
+{
+    const BundleHeader *header = bundle->header;
+    if (memcmp(header->magic, BUNDLE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != BUNDLE_VERSION || header->size != bundle->size)
+        return -1;
+
+    uint32_t buckets = header->bucket_count;
+    if (buckets == 0 || (buckets & (buckets - 1)) != 0 || buckets <= header->file_count ||
+        header->files % 8 != 0 || header->buckets % 4 != 0 ||
+        !bundle_in_bounds(bundle, header->prefix, header->prefix_len) ||
+        !bundle_in_bounds(bundle, header->files,
+                          (uint64_t)header->file_count * sizeof(BundleFile)) ||
+        !bundle_in_bounds(bundle, header->buckets, (uint64_t)buckets * sizeof(uint32_t)))
+        return -1;
+
+    for (uint32_t i = 0; i < buckets; i++)
+    {
+        if (bundle->buckets[i] > header->file_count) return -1;
+    }
+
+    for (uint32_t i = 0; i < header->file_count; i++)
+    {
+        const BundleFile *file = &bundle->files[i];
+        if (!bundle_in_bounds(bundle, file->path, file->path_len) ||
+            !bundle_in_bounds(bundle, file->mime, 1) ||
+            !memchr(bundle->map + file->mime, '\0', bundle->size - file->mime))
+            return -1;
+
+        for (int enc = 0; enc < ENC_COUNT; enc++)
+        {
+            const BundleVariant *variant = &file->variants[enc];
+            if ((variant->offset || enc == ENC_IDENTITY) &&
+                (variant->body_len > bundle->size ||
+                 !bundle_in_bounds(bundle, variant->offset,
+                                   variant->head_len + variant->body_len) ||
+                 !memchr(variant->etag, '\0', sizeof(variant->etag))))
+                return -1;
+        }
+    }
+    return OK;
+}
+
+static int bundle_in_bounds(const Bundle *bundle, uint64_t offset, uint64_t len)
+{
+    return offset <= bundle->size && len <= bundle->size - offset;
+}
+
+/**
+ * @brief   Adds the regular files below @p dir to the packer's paths.
+ */
+static int pack_collect(Packer *packer, const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+    {
+        LOG(ERROR, "Failed to open directory %s: %s", dir, strerror(errno));
+        return -1;
+    }
+
+    int status = OK;
+    struct dirent *ent;
+    while (status == OK && (ent = readdir(d)) != NULL)
+    {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+
+        char path[PATH_MAX];
+        int len = strcmp(dir, ".") == 0 ? snprintf(path, sizeof(path), "%s", ent->d_name)
+                                        : snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (len < 0 || (size_t)len >= sizeof(path)) continue;
+
+        struct stat st, lst;
+        if (stat(path, &st) < 0 || lstat(path, &lst) < 0) continue;
+        if (S_ISDIR(st.st_mode) && !S_ISLNK(lst.st_mode))
+        {
+            status = pack_collect(packer, path);
+        }
+        else if (S_ISREG(st.st_mode))
+        {
+            int skipped = 0;
+            for (int i = 0; i < 2; i++)
+                skipped |= st.st_dev == packer->skip[i].st_dev &&
+                           st.st_ino == packer->skip[i].st_ino;
+            if (!skipped) status = pack_add_path(packer, path);
+        }
+    }
+
+    closedir(d);
+    return status;
+}
+
+static int pack_add_path(Packer *packer, const char *path)
+{
+    if (packer->count == packer->capacity)
+    {
+        size_t capacity = packer->capacity ? packer->capacity * 2 : 256;
+        char **paths    = realloc(packer->paths, capacity * sizeof(char *));
+        if (!paths) return -1;
+        packer->paths    = paths;
+        packer->capacity = capacity;
+    }
+
+    size_t len   = strlen(path);
+    char *request = malloc(len + 2);
+    if (!request) return -1;
+    request[0] = '/';
+    memcpy(request + 1, path, len + 1);
+    packer->paths[packer->count++] = request;
+    return OK;
+}
+
+/**
+ * @brief   Writes the variants of the file at request path @p path, the
+ *          same ones static_file_handler() would find on disk.
+ */
+static int pack_file(Packer *packer, BundleFile *file, const char *path)
+{
+    struct stat st;
+    char *body = read_file(path + 1, &st);
+    if (!body)
+    {
+        LOG(ERROR, "Failed to read %s: %s", path + 1, strerror(errno));
+        return -1;
+    }
+
+    const char *mime = get_mime_type(path + 1);
+    int vary         = static_compressible(mime);
+    file->hash       = hash_path(path, strlen(path));
+    file->path_len   = strlen(path);
+    file->vary       = vary;
+
+    int status = pack_variant(packer, &file->variants[ENC_IDENTITY], mime, ENC_IDENTITY, vary,
+                              body, st.st_size, &st, 0);
+    if (status == OK && vary)
+    {
+        static const struct
+        {
+            const char *suffix;
+            int encoding;
+        } siblings[] = {{".br", ENC_BR}, {".gz", ENC_GZIP}};
+
+        char sibling_path[PATH_MAX];
+        for (size_t i = 0; status == OK && i < sizeof(siblings) / sizeof(siblings[0]); i++)
+        {
+            struct stat sibling_st;
+            snprintf(sibling_path, sizeof(sibling_path), "%s%s", path + 1, siblings[i].suffix);
+            char *sibling = read_file(sibling_path, &sibling_st);
+            if (!sibling) continue;
+            status = pack_variant(packer, &file->variants[siblings[i].encoding], mime,
+                                  siblings[i].encoding, vary, sibling, sibling_st.st_size,
+                                  &sibling_st, 0);
+            free(sibling);
+        }
+
+        // Without a .gz sibling gzip it here, as static_compress would
+        if (status == OK && !file->variants[ENC_GZIP].offset && st.st_size >= STATIC_COMPRESS_MIN)
+        {
+            size_t gz_len;
+            char *gz = gzip_compress(body, st.st_size, &gz_len);
+            if (gz && gz_len < (size_t)st.st_size)
+                status = pack_variant(packer, &file->variants[ENC_GZIP], mime, ENC_GZIP, vary, gz,
+                                      gz_len, &st, 1);
+            free(gz);
+        }
+    }
+    free(body);
+    return status;
+}
+
+/**
+ * @brief   Writes one variant's 200 response head and body.
+ *
+ * @param   st           The file @p body is, or was gzipped from.
+ * @param   transformed  Whether @p body was gzipped here.
+ */
+static int pack_variant(Packer *packer, BundleVariant *variant, const char *mime, int encoding,
+                        int vary, const char *body, size_t len, const struct stat *st,
+                        int transformed)
+{
+    static_write_etag(variant->etag, st->st_ino, st->st_size, st->st_mtim.tv_sec, transformed);
+
+    char head[STATIC_HEAD_SIZE];
+    int head_len = static_write_head(head, sizeof(head), mime, encoding, vary, len, variant->etag,
+                                     st->st_mtim.tv_sec);
+    if (head_len < 0) return -1;
+
+    variant->offset      = packer->pos;
+    variant->body_len    = len;
+    variant->ino         = st->st_ino;
+    variant->mtime       = st->st_mtim.tv_sec;
+    variant->head_len    = head_len;
+    variant->transformed = transformed;
+    if (pack_write(packer, head, head_len) < 0 || pack_write(packer, body, len) < 0) return -1;
+    return OK;
+}
+
+/**
+ * @brief   Writes the strings, the file table and the hash buckets behind
+ *          the bodies and fills in @p header.
+ */
+static int pack_index(Packer *packer, BundleHeader *header, const char *prefix)
+{
+    memcpy(header->magic, BUNDLE_MAGIC, sizeof(header->magic));
+    header->version    = BUNDLE_VERSION;
+    header->file_count = packer->count;
+    header->prefix_len = strlen(prefix);
+    header->prefix     = packer->pos;
+    if (pack_write(packer, prefix, header->prefix_len + 1) < 0) return -1;
+
+    for (size_t i = 0; i < packer->count; i++)
+    {
+        BundleFile *file = &packer->files[i];
+        const char *mime = get_mime_type(packer->paths[i]);
+        file->path       = packer->pos;
+        if (pack_write(packer, packer->paths[i], file->path_len + 1) < 0) return -1;
+        file->mime = packer->pos;
+        if (pack_write(packer, mime, strlen(mime) + 1) < 0) return -1;
+    }
+
+    if (pack_align(packer) < 0) return -1;
+    header->files = packer->pos;
+    if (pack_write(packer, packer->files, packer->count * sizeof(BundleFile)) < 0) return -1;
+
+    // Linear probing, at most half full
+    uint32_t bucket_count = 2;
+    while (bucket_count < 2 * packer->count)
+        bucket_count *= 2;
+    uint32_t *buckets = calloc(bucket_count, sizeof(uint32_t));
+    if (!buckets) return -1;
+    for (size_t i = 0; i < packer->count; i++)
+    {
+        uint32_t slot = packer->files[i].hash & (bucket_count - 1);
+        while (buckets[slot])
+            slot = (slot + 1) & (bucket_count - 1);
+        buckets[slot] = i + 1;
+    }
+
+    header->bucket_count = bucket_count;
+    header->buckets      = packer->pos;
+    int status           = pack_write(packer, buckets, bucket_count * sizeof(uint32_t));
+    free(buckets);
+    header->size = packer->pos;
+    return status;
+}
+
+static int pack_write(Packer *packer, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0)
+    {
+        ssize_t written = write(packer->fd, p, len);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            LOG(ERROR, "Failed to write the bundle: %s", strerror(errno));
+            return -1;
+        }
+        p += written;
+        len -= written;
+        packer->pos += written;
+    }
+    return OK;
+}
+
+/**
+ * @brief   Pads to 8 bytes, so the mapped file table is aligned.
+ */
+static int pack_align(Packer *packer)
+{
+    static const char zeros[8];
+    return pack_write(packer, zeros, (8 - packer->pos % 8) % 8);
+}
+
+/**
+ * @returns The contents of the regular file @p path, NULL if it is none or
+ *          can't be read.
+ */
+static char *read_file(const char *path, struct stat *st)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    char *data = NULL;
+    if (fstat(fd, st) == 0 && S_ISREG(st->st_mode) && (data = malloc(st->st_size + 1)) != NULL)
+    {
+        size_t done = 0;
+        while (done < (size_t)st->st_size)
+        {
+            ssize_t n = read(fd, data + done, st->st_size - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            done += n;
+        }
+        if (done < (size_t)st->st_size)
+        {
+            free(data);
+            data = NULL;
+        }
+    }
+    close(fd);
+    return data;
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static uint64_t hash_path(const char *path, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)path[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file    bundle.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Memory-mapped static asset bundle made by cserver-pack.
+ *
+ */
+
+#ifndef HTTPBUNDLE_H
+#define HTTPBUNDLE_H
+
+#include "common.h"
+#include "utils/compress.h"
+
+#define BUNDLE_MAGIC "CSBUNDLE" // 8 bytes, no NUL
+#define BUNDLE_VERSION 1        // bumped with any change of the layout below
+#define BUNDLE_ETAG_SIZE 64     // STATIC_ETAG_SIZE
+
+/*
+ * Layout, native byte order, offsets from the start of the file:
+ * BundleHeader, then per variant its response head followed by the body,
+ * then the NUL-terminated paths and MIME types, the BundleFile table and
+ * the hash buckets.
+ */
+
+/**
+ * @brief   One representation of a file: the file itself, or a br / gzip
+ *          body for clients accepting it.
+ */
+typedef struct BundleVariant
+{
+    uint64_t offset;             // head of the 200 response, body right behind; 0 = none
+    uint64_t body_len;           // bytes of body
+    uint64_t ino;                // inode of the file the body is, or was made from
+    int64_t mtime;               // its mtime, for Last-Modified and If-Modified-Since
+    uint32_t head_len;           // bytes of head
+    uint32_t transformed;        // gzipped by cserver-pack, not a .gz sibling
+    char etag[BUNDLE_ETAG_SIZE]; // quoted entity tag, the one serving from disk would use
+} BundleVariant;
+
+typedef struct BundleFile
+{
+    uint64_t hash;                     // hash of the path
+    uint64_t path;                     // offset of the request path, e.g. "/static/app.js"
+    uint64_t mime;                     // offset of the Content-Type
+    uint32_t path_len;                 // bytes of path
+    uint32_t vary;                     // compressible, heads carry Vary: Accept-Encoding
+    BundleVariant variants[ENC_COUNT]; // indexed by ContentEncoding
+} BundleFile;
+
+typedef struct BundleHeader
+{
+    char magic[8];         // BUNDLE_MAGIC
+    uint32_t version;      // BUNDLE_VERSION
+    uint32_t file_count;   // entries in the file table
+    uint32_t bucket_count; // power of two, more than file_count
+    uint32_t prefix_len;   // bytes of prefix
+    uint64_t prefix;       // offset of the path of the packed directory, "" for the root
+    uint64_t files;        // offset of the BundleFile table, sorted by path
+    uint64_t buckets;      // offset of the buckets: file index + 1, 0 = empty
+    uint64_t size;         // bytes of the whole bundle
+} BundleHeader;
+
+/**
+ * @brief   An open bundle. Read-only once mapped, so every worker shares it.
+ */
+typedef struct Bundle
+{
+    const char *map; // whole file, NULL when no bundle is configured
+    size_t size;
+    const BundleHeader *header;
+    const BundleFile *files;
+    const uint32_t *buckets;
+} Bundle;
+
+int bundle_open(Bundle *bundle, const char *path);
+void bundle_close(Bundle *bundle);
+int bundle_covers(const Bundle *bundle, const char *path, size_t len);
+const BundleFile *bundle_lookup(const Bundle *bundle, const char *path, size_t len);
+
+int bundle_pack(const char *dir, const char *output);
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file    canned.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Canned response implementations.
+ *
+ * @details Every error the server produces by itself has the same bytes
+ *          each time, so they are formatted once at startup, in a keep-alive
+ *          and a "Connection: close" variant, and queued by reference. An
+ *          error flood from a scanner costs no allocation or formatting.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include "canned.h"
+#include "common.h"
+
+typedef struct
+{
+    int status_code;
+    const char *phrase;
+} CannedStatus;
+
+static const CannedStatus statuses[] = {
+    {400, "Bad Request"},
+    {403, "Forbidden"},
+    {404, "Not Found"},
+    {405, "Method Not Allowed"},
+    {408, "Request Timeout"},
+    {411, "Length Required"},
+    {413, "Content Too Large"},
+    {414, "URI Too Long"},
+    {431, "Request Header Fields Too Large"},
+    {500, "Internal Server Error"},
+    {501, "Not Implemented"},
+    {502, "Bad Gateway"},
+    {503, "Service Unavailable"},
+    {504, "Gateway Timeout"},
+    {505, "HTTP Version Not Supported"},
+};
+
+static char storage[CANNED_STORAGE];
+static CannedResponse canned[CANNED_MAX_STATUS - CANNED_MIN_STATUS + 1][2];
+static pthread_once_t canned_once = PTHREAD_ONCE_INIT;
+static int canned_status          = -1;
+
+static void canned_build(void);
+
+/**
+ * @brief   Formats the table. Safe to call more than once.
+ *
+ * @returns OK, or -1 if CANNED_STORAGE is too small.
+ */
+int canned_init(void)
+{
+    pthread_once(&canned_once, canned_build);
+    return canned_status;
+}
+
+/**
+ * @returns The canned response for @p status_code, the variant closing the
+ *          connection unless @p keep_alive, or NULL if there is none.
+ */
+const CannedResponse *canned_response(int status_code, int keep_alive)
+{
+    if (status_code < CANNED_MIN_STATUS || status_code > CANNED_MAX_STATUS) return NULL;
+
+    const CannedResponse *res = &canned[status_code - CANNED_MIN_STATUS][keep_alive ? 1 : 0];
+    return res->data ? res : NULL;
+}
+
+// ---------- UTILS ----------
+
+static void canned_build(void)
+{
+    size_t used = 0;
+
+    for (size_t i = 0; i < sizeof(statuses) / sizeof(statuses[0]); i++)
+    {
+        const CannedStatus *st = &statuses[i];
+        char body[96];
+        int body_len = snprintf(body, sizeof(body), "<h1>%d %s</h1>", st->status_code, st->phrase);
+
+        for (int keep_alive = 0; keep_alive < 2; keep_alive++)
+        {
+            int len = snprintf(storage + used, sizeof(storage) - used,
+                               "HTTP/1.1 %d %s\r\n"
+                               "Content-Type: text/html\r\n"
+                               "Content-Length: %d\r\n"
+                               "%s"
+                               "\r\n"
+                               "%s",
+                               st->status_code, st->phrase, body_len,
+                               keep_alive ? "" : "Connection: close\r\n", body);
+            if (len < 0 || (size_t)len >= sizeof(storage) - used)
+            {
+                LOG(ERROR, "Canned responses don't fit in %d bytes.", CANNED_STORAGE);
+                return;
+            }
+
+            CannedResponse *res = &canned[st->status_code - CANNED_MIN_STATUS][keep_alive];
+            res->data           = storage + used;
+            res->len            = (size_t)len;
+            used += (size_t)len;
+        }
+    }
+    canned_status = OK;
+}
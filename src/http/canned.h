@@ -0,0 +1,31 @@
+/**
+ * @file    canned.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Preserialized responses for error and fixed-status replies.
+ *
+ */
+
+#ifndef HTTPCANNED_H
+#define HTTPCANNED_H
+
+#include <stddef.h>
+
+#define CANNED_MIN_STATUS 400
+#define CANNED_MAX_STATUS 599
+#define CANNED_STORAGE 16384 // bytes for every canned response together
+
+/**
+ * @brief   A complete response, head and body, in static memory that is
+ *          never written after canned_init().
+ */
+typedef struct CannedResponse
+{
+    const char *data;
+    size_t len;
+} CannedResponse;
+
+int canned_init(void);
+const CannedResponse *canned_response(int status_code, int keep_alive);
+
+#endif
@@ -0,0 +1,277 @@
+/**
+ * @file    conditional.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Conditional request and Range header implementations.
+ *
+ * @details Evaluates If-None-Match / If-Modified-Since and Range / If-Range
+ *          against the validators of a representation, following the order
+ *          of RFC 9110 section 13.2.2. If-Match and If-Unmodified-Since are
+ *          left out, they only matter for state-changing methods.
+ */
+
+#include <strings.h>
+#include "conditional.h"
+
+static int method_is(const HTTPRequest *req, const char *method);
+static int etag_listed(const char *list, size_t len, const Validators *validators);
+static int parse_range(const char *spec, size_t len, size_t size, ByteRange *range);
+static int add_range(ByteRange ranges[RANGES_MAX], int count, ByteRange range);
+static int parse_size_digits(const char *digits, size_t len, size_t *out);
+static void trim(const char **start, const char **end);
+
+/**
+ * @brief   Whether a GET or HEAD request can be answered with 304 Not
+ *          Modified. If-None-Match takes precedence, If-Modified-Since is
+ *          only looked at without it.
+ */
+int request_not_modified(const HTTPRequest *req, const Validators *validators)
+{
+    if (!method_is(req, "GET") && !method_is(req, "HEAD")) return 0;
+
+    const HTTPHeader *none_match = get_http_header(req, HDR_IF_NONE_MATCH);
+    if (none_match) return etag_listed(none_match->value, none_match->value_len, validators);
+
+    const HTTPHeader *since = get_http_header(req, HDR_IF_MODIFIED_SINCE);
+    time_t date;
+    if (since && parse_http_date(since->value, since->value_len, &date) == OK)
+        return validators->last_modified <= date;
+
+    return 0;
+}
+
+/**
+ * @brief   Parses the Range header of a GET request for a body of @p size
+ *          bytes. Overlong ranges are clipped to the body, overlapping and
+ *          adjacent ones are merged.
+ *
+ * The header is ignored (the whole body is served) if it isn't a valid
+ * bytes range set, names more than RANGES_MAX ranges after merging or
+ * If-Range doesn't match the current validators.
+ *
+ * @returns Number of ranges stored in @p ranges, 0 to serve the whole
+ *          body, -1 if no range overlaps the body (416).
+ */
+int request_ranges(const HTTPRequest *req, const Validators *validators, size_t size,
+                   ByteRange ranges[RANGES_MAX])
+{
+    const HTTPHeader *range = get_http_header(req, HDR_RANGE);
+    if (!range || !method_is(req, "GET") || (req->repeated & HDR_BIT(HDR_RANGE))) return 0;
+
+    // If-Range: a strong entity tag or the exact Last-Modified date
+    const HTTPHeader *if_range = get_http_header(req, HDR_IF_RANGE);
+    if (if_range)
+    {
+        time_t date;
+        if (if_range->value_len > 0 && if_range->value[0] == '"')
+        {
+            if (if_range->value_len != validators->etag_len ||
+                memcmp(if_range->value, validators->etag, validators->etag_len) != 0)
+                return 0;
+        }
+        else if (parse_http_date(if_range->value, if_range->value_len, &date) < 0 ||
+                 date != validators->last_modified)
+        {
+            return 0;
+        }
+    }
+
+    const char *p   = range->value;
+    const char *end = p + range->value_len;
+    if (end - p < 6 || strncasecmp(p, "bytes=", 6) != 0) return 0;
+    p += 6;
+
+    int count       = 0;
+    int unsatisfied = 0;
+    while (p < end)
+    {
+        const char *comma    = memchr(p, ',', end - p);
+        const char *spec     = p;
+        const char *spec_end = comma ? comma : end;
+        p                    = comma ? comma + 1 : end;
+
+        trim(&spec, &spec_end);
+        if (spec == spec_end) continue; // empty list elements are allowed
+
+        ByteRange parsed;
+        int status = parse_range(spec, spec_end - spec, size, &parsed);
+        if (status < 0) return 0;
+        if (status == 0)
+        {
+            unsatisfied++;
+            continue;
+        }
+        count = add_range(ranges, count, parsed);
+        if (count < 0) return 0;
+    }
+
+    if (count == 0) return unsatisfied > 0 ? -1 : 0;
+    return count;
+}
+
+/**
+ * @brief   Parses an HTTP-date in any of the three formats of RFC 9110
+ *          section 5.6.7.
+ *
+ * @returns OK, or -1 if @p value isn't a date.
+ */
+int parse_http_date(const char *value, size_t len, time_t *out)
+{
+    static const char *formats[] = {
+        "%a, %d %b %Y %H:%M:%S GMT", // IMF-fixdate
+        "%A, %d-%b-%y %H:%M:%S GMT", // obsolete RFC 850
+        "%a %b %e %H:%M:%S %Y",      // obsolete asctime()
+    };
+
+    char date[64];
+    if (len >= sizeof(date)) return -1;
+    memcpy(date, value, len);
+    date[len] = '\0';
+
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        struct tm tm = {0};
+        const char *parsed = strptime(date, formats[i], &tm);
+        if (parsed && *parsed == '\0')
+        {
+            *out = timegm(&tm);
+            return OK;
+        }
+    }
+    return -1;
+}
+
+// ---------- UTILS ----------
+
+static int method_is(const HTTPRequest *req, const char *method)
+{
+    size_t len = strlen(method);
+    return req->request_line.method_len == len &&
+           memcmp(req->request_line.method, method, len) == 0;
+}
+
+/**
+ * @brief   Weak comparison of every entity tag in an If-None-Match list with
+ *          ours, "*" matching any.
+ */
+static int etag_listed(const char *list, size_t len, const Validators *validators)
+{
+    const char *p   = list;
+    const char *end = list + len;
+    while (p < end)
+    {
+        const char *comma   = memchr(p, ',', end - p);
+        const char *tag     = p;
+        const char *tag_end = comma ? comma : end;
+        p                   = comma ? comma + 1 : end;
+
+        trim(&tag, &tag_end);
+        if (tag_end - tag == 1 && *tag == '*') return 1;
+        if (tag_end - tag > 2 && tag[0] == 'W' && tag[1] == '/') tag += 2;
+        if ((size_t)(tag_end - tag) == validators->etag_len &&
+            memcmp(tag, validators->etag, validators->etag_len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief   Parses one "first-last", "first-" or "-suffix" range.
+ *
+ * @returns 1 with @p range set, 0 if it doesn't overlap the body, -1 if it
+ *          is malformed.
+ */
+static int parse_range(const char *spec, size_t len, size_t size, ByteRange *range)
+{
+    const char *dash = memchr(spec, '-', len);
+    if (!dash) return -1;
+    size_t first_len = dash - spec;
+    size_t last_len  = len - first_len - 1;
+
+    size_t first, last;
+    if (first_len == 0)
+    {
+        // Suffix: the final bytes of the body
+        if (parse_size_digits(dash + 1, last_len, &last) < 0) return -1;
+        if (last == 0 || size == 0) return 0;
+        range->start  = last < size ? size - last : 0;
+        range->length = size - range->start;
+        return 1;
+    }
+
+    if (parse_size_digits(spec, first_len, &first) < 0) return -1;
+    if (last_len == 0)
+    {
+        last = SIZE_MAX;
+    }
+    else
+    {
+        if (parse_size_digits(dash + 1, last_len, &last) < 0) return -1;
+        if (last < first) return -1;
+    }
+
+    if (first >= size) return 0;
+    if (last >= size) last = size - 1;
+    range->start  = first;
+    range->length = last - first + 1;
+    return 1;
+}
+
+/**
+ * @brief   Adds @p range to the @p count disjoint ones in @p ranges, merged
+ *          into the first it overlaps or touches, so "bytes=0-,0-,0-" sends
+ *          the body once. The client's order is kept otherwise.
+ *
+ * @returns The new count, -1 if that would exceed RANGES_MAX.
+ */
+static int add_range(ByteRange ranges[RANGES_MAX], int count, ByteRange range)
+{
+    int kept = 0;
+    int into = -1;
+    for (int i = 0; i < count; i++)
+    {
+        ByteRange known = ranges[i];
+        size_t known_end = known.start + known.length;
+        size_t range_end = range.start + range.length;
+        if (range.start > known_end || known.start > range_end)
+        {
+            ranges[kept++] = known;
+            continue;
+        }
+
+        range.start  = known.start < range.start ? known.start : range.start;
+        range.length = (known_end > range_end ? known_end : range_end) - range.start;
+        if (into < 0) into = kept++;
+    }
+
+    if (into >= 0)
+    {
+        ranges[into] = range;
+        return kept;
+    }
+    if (kept == RANGES_MAX) return -1;
+    ranges[kept++] = range;
+    return kept;
+}
+
+static int parse_size_digits(const char *digits, size_t len, size_t *out)
+{
+    if (len == 0) return -1;
+
+    size_t value = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!isdigit((unsigned char)digits[i]) || value > (SIZE_MAX - 9) / 10) return -1;
+        value = value * 10 + (digits[i] - '0');
+    }
+    *out = value;
+    return OK;
+}
+
+static void trim(const char **start, const char **end)
+{
+    while (*start < *end && (**start == ' ' || **start == '\t'))
+        (*start)++;
+    while (*end > *start && ((*end)[-1] == ' ' || (*end)[-1] == '\t'))
+        (*end)--;
+}
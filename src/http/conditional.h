@@ -0,0 +1,38 @@
+/**
+ * @file    conditional.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Conditional request and Range header prototypes.
+ *
+ */
+
+#ifndef HTTPCONDITIONAL_H
+#define HTTPCONDITIONAL_H
+
+#include <time.h>
+#include "request.h"
+
+#define RANGES_MAX 6 // ranges answered in one 206, more are served whole
+
+typedef struct ByteRange
+{
+    size_t start;
+    size_t length;
+} ByteRange;
+
+/**
+ * @brief   Validators of the representation a request is answered with.
+ */
+typedef struct Validators
+{
+    const char *etag; // quoted strong entity tag
+    size_t etag_len;
+    time_t last_modified;
+} Validators;
+
+int request_not_modified(const HTTPRequest *req, const Validators *validators);
+int request_ranges(const HTTPRequest *req, const Validators *validators, size_t size,
+                   ByteRange ranges[RANGES_MAX]);
+int parse_http_date(const char *value, size_t len, time_t *out);
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * @file    connpool.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Connection pool implementations.
+ *
+ * @details The pool starts empty and grows a slab at a time up to the
+ *          configured max_connections, so idle workers don't pay for the
+ *          worst case and accept() cost doesn't depend on how many sockets
+ *          are open.
+ */
+
+#include "connpool.h"
+#include "server.h"
+
+static int connpool_grow(ConnectionPool *pool);
+
+int connpool_init(ConnectionPool *pool, size_t max)
+{
+    memset(pool, 0, sizeof(ConnectionPool));
+    pool->max = max;
+
+    pool->slabs = calloc((max + CONNPOOL_SLAB - 1) / CONNPOOL_SLAB, sizeof(Connection *));
+    return pool->slabs || max == 0 ? OK : -1;
+}
+
+void connpool_destroy(ConnectionPool *pool)
+{
+    for (size_t i = 0; i < pool->slab_count; i++)
+        free(pool->slabs[i]);
+    free(pool->slabs);
+    memset(pool, 0, sizeof(ConnectionPool));
+}
+
+/**
+ * @returns A zeroed slot, or NULL once max_connections are in use. Slots
+ *          released in the current batch don't count as free yet, handing
+ *          one out would let its stale events reach the new client.
+ */
+Connection *connpool_get(ConnectionPool *pool)
+{
+    if (!pool->free_list && connpool_grow(pool) < 0) return NULL;
+
+    Connection *conn = pool->free_list;
+    pool->free_list  = conn->next_free;
+    conn->next_free  = NULL;
+    return conn;
+}
+
+/**
+ * @brief   Returns a slot whose connection was freed. It keeps its EV_CLIENT
+ *          tag with socket == 0 and is only reused after connpool_recycle(),
+ *          so events still queued for the old socket in the current batch
+ *          are recognized and skipped instead of hitting a new client.
+ */
+void connpool_put(ConnectionPool *pool, Connection *conn)
+{
+    // The generation survives so late io_uring completions for the old
+    // client can be told apart from the next one's
+    uint16_t generation = conn->generation;
+    memset(conn, 0, sizeof(Connection));
+    conn->kind       = EV_CLIENT;
+    conn->generation = generation + 1;
+    conn->next_free  = pool->released;
+    pool->released  = conn;
+}
+
+/**
+ * @brief   Makes the slots released so far available again. Call it between
+ *          batches of events.
+ */
+void connpool_recycle(ConnectionPool *pool)
+{
+    while (pool->released)
+    {
+        Connection *conn = pool->released;
+        pool->released   = conn->next_free;
+        conn->next_free  = pool->free_list;
+        pool->free_list  = conn;
+    }
+}
+
+/**
+ * @returns Slot @p index (below pool->capacity), used or not. In-use slots
+ *          have a socket.
+ */
+Connection *connpool_at(const ConnectionPool *pool, size_t index)
+{
+    return &pool->slabs[index / CONNPOOL_SLAB][index % CONNPOOL_SLAB];
+}
+
+// ---------- UTILS ----------
+
+static int connpool_grow(ConnectionPool *pool)
+{
+    if (pool->capacity >= pool->max) return -1;
+
+    size_t count = pool->max - pool->capacity;
+    if (count > CONNPOOL_SLAB) count = CONNPOOL_SLAB;
+
+    // Cache-line aligned, so neighbouring slots never share a line
+    Connection *slab = aligned_alloc(_Alignof(Connection), count * sizeof(Connection));
+    if (!slab)
+    {
+        LOG(ERROR, "Failed to grow the connection pool.");
+        return -1;
+    }
+    memset(slab, 0, count * sizeof(Connection));
+    for (size_t i = 0; i < count; i++)
+        slab[i].kind = EV_CLIENT;
+
+    // Chain in reverse so slots are handed out in address order
+    for (size_t i = count; i-- > 0;)
+    {
+        slab[i].next_free = pool->free_list;
+        pool->free_list   = &slab[i];
+    }
+
+    pool->slabs[pool->slab_count++] = slab;
+    pool->capacity += count;
+    return OK;
+}
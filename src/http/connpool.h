@@ -0,0 +1,40 @@
+/**
+ * @file    connpool.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Growable per-worker pool of client connection slots.
+ *
+ */
+
+#ifndef HTTPCONNPOOL_H
+#define HTTPCONNPOOL_H
+
+#include "common.h"
+
+#define CONNPOOL_SLAB 256 // slots allocated at a time
+
+struct Connection;
+
+/**
+ * @brief   Slots are allocated in slabs that never move, so epoll and
+ *          upstreams can keep pointers to them, and unused slots are chained
+ *          in a free list for O(1) get and put.
+ */
+typedef struct ConnectionPool
+{
+    struct Connection **slabs;     // CONNPOOL_SLAB slots each, the last may be shorter
+    size_t slab_count;             // slabs allocated
+    size_t capacity;               // slots allocated over all slabs
+    size_t max;                    // slots allowed at most
+    struct Connection *free_list;  // unused slots
+    struct Connection *released;   // freed during the current batch of events
+} ConnectionPool;
+
+int connpool_init(ConnectionPool *pool, size_t max);
+void connpool_destroy(ConnectionPool *pool);
+struct Connection *connpool_get(ConnectionPool *pool);
+void connpool_put(ConnectionPool *pool, struct Connection *conn);
+void connpool_recycle(ConnectionPool *pool);
+struct Connection *connpool_at(const ConnectionPool *pool, size_t index);
+
+#endif
@@ -0,0 +1,475 @@
+/**
+ * @file    filecache.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   LRU cache of static files implementations.
+ *
+ * @details Entries hold the complete response (head and file bytes) so a hit
+ *          is served with nothing but the socket write. Staleness is caught
+ *          by inotify watches on the directories of cached files. Without
+ *          inotify an entry is re-checked with stat() at most every
+ *          revalidate_ms and dropped if its inode, size or mtime changed.
+ *
+ *          A file can have an entry per content coding; an entry's path is
+ *          the file its body was made from, so invalidation treats every
+ *          coding alike. Entries also remember which precompressed siblings
+ *          existed, so a change to file, file.br or file.gz evicts the
+ *          entries of all three (with stat() checks, a sibling added later
+ *          shows once file itself changes).
+ */
+
+#include <sys/inotify.h>
+#include "filecache.h"
+#include "utils/clock.h"
+#include "utils/compress.h"
+
+static uint64_t hash_path(const char *path, size_t len);
+static CacheEntry *filecache_find(FileCache *cache, const char *path, size_t len, int encoding,
+                                  uint64_t hash);
+static CacheEntry *entry_create(FileCache *cache, const char *path, size_t path_len, int encoding,
+                                const struct stat *st, const char *head, size_t head_len,
+                                size_t body_len);
+static void entry_link(FileCache *cache, CacheEntry *entry);
+static void lru_unlink(FileCache *cache, CacheEntry *entry);
+static void lru_push_front(FileCache *cache, CacheEntry *entry);
+static void filecache_watch(FileCache *cache, const char *path, size_t path_len);
+static void filecache_evict_path(FileCache *cache, const char *path, size_t path_len);
+static void filecache_evict_dir(FileCache *cache, const char *dir);
+static void filecache_clear(FileCache *cache);
+static void entry_free(CacheEntry *entry);
+
+/**
+ * @brief   Prepares an empty cache holding at most @p budget bytes.
+ *
+ * @returns OK. A budget of 0 disables caching.
+ */
+int filecache_init(FileCache *cache, size_t budget, const Config *cfg)
+{
+    memset(cache, 0, sizeof(FileCache));
+    cache->budget        = budget;
+    cache->max_file      = cfg->static_cache_max_file;
+    cache->revalidate_ms = cfg->static_cache_revalidate;
+    cache->inotify_fd    = -1;
+
+    if (budget > 0 && cfg->static_cache_inotify)
+    {
+        cache->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (cache->inotify_fd < 0)
+            LOG(WARNING, "inotify unavailable, static cache falls back to stat().");
+    }
+
+    return OK;
+}
+
+/**
+ * @brief   Applies reloaded settings, evicting least recently used entries
+ *          down to the new budget. Whether inotify is used doesn't change.
+ */
+void filecache_configure(FileCache *cache, size_t budget, const Config *cfg)
+{
+    cache->budget        = budget;
+    cache->max_file      = cfg->static_cache_max_file;
+    cache->revalidate_ms = cfg->static_cache_revalidate;
+
+    while (cache->lru_tail && cache->bytes > cache->budget)
+        filecache_evict(cache, cache->lru_tail);
+}
+
+void filecache_destroy(FileCache *cache)
+{
+    filecache_clear(cache);
+
+    for (int i = 0; i < cache->watch_count; i++)
+        free(cache->watches[i].dir);
+    cache->watch_count = 0;
+
+    if (cache->inotify_fd >= 0)
+    {
+        close(cache->inotify_fd);
+        cache->inotify_fd = -1;
+    }
+}
+
+/**
+ * @brief   Finds a fresh entry for @p path in @p encoding and marks it most
+ *          recently used.
+ *
+ * @returns The entry, NULL on a miss or if the cached version went stale.
+ */
+CacheEntry *filecache_lookup(FileCache *cache, const char *path, size_t path_len, int encoding)
+{
+    if (cache->budget == 0) return NULL;
+
+    CacheEntry *entry = filecache_find(cache, path, path_len, encoding, hash_path(path, path_len));
+    if (!entry) return NULL;
+
+    if (cache->inotify_fd < 0)
+    {
+        uint64_t now = monotonic_ms();
+        if (now - entry->validated_at >= cache->revalidate_ms)
+        {
+            struct stat st;
+            if (stat(entry->path, &st) < 0 || st.st_ino != entry->ino ||
+                st.st_dev != entry->dev || st.st_size != entry->size ||
+                st.st_mtim.tv_sec != entry->mtime.tv_sec ||
+                st.st_mtim.tv_nsec != entry->mtime.tv_nsec)
+            {
+                filecache_evict(cache, entry);
+                return NULL;
+            }
+            entry->validated_at = now;
+        }
+    }
+
+    lru_unlink(cache, entry);
+    lru_push_front(cache, entry);
+    return entry;
+}
+
+/**
+ * @brief   Reads the file behind @p fd into a new entry preceded by @p head.
+ *
+ * Least recently used entries are evicted to stay within the budget.
+ *
+ * @returns The new entry, NULL if the file is too large or can't be read.
+ */
+CacheEntry *filecache_insert(FileCache *cache, const char *path, size_t path_len, int encoding,
+                             int fd, const struct stat *st, const char *head, size_t head_len)
+{
+    size_t body_len   = st->st_size;
+    CacheEntry *entry = entry_create(cache, path, path_len, encoding, st, head, head_len, body_len);
+    if (!entry) return NULL;
+
+    size_t total_read = 0;
+    while (total_read < body_len)
+    {
+        ssize_t bytes = pread(fd, entry->data + head_len + total_read, body_len - total_read,
+                              total_read);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0)
+        {
+            LOG(ERROR, "Failed to read %s into the static cache.", entry->path);
+            entry_free(entry);
+            return NULL;
+        }
+        total_read += bytes;
+    }
+
+    entry_link(cache, entry);
+    return entry;
+}
+
+/**
+ * @brief   filecache_insert() for a body already in memory, e.g. a
+ *          compressed version of the file @p st describes. @p body is copied.
+ */
+CacheEntry *filecache_insert_data(FileCache *cache, const char *path, size_t path_len,
+                                  int encoding, const struct stat *st, const char *head,
+                                  size_t head_len, const char *body, size_t body_len)
+{
+    CacheEntry *entry = entry_create(cache, path, path_len, encoding, st, head, head_len, body_len);
+    if (!entry) return NULL;
+
+    memcpy(entry->data + head_len, body, body_len);
+    entry_link(cache, entry);
+    return entry;
+}
+
+/**
+ * @brief   Removes an entry from the cache. It is freed right away unless a
+ *          connection is still sending it, then on its last release.
+ */
+void filecache_evict(FileCache *cache, CacheEntry *entry)
+{
+    CacheEntry **link = &cache->buckets[entry->hash & (FILECACHE_BUCKETS - 1)];
+    while (*link && *link != entry)
+        link = &(*link)->hnext;
+    if (*link) *link = entry->hnext;
+
+    lru_unlink(cache, entry);
+    cache->bytes -= entry->head_len + entry->body_len;
+    cache->count--;
+
+    entry->evicted = 1;
+    if (entry->refs == 0) entry_free(entry);
+}
+
+/**
+ * @brief   Keeps @p entry's data alive while an output queue references it.
+ */
+void filecache_retain(CacheEntry *entry)
+{
+    entry->refs++;
+}
+
+/**
+ * @brief   Drops a reference taken with filecache_retain(). Takes a void
+ *          pointer so it can be used as an output segment release callback.
+ */
+void filecache_release(void *entry)
+{
+    CacheEntry *cached = entry;
+    if (--cached->refs == 0 && cached->evicted) entry_free(cached);
+}
+
+/**
+ * @brief   Drains the inotify fd and evicts every entry whose file changed.
+ */
+void filecache_handle_inotify(FileCache *cache)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (1)
+    {
+        ssize_t len = read(cache->inotify_fd, buf, sizeof(buf));
+        if (len <= 0) break;
+
+        for (char *ptr = buf; ptr < buf + len;)
+        {
+            struct inotify_event *event = (struct inotify_event *)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                filecache_clear(cache);
+                continue;
+            }
+
+            int w = 0;
+            while (w < cache->watch_count && cache->watches[w].wd != event->wd)
+                w++;
+            if (w == cache->watch_count) continue;
+
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+            {
+                // Directory itself is gone, drop everything cached below it
+                filecache_evict_dir(cache, cache->watches[w].dir);
+                free(cache->watches[w].dir);
+                cache->watches[w] = cache->watches[--cache->watch_count];
+                continue;
+            }
+
+            if (event->len == 0) continue;
+
+            char path[PATH_MAX];
+            int path_len =
+                snprintf(path, sizeof(path), "%s/%s", cache->watches[w].dir, event->name);
+            if (path_len < 0 || (size_t)path_len >= sizeof(path)) continue;
+
+            // Variants of a file remember its siblings, so they all go
+            if (path_len > 3 && (memcmp(path + path_len - 3, ".br", 3) == 0 ||
+                                 memcmp(path + path_len - 3, ".gz", 3) == 0))
+                path_len -= 3;
+            filecache_evict_path(cache, path, path_len);
+            if ((size_t)path_len + 3 >= sizeof(path)) continue;
+            memcpy(path + path_len, ".br", 4);
+            filecache_evict_path(cache, path, path_len + 3);
+            memcpy(path + path_len, ".gz", 4);
+            filecache_evict_path(cache, path, path_len + 3);
+        }
+    }
+}
+
+// ---------- UTILS ----------
+
+static uint64_t hash_path(const char *path, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)path[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static CacheEntry *filecache_find(FileCache *cache, const char *path, size_t len, int encoding,
+                                  uint64_t hash)
+{
+    for (CacheEntry *entry = cache->buckets[hash & (FILECACHE_BUCKETS - 1)]; entry;
+         entry             = entry->hnext)
+    {
+        if (entry->hash == hash && entry->encoding == encoding && entry->path_len == len &&
+            memcmp(entry->path, path, len) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+/**
+ * @brief   Allocates an entry for @p st with @p head copied in and room for
+ *          @p body_len bytes behind it.
+ *
+ * @returns The entry, NULL if it's too large or memory allocation fails.
+ */
+static CacheEntry *entry_create(FileCache *cache, const char *path, size_t path_len, int encoding,
+                                const struct stat *st, const char *head, size_t head_len,
+                                size_t body_len)
+{
+    size_t need = head_len + body_len;
+    if (cache->budget == 0 || body_len > cache->max_file || need > cache->budget) return NULL;
+
+    CacheEntry *entry = calloc(1, sizeof(CacheEntry));
+    if (!entry) return NULL;
+
+    entry->path = strndup(path, path_len);
+    entry->data = malloc(need);
+    if (!entry->path || !entry->data)
+    {
+        entry_free(entry);
+        return NULL;
+    }
+    memcpy(entry->data, head, head_len);
+
+    entry->path_len     = path_len;
+    entry->hash         = hash_path(path, path_len);
+    entry->encoding     = encoding;
+    entry->head_len     = head_len;
+    entry->body_len     = body_len;
+    entry->dev          = st->st_dev;
+    entry->ino          = st->st_ino;
+    entry->size         = st->st_size;
+    entry->mtime        = st->st_mtim;
+    entry->validated_at = monotonic_ms();
+    return entry;
+}
+
+/**
+ * @brief   Puts a new entry into the cache, replacing an older version and
+ *          evicting least recently used entries to stay within the budget.
+ */
+static void entry_link(FileCache *cache, CacheEntry *entry)
+{
+    CacheEntry *old = filecache_find(cache, entry->path, entry->path_len, entry->encoding,
+                                     entry->hash);
+    if (old) filecache_evict(cache, old);
+
+    size_t need = entry->head_len + entry->body_len;
+    while (cache->lru_tail && cache->bytes + need > cache->budget)
+        filecache_evict(cache, cache->lru_tail);
+
+    size_t bucket          = entry->hash & (FILECACHE_BUCKETS - 1);
+    entry->hnext           = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    lru_push_front(cache, entry);
+    cache->bytes += need;
+    cache->count++;
+
+    filecache_watch(cache, entry->path, entry->path_len);
+}
+
+static void lru_unlink(FileCache *cache, CacheEntry *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else if (cache->lru_head == entry)
+        cache->lru_head = entry->next;
+
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else if (cache->lru_tail == entry)
+        cache->lru_tail = entry->prev;
+
+    entry->prev = entry->next = NULL;
+}
+
+static void lru_push_front(FileCache *cache, CacheEntry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->prev = entry;
+    cache->lru_head = entry;
+    if (!cache->lru_tail) cache->lru_tail = entry;
+}
+
+/**
+ * @brief   Makes sure the directory containing @p path is watched.
+ */
+static void filecache_watch(FileCache *cache, const char *path, size_t path_len)
+{
+    if (cache->inotify_fd < 0) return;
+
+    const char *slash = memrchr(path, '/', path_len);
+    if (!slash) return;
+    size_t dir_len = slash - path;
+
+    for (int i = 0; i < cache->watch_count; i++)
+    {
+        if (strlen(cache->watches[i].dir) == dir_len &&
+            memcmp(cache->watches[i].dir, path, dir_len) == 0)
+            return;
+    }
+
+    if (cache->watch_count >= FILECACHE_MAX_WATCHES)
+    {
+        // Out of watches: entries in unwatched directories could go stale
+        LOG(WARNING, "Static cache watch limit reached, falling back to stat().");
+        close(cache->inotify_fd);
+        cache->inotify_fd = -1;
+        return;
+    }
+
+    char *dir = strndup(path, dir_len);
+    if (!dir) return;
+
+    int wd = inotify_add_watch(cache->inotify_fd, dir,
+                               IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_DELETE | IN_CREATE | IN_DELETE_SELF |
+                                   IN_MOVE_SELF);
+    if (wd < 0)
+    {
+        LOG(WARNING, "Failed to watch %s, falling back to stat().", dir);
+        free(dir);
+        close(cache->inotify_fd);
+        cache->inotify_fd = -1;
+        return;
+    }
+
+    cache->watches[cache->watch_count].wd  = wd;
+    cache->watches[cache->watch_count].dir = dir;
+    cache->watch_count++;
+}
+
+/**
+ * @brief   Evicts the entries of @p path in every coding.
+ */
+static void filecache_evict_path(FileCache *cache, const char *path, size_t path_len)
+{
+    uint64_t hash = hash_path(path, path_len);
+    for (int enc = 0; enc < ENC_COUNT; enc++)
+    {
+        CacheEntry *entry = filecache_find(cache, path, path_len, enc, hash);
+        if (entry)
+        {
+            LOG(DEBUG, "Static cache: %.*s changed, evicting.", (int)path_len, path);
+            filecache_evict(cache, entry);
+        }
+    }
+}
+
+static void filecache_evict_dir(FileCache *cache, const char *dir)
+{
+    size_t dir_len     = strlen(dir);
+    CacheEntry *entry  = cache->lru_head;
+    while (entry)
+    {
+        CacheEntry *next = entry->next;
+        if (entry->path_len > dir_len && memcmp(entry->path, dir, dir_len) == 0 &&
+            entry->path[dir_len] == '/')
+            filecache_evict(cache, entry);
+        entry = next;
+    }
+}
+
+static void filecache_clear(FileCache *cache)
+{
+    while (cache->lru_head)
+        filecache_evict(cache, cache->lru_head);
+}
+
+static void entry_free(CacheEntry *entry)
+{
+    free(entry->path);
+    free(entry->data);
+    free(entry);
+}
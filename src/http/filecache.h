@@ -0,0 +1,85 @@
+/**
+ * @file    filecache.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   LRU cache of static files with pre-serialized response heads.
+ *
+ */
+
+#ifndef HTTPFILECACHE_H
+#define HTTPFILECACHE_H
+
+#include "common.h"
+#include "utils/config.h"
+
+#define FILECACHE_BUCKETS 1024 // hash buckets, power of two
+#define FILECACHE_MAX_WATCHES 256
+
+typedef struct CacheEntry
+{
+    char *path;        // resolved filesystem path, the key together with encoding
+    size_t path_len;
+    uint64_t hash;     // hash of path
+    int encoding;      // ContentEncoding of the body
+    unsigned siblings; // ENC_BIT()s of path.br / path.gz found when this was cached
+
+    char *data;      // response head immediately followed by the file bytes
+    size_t head_len; // bytes of data that are the head
+    size_t body_len; // bytes of data that are the file
+
+    dev_t dev; // identity of the cached version
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    uint64_t validated_at; // monotonic ms of the last stat() check
+    int refs;              // output queues still sending data
+    int evicted;           // out of the cache, freed when refs drops to 0
+
+    struct CacheEntry *hnext; // bucket chain
+    struct CacheEntry *prev;  // LRU list, most recently used first
+    struct CacheEntry *next;
+} CacheEntry;
+
+typedef struct DirWatch
+{
+    int wd;
+    char *dir;
+} DirWatch;
+
+/**
+ * @brief   One cache per worker, so lookups and LRU updates need no lock.
+ */
+typedef struct FileCache
+{
+    CacheEntry *buckets[FILECACHE_BUCKETS];
+    CacheEntry *lru_head;
+    CacheEntry *lru_tail;
+    size_t bytes;     // sum of entry data sizes
+    size_t budget;    // evict least recently used entries above this
+    size_t max_file;  // files larger than this are never cached
+    size_t count;     // entries in the cache
+    uint64_t revalidate_ms;
+    uint64_t hits;    // static requests answered from the cache
+    uint64_t misses;  // static requests that weren't
+
+    int inotify_fd; // -1 when invalidation falls back to stat()
+    DirWatch watches[FILECACHE_MAX_WATCHES];
+    int watch_count;
+} FileCache;
+
+int filecache_init(FileCache *cache, size_t budget, const Config *cfg);
+void filecache_configure(FileCache *cache, size_t budget, const Config *cfg);
+void filecache_destroy(FileCache *cache);
+
+CacheEntry *filecache_lookup(FileCache *cache, const char *path, size_t path_len, int encoding);
+CacheEntry *filecache_insert(FileCache *cache, const char *path, size_t path_len, int encoding,
+                             int fd, const struct stat *st, const char *head, size_t head_len);
+CacheEntry *filecache_insert_data(FileCache *cache, const char *path, size_t path_len,
+                                  int encoding, const struct stat *st, const char *head,
+                                  size_t head_len, const char *body, size_t body_len);
+void filecache_evict(FileCache *cache, CacheEntry *entry);
+void filecache_retain(CacheEntry *entry);
+void filecache_release(void *entry);
+void filecache_handle_inotify(FileCache *cache);
+
+#endif
@@ -0,0 +1,667 @@
+/**
+ * @file    lifecycle.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Config reload, graceful drain and binary upgrade implementations.
+ *
+ * @details The main thread supervises the workers and is the only thread
+ *          taking the control signals:
+ *          - SIGHUP parses the config file again and posts it as a new
+ *            ServerConfig to every worker. Each worker adopts it after its
+ *            current batch of events with new backends and balancer;
+ *            requests already running finish with the config they started
+ *            with.
+ *          - SIGTERM and SIGINT drain: workers stop accepting, close idle
+ *            keep-alive connections and exit once the others are answered,
+ *            or when shutdown_timeout runs out. A second one closes what is
+ *            left at once.
+ *          - SIGUSR2 starts the binary again, handing it the listeners as
+ *            inherited fds. Those are the same sockets, so no connection in
+ *            an accept queue is lost. The new process tells the old one to
+ *            drain once its workers run.
+ *
+ *          Nothing a worker writes while serving is shared. The little that
+ *          has to cross threads, config swaps and proxy cache purges, is
+ *          posted to the receiving worker's Mailbox and handled between its
+ *          batches, so no worker ever waits for a lock another one holds.
+ */
+
+#include <sys/wait.h>
+#include "lifecycle.h"
+#include "server.h"
+#include "uring.h"
+#include "utils/clock.h"
+
+extern char **environ;
+
+static void worker_read_mail(Worker *self);
+static void worker_adopt(Worker *self, ServerConfig *shared);
+static void mail_free(Mail *mail);
+static void worker_retire(Worker *self, WorkerConfig *config);
+static void worker_start_drain(Worker *self);
+static void worker_close_connections(Worker *self, int idle_only);
+static void reload_config(HTTPServer *self);
+static void start_upgrade(HTTPServer *self);
+static void reap_children(HTTPServer *self);
+static void request_drain(HTTPServer *self, int sig);
+
+/**
+ * @brief   Compiles the routes of @p cfg and maps its static bundle. The
+ *          ServerConfig owns @p cfg from now on, the caller holds the only
+ *          reference.
+ *
+ * @returns The config, NULL if a route or the bundle is invalid (@p cfg
+ *          stays the caller's then) or memory runs out.
+ */
+ServerConfig *server_config_create(Config *cfg, unsigned generation)
+{
+    ServerConfig *shared = calloc(1, sizeof(ServerConfig));
+    if (!shared) return NULL;
+
+    if (router_init(&shared->router, cfg->routes, (int)cfg->route_count, cfg->backends,
+                    (int)cfg->backend_count) < 0)
+    {
+        free(shared);
+        return NULL;
+    }
+    if (cfg->static_bundle && bundle_open(&shared->bundle, cfg->static_bundle) < 0)
+    {
+        router_destroy(&shared->router);
+        free(shared);
+        return NULL;
+    }
+    shared->config     = cfg;
+    shared->generation = generation;
+    shared->refs       = 1;
+    return shared;
+}
+
+void server_config_retain(ServerConfig *shared)
+{
+    __atomic_add_fetch(&shared->refs, 1, __ATOMIC_RELAXED);
+}
+
+void server_config_release(ServerConfig *shared)
+{
+    if (__atomic_sub_fetch(&shared->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+
+    router_destroy(&shared->router);
+    bundle_close(&shared->bundle);
+    free_config(shared->config);
+    free(shared);
+}
+
+/**
+ * @brief   Sets up one keep-alive pool per backend of @p shared, the default
+ *          backend if it has none, and takes a reference to it.
+ *
+ * @returns The config, NULL on error.
+ */
+WorkerConfig *worker_config_create(ServerConfig *shared)
+{
+    const Config *cfg    = shared->config;
+    WorkerConfig *config = calloc(1, sizeof(WorkerConfig));
+    if (!config) return NULL;
+
+    config->shared = shared;
+    config->cfg    = cfg;
+    server_config_retain(shared);
+
+    int backend_count = cfg->backend_count > 0 ? (int)cfg->backend_count : 1;
+    config->backends  = calloc(backend_count, sizeof(Backend));
+    if (!config->backends)
+    {
+        LOG(ERROR, "Failed to allocate memory for backends.");
+        worker_config_destroy(config);
+        return NULL;
+    }
+    for (int i = 0; i < backend_count; i++)
+    {
+        const char *spec = cfg->backend_count > 0 ? cfg->backends[i] : DEFAULT_BACKEND;
+        if (backend_init(&config->backends[i], spec, cfg) < 0)
+        {
+            LOG(ERROR, "Invalid backend '%s'.", spec);
+            worker_config_destroy(config);
+            return NULL;
+        }
+        config->backend_count++;
+    }
+    if (balancer_init(&config->balancer, config->backends, config->backend_count, cfg) < 0)
+    {
+        worker_config_destroy(config);
+        return NULL;
+    }
+    return config;
+}
+
+/**
+ * @brief   Closes the config's pooled backend connections and drops its
+ *          reference. Safe on a partially created config.
+ */
+void worker_config_destroy(WorkerConfig *config)
+{
+    balancer_destroy(&config->balancer);
+    for (int i = 0; i < config->backend_count; i++)
+        backend_destroy(&config->backends[i]);
+    free(config->backends);
+    server_config_release(config->shared);
+    free(config);
+}
+
+/**
+ * @brief   Runs the request about to be dispatched on @p conn under the
+ *          worker's current config.
+ */
+void worker_config_acquire(Worker *self, Connection *conn)
+{
+    worker_config_release(self, conn);
+    conn->config = self->config;
+    conn->config->requests++;
+}
+
+/**
+ * @brief   The request on @p conn is finished. A replaced config is freed
+ *          with its last request.
+ */
+void worker_config_release(Worker *self, Connection *conn)
+{
+    WorkerConfig *config = conn->config;
+    if (!config) return;
+
+    conn->config = NULL;
+    if (--config->requests > 0 || config == self->config) return;
+
+    WorkerConfig **link = &self->retired;
+    while (*link && *link != config)
+        link = &(*link)->next;
+    if (*link) *link = config->next;
+    worker_config_destroy(config);
+}
+
+/**
+ * @brief   Runs after every batch of events: handles the worker's mail and
+ *          moves a drain along.
+ *
+ * @returns 1 once a draining worker has no connection left and its loop
+ *          should end, 0 otherwise.
+ */
+int worker_sync(Worker *self)
+{
+    HTTPServer *httpserver = self->httpserver;
+
+    if (mailbox_pending(&self->mailbox)) worker_read_mail(self);
+
+    int drain = __atomic_load_n(&httpserver->draining, __ATOMIC_RELAXED);
+    if (drain == DRAIN_NONE) return 0;
+
+    if (self->draining == DRAIN_NONE) worker_start_drain(self);
+    if (drain == DRAIN_NOW || monotonic_ms() >= self->drain_deadline)
+    {
+        if (self->draining != DRAIN_NOW && self->active_count > 0)
+            LOG(WARNING, "Worker %d closes %zu connection(s) still open.", self->id,
+                self->active_count);
+        self->draining = DRAIN_NOW;
+        worker_close_connections(self, 0);
+    }
+    return self->active_count == 0;
+}
+
+/**
+ * @brief   Posts a copy of @p data to every other worker's mailbox.
+ */
+void worker_broadcast(Worker *self, MailKind kind, const void *data, size_t len)
+{
+    HTTPServer *httpserver = self->httpserver;
+    for (int i = 0; i < httpserver->worker_count; i++)
+    {
+        Worker *worker = httpserver->workers[i];
+        if (worker == self) continue;
+
+        Mail *mail = mail_create(kind, NULL, data, len);
+        if (!mail)
+        {
+            LOG(ERROR, "Failed to allocate mail for worker %d.", worker->id);
+            continue;
+        }
+        mailbox_post(&worker->mailbox, mail);
+    }
+}
+
+/**
+ * @brief   Frees mail the worker never got to, from worker_destroy().
+ */
+void worker_drop_mail(Worker *self)
+{
+    Mail *mail = mailbox_take(&self->mailbox);
+    while (mail)
+    {
+        Mail *next = mail->next;
+        mail_free(mail);
+        mail = next;
+    }
+}
+
+/**
+ * @brief   The control signals the supervisor takes. Every thread has to
+ *          block them, so they're blocked before the first thread starts.
+ */
+void control_signals(sigset_t *set)
+{
+    sigemptyset(set);
+    sigaddset(set, SIGHUP);
+    sigaddset(set, SIGINT);
+    sigaddset(set, SIGTERM);
+    sigaddset(set, SIGUSR2);
+    sigaddset(set, SIGCHLD);
+}
+
+/**
+ * @brief   Picks up the listeners an old binary passed in LISTEN_FDS_ENV.
+ *          Fds that aren't listening TCP sockets on the configured port are
+ *          ignored.
+ */
+void httpserver_inherit_listeners(HTTPServer *self)
+{
+    const char *value = getenv(LISTEN_FDS_ENV);
+    if (!value) return;
+
+    self->listen_fds = calloc(MAX_WORKERS, sizeof(int));
+    if (!self->listen_fds) return;
+
+    for (const char *p = value; *p && self->listen_fd_count < MAX_WORKERS;)
+    {
+        char *end;
+        long fd = strtol(p, &end, 10);
+        if (end == p) break;
+        p = *end == ',' ? end + 1 : end;
+
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int listening      = 0;
+        socklen_t opt_len  = sizeof(listening);
+        if (fd < 0 || fd > INT_MAX ||
+            getsockname((int)fd, (struct sockaddr *)&addr, &addr_len) < 0 ||
+            addr.sin_family != AF_INET || ntohs(addr.sin_port) != self->port ||
+            getsockopt((int)fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &opt_len) < 0 ||
+            !listening)
+        {
+            LOG(WARNING, "Inherited fd %ld isn't a listener on port %d, ignored.", fd,
+                self->port);
+            continue;
+        }
+        self->listen_fds[self->listen_fd_count++] = (int)fd;
+    }
+    unsetenv(LISTEN_FDS_ENV);
+
+    if (self->listen_fd_count > 0) self->upgrade_parent = getppid();
+}
+
+/**
+ * @returns The inherited listener for worker @p index, which the caller owns
+ *          from now on, or -1 if it has to create its own.
+ */
+int httpserver_take_listener(HTTPServer *self, int index)
+{
+    if (index >= self->listen_fd_count || self->listen_fds[index] < 0) return -1;
+
+    int fd                   = self->listen_fds[index];
+    self->listen_fds[index]  = -1;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+/**
+ * @brief   Runs on the main thread while the workers serve and takes the
+ *          control signals. Returns when every worker has exited.
+ */
+void httpserver_supervise(HTTPServer *self)
+{
+    // Listeners for workers the new config doesn't have any more
+    for (int i = 0; i < self->listen_fd_count; i++)
+    {
+        if (self->listen_fds[i] < 0) continue;
+        LOG(WARNING, "Closing inherited listener %d, there are fewer workers now.",
+            self->listen_fds[i]);
+        close(self->listen_fds[i]);
+        self->listen_fds[i] = -1;
+    }
+
+    if (self->upgrade_parent > 1)
+    {
+        LOG(INFO, "Took over the listeners, draining the old process %d.",
+            (int)self->upgrade_parent);
+        kill(self->upgrade_parent, SIGTERM);
+        self->upgrade_parent = 0;
+    }
+
+    sigset_t signals;
+    control_signals(&signals);
+    struct timespec tick = {0, 100 * 1000 * 1000};
+
+    while (__atomic_load_n(&self->running, __ATOMIC_ACQUIRE) > 0)
+    {
+        siginfo_t info;
+        int sig = sigtimedwait(&signals, &info, &tick);
+        if (sig < 0) continue; // timeout or EINTR, look at the workers again
+
+        switch (sig)
+        {
+        case SIGHUP:
+            reload_config(self);
+            break;
+        case SIGUSR2:
+            start_upgrade(self);
+            break;
+        case SIGCHLD:
+            reap_children(self);
+            break;
+        default:
+            request_drain(self, sig);
+            break;
+        }
+    }
+}
+
+// ---------- UTILS ----------
+
+/**
+ * @brief   Handles the mail posted since the last batch, in order. Of several
+ *          reloads only the newest config is applied.
+ */
+static void worker_read_mail(Worker *self)
+{
+    ServerConfig *newest = NULL;
+
+    Mail *mail = mailbox_take(&self->mailbox);
+    while (mail)
+    {
+        Mail *next = mail->next;
+        switch (mail->kind)
+        {
+        case MAIL_CONFIG:
+            if (newest) server_config_release(newest);
+            newest    = mail->ref;
+            mail->ref = NULL;
+            break;
+        case MAIL_PURGE:
+            proxycache_purge(&self->proxy_cache, mail->data, mail->len);
+            break;
+        }
+        mail_free(mail);
+        mail = next;
+    }
+
+    if (newest) worker_adopt(self, newest);
+}
+
+/**
+ * @brief   Switches new requests to @p shared, taking over the reference the
+ *          mail carried. Idle connections and health of backends in both
+ *          configs carry over, so a reload doesn't open a new connection to
+ *          every backend.
+ */
+static void worker_adopt(Worker *self, ServerConfig *shared)
+{
+    HTTPServer *httpserver = self->httpserver;
+    self->generation       = shared->generation; // also when applying it fails
+
+    WorkerConfig *next = worker_config_create(shared);
+    server_config_release(shared);
+    if (!next)
+    {
+        LOG(ERROR, "Worker %d failed to apply config generation %u, keeping generation %u.",
+            self->id, shared->generation, self->config->shared->generation);
+        return;
+    }
+
+    WorkerConfig *old = self->config;
+    for (int i = 0; i < next->backend_count; i++)
+    {
+        for (int j = 0; j < old->backend_count; j++)
+        {
+            if (strcmp(next->backends[i].host, old->backends[j].host) == 0 &&
+                strcmp(next->backends[i].port, old->backends[j].port) == 0)
+            {
+                backend_adopt(&next->backends[i], &old->backends[j]);
+                break;
+            }
+        }
+    }
+
+    self->config = next;
+    worker_retire(self, old);
+
+    const Config *cfg = next->cfg;
+    filecache_configure(&self->cache, cfg->static_cache_size / httpserver->worker_count, cfg);
+    proxycache_configure(&self->proxy_cache, cfg->proxy_cache_size / httpserver->worker_count,
+                         cfg);
+    LOG(DEBUG, "Worker %d runs config generation %u.", self->id, self->generation);
+}
+
+static void mail_free(Mail *mail)
+{
+    if (mail->kind == MAIL_CONFIG && mail->ref) server_config_release(mail->ref);
+    free(mail);
+}
+
+/**
+ * @brief   Keeps a replaced config until its last request finishes.
+ */
+static void worker_retire(Worker *self, WorkerConfig *config)
+{
+    if (config->requests == 0)
+    {
+        worker_config_destroy(config);
+        return;
+    }
+    config->next  = self->retired;
+    self->retired = config;
+}
+
+/**
+ * @brief   Stops accepting and closes idle keep-alive connections. Requests
+ *          parsed from now on are answered with "Connection: close".
+ */
+static void worker_start_drain(Worker *self)
+{
+    const Config *cfg    = self->config->cfg;
+    self->draining       = DRAIN_GRACEFUL;
+    self->drain_deadline = monotonic_ms() + (uint64_t)cfg->shutdown_timeout * 1000;
+
+    if (self->server)
+    {
+        if (self->ring)
+            uring_stop_accept(self);
+        else
+            epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, self->server->socket, NULL);
+
+        // Whatever is queued already is served here: accept wakeups are
+        // exclusive, a new binary waiting on the same socket may never see
+        // one the cancelled accept swallowed
+        accept_connection(self);
+        server_destructor(self->server);
+        self->server = NULL;
+    }
+
+    worker_close_connections(self, 1);
+    LOG(INFO, "Worker %d draining, %zu connection(s) open.", self->id, self->active_count);
+}
+
+/**
+ * @brief   Closes every connection, or with @p idle_only keep-alive ones
+ *          waiting for a next request without having sent a byte of it. A
+ *          connection just accepted gets to send its first request.
+ */
+static void worker_close_connections(Worker *self, int idle_only)
+{
+    for (size_t i = 0; i < self->connections.capacity; i++)
+    {
+        Connection *conn = connpool_at(&self->connections, i);
+        if (conn->socket <= 0) continue;
+
+        int idle = conn->phase == CONN_READING && conn->deadline == DEADLINE_IDLE &&
+                   conn->len == 0 && !conn->body_streaming && !has_pending_output(conn);
+        if (!idle_only || idle) close_connection(self, conn);
+    }
+}
+
+/**
+ * @brief   Parses the config file again and posts it to every worker.
+ *          Nothing changes if it doesn't parse, has an invalid route or an
+ *          invalid backend.
+ */
+static void reload_config(HTTPServer *self)
+{
+    Config *cfg = parse_config(CONFIG_FILE);
+    if (!cfg)
+    {
+        LOG(ERROR, "Failed to reload %s, keeping the current config.", CONFIG_FILE);
+        return;
+    }
+
+    for (size_t i = 0; i < cfg->backend_count; i++)
+    {
+        Backend probe;
+        int valid = backend_init(&probe, cfg->backends[i], cfg) == 0;
+        backend_destroy(&probe);
+        if (!valid)
+        {
+            LOG(ERROR, "Invalid backend '%s', keeping the current config.", cfg->backends[i]);
+            free_config(cfg);
+            return;
+        }
+    }
+
+    const Config *running = self->config;
+    if (cfg->port != running->port || cfg->workers != running->workers ||
+        cfg->max_connections != running->max_connections ||
+        cfg->listen_backlog != running->listen_backlog ||
+        cfg->edge_triggered != running->edge_triggered || cfg->io_uring != running->io_uring ||
+        cfg->client_buffer_size != running->client_buffer_size ||
+        cfg->cpu_affinity != running->cpu_affinity || cfg->numa != running->numa)
+        LOG(WARNING, "port, workers, max_connections, listen_backlog, edge_triggered, io_backend, "
+                     "client_buffer_size, cpu_affinity and numa only change with a restart or "
+                     "upgrade.");
+
+    ServerConfig *shared = server_config_create(cfg, self->current->generation + 1);
+    if (!shared)
+    {
+        LOG(ERROR, "Invalid routes or static bundle, keeping the current config.");
+        free_config(cfg);
+        return;
+    }
+
+    // Each worker gets its own reference, the supervisor keeps one as current
+    for (int i = 0; i < self->worker_count; i++)
+    {
+        Worker *worker = self->workers[i];
+        server_config_retain(shared);
+        Mail *mail = mail_create(MAIL_CONFIG, shared, NULL, 0);
+        if (!mail)
+        {
+            LOG(ERROR, "Failed to allocate mail, worker %d keeps its config.", worker->id);
+            server_config_release(shared);
+            continue;
+        }
+        mailbox_post(&worker->mailbox, mail);
+    }
+    server_config_release(self->current); // workers hold their own references
+    self->current = shared;
+
+    __atomic_store_n(&log_level, cfg->log_level, __ATOMIC_RELAXED);
+    LOG(INFO, "Reloaded %s, config generation %u.", CONFIG_FILE, shared->generation);
+}
+
+/**
+ * @brief   Starts the binary again with the listeners of every worker. Only
+ *          async-signal-safe calls are made between fork() and exec, the
+ *          environment is built before.
+ */
+static void start_upgrade(HTTPServer *self)
+{
+    if (self->upgrade_pid > 0 || self->draining != DRAIN_NONE || !self->exe_path)
+    {
+        LOG(WARNING, "Ignoring SIGUSR2, %s.",
+            self->upgrade_pid > 0 ? "a new binary is already starting" : "not serving");
+        return;
+    }
+
+    int fds[MAX_WORKERS];
+    int count      = 0;
+    char list[sizeof(LISTEN_FDS_ENV) + MAX_WORKERS * 12];
+    size_t len     = (size_t)snprintf(list, sizeof(list), "%s=", LISTEN_FDS_ENV);
+    for (int i = 0; i < self->worker_count; i++)
+    {
+        if (!self->workers[i]->server) continue;
+        fds[count] = self->workers[i]->server->socket;
+        len += (size_t)snprintf(list + len, sizeof(list) - len, "%s%d", count > 0 ? "," : "",
+                                fds[count]);
+        count++;
+    }
+
+    size_t env_count = 0;
+    while (environ[env_count])
+        env_count++;
+    char **envp = calloc(env_count + 2, sizeof(char *));
+    if (!envp)
+    {
+        LOG(ERROR, "Failed to allocate memory for the upgrade.");
+        return;
+    }
+    size_t n  = 0;
+    envp[n++] = list;
+    for (size_t i = 0; i < env_count; i++)
+        if (strncmp(environ[i], LISTEN_FDS_ENV "=", sizeof(LISTEN_FDS_ENV)) != 0)
+            envp[n++] = environ[i];
+    char *argv[] = {self->exe_path, NULL};
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        for (int i = 0; i < count; i++)
+            fcntl(fds[i], F_SETFD, 0);
+        execve(self->exe_path, argv, envp);
+        _exit(127);
+    }
+    free(envp);
+
+    if (pid < 0)
+    {
+        LOG(ERROR, "Failed to fork the new binary: %s", strerror(errno));
+        return;
+    }
+    self->upgrade_pid = pid;
+    LOG(INFO, "Started %s (pid %d) with %d listener(s).", self->exe_path, (int)pid, count);
+}
+
+/**
+ * @brief   A new binary that exits never took over, this process keeps serving.
+ */
+static void reap_children(HTTPServer *self)
+{
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        if (pid != self->upgrade_pid) continue;
+
+        LOG(ERROR, "New binary (pid %d) exited with status %d, still serving.", (int)pid,
+            WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        self->upgrade_pid = 0;
+    }
+}
+
+static void request_drain(HTTPServer *self, int sig)
+{
+    int mode = self->draining == DRAIN_NONE ? DRAIN_GRACEFUL : DRAIN_NOW;
+    __atomic_store_n(&self->draining, mode, __ATOMIC_RELAXED);
+
+    if (mode == DRAIN_GRACEFUL)
+        LOG(INFO, "%s received, draining connections for up to %d seconds.", strsignal(sig),
+            self->current->config->shutdown_timeout);
+    else
+        LOG(INFO, "%s received again, closing the remaining connections.", strsignal(sig));
+}
@@ -0,0 +1,91 @@
+/**
+ * @file    lifecycle.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Config reload, graceful drain and binary upgrade.
+ *
+ */
+
+#ifndef HTTPLIFECYCLE_H
+#define HTTPLIFECYCLE_H
+
+#include <signal.h>
+#include "common.h"
+#include "utils/config.h"
+#include "backend.h"
+#include "balancer.h"
+#include "bundle.h"
+#include "mailbox.h"
+#include "router.h"
+
+#define LISTEN_FDS_ENV "CSERVER_LISTEN_FDS" // listeners handed to a new binary, "fd,fd,..."
+
+struct Worker;
+struct Connection;
+struct HTTPServer;
+
+typedef enum
+{
+    DRAIN_NONE,     // serving
+    DRAIN_GRACEFUL, // not accepting, connections finish their requests
+    DRAIN_NOW       // remaining connections are closed
+} DrainMode;
+
+/**
+ * @brief   Messages workers get in their Mailbox.
+ */
+typedef enum
+{
+    MAIL_CONFIG, // ref: a ServerConfig reference, run new requests under it
+    MAIL_PURGE   // data: a proxy cache key another worker invalidated
+} MailKind;
+
+/**
+ * @brief   What a reload replaces, shared by every worker: a parsed config,
+ *          the routes compiled from it and the static bundle it names. Freed
+ *          by whoever drops the last reference.
+ */
+typedef struct ServerConfig
+{
+    Config *config;      // owned
+    Router router;       // compiled from config->routes
+    Bundle bundle;       // config->static_bundle mapped, map is NULL without one
+    unsigned generation; // 1 at startup, one more per reload
+    int refs;            // HTTPServer while current or startup, queued MAIL_CONFIGs and
+                         // one per WorkerConfig
+} ServerConfig;
+
+/**
+ * @brief   A worker's backends and balancer for one ServerConfig. A reload
+ *          gives every worker a new one, an old one stays until the requests
+ *          started under it are finished.
+ */
+typedef struct WorkerConfig
+{
+    ServerConfig *shared;      // referenced
+    const Config *cfg;         // shared->config
+    Backend *backends;         // one keep-alive pool per backend of cfg
+    int backend_count;         // entries in backends
+    Balancer balancer;         // picks a backend per proxied request
+    size_t requests;           // requests started under it and not finished
+    struct WorkerConfig *next; // Worker.retired link
+} WorkerConfig;
+
+ServerConfig *server_config_create(Config *cfg, unsigned generation);
+void server_config_retain(ServerConfig *shared);
+void server_config_release(ServerConfig *shared);
+
+WorkerConfig *worker_config_create(ServerConfig *shared);
+void worker_config_destroy(WorkerConfig *config);
+void worker_config_acquire(struct Worker *self, struct Connection *conn);
+void worker_config_release(struct Worker *self, struct Connection *conn);
+int worker_sync(struct Worker *self);
+void worker_broadcast(struct Worker *self, MailKind kind, const void *data, size_t len);
+void worker_drop_mail(struct Worker *self);
+
+void control_signals(sigset_t *set);
+void httpserver_inherit_listeners(struct HTTPServer *self);
+int httpserver_take_listener(struct HTTPServer *self, int index);
+void httpserver_supervise(struct HTTPServer *self);
+
+#endif
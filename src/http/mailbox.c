@@ -0,0 +1,106 @@
+/**
+ * @file    mailbox.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Worker mailbox implementations.
+ *
+ * @details Messages are pushed onto a Treiber stack and the owner takes the
+ *          whole stack with one exchange, then reverses it, so it sees them
+ *          in the order they were posted. Messages are rare (reloads, cache
+ *          purges), the hot path only ever loads head to find it empty.
+ */
+
+#include <sys/eventfd.h>
+#include "mailbox.h"
+
+int mailbox_init(Mailbox *box)
+{
+    box->head    = NULL;
+    box->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return box->wake_fd >= 0 ? OK : -1;
+}
+
+/**
+ * @brief   Closes the eventfd. Mail still queued has to be taken first, its
+ *          refs are the caller's to release.
+ */
+void mailbox_destroy(Mailbox *box)
+{
+    if (box->wake_fd >= 0) close(box->wake_fd);
+    box->wake_fd = -1;
+}
+
+/**
+ * @returns A message with a copy of @p data, free() it once handled. NULL if
+ *          memory runs out.
+ */
+Mail *mail_create(int kind, void *ref, const void *data, size_t len)
+{
+    Mail *mail = malloc(sizeof(Mail) + len);
+    if (!mail) return NULL;
+
+    mail->next = NULL;
+    mail->kind = kind;
+    mail->ref  = ref;
+    mail->len  = len;
+    if (len > 0) memcpy(mail->data, data, len);
+    return mail;
+}
+
+/**
+ * @brief   Queues @p mail, which belongs to the receiver from now on. Safe
+ *          from any thread.
+ */
+void mailbox_post(Mailbox *box, Mail *mail)
+{
+    Mail *head = __atomic_load_n(&box->head, __ATOMIC_RELAXED);
+    do
+        mail->next = head;
+    while (!__atomic_compare_exchange_n(&box->head, &head, mail, 1, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED));
+
+    // Mail already waiting means the owner has been woken and takes this one too
+    uint64_t one = 1;
+    if (!head && write(box->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        LOG(ERROR, "Failed to wake a worker for its mail: %s", strerror(errno));
+}
+
+/**
+ * @brief   Takes every queued message, oldest first. Owner only.
+ *
+ * @returns The first message, the rest follow through next. NULL if none.
+ */
+Mail *mailbox_take(Mailbox *box)
+{
+    Mail *mail = __atomic_exchange_n(&box->head, NULL, __ATOMIC_ACQUIRE);
+
+    Mail *ordered = NULL;
+    while (mail)
+    {
+        Mail *next = mail->next;
+        mail->next = ordered;
+        ordered    = mail;
+        mail       = next;
+    }
+    return ordered;
+}
+
+/**
+ * @brief   Cheap check for the owner, which keeps the cache line shared
+ *          while nothing is posted.
+ */
+int mailbox_pending(const Mailbox *box)
+{
+    return __atomic_load_n(&box->head, __ATOMIC_RELAXED) != NULL;
+}
+
+/**
+ * @brief   Resets the eventfd after it woke the owner. Mail posted from now
+ *          on either finds mail waiting or wakes the owner again.
+ */
+void mailbox_clear_wakeup(Mailbox *box)
+{
+    uint64_t count;
+    while (read(box->wake_fd, &count, sizeof(count)) < 0 && errno == EINTR)
+        ;
+}
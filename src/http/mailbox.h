@@ -0,0 +1,47 @@
+/**
+ * @file    mailbox.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Lock-free queue of messages to a worker from other threads.
+ *
+ */
+
+#ifndef HTTPMAILBOX_H
+#define HTTPMAILBOX_H
+
+#include "common.h"
+
+/**
+ * @brief   One message. What kind, ref and data mean is up to the sender
+ *          and the receiving worker, the mailbox only moves it.
+ */
+typedef struct Mail
+{
+    struct Mail *next; // queue link
+    int kind;          // what the receiver does with it
+    void *ref;         // object handed over with the message, if any
+    size_t len;        // bytes of data
+    char data[];       // copied payload
+} Mail;
+
+/**
+ * @brief   Multi-producer, single-consumer: any thread posts, only the
+ *          owning worker takes. Posting is a compare-and-swap on head, and
+ *          only the post that finds the box empty writes the eventfd, so a
+ *          burst of messages costs the worker one wakeup.
+ */
+typedef struct Mailbox
+{
+    Mail *head __attribute__((aligned(CACHE_LINE_SIZE))); // newest first, written by senders
+    int wake_fd;                                           // eventfd the owner polls
+} Mailbox;
+
+int mailbox_init(Mailbox *box);
+void mailbox_destroy(Mailbox *box);
+Mail *mail_create(int kind, void *ref, const void *data, size_t len);
+void mailbox_post(Mailbox *box, Mail *mail);
+Mail *mailbox_take(Mailbox *box);
+int mailbox_pending(const Mailbox *box);
+void mailbox_clear_wakeup(Mailbox *box);
+
+#endif
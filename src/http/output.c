@@ -0,0 +1,299 @@
+/**
+ * @file    output.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Per-connection output queue implementations.
+ *
+ * @details Nothing here blocks. output_flush() sends what the socket takes
+ *          and reports OUTPUT_BLOCKED otherwise, the caller then waits for
+ *          EPOLLOUT and calls it again. Memory segments are batched into a
+ *          single writev(), file segments go out with sendfile().
+ */
+
+#include "output.h"
+
+static OutSegment *output_tail(OutputQueue *queue);
+static OutSegment *output_push(OutputQueue *queue);
+static void output_pop(OutputQueue *queue);
+static void segment_release(OutputQueue *queue, OutSegment *seg);
+
+void output_init(OutputQueue *queue)
+{
+    memset(queue, 0, sizeof(OutputQueue));
+}
+
+/**
+ * @brief   Drops everything queued. The spare buffer is kept for reuse.
+ */
+void output_reset(OutputQueue *queue)
+{
+    while (queue->count > 0)
+        output_pop(queue);
+    queue->head          = 0;
+    queue->pending_bytes = 0;
+    queue->sent_bytes    = 0;
+    queue->truncated     = 0;
+}
+
+void output_free(OutputQueue *queue)
+{
+    output_reset(queue);
+    free(queue->spare);
+    queue->spare     = NULL;
+    queue->spare_cap = 0;
+}
+
+/**
+ * @brief   Copies @p data to the end of the queue.
+ *
+ * Small writes are coalesced into the tail buffer, so the number of
+ * segments only grows with larger, separate pieces of output.
+ *
+ * @returns OK on success, -1 if memory ran out or the queue is full.
+ */
+int output_append(OutputQueue *queue, const char *data, size_t len)
+{
+    if (len == 0) return OK;
+
+    OutSegment *tail = output_tail(queue);
+    if (tail && tail->kind == SEG_OWNED &&
+        (tail->cap - tail->len >= len || queue->count == OUTPUT_MAX_SEGMENTS))
+    {
+        if (tail->cap - tail->len < len)
+        {
+            size_t new_cap = tail->cap;
+            while (new_cap < tail->len + len)
+                new_cap *= 2;
+
+            char *new_buf = realloc((char *)tail->data, new_cap);
+            if (!new_buf) return -1;
+            tail->data = new_buf;
+            tail->cap  = new_cap;
+        }
+        memcpy((char *)tail->data + tail->len, data, len);
+        tail->len += len;
+        queue->pending_bytes += len;
+        return OK;
+    }
+
+    if (queue->count == OUTPUT_MAX_SEGMENTS) return -1;
+
+    char *buf;
+    size_t cap;
+    if (queue->spare && queue->spare_cap >= len)
+    {
+        buf          = queue->spare;
+        cap          = queue->spare_cap;
+        queue->spare = NULL;
+    }
+    else
+    {
+        cap = len > OUTPUT_SEGMENT_SIZE ? len : OUTPUT_SEGMENT_SIZE;
+        buf = malloc(cap);
+        if (!buf) return -1;
+    }
+    memcpy(buf, data, len);
+
+    OutSegment *seg = output_push(queue);
+    seg->kind       = SEG_OWNED;
+    seg->data       = buf;
+    seg->len        = len;
+    seg->cap        = cap;
+    queue->pending_bytes += len;
+    return OK;
+}
+
+/**
+ * @brief   Queues @p data without copying it. @p release, unless NULL (for
+ *          static memory), is called with @p ctx once the bytes are sent or
+ *          dropped.
+ *
+ * Falls back to a copy (and an immediate release) if the queue is full.
+ *
+ * @returns OK on success, -1 on failure, in which case @p release was
+ *          already called.
+ */
+int output_append_shared(OutputQueue *queue, const char *data, size_t len,
+                         void (*release)(void *ctx), void *ctx)
+{
+    if (len == 0 || queue->count == OUTPUT_MAX_SEGMENTS)
+    {
+        int status = output_append(queue, data, len);
+        if (release) release(ctx);
+        return status;
+    }
+
+    OutSegment *seg = output_push(queue);
+    seg->kind       = SEG_SHARED;
+    seg->data       = data;
+    seg->len        = len;
+    seg->release    = release;
+    seg->ctx        = ctx;
+    queue->pending_bytes += len;
+    return OK;
+}
+
+/**
+ * @brief   Queues @p length bytes of @p fd from @p offset. The queue takes
+ *          ownership of @p fd and closes it even on failure.
+ *
+ * @returns OK on success, -1 if the queue is full.
+ */
+int output_append_file(OutputQueue *queue, int fd, off_t offset, size_t length)
+{
+    if (queue->count == OUTPUT_MAX_SEGMENTS)
+    {
+        close(fd);
+        return -1;
+    }
+
+    OutSegment *seg = output_push(queue);
+    seg->kind       = SEG_FILE;
+    seg->fd         = fd;
+    seg->offset     = offset;
+    seg->end        = offset + length;
+    return OK;
+}
+
+int output_pending(const OutputQueue *queue)
+{
+    return queue->count > 0;
+}
+
+/**
+ * @brief   Sends queued segments in order until the queue is empty or the
+ *          socket would block.
+ */
+OutputStatus output_flush(OutputQueue *queue, int socket)
+{
+    while (queue->count > 0)
+    {
+        OutSegment *seg = &queue->segments[queue->head];
+
+        if (seg->kind == SEG_FILE)
+        {
+            // File body straight from the page cache, no user space copy
+            if (seg->offset >= seg->end)
+            {
+                output_pop(queue);
+                continue;
+            }
+
+            ssize_t bytes_sent = sendfile(socket, seg->fd, &seg->offset, seg->end - seg->offset);
+            if (bytes_sent < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return OUTPUT_BLOCKED;
+                if (errno == EINTR) continue;
+                return OUTPUT_ERROR;
+            }
+            if (bytes_sent == 0)
+            {
+                // File shrank under us
+                queue->truncated = 1;
+                output_pop(queue);
+                continue;
+            }
+            queue->sent_bytes += bytes_sent;
+            continue;
+        }
+
+        // Gather every memory segment up to the next file into one writev()
+        struct iovec iov[OUTPUT_MAX_SEGMENTS];
+        int iov_count = 0;
+        size_t total  = 0;
+        for (int i = 0; i < queue->count; i++)
+        {
+            OutSegment *s = &queue->segments[(queue->head + i) % OUTPUT_MAX_SEGMENTS];
+            if (s->kind == SEG_FILE) break;
+
+            iov[iov_count].iov_base = (char *)s->data + s->sent;
+            iov[iov_count].iov_len  = s->len - s->sent;
+            total += s->len - s->sent;
+            iov_count++;
+        }
+
+        ssize_t bytes_sent = writev(socket, iov, iov_count);
+        if (bytes_sent < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return OUTPUT_BLOCKED;
+            if (errno == EINTR) continue;
+            return OUTPUT_ERROR;
+        }
+        queue->pending_bytes -= bytes_sent;
+        queue->sent_bytes += bytes_sent;
+
+        size_t left = bytes_sent;
+        while (left > 0)
+        {
+            OutSegment *s = &queue->segments[queue->head];
+            size_t remaining = s->len - s->sent;
+            if (left < remaining)
+            {
+                s->sent += left;
+                break;
+            }
+            left -= remaining;
+            s->sent = s->len;
+            output_pop(queue);
+        }
+
+        // A short write means the socket buffer is full
+        if ((size_t)bytes_sent < total) return OUTPUT_BLOCKED;
+    }
+
+    return OUTPUT_DRAINED;
+}
+
+// ---------- UTILS ----------
+
+static OutSegment *output_tail(OutputQueue *queue)
+{
+    if (queue->count == 0) return NULL;
+    return &queue->segments[(queue->head + queue->count - 1) % OUTPUT_MAX_SEGMENTS];
+}
+
+static OutSegment *output_push(OutputQueue *queue)
+{
+    OutSegment *seg = &queue->segments[(queue->head + queue->count) % OUTPUT_MAX_SEGMENTS];
+    memset(seg, 0, sizeof(OutSegment));
+    seg->fd = -1;
+    queue->count++;
+    return seg;
+}
+
+static void output_pop(OutputQueue *queue)
+{
+    OutSegment *seg = &queue->segments[queue->head];
+    if (seg->kind != SEG_FILE) queue->pending_bytes -= seg->len - seg->sent;
+    segment_release(queue, seg);
+    queue->head = (queue->head + 1) % OUTPUT_MAX_SEGMENTS;
+    queue->count--;
+}
+
+static void segment_release(OutputQueue *queue, OutSegment *seg)
+{
+    switch (seg->kind)
+    {
+    case SEG_OWNED:
+        // Keep a drained buffer around for the next response, unless it's huge
+        if (seg->cap <= OUTPUT_SPARE_MAX && (!queue->spare || queue->spare_cap < seg->cap))
+        {
+            free(queue->spare);
+            queue->spare     = (char *)seg->data;
+            queue->spare_cap = seg->cap;
+        }
+        else
+        {
+            free((char *)seg->data);
+        }
+        break;
+    case SEG_SHARED:
+        if (seg->release) seg->release(seg->ctx);
+        break;
+    case SEG_FILE:
+        close(seg->fd);
+        break;
+    }
+    seg->data = NULL;
+    seg->fd   = -1;
+}
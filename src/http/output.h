@@ -0,0 +1,75 @@
+/**
+ * @file    output.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Per-connection output queue of memory and file segments.
+ *
+ */
+
+#ifndef HTTPOUTPUT_H
+#define HTTPOUTPUT_H
+
+#include <sys/uio.h>
+#include "common.h"
+
+#define OUTPUT_MAX_SEGMENTS 16    // segments queued at once, also the writev() batch
+#define OUTPUT_SEGMENT_SIZE 4096  // smallest buffer allocated for copied output
+#define OUTPUT_SPARE_MAX 65536    // largest drained buffer kept for reuse
+
+typedef enum
+{
+    SEG_OWNED,  // heap buffer owned by the queue, later copies may be appended
+    SEG_SHARED, // borrowed memory, release() (if any) is called once it is sent
+    SEG_FILE    // file range sent with sendfile(), fd owned by the queue
+} SegmentKind;
+
+typedef struct OutSegment
+{
+    SegmentKind kind;
+    const char *data;            // SEG_OWNED and SEG_SHARED bytes
+    size_t len;                  // bytes in data
+    size_t cap;                  // SEG_OWNED allocated size
+    size_t sent;                 // bytes of data already sent
+    void (*release)(void *ctx);  // SEG_SHARED, called with ctx when done
+    void *ctx;
+    int fd;                      // SEG_FILE
+    off_t offset;                // next byte of fd to send
+    off_t end;                   // end offset of the range
+} OutSegment;
+
+/**
+ * @brief   Ring of segments flushed in order. Consecutive memory segments go
+ *          out in one writev(), so a head and its body share a syscall.
+ */
+typedef struct OutputQueue
+{
+    OutSegment segments[OUTPUT_MAX_SEGMENTS];
+    int head;             // index of the oldest segment
+    int count;            // segments queued
+    size_t pending_bytes; // memory bytes not sent yet, files excluded
+    size_t sent_bytes;    // bytes sent since the last output_reset()
+    int truncated;        // a file ended before its range was sent
+    char *spare;          // drained SEG_OWNED buffer kept for the next copy
+    size_t spare_cap;     // allocated size of spare
+} OutputQueue;
+
+typedef enum
+{
+    OUTPUT_DRAINED = 0, // everything was sent
+    OUTPUT_BLOCKED = 1, // socket buffer full, wait for EPOLLOUT
+    OUTPUT_ERROR   = -1 // send failed, drop the connection
+} OutputStatus;
+
+void output_init(OutputQueue *queue);
+void output_reset(OutputQueue *queue);
+void output_free(OutputQueue *queue);
+
+int output_append(OutputQueue *queue, const char *data, size_t len);
+int output_append_shared(OutputQueue *queue, const char *data, size_t len,
+                         void (*release)(void *ctx), void *ctx);
+int output_append_file(OutputQueue *queue, int fd, off_t offset, size_t length);
+
+int output_pending(const OutputQueue *queue);
+OutputStatus output_flush(OutputQueue *queue, int socket);
+
+#endif
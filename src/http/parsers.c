@@ -7,67 +7,91 @@
  */
 
 #include "parsers.h"
+#include "tokenizer.h"
 
+static int request_body_framing(RequestParser *parser, const HTTPRequest *req);
+static int response_body_framing(ResponseParser *parser);
+static int parse_content_length(const HTTPHeader *header, size_t *value);
+static int is_chunked(const HTTPHeader *header);
+static int is_token(const char *data, size_t len);
+static int is_tchar(unsigned char c);
+static int chunk_ext_step(ChunkedState *st, unsigned char c);
+static void chunk_line_end(ChunkedState *st);
+
+/**
+ * @brief   Parses "METHOD SP URI SP PROTOCOL CRLF" at the start of @p reqstr.
+ *
+ * The line end and the first space are found in one tokenizer pass, only
+ * the short remainder after the method is searched again for the URI end.
+ *
+ * @returns Bytes consumed including the CRLF, 0 if the line isn't complete
+ *          yet, -1 if it is malformed.
+ */
 int parse_request_line(HTTPRequest *req_t, const char *reqstr, size_t len)
 {
     if (!req_t || !reqstr) return -1;
 
-    // Putting pointers at start and end of the incoming string
-    const char *ptr = reqstr;
-    const char *end = reqstr + len;
+    size_t sp = 0;
+    size_t lf = token_line(reqstr, len, ' ', &sp);
+    if (lf == len) return 0;
+    if (lf == 0 || reqstr[lf - 1] != '\r') return -1;
 
     // Parse method (put pointer to buffer)
-    const char *space = memchr(ptr, ' ', end - ptr);
-    if (!space) return -1;
-    req_t->request_line.method     = (char *)ptr;
-    req_t->request_line.method_len = space - ptr;
-    ptr                            = space + 1;
+    size_t line_end = lf - 1;
+    if (sp == 0 || sp >= line_end) return -1;
+    req_t->request_line.method     = (char *)reqstr;
+    req_t->request_line.method_len = sp;
 
     // Parse URI (put pointer to buffer)
-    space = memchr(ptr, ' ', end - ptr);
-    if (!space) return -1;
-    req_t->request_line.uri     = (char *)ptr;
-    req_t->request_line.uri_len = space - ptr;
-    ptr                         = space + 1;
+    const char *uri   = reqstr + sp + 1;
+    const char *space = memchr(uri, ' ', reqstr + line_end - uri);
+    if (!space || space == uri) return -1;
+    req_t->request_line.uri     = (char *)uri;
+    req_t->request_line.uri_len = space - uri;
 
     // Parse protocol (put pointer to buffer)
-    const char *crlf = memmem(ptr, end - ptr, "\r\n", 2);
-    if (!crlf) return -1;
-    req_t->request_line.protocol     = (char *)ptr;
-    req_t->request_line.protocol_len = crlf - ptr;
-    ptr                              = crlf + 2;
-
-    LOG("DEBUG", "Request line parsed: %.*s", req_t->request_line.uri_len, req_t->request_line.uri);
+    req_t->request_line.protocol     = (char *)space + 1;
+    req_t->request_line.protocol_len = reqstr + line_end - (space + 1);
 
-    return ptr - reqstr;
+    return lf + 1;
 }
 
+/**
+ * @brief   Parses one "Name: value CRLF" header line.
+ *
+ * The name has to be a token right up to the colon (RFC 9112 section 5.1):
+ * "Host : x", a name with leading whitespace or control characters and an
+ * obs-fold continuation line are all rejected, a lenient parse would let
+ * them reach a backend that reads them differently.
+ *
+ * @returns Bytes consumed including the CRLF, 0 if the line isn't complete
+ *          yet, -1 if it is malformed.
+ */
 int parse_header(HTTPHeader *header, const char *line, size_t len)
 {
-    const char *ptr = line;
-    const char *end = line + len;
+    size_t colon = 0;
+    size_t lf    = token_line(line, len, ':', &colon);
+    if (lf == len) return 0;
+    if (lf == 0 || line[lf - 1] != '\r') return -1;
 
-    // Find colon
-    const char *colon = memchr(ptr, ':', end - ptr);
-    if (!colon) return -1;
-    header->name     = (char *)ptr;
-    header->name_len = colon - ptr;
-    ptr              = colon + 1;
+    // Name up to the colon
+    size_t line_end = lf - 1;
+    if (colon == 0 || colon >= line_end || !is_token(line, colon)) return -1;
+    header->name     = (char *)line;
+    header->name_len = colon;
+    header->id       = http_header_id(line, colon);
 
-    // Skip whitespaces
-    while (ptr < end && isspace(*ptr))
+    // Value without the surrounding whitespace
+    const char *ptr = line + colon + 1;
+    const char *end = line + line_end;
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
         ptr++;
-
-    // Find end of line
-    const char *crlf = memmem(ptr, end - ptr, "\r\n", 2);
-    if (!crlf) return -1;
+    while (end > ptr && (end[-1] == ' ' || end[-1] == '\t'))
+        end--;
     header->value     = (char *)ptr;
-    header->value_len = crlf - ptr;
-    ptr               = crlf + 2;
-
-    LOG("DEBUG", "Header parsed: %.*s", header->name_len, header->name);
+    header->value_len = end - ptr;
 
-    return ptr - line;
+    return lf + 1;
 }
 
 int parse_http_request(const char *data, size_t len, HTTPRequest *req)
@@ -77,17 +101,19 @@ int parse_http_request(const char *data, size_t len, HTTPRequest *req)
     int consumed    = 0;
 
     consumed = parse_request_line(req, ptr, end - ptr);
-    if (consumed < 0) return -1;
+    if (consumed <= 0) return -1;
     ptr += consumed;
 
     req->header_count = 0;
+    req->repeated     = 0;
+    memset(req->known, 0, sizeof(req->known));
     while (ptr < end && memcmp(ptr, "\r\n", 2) != 0)
     {
         if (req->header_count >= MAX_HEADERS) return -1;
         consumed = parse_header(&req->headers[req->header_count], ptr, end - ptr);
-        if (consumed < 0) return -1;
+        if (consumed <= 0) return -1;
         ptr += consumed;
-        req->header_count++;
+        index_http_header(req, req->header_count++);
     }
 
     if (ptr + 2 > end || memcmp(ptr, "\r\n", 2) != 0) return -1;
@@ -97,11 +123,403 @@ int parse_http_request(const char *data, size_t len, HTTPRequest *req)
     req->body     = (char *)ptr;
     req->body_len = end - ptr;
 
-    LOG("DEBUG", "HTTP request parsed.");
+    LOG(DEBUG, "HTTP request parsed.");
 
     return 0;
 }
 
+void request_parser_init(RequestParser *parser)
+{
+    memset(parser, 0, sizeof(RequestParser));
+    parser->state = PARSE_REQUEST_LINE;
+}
+
+/**
+ * @brief   Advances @p parser over the bytes of the request received so far.
+ *
+ * Call it again with the same @p data (grown by later reads) until it
+ * returns PARSE_DONE. The request line and headers are parsed a line at a
+ * time and never looked at again. The body is framed by Content-Length or
+ * decoded in place when chunked, so bytes after the request stay untouched
+ * and parser->parsed tells where the next pipelined request starts.
+ *
+ * @param   data  Start of the request. Pointers stored in @p req point into
+ *                it, and chunked bodies are decoded over it.
+ * @param   len   Bytes available from @p data, may include later requests.
+ *
+ * With parser->stream_body set it stops in PARSE_BODY once the head is
+ * complete, parser->parsed being the head length, and leaves the body to
+ * parse_request_body() so it never has to be buffered whole.
+ *
+ * @returns PARSE_DONE when the request is complete, PARSE_ERROR on malformed
+ *          input, otherwise the state waiting for more data.
+ */
+ParseState parse_http_request_partial(RequestParser *parser, HTTPRequest *req, char *data,
+                                      size_t len)
+{
+    while (parser->state != PARSE_DONE && parser->state != PARSE_ERROR)
+    {
+        char *ptr    = data + parser->parsed;
+        size_t avail = len - parser->parsed;
+
+        switch (parser->state)
+        {
+        case PARSE_REQUEST_LINE:
+        {
+            // Tolerate empty lines before a request (RFC 9112 section 2.2)
+            if (avail >= 2 && ptr[0] == '\r' && ptr[1] == '\n')
+            {
+                parser->parsed += 2;
+                break;
+            }
+
+            int consumed = parse_request_line(req, ptr, avail);
+            if (consumed == 0)
+            {
+                if (avail > MAX_REQUEST_HEAD) parser->state = PARSE_ERROR;
+                return parser->state;
+            }
+            if (consumed < 0 || req->request_line.protocol_len < 5 ||
+                memcmp(req->request_line.protocol, "HTTP/", 5) != 0)
+            {
+                parser->state = PARSE_ERROR;
+                break;
+            }
+            req->header_count = 0;
+            req->repeated     = 0;
+            memset(req->known, 0, sizeof(req->known));
+            parser->parsed += consumed;
+            parser->state = PARSE_HEADERS;
+            break;
+        }
+
+        case PARSE_HEADERS:
+        {
+            if (avail < 2) return parser->state;
+
+            if (ptr[0] != '\r')
+            {
+                if (req->header_count >= MAX_HEADERS)
+                {
+                    parser->state = PARSE_ERROR;
+                    break;
+                }
+                int consumed = parse_header(&req->headers[req->header_count], ptr, avail);
+                if (consumed == 0)
+                {
+                    if (len > MAX_REQUEST_HEAD) parser->state = PARSE_ERROR;
+                    return parser->state;
+                }
+                if (consumed < 0)
+                {
+                    parser->state = PARSE_ERROR;
+                    break;
+                }
+                index_http_header(req, req->header_count++);
+                parser->parsed += consumed;
+                break;
+            }
+
+            // Blank line: the head is complete, find out how the body is framed
+            if (ptr[1] != '\n' || request_body_framing(parser, req) < 0)
+            {
+                parser->state = PARSE_ERROR;
+                break;
+            }
+            parser->parsed += 2;
+            parser->body_start = parser->parsed;
+            parser->state = parser->chunked || parser->content_length > 0 ? PARSE_BODY : PARSE_DONE;
+            req->body     = NULL;
+            req->body_len = 0;
+            break;
+        }
+
+        case PARSE_BODY:
+            if (parser->stream_body) return parser->state;
+
+            if (!parser->chunked)
+            {
+                if (len - parser->body_start < parser->content_length) return parser->state;
+
+                req->body      = data + parser->body_start;
+                req->body_len  = parser->content_length;
+                parser->parsed = parser->body_start + parser->content_length;
+                parser->state  = PARSE_DONE;
+                break;
+            }
+
+            // Decoded chunks are moved down to follow the body decoded so far
+            size_t decoded = 0;
+            long consumed  = chunked_decode(&parser->chunk, ptr, avail,
+                                            data + parser->body_start + req->body_len, &decoded);
+            if (consumed < 0)
+            {
+                parser->state = PARSE_ERROR;
+                break;
+            }
+            parser->parsed += consumed;
+            req->body_len += decoded;
+            req->body = data + parser->body_start;
+
+            if (parser->chunk.phase != CHUNK_DONE) return parser->state;
+            parser->state = PARSE_DONE;
+            break;
+
+        default:
+            parser->state = PARSE_ERROR;
+            break;
+        }
+    }
+
+    return parser->state;
+}
+
+/**
+ * @brief   Advances a streamed body over the next bytes received after what
+ *          was consumed before.
+ *
+ * Used once parse_http_request_partial() stopped in PARSE_BODY for a parser
+ * with stream_body set. Bytes after the end of the body are left untouched
+ * and parser->state becomes PARSE_DONE when it ends.
+ *
+ * @param   decode   Strip the chunked framing, moving the data to the front of
+ *                   @p data. Otherwise the body is passed on as it was sent.
+ * @param   out_len  Set to the number of body bytes at the front of @p data.
+ *
+ * @returns Bytes of @p data that belong to the body, -1 on malformed input.
+ */
+long parse_request_body(RequestParser *parser, char *data, size_t len, int decode,
+                        size_t *out_len)
+{
+    *out_len = 0;
+    if (parser->state != PARSE_BODY) return 0;
+
+    if (!parser->chunked)
+    {
+        size_t n = len < parser->body_remaining ? len : parser->body_remaining;
+        parser->body_remaining -= n;
+        parser->body_received += n;
+        if (parser->body_remaining == 0) parser->state = PARSE_DONE;
+        *out_len = n;
+        return (long)n;
+    }
+
+    size_t decoded = 0;
+    long consumed  = chunked_decode(&parser->chunk, data, len, decode ? data : NULL, &decoded);
+    if (consumed < 0)
+    {
+        parser->state = PARSE_ERROR;
+        return -1;
+    }
+    parser->body_received += decoded;
+    if (parser->chunk.phase == CHUNK_DONE) parser->state = PARSE_DONE;
+    *out_len = decode ? decoded : (size_t)consumed;
+    return consumed;
+}
+
+/**
+ * @brief   Parses "HTTP/1.x SP 3DIGIT SP reason CRLF" at the start of @p line.
+ *
+ * @returns Bytes consumed including the CRLF, 0 if the line isn't complete
+ *          yet, -1 if it is malformed.
+ */
+int parse_status_line(ResponseParser *parser, const char *line, size_t len)
+{
+    size_t sp = 0;
+    size_t lf = token_line(line, len, ' ', &sp);
+    if (lf == len) return 0;
+    if (lf == 0 || line[lf - 1] != '\r') return -1;
+
+    size_t line_end = lf - 1;
+    if (sp != 8 || memcmp(line, "HTTP/1.", 7) != 0 || !isdigit((unsigned char)line[7])) return -1;
+    if (line_end < 12 || !isdigit((unsigned char)line[9]) || !isdigit((unsigned char)line[10]) ||
+        !isdigit((unsigned char)line[11]))
+        return -1;
+    if (line_end > 12 && line[12] != ' ') return -1;
+
+    parser->minor_version = line[7] - '0';
+    parser->status_code   = (line[9] - '0') * 100 + (line[10] - '0') * 10 + (line[11] - '0');
+    parser->reason        = line_end > 12 ? line + 13 : line + line_end;
+    parser->reason_len    = line_end > 12 ? line_end - 13 : 0;
+
+    return lf + 1;
+}
+
+void response_parser_init(ResponseParser *parser)
+{
+    parser->state        = PARSE_REQUEST_LINE;
+    parser->parsed       = 0;
+    parser->header_count = 0;
+}
+
+/**
+ * @brief   Advances @p parser over the bytes of a response head received so
+ *          far, like parse_http_request_partial() does for requests.
+ *
+ * Call it again with the same @p data (grown by later reads) until it
+ * returns PARSE_DONE, parser->parsed is then the head length and the body
+ * framing fields are set. The body itself is left to the caller.
+ *
+ * @returns PARSE_DONE when the head is complete, PARSE_ERROR on malformed or
+ *          ambiguously framed input, otherwise the state waiting for more.
+ */
+ParseState parse_http_response_partial(ResponseParser *parser, const char *data, size_t len)
+{
+    while (parser->state != PARSE_DONE && parser->state != PARSE_ERROR)
+    {
+        const char *ptr = data + parser->parsed;
+        size_t avail    = len - parser->parsed;
+        int consumed;
+
+        if (parser->state == PARSE_REQUEST_LINE)
+        {
+            consumed = parse_status_line(parser, ptr, avail);
+            if (consumed == 0) return parser->state;
+            if (consumed < 0)
+            {
+                parser->state = PARSE_ERROR;
+                break;
+            }
+            parser->parsed += consumed;
+            parser->state = PARSE_HEADERS;
+            continue;
+        }
+
+        if (avail < 2) return parser->state;
+        if (ptr[0] == '\r')
+        {
+            // Blank line: the head is complete, find out how the body is framed
+            parser->state = ptr[1] == '\n' && response_body_framing(parser) == OK ? PARSE_DONE
+                                                                                 : PARSE_ERROR;
+            parser->parsed += 2;
+            break;
+        }
+
+        if (parser->header_count >= MAX_HEADERS)
+        {
+            parser->state = PARSE_ERROR;
+            break;
+        }
+        consumed = parse_header(&parser->headers[parser->header_count], ptr, avail);
+        if (consumed == 0) return parser->state;
+        if (consumed < 0)
+        {
+            parser->state = PARSE_ERROR;
+            break;
+        }
+        parser->header_count++;
+        parser->parsed += consumed;
+    }
+
+    return parser->state;
+}
+
+/**
+ * @brief   Decodes (or just scans) a chunked body incrementally.
+ *
+ * Can be fed arbitrary slices of the stream. Chunk data is copied to @p out,
+ * which may alias @p in for in-place decoding, or skipped when @p out is NULL
+ * so callers relaying the raw bytes can track where the body ends.
+ *
+ * @param   st       Decoder state, zero-initialized before the first call.
+ * @param   in       Next slice of the encoded stream.
+ * @param   len      Length of @p in.
+ * @param   out      Destination for decoded data or NULL.
+ * @param   out_len  Set to the number of decoded bytes written, may be NULL.
+ *
+ * @returns Number of bytes of @p in consumed, -1 on malformed input. Stops
+ *          right after the final CRLF once st->phase is CHUNK_DONE.
+ */
+long chunked_decode(ChunkedState *st, const char *in, size_t len, char *out, size_t *out_len)
+{
+    size_t i       = 0;
+    size_t written = 0;
+
+    while (i < len && st->phase != CHUNK_DONE)
+    {
+        char c = in[i];
+
+        // Every line ends in CRLF, a bare CR or LF anywhere outside chunk
+        // data is malformed, so a relayed body ends where the backend sees it end
+        if (st->cr)
+        {
+            if (c != '\n') return -1;
+            st->cr = 0;
+            chunk_line_end(st);
+            i++;
+            continue;
+        }
+        if (c == '\n' && st->phase != CHUNK_DATA) return -1;
+
+        switch (st->phase)
+        {
+        case CHUNK_SIZE:
+            if (isxdigit((unsigned char)c))
+            {
+                if (st->remaining > (SIZE_MAX >> 4)) return -1;
+                int digit     = isdigit((unsigned char)c) ? c - '0' : (tolower(c) - 'a' + 10);
+                st->remaining = (st->remaining << 4) | digit;
+                st->digits++;
+            }
+            else if (st->digits == 0)
+            {
+                return -1;
+            }
+            else if (c == '\r')
+            {
+                st->cr = 1;
+            }
+            else if (c == ';' || c == ' ' || c == '\t')
+            {
+                st->phase = CHUNK_EXT;
+                st->ext   = c == ';' ? EXT_NAME_START : EXT_SEMICOLON;
+            }
+            else
+            {
+                return -1;
+            }
+            i++;
+            break;
+
+        case CHUNK_EXT:
+            if (chunk_ext_step(st, (unsigned char)c) < 0) return -1;
+            i++;
+            break;
+
+        case CHUNK_DATA:
+        {
+            size_t n = len - i < st->remaining ? len - i : st->remaining;
+            if (out) memmove(out + written, in + i, n);
+            written += n;
+            i += n;
+            st->remaining -= n;
+            if (st->remaining == 0) st->phase = CHUNK_DATA_END;
+            break;
+        }
+
+        case CHUNK_DATA_END:
+            if (c != '\r') return -1;
+            st->cr = 1;
+            i++;
+            break;
+
+        case CHUNK_TRAILER:
+            if (c == '\r')
+                st->cr = 1;
+            else
+                st->line_len++;
+            i++;
+            break;
+
+        case CHUNK_DONE:
+            break;
+        }
+    }
+
+    if (out_len) *out_len = written;
+    return (long)i;
+}
+
 void print_request(const HTTPRequest *req)
 {
     printf("Method: %.*s\n", (int)req->request_line.method_len, req->request_line.method);
@@ -138,3 +556,296 @@ const char *get_mime_type(const char *filepath)
 
     return "application/octet-stream";
 }
+
+/**
+ * @brief   Maps a header name to its HeaderId, switching on the length and
+ *          first letter so most names are rejected without a comparison.
+ */
+HeaderId http_header_id(const char *name, size_t len)
+{
+    static const char *names[HDR_COUNT] = {
+        [HDR_HOST]              = "host",
+        [HDR_CONNECTION]        = "connection",
+        [HDR_KEEP_ALIVE]        = "keep-alive",
+        [HDR_CONTENT_LENGTH]    = "content-length",
+        [HDR_TRANSFER_ENCODING] = "transfer-encoding",
+        [HDR_PROXY_CONNECTION]  = "proxy-connection",
+        [HDR_TE]                = "te",
+        [HDR_UPGRADE]           = "upgrade",
+        [HDR_ACCEPT_ENCODING]   = "accept-encoding",
+        [HDR_IF_NONE_MATCH]     = "if-none-match",
+        [HDR_IF_MODIFIED_SINCE] = "if-modified-since",
+        [HDR_IF_RANGE]          = "if-range",
+        [HDR_RANGE]             = "range",
+    };
+    HeaderId id;
+
+    switch (len)
+    {
+    case 2: id = HDR_TE; break;
+    case 4: id = HDR_HOST; break;
+    case 5: id = HDR_RANGE; break;
+    case 7: id = HDR_UPGRADE; break;
+    case 8: id = HDR_IF_RANGE; break;
+    case 10: id = (name[0] | 0x20) == 'c' ? HDR_CONNECTION : HDR_KEEP_ALIVE; break;
+    case 13: id = HDR_IF_NONE_MATCH; break;
+    case 14: id = HDR_CONTENT_LENGTH; break;
+    case 15: id = HDR_ACCEPT_ENCODING; break;
+    case 16: id = HDR_PROXY_CONNECTION; break;
+    case 17: id = (name[0] | 0x20) == 't' ? HDR_TRANSFER_ENCODING : HDR_IF_MODIFIED_SINCE; break;
+    default: return HDR_OTHER;
+    }
+
+    return strncasecmp(name, names[id], len) == 0 ? id : HDR_OTHER;
+}
+
+// ---------- UTILS ----------
+
+/**
+ * @brief   Reads Content-Length and Transfer-Encoding into @p parser.
+ *
+ * @returns OK, or -1 when the framing is invalid or ambiguous. A request
+ *          carrying both headers is rejected rather than guessed at, since
+ *          disagreeing with a proxy in front of us enables request smuggling.
+ */
+static int request_body_framing(RequestParser *parser, const HTTPRequest *req)
+{
+    parser->content_length = 0;
+    parser->body_remaining = 0;
+    parser->body_received  = 0;
+    parser->chunked        = 0;
+    memset(&parser->chunk, 0, sizeof(ChunkedState));
+
+    const HTTPHeader *length   = get_http_header(req, HDR_CONTENT_LENGTH);
+    const HTTPHeader *encoding = get_http_header(req, HDR_TRANSFER_ENCODING);
+    if (length && encoding) return -1;
+    if (req->repeated & (HDR_BIT(HDR_CONTENT_LENGTH) | HDR_BIT(HDR_TRANSFER_ENCODING))) return -1;
+
+    if (length)
+    {
+        if (parse_content_length(length, &parser->content_length) < 0) return -1;
+        parser->body_remaining = parser->content_length;
+    }
+    else if (encoding)
+    {
+        // chunked has to be the final coding, anything else we can't frame
+        if (!is_chunked(encoding)) return -1;
+        parser->chunked = 1;
+    }
+
+    return OK;
+}
+
+/**
+ * @brief   Reads the framing and persistence headers of a response head.
+ *
+ * @returns OK, or -1 when the framing is invalid or ambiguous, for the same
+ *          smuggling reasons as request_body_framing(). A transfer coding
+ *          other than chunked leaves the body delimited by the close.
+ */
+static int response_body_framing(ResponseParser *parser)
+{
+    const HTTPHeader *length   = NULL;
+    const HTTPHeader *encoding = NULL;
+
+    parser->has_length = 0;
+    parser->chunked    = 0;
+    parser->close      = parser->minor_version == 0; // HTTP/1.0 closes unless told otherwise
+
+    for (int i = 0; i < parser->header_count; i++)
+    {
+        const HTTPHeader *header = &parser->headers[i];
+        switch (header->id)
+        {
+        case HDR_CONTENT_LENGTH:
+            if (length) return -1;
+            length = header;
+            break;
+        case HDR_TRANSFER_ENCODING:
+            if (encoding) return -1;
+            encoding = header;
+            break;
+        case HDR_CONNECTION:
+            if (header->value_len == 5 && strncasecmp(header->value, "close", 5) == 0)
+                parser->close = 1;
+            else if (header->value_len == 10 && strncasecmp(header->value, "keep-alive", 10) == 0)
+                parser->close = 0;
+            break;
+        default:
+            break;
+        }
+    }
+    if (length && encoding) return -1;
+
+    if (length)
+    {
+        if (parse_content_length(length, &parser->content_length) < 0) return -1;
+        parser->has_length = 1;
+    }
+    else if (encoding)
+    {
+        parser->chunked = is_chunked(encoding);
+    }
+
+    return OK;
+}
+
+/**
+ * @brief   Reads a Content-Length value, digits only and without overflow.
+ */
+static int parse_content_length(const HTTPHeader *header, size_t *value)
+{
+    if (header->value_len == 0) return -1;
+
+    size_t n = 0;
+    for (size_t j = 0; j < header->value_len; j++)
+    {
+        char c = header->value[j];
+        if (!isdigit((unsigned char)c) || n > (SIZE_MAX - 9) / 10) return -1;
+        n = n * 10 + (c - '0');
+    }
+    *value = n;
+    return OK;
+}
+
+/**
+ * @returns Whether the last coding of a Transfer-Encoding list is exactly
+ *          the token chunked, and no earlier one is (RFC 9112 section 6.1).
+ *          "xchunked" or "chunked, chunked" is not.
+ */
+static int is_chunked(const HTTPHeader *header)
+{
+    const char *p   = header->value;
+    const char *end = p + header->value_len;
+    for (;;)
+    {
+        const char *comma = memchr(p, ',', end - p);
+        const char *stop  = comma ? comma : end;
+        while (p < stop && (*p == ' ' || *p == '\t'))
+            p++;
+        while (stop > p && (stop[-1] == ' ' || stop[-1] == '\t'))
+            stop--;
+
+        if (stop - p == 7 && strncasecmp(p, "chunked", 7) == 0) return !comma;
+        if (!comma) return 0;
+        p = comma + 1;
+    }
+}
+
+/**
+ * @returns Whether @p data is a non-empty token: alphanumerics and
+ *          !#$%&'*+-.^_`|~ (RFC 9110 section 5.6.2).
+ */
+static int is_token(const char *data, size_t len)
+{
+    if (len == 0) return 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!is_tchar((unsigned char)data[i])) return 0;
+    }
+    return 1;
+}
+
+static int is_tchar(unsigned char c)
+{
+    return isalnum(c) || (c != '\0' && strchr("!#$%&'*+-.^_`|~", c));
+}
+
+/**
+ * @brief   Takes one byte of the chunk extensions. A CR may only end the
+ *          line after a complete name or value.
+ *
+ * @returns OK, or -1 if the byte can't appear there.
+ */
+static int chunk_ext_step(ChunkedState *st, unsigned char c)
+{
+    int space = c == ' ' || c == '\t';
+
+    switch (st->ext)
+    {
+    case EXT_SEMICOLON:
+        if (c == ';') st->ext = EXT_NAME_START;
+        return c == ';' || space ? OK : -1;
+
+    case EXT_NAME_START:
+        if (is_tchar(c)) st->ext = EXT_NAME;
+        return is_tchar(c) || space ? OK : -1;
+
+    case EXT_NAME:
+    case EXT_EQUALS:
+        if (c == '=')
+            st->ext = EXT_VALUE_START;
+        else if (c == ';')
+            st->ext = EXT_NAME_START;
+        else if (space)
+            st->ext = EXT_EQUALS;
+        else if (st->ext == EXT_NAME && c == '\r')
+            st->cr = 1;
+        else if (st->ext != EXT_NAME || !is_tchar(c))
+            return -1;
+        return OK;
+
+    case EXT_VALUE_START:
+        if (c == '"')
+            st->ext = EXT_QUOTED;
+        else if (is_tchar(c))
+            st->ext = EXT_VALUE;
+        else if (!space)
+            return -1;
+        return OK;
+
+    case EXT_VALUE:
+    case EXT_VALUE_END:
+        if (c == ';')
+            st->ext = EXT_NAME_START;
+        else if (space)
+            st->ext = EXT_SEMICOLON;
+        else if (c == '\r')
+            st->cr = 1;
+        else if (st->ext != EXT_VALUE || !is_tchar(c))
+            return -1;
+        return OK;
+
+    case EXT_QUOTED:
+        // qdtext: HTAB, SP, VCHAR except '"' and '\', obs-text
+        if (c == '"')
+            st->ext = EXT_VALUE_END;
+        else if (c == '\\')
+            st->ext = EXT_ESCAPED;
+        else if (!space && (c < 0x21 || c == 0x7f))
+            return -1;
+        return OK;
+
+    case EXT_ESCAPED:
+        if (!space && (c < 0x21 || c == 0x7f)) return -1;
+        st->ext = EXT_QUOTED;
+        return OK;
+    }
+    return -1;
+}
+
+/**
+ * @brief   Moves on after the CRLF ending a size line, chunk data or a
+ *          trailer line.
+ */
+static void chunk_line_end(ChunkedState *st)
+{
+    switch (st->phase)
+    {
+    case CHUNK_SIZE:
+    case CHUNK_EXT:
+        st->digits   = 0;
+        st->phase    = st->remaining ? CHUNK_DATA : CHUNK_TRAILER;
+        st->line_len = 0;
+        break;
+    case CHUNK_DATA_END:
+        st->phase = CHUNK_SIZE;
+        break;
+    case CHUNK_TRAILER:
+        if (st->line_len == 0) st->phase = CHUNK_DONE;
+        st->line_len = 0;
+        break;
+    default:
+        break;
+    }
+}
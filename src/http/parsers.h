@@ -6,11 +6,107 @@
  *
  */
 
+#ifndef HTTPPARSERS_H
+#define HTTPPARSERS_H
+
 #include "request.h"
 #include "response.h"
 
+/**
+ * @brief   Incremental state of a chunked transfer-coding body.
+ */
+typedef enum
+{
+    CHUNK_SIZE,     // reading the hex size line
+    CHUNK_EXT,      // chunk extensions, up to the CRLF
+    CHUNK_DATA,     // inside chunk data
+    CHUNK_DATA_END, // CRLF after chunk data
+    CHUNK_TRAILER,  // trailer section after the last chunk
+    CHUNK_DONE      // terminating empty line seen
+} ChunkPhase;
+
+/**
+ * @brief   Position inside *( BWS ";" BWS name [ BWS "=" BWS value ] ), the
+ *          value being a token or a quoted string.
+ */
+typedef enum
+{
+    EXT_SEMICOLON,   // whitespace until the next ';'
+    EXT_NAME_START,  // whitespace until the name
+    EXT_NAME,        // inside the name
+    EXT_EQUALS,      // whitespace after the name, until '=' or ';'
+    EXT_VALUE_START, // whitespace until the value
+    EXT_VALUE,       // inside a token value
+    EXT_QUOTED,      // inside a quoted-string value
+    EXT_ESCAPED,     // after a backslash in it
+    EXT_VALUE_END    // right after the closing quote
+} ChunkExtPhase;
+
+typedef struct ChunkedState
+{
+    ChunkPhase phase;
+    ChunkExtPhase ext; // where in the extensions, while in CHUNK_EXT
+    size_t remaining;  // bytes left in the current chunk (or its size while parsing)
+    size_t line_len;   // length of the current trailer line
+    int digits;        // hex digits seen on the size line
+    int cr;            // a line ended in CR, only LF may follow
+} ChunkedState;
+
+long chunked_decode(ChunkedState *st, const char *in, size_t len, char *out, size_t *out_len);
+
+/**
+ * @brief   Progress of one request, kept between reads so parsing resumes
+ *          where it stopped instead of starting over.
+ */
+typedef struct RequestParser
+{
+    ParseState state;      // next part expected, PARSE_DONE once complete
+    size_t parsed;         // bytes of the request consumed so far
+    size_t body_start;     // offset of the body in the request
+    size_t content_length; // Content-Length framed body size
+    int chunked;           // Transfer-Encoding: chunked body
+    ChunkedState chunk;    // decoder state of a chunked body
+    int stream_body;       // stop after the head, the body goes through parse_request_body()
+    size_t body_remaining; // Content-Length body bytes not streamed yet
+    size_t body_received;  // body bytes streamed so far, without chunk framing
+} RequestParser;
+
+void request_parser_init(RequestParser *parser);
+ParseState parse_http_request_partial(RequestParser *parser, HTTPRequest *req, char *data,
+                                      size_t len);
+long parse_request_body(RequestParser *parser, char *data, size_t len, int decode,
+                        size_t *out_len);
+
+/**
+ * @brief   Progress of a response head read from a backend. The status line
+ *          and headers go through the same line and header routines as
+ *          request heads. Pointers refer to the data being parsed.
+ */
+typedef struct ResponseParser
+{
+    ParseState state;                // PARSE_REQUEST_LINE stands for the status line
+    size_t parsed;                   // bytes of the head consumed so far
+    int minor_version;               // x of HTTP/1.x
+    int status_code;                 // three digit status code
+    const char *reason;              // reason phrase
+    size_t reason_len;
+    HTTPHeader headers[MAX_HEADERS]; // every header, in order
+    int header_count;
+    size_t content_length;           // Content-Length, if has_length
+    int has_length;                  // Content-Length framed body
+    int chunked;                     // Transfer-Encoding ends in chunked
+    int close;                       // the backend closes the connection after this
+} ResponseParser;
+
+void response_parser_init(ResponseParser *parser);
+ParseState parse_http_response_partial(ResponseParser *parser, const char *data, size_t len);
+int parse_status_line(ResponseParser *parser, const char *line, size_t len);
+
 int parse_request_line(HTTPRequest *req_t, const char *reqstr, size_t len);
 int parse_header(HTTPHeader *header, const char *line, size_t len);
+HeaderId http_header_id(const char *name, size_t len);
 int parse_http_request(const char *data, size_t len, HTTPRequest *req);
 void print_request(const HTTPRequest *req);
-const char *get_mime_type(const char *filepath);
\ No newline at end of file
+const char *get_mime_type(const char *filepath);
+
+#endif
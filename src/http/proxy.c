@@ -0,0 +1,913 @@
+/**
+ * @file    proxy.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Non-blocking reverse proxy implementations.
+ *
+ * @details An Upstream is registered in the worker's epoll instance next to
+ *          the client sockets and moves CONNECTING -> SENDING -> RECEIVING as
+ *          readiness events arrive. Response bytes are appended to the
+ *          client's output as soon as they are read, so a slow backend only
+ *          delays its own client.
+ *
+ *          The request body is not buffered: it is relayed from the client's
+ *          input buffer as it arrives, in its original framing, and reading
+ *          from the client pauses while the backend doesn't keep up.
+ *
+ *          Backend connections are HTTP/1.1 keep-alive and come from the
+ *          Backend's pool. The response head is parsed with the request
+ *          parser's line and header routines and forwarded without its
+ *          hop-by-hop headers; the body follows byte for byte in its original
+ *          framing (Content-Length or chunked), which is tracked so the
+ *          connection can go back to the pool as soon as the response ends.
+ *
+ *          Cacheable GETs are looked up in the worker's ProxyCache first. A
+ *          request that misses feeds the response into a cache fill while
+ *          relaying it, and concurrent misses on it wait until the fill ends.
+ *          An unsafe request that succeeds purges its target from the cache
+ *          of every worker.
+ */
+
+#include <inttypes.h>
+#include "proxy.h"
+#include "utils/clock.h"
+
+// Hop-by-hop headers, plus the request framing and Host the proxy writes itself
+#define RESPONSE_HOP_HEADERS                                                                    \
+    (HDR_BIT(HDR_CONNECTION) | HDR_BIT(HDR_KEEP_ALIVE) | HDR_BIT(HDR_PROXY_CONNECTION) |       \
+     HDR_BIT(HDR_TE) | HDR_BIT(HDR_UPGRADE))
+#define REQUEST_HOP_HEADERS                                                                     \
+    (RESPONSE_HOP_HEADERS | HDR_BIT(HDR_HOST) | HDR_BIT(HDR_CONTENT_LENGTH) |                   \
+     HDR_BIT(HDR_TRANSFER_ENCODING))
+
+static int is_hop_header(const HTTPHeader *header, uint32_t hop_headers);
+static int is_idempotent(const HTTPRequest *req);
+static int proxy_build_request(Upstream *up, Backend *backend);
+static long proxy_send_body(Worker *worker, Connection *conn, const char *data, size_t len,
+                            int last);
+static int proxy_connect(Worker *worker, Upstream *up);
+static int proxy_start(Worker *worker, Connection *conn, ProxyCacheFill *fill);
+static int proxy_serve_cached(Connection *conn, ProxyCacheEntry *entry);
+static void proxy_end_fill(Worker *worker, ProxyCacheFill *fill, int complete);
+static void proxy_drop_fill(Worker *worker, Upstream *up, int complete);
+static void proxy_invalidate(Worker *worker, const HTTPRequest *req);
+static int proxy_relay_response(Worker *worker, Upstream *up, const char *data, size_t len);
+static int proxy_relay_head(Worker *worker, Upstream *up);
+static int proxy_track_body(Worker *worker, Upstream *up, const char *data, size_t len);
+static void proxy_fail(Worker *worker, Upstream *up);
+static void proxy_finish(Worker *worker, Upstream *up, int reusable);
+static void proxy_close(Worker *worker, Upstream *up, int reusable);
+static int proxy_set_events(Worker *worker, Upstream *up, uint32_t events);
+
+/**
+ * @brief   Answers the parsed request on @p conn from the response cache or
+ *          hands it to a backend chosen by the worker's balancer.
+ *
+ * The client is parked in CONN_PROXYING until the upstream finishes, or
+ * until the fetch of the same response it waits for does. If no backend can
+ * even be dialed a 502 is queued instead.
+ *
+ * @returns OK if the request was proxied or answered, -1 on internal error.
+ */
+int proxy_request(Worker *worker, Connection *conn)
+{
+    ProxyCacheEntry *entry = NULL;
+    ProxyCacheFill *fill   = NULL;
+
+    switch (proxycache_lookup(&worker->proxy_cache, &conn->request, &entry, &fill))
+    {
+    case PROXYCACHE_HIT:
+        return proxy_serve_cached(conn, entry);
+
+    case PROXYCACHE_WAIT:
+        conn->cache_fill = fill;
+        conn->wait_next  = fill->waiters;
+        fill->waiters    = conn;
+        conn->phase      = CONN_PROXYING;
+        update_connection_events(worker, conn);
+        return OK;
+
+    default:
+        return proxy_start(worker, conn, fill);
+    }
+}
+
+/**
+ * @brief   Takes a request waiting for a cache fetch off it, its client went
+ *          away.
+ */
+void proxy_cancel_wait(Worker *worker, Connection *conn)
+{
+    (void)worker;
+
+    Connection **link = &conn->cache_fill->waiters;
+    while (*link && *link != conn)
+        link = &(*link)->wait_next;
+    if (*link) *link = conn->wait_next;
+
+    conn->cache_fill = NULL;
+    conn->wait_next  = NULL;
+}
+
+/**
+ * @brief   Sends the request on @p conn to a backend, feeding the response
+ *          into @p fill as well unless it is NULL.
+ */
+static int proxy_start(Worker *worker, Connection *conn, ProxyCacheFill *fill)
+{
+    HTTPRequest *req = &conn->request;
+
+    Upstream *up = calloc(1, sizeof(Upstream));
+    if (!up)
+    {
+        if (fill) proxy_end_fill(worker, fill, 0);
+        return -1;
+    }
+
+    up->kind         = EV_UPSTREAM;
+    up->fd           = -1;
+    up->client       = conn;
+    up->head_request = req->request_line.method_len == 4 &&
+                       strncmp(req->request_line.method, "HEAD", 4) == 0;
+    up->retryable    = is_idempotent(req);
+    up->started_us   = monotonic_us();
+    up->fill         = fill;
+    up->balancer     = &conn->config->balancer;
+
+    // Backends outside the route's group count as tried, so neither the first
+    // pick nor a retry leaves the group
+    const Route *route = conn->route;
+    if (route && route->backends) up->tried = ~route->backends;
+
+    // Dial failures are cheap to detect, so try every backend before giving up
+    Backend *backend;
+    while ((backend = balancer_pick(up->balancer, req, up->tried)) != NULL)
+    {
+        up->tried |= balancer_mask(up->balancer, backend);
+        if (proxy_build_request(up, backend) < 0)
+        {
+            proxy_drop_fill(worker, up, 0);
+            free(up->req_buf);
+            free(up);
+            return -1;
+        }
+        if (proxy_connect(worker, up) == 0) break;
+
+        LOG(ERROR, "Failed to connect to backend %s:%s.", backend->host, backend->port);
+        balancer_report(up->balancer, backend, 0);
+    }
+
+    if (!backend)
+    {
+        proxy_drop_fill(worker, up, 0);
+        free(up->req_buf);
+        free(up);
+        return queue_canned(conn, 502);
+    }
+
+    conn->upstream = up;
+    conn->phase    = CONN_PROXYING;
+    conn->on_body  = proxy_send_body;
+    conn->body_raw = 1;
+    update_connection_events(worker, conn);
+
+    LOG(DEBUG, "Proxying %.*s to %s:%s (FD %d%s).", (int)req->request_line.uri_len,
+        req->request_line.uri, backend->host, backend->port, up->fd,
+        up->reused ? ", reused" : "");
+
+    return OK;
+}
+
+/**
+ * @brief   Advances an upstream on a readiness event from its backend fd.
+ */
+void proxy_handle_event(Worker *worker, Upstream *up, uint32_t events)
+{
+    if (up->state == UPSTREAM_CLOSED) return; // closed earlier in this batch
+
+    if (up->state == UPSTREAM_CONNECTING)
+    {
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return;
+
+        int err       = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(up->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0)
+        {
+            LOG(ERROR, "Failed to connect to proxy backend.");
+            proxy_fail(worker, up);
+            return;
+        }
+        up->state = UPSTREAM_SENDING;
+    }
+
+    if (up->state == UPSTREAM_SENDING)
+    {
+        while (up->req_sent < up->req_len)
+        {
+            ssize_t bytes_sent = send(up->fd, up->req_buf + up->req_sent,
+                                      up->req_len - up->req_sent, MSG_NOSIGNAL);
+            if (bytes_sent < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+                if (errno == EINTR) continue;
+
+                LOG(ERROR, "Failed to send request to proxy backend.");
+                proxy_fail(worker, up);
+                return;
+            }
+            up->req_sent += bytes_sent;
+        }
+
+        // The body follows as the client sends it, proxy_send_body() moves on
+        if (up->client && up->client->body_streaming)
+        {
+            if ((events & (EPOLLERR | EPOLLHUP)) || proxy_set_events(worker, up, 0) < 0)
+                proxy_fail(worker, up);
+            else
+                resume_body(worker, up->client);
+            return;
+        }
+
+        up->state = UPSTREAM_RECEIVING;
+        if (proxy_set_events(worker, up, EPOLLIN) < 0) proxy_fail(worker, up);
+        return;
+    }
+
+    if (up->state == UPSTREAM_RECEIVING)
+    {
+        Connection *conn = up->client;
+        char chunk[PROXY_CHUNK_SIZE];
+
+        while (conn->out.pending_bytes < PROXY_OUTPUT_HIGH_WATER)
+        {
+            ssize_t bytes_read = recv(up->fd, chunk, sizeof(chunk), 0);
+            if (bytes_read < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if (errno == EINTR) continue;
+
+                LOG(ERROR, "Failed to read from backend.");
+                proxy_fail(worker, up);
+                return;
+            }
+            if (bytes_read == 0)
+            {
+                // Only a close-delimited body may legitimately end with EOF
+                if (up->head_done && up->body_mode == BODY_UNTIL_CLOSE)
+                {
+                    conn->keep_alive = 0;
+                    proxy_finish(worker, up, 0);
+                }
+                else
+                {
+                    LOG(ERROR, "Backend closed the connection mid-response.");
+                    proxy_fail(worker, up);
+                }
+                return;
+            }
+
+            up->resp_bytes += bytes_read;
+
+            int complete = proxy_relay_response(worker, up, chunk, bytes_read);
+            if (complete < 0)
+            {
+                LOG(ERROR, "Malformed response from backend.");
+                proxy_fail(worker, up);
+                return;
+            }
+            if (complete)
+            {
+                proxy_finish(worker, up, !up->backend_close);
+                return;
+            }
+        }
+
+        // Stop reading until the client drains, flush_connection() resumes us
+        if (conn->out.pending_bytes >= PROXY_OUTPUT_HIGH_WATER)
+        {
+            up->paused = 1;
+            proxy_set_events(worker, up, 0);
+        }
+
+        flush_connection(worker, conn);
+    }
+}
+
+/**
+ * @brief   Re-enables reading from a backend paused for backpressure.
+ */
+void proxy_resume(Worker *worker, Upstream *up)
+{
+    if (!up->paused || up->state != UPSTREAM_RECEIVING) return;
+
+    up->paused = 0;
+    if (proxy_set_events(worker, up, EPOLLIN) < 0) proxy_fail(worker, up);
+}
+
+/**
+ * @brief   Drops an upstream whose client went away. Its backend connection
+ *          is mid-exchange and can't be pooled.
+ */
+void proxy_abort(Worker *worker, Upstream *up)
+{
+    proxy_drop_fill(worker, up, 0);
+    up->client = NULL;
+    proxy_close(worker, up, 0);
+}
+
+/**
+ * @brief   Frees upstreams closed during the last batch of events.
+ */
+void proxy_reap(Worker *worker)
+{
+    while (worker->closed_upstreams)
+    {
+        Upstream *up             = worker->closed_upstreams;
+        worker->closed_upstreams = up->next;
+        free(up->req_buf);
+        free(up->head);
+        free(up);
+    }
+}
+
+// ---------- UTILS ----------
+
+/**
+ * @brief   Whether @p header is one of @p hop_headers (HDR_BIT() mask), the
+ *          hop-by-hop headers and those the proxy rewrites itself, which
+ *          aren't forwarded.
+ */
+static int is_hop_header(const HTTPHeader *header, uint32_t hop_headers)
+{
+    return header->id != HDR_OTHER && (hop_headers & HDR_BIT(header->id)) != 0;
+}
+
+/**
+ * @brief   Requests that can be replayed on a fresh connection when a pooled
+ *          one turns out to be dead.
+ */
+static int is_idempotent(const HTTPRequest *req)
+{
+    static const char *methods[] = {"GET", "HEAD", "PUT", "DELETE", "OPTIONS", "TRACE"};
+
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++)
+    {
+        if (req->request_line.method_len == strlen(methods[i]) &&
+            strncmp(req->request_line.method, methods[i], req->request_line.method_len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief   Serializes the client's request for @p backend into up->req_buf.
+ */
+static int proxy_build_request(Upstream *up, Backend *backend)
+{
+    HTTPRequest *req = &up->client->request;
+
+    // A wildcard route forwards the path below its prefix, "/api/users" as "/users"
+    const char *api_path = up->client->route_path;
+    size_t api_path_len  = up->client->route_path_len;
+    const char *slash    = (api_path_len == 0 || api_path[0] != '/') ? "/" : "";
+
+    // Request line, forwarded headers and our own framing headers, the body
+    // is relayed from the client's buffer afterwards
+    size_t capacity = req->request_line.method_len + api_path_len + strlen(backend->host) +
+                      strlen(backend->port) + 128;
+    for (int i = 0; i < req->header_count; i++)
+        capacity += req->headers[i].name_len + req->headers[i].value_len + 4;
+
+    char *proxy_request = malloc(capacity);
+    if (!proxy_request)
+    {
+        LOG(ERROR, "Failed to build proxy request.");
+        return -1;
+    }
+
+    size_t len = snprintf(proxy_request, capacity, "%.*s %s%.*s HTTP/1.1\r\nHost: %s:%s\r\n",
+                          (int)req->request_line.method_len, req->request_line.method, slash,
+                          (int)api_path_len, api_path, backend->host, backend->port);
+
+    for (int i = 0; i < req->header_count; i++)
+    {
+        if (is_hop_header(&req->headers[i], REQUEST_HOP_HEADERS)) continue;
+        len += snprintf(proxy_request + len, capacity - len, "%.*s: %.*s\r\n",
+                        (int)req->headers[i].name_len, req->headers[i].name,
+                        (int)req->headers[i].value_len, req->headers[i].value);
+    }
+
+    const RequestParser *parser = &up->client->parser;
+    if (parser->chunked)
+        len += snprintf(proxy_request + len, capacity - len, "Transfer-Encoding: chunked\r\n");
+    else
+        len += snprintf(proxy_request + len, capacity - len, "Content-Length: %zu\r\n",
+                        parser->content_length);
+    len += snprintf(proxy_request + len, capacity - len, "Connection: keep-alive\r\n\r\n");
+
+    free(up->req_buf);
+    up->req_buf  = proxy_request;
+    up->req_len  = len;
+    up->backend  = backend;
+    up->reused   = 0;
+    up->retried  = 0;
+    return OK;
+}
+
+/**
+ * @brief   Body handler of proxied requests: sends what the client's buffer
+ *          holds of the body straight to the backend.
+ *
+ * Nothing is taken before the request head is out. Whatever the backend
+ * socket doesn't accept stays in the client's buffer, which pauses reading
+ * from the client until EPOLLOUT on the backend resumes the body.
+ */
+static long proxy_send_body(Worker *worker, Connection *conn, const char *data, size_t len,
+                            int last)
+{
+    Upstream *up = conn->upstream;
+    if (!up || up->state != UPSTREAM_SENDING || up->req_sent < up->req_len) return 0;
+
+    size_t sent = 0;
+    while (sent < len)
+    {
+        ssize_t bytes_sent = send(up->fd, data + sent, len - sent, MSG_NOSIGNAL);
+        if (bytes_sent < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+
+            LOG(ERROR, "Failed to send request body to proxy backend.");
+            up->body_sent += sent;
+            proxy_fail(worker, up);
+            return (long)sent;
+        }
+        sent += bytes_sent;
+    }
+    up->body_sent += sent;
+
+    if (sent < len)
+    {
+        if (proxy_set_events(worker, up, EPOLLOUT) < 0) proxy_fail(worker, up);
+        return (long)sent;
+    }
+    if (last)
+    {
+        up->state = UPSTREAM_RECEIVING;
+        if (proxy_set_events(worker, up, EPOLLIN) < 0) proxy_fail(worker, up);
+    }
+    return (long)sent;
+}
+
+/**
+ * @brief   Takes a connection from the backend's pool (or dials a new one)
+ *          and registers it for the first step of the exchange.
+ */
+static int proxy_connect(Worker *worker, Upstream *up)
+{
+    up->fd = backend_acquire(up->backend, &up->reused);
+    if (up->fd < 0) return -1;
+
+    // A pooled connection is usually established already, but a pre-warmed one
+    // may still be connecting: EPOLLOUT covers both.
+    up->state    = UPSTREAM_CONNECTING;
+    up->req_sent = 0;
+
+    struct epoll_event ev;
+    ev.events   = EPOLLOUT;
+    ev.data.ptr = up;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, up->fd, &ev) == -1)
+    {
+        LOG(ERROR, "Failed to add backend socket to epoll event loop.");
+        backend_release(up->backend, up->fd, 0);
+        up->fd = -1;
+        return -1;
+    }
+
+    return OK;
+}
+
+/**
+ * @brief   Relays one read of response bytes to the client.
+ *
+ * Heads are parsed where they arrive, or gathered in up->head first when a
+ * read ends inside one, and queued rewritten by proxy_relay_head(). Interim
+ * 1xx heads are relayed the same way and followed by the final one. Body
+ * bytes are queued as they are.
+ *
+ * @returns 1 once the response is complete, 0 if more is expected, -1 if
+ *          the response can't be parsed or framed.
+ */
+static int proxy_relay_response(Worker *worker, Upstream *up, const char *data, size_t len)
+{
+    while (!up->head_done)
+    {
+        const char *head = data;
+        size_t gathered  = up->head_len;
+
+        if (gathered > 0)
+        {
+            if (gathered + len > PROXY_MAX_HEAD) return -1;
+            memcpy(up->head + gathered, data, len);
+            up->head_len += len;
+            head = up->head;
+        }
+
+        response_parser_init(&up->parser);
+        ParseState state = parse_http_response_partial(&up->parser, head, gathered + len);
+        if (state == PARSE_ERROR) return -1;
+        if (state != PARSE_DONE)
+        {
+            // Keep the partial head until the rest of it arrives
+            if (gathered == 0)
+            {
+                if (len > PROXY_MAX_HEAD) return -1;
+                if (!up->head && !(up->head = malloc(PROXY_MAX_HEAD))) return -1;
+                memcpy(up->head, data, len);
+                up->head_len = len;
+            }
+            return 0;
+        }
+
+        if (proxy_relay_head(worker, up) < 0) return -1;
+
+        // The rest of this read follows the head
+        data += up->parser.parsed - gathered;
+        len -= up->parser.parsed - gathered;
+        up->head_len = 0;
+    }
+
+    if (len == 0) return up->body_mode == BODY_NONE;
+    return proxy_track_body(worker, up, data, len);
+}
+
+/**
+ * @brief   Queues the parsed head for the client as HTTP/1.1, without the
+ *          backend's hop-by-hop headers, and works out how its body ends.
+ *
+ * The client connection's own persistence is announced instead, so a close
+ * delimited body makes it "Connection: close".
+ */
+static int proxy_relay_head(Worker *worker, Upstream *up)
+{
+    const ResponseParser *parser = &up->parser;
+    Connection *conn             = up->client;
+    int code                     = parser->status_code;
+    int interim                  = code >= 100 && code < 200 && code != 101;
+
+    if (!interim)
+    {
+        up->head_done     = 1;
+        up->backend_close = parser->close;
+        conn->status      = code;
+
+        if (up->head_request || code == 204 || code == 304 || (code >= 100 && code < 200))
+        {
+            up->body_mode = BODY_NONE;
+        }
+        else if (parser->chunked)
+        {
+            up->body_mode = BODY_CHUNKED;
+            memset(&up->chunked, 0, sizeof(ChunkedState));
+        }
+        else if (parser->has_length)
+        {
+            up->body_mode      = BODY_LENGTH;
+            up->body_remaining = parser->content_length;
+        }
+        else
+        {
+            up->body_mode     = BODY_UNTIL_CLOSE;
+            up->backend_close = 1;
+            conn->keep_alive  = 0; // the client has to see the close too
+        }
+
+        if (code < 400) proxy_invalidate(worker, &conn->request);
+
+        // Requests waiting on an uncacheable response go to the backend themselves
+        if (up->fill && proxycache_fill_head(&worker->proxy_cache, up->fill, &conn->request,
+                                             parser, RESPONSE_HOP_HEADERS) < 0)
+            proxy_drop_fill(worker, up, 0);
+    }
+
+    // Status line, forwarded headers, our Connection header and the blank line
+    size_t capacity = 13 + parser->reason_len + 2 + 19 + 2;
+    for (int i = 0; i < parser->header_count; i++)
+        capacity += parser->headers[i].name_len + parser->headers[i].value_len + 4;
+
+    char *head = arena_alloc(&conn->arena, capacity);
+    if (!head) return -1;
+
+    size_t len = snprintf(head, capacity, "HTTP/1.1 %03d %.*s\r\n", code, (int)parser->reason_len,
+                          parser->reason);
+    for (int i = 0; i < parser->header_count; i++)
+    {
+        const HTTPHeader *header = &parser->headers[i];
+        if (is_hop_header(header, RESPONSE_HOP_HEADERS)) continue;
+
+        memcpy(head + len, header->name, header->name_len);
+        len += header->name_len;
+        head[len++] = ':';
+        head[len++] = ' ';
+        memcpy(head + len, header->value, header->value_len);
+        len += header->value_len;
+        head[len++] = '\r';
+        head[len++] = '\n';
+    }
+    if (!interim && !conn->keep_alive)
+    {
+        memcpy(head + len, "Connection: close\r\n", 19);
+        len += 19;
+    }
+    head[len++] = '\r';
+    head[len++] = '\n';
+
+    if (output_append_shared(&conn->out, head, len, NULL, NULL) < 0) return -1;
+    up->relayed += len;
+
+    return OK;
+}
+
+/**
+ * @brief   Relays body bytes and follows their framing.
+ *
+ * @returns 1 once the body is complete, 0 if more is expected, -1 if the
+ *          chunked framing is broken.
+ */
+static int proxy_track_body(Worker *worker, Upstream *up, const char *data, size_t len)
+{
+    size_t body = len;
+    int complete;
+
+    switch (up->body_mode)
+    {
+    case BODY_NONE:
+        body     = 0;
+        complete = 1;
+        break;
+
+    case BODY_LENGTH:
+        if (len > up->body_remaining) body = up->body_remaining;
+        up->body_remaining -= body;
+        complete = up->body_remaining == 0;
+        break;
+
+    case BODY_CHUNKED:
+    {
+        long consumed = chunked_decode(&up->chunked, data, len, NULL, NULL);
+        if (consumed < 0) return -1;
+        body     = consumed;
+        complete = up->chunked.phase == CHUNK_DONE;
+        break;
+    }
+
+    default:
+        complete = 0;
+        break;
+    }
+
+    // Bytes past the end of the response we can't account for
+    if (body < len) up->backend_close = 1;
+
+    if (body > 0)
+    {
+        if (queue_output(up->client, data, body) < 0) return -1;
+        up->relayed += body;
+
+        if (up->fill && proxycache_fill_body(&worker->proxy_cache, up->fill, data, body) < 0)
+            proxy_drop_fill(worker, up, 0);
+    }
+    return complete;
+}
+
+/**
+ * @brief   Ends the exchange on a backend error.
+ *
+ * Before any response byte arrived and as long as no body byte was relayed
+ * (those are gone from the client's buffer) the request is retried: once on
+ * a fresh connection if a pooled one turned out to be dead, then on the
+ * other backends if the request is idempotent or was never sent. Otherwise, if
+ * nothing was relayed yet the client gets a 502, else it is closed after
+ * what it has.
+ */
+static void proxy_fail(Worker *worker, Upstream *up)
+{
+    Connection *conn = up->client;
+    int reported     = 0;
+
+    while (conn && up->resp_bytes == 0 && up->body_sent == 0 &&
+           (up->retryable || up->req_sent == 0))
+    {
+        Backend *next = NULL;
+
+        if (up->fd >= 0)
+        {
+            epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, up->fd, NULL);
+            backend_release(up->backend, up->fd, 0);
+            up->fd = -1;
+        }
+
+        if (up->reused && !up->retried)
+        {
+            LOG(DEBUG, "Pooled connection to %s:%s failed, retrying.", up->backend->host,
+                up->backend->port);
+
+            // Drain the rest of the pool too, its connections are likely just as stale
+            while (up->backend->idle_count > 0)
+                close(up->backend->idle[--up->backend->idle_count].fd);
+            up->retried = 1;
+            next        = up->backend;
+        }
+        else
+        {
+            balancer_report(up->balancer, up->backend, 0);
+            reported = 1;
+
+            next = balancer_pick(up->balancer, &conn->request, up->tried);
+            if (!next) break;
+
+            LOG(DEBUG, "Backend %s:%s failed, retrying on %s:%s.", up->backend->host,
+                up->backend->port, next->host, next->port);
+            up->tried |= balancer_mask(up->balancer, next);
+            if (proxy_build_request(up, next) < 0) break;
+            reported = 0;
+        }
+
+        if (proxy_connect(worker, up) == 0) return;
+    }
+
+    if (!reported) balancer_report(up->balancer, up->backend, 0);
+    proxy_drop_fill(worker, up, 0);
+
+    int relayed = up->relayed > 0;
+
+    proxy_close(worker, up, 0);
+    if (!conn) return;
+
+    conn->upstream = NULL;
+    conn->phase    = CONN_WRITING;
+    abandon_body(worker, conn); // nobody takes the rest of it now
+
+    if (!relayed)
+    {
+        if (queue_canned(conn, 502) < 0)
+        {
+            close_connection(worker, conn);
+            return;
+        }
+    }
+    else
+    {
+        conn->keep_alive = 0;
+    }
+    flush_connection(worker, conn);
+}
+
+/**
+ * @brief   The response is complete, hand the client back to the write path.
+ */
+static void proxy_finish(Worker *worker, Upstream *up, int reusable)
+{
+    Connection *conn = up->client;
+
+    LOG(DEBUG, "Received %zu bytes response from backend.", up->resp_bytes);
+
+    proxy_drop_fill(worker, up, 1);
+
+    balancer_report(up->balancer, up->backend, 1);
+    proxy_close(worker, up, reusable);
+    if (!conn) return;
+
+    conn->upstream = NULL;
+    conn->phase    = CONN_WRITING;
+    flush_connection(worker, conn);
+}
+
+/**
+ * @brief   Unregisters the backend fd and returns it to the pool (or closes
+ *          it). The struct itself is freed by proxy_reap() once the current
+ *          batch of events is processed.
+ */
+static void proxy_close(Worker *worker, Upstream *up, int reusable)
+{
+    if (up->state == UPSTREAM_CLOSED) return;
+
+    // Latency and backend of the exchange for the access log
+    if (up->client)
+    {
+        up->client->backend     = up->backend;
+        up->client->upstream_us = (uint32_t)(monotonic_us() - up->started_us);
+    }
+
+    if (up->fd >= 0)
+    {
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, up->fd, NULL);
+        backend_release(up->backend, up->fd, reusable);
+        up->fd = -1;
+    }
+    up->state = UPSTREAM_CLOSED;
+
+    up->next                 = worker->closed_upstreams;
+    worker->closed_upstreams = up;
+}
+
+/**
+ * @brief   Queues a cached response by reference, with its Age and the
+ *          client's Connection header appended to the stored head.
+ */
+static int proxy_serve_cached(Connection *conn, ProxyCacheEntry *entry)
+{
+    char *tail = arena_sprintf(&conn->arena, "Age: %" PRIu64 "\r\n%s\r\n", proxycache_age(entry),
+                               conn->keep_alive ? "" : "Connection: close\r\n");
+    if (!tail) return -1;
+
+    conn->status = entry->status_code;
+
+    proxycache_retain(entry);
+    if (output_append_shared(&conn->out, entry->data, entry->head_len, proxycache_release,
+                             entry) < 0 ||
+        output_append_shared(&conn->out, tail, strlen(tail), NULL, NULL) < 0)
+        return -1;
+    if (entry->body_len == 0) return OK;
+
+    proxycache_retain(entry);
+    return output_append_shared(&conn->out, entry->data + entry->head_len, entry->body_len,
+                                proxycache_release, entry);
+}
+
+/**
+ * @brief   Ends a cache fetch and answers the requests that waited for it:
+ *          from the new entry if it was stored and matches their Vary
+ *          headers, otherwise each from a backend of its own.
+ */
+static void proxy_end_fill(Worker *worker, ProxyCacheFill *fill, int complete)
+{
+    Connection *waiter     = fill->waiters;
+    ProxyCacheEntry *entry = proxycache_fill_finish(&worker->proxy_cache, fill, complete);
+
+    while (waiter)
+    {
+        Connection *conn = waiter;
+        waiter           = conn->wait_next;
+        conn->cache_fill = NULL;
+        conn->wait_next  = NULL;
+        conn->phase      = CONN_WRITING;
+
+        int status;
+        if (entry && proxycache_entry_matches(entry, &conn->request))
+        {
+            worker->proxy_cache.hits++;
+            status = proxy_serve_cached(conn, entry);
+        }
+        else
+        {
+            status = proxy_start(worker, conn, NULL);
+        }
+
+        if (status < 0)
+            close_connection(worker, conn);
+        else if (conn->phase == CONN_WRITING)
+            flush_connection(worker, conn);
+    }
+}
+
+/**
+ * @brief   Ends the cache fetch @p up feeds, if any.
+ */
+static void proxy_drop_fill(Worker *worker, Upstream *up, int complete)
+{
+    ProxyCacheFill *fill = up->fill;
+    if (!fill) return;
+
+    up->fill = NULL;
+    proxy_end_fill(worker, fill, complete);
+}
+
+/**
+ * @brief   A PUT, POST, DELETE... the backend didn't refuse changed its
+ *          target, so no worker may answer from a stored copy any more.
+ */
+static void proxy_invalidate(Worker *worker, const HTTPRequest *req)
+{
+    if (worker->proxy_cache.budget == 0) return;
+
+    char key[PROXYCACHE_MAX_KEY];
+    size_t len = proxycache_invalidation_key(req, key, sizeof(key));
+    if (len == 0) return;
+
+    proxycache_purge(&worker->proxy_cache, key, len);
+    worker_broadcast(worker, MAIL_PURGE, key, len);
+}
+
+static int proxy_set_events(Worker *worker, Upstream *up, uint32_t events)
+{
+    struct epoll_event ev;
+    ev.events   = events;
+    ev.data.ptr = up;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, up->fd, &ev) == -1)
+    {
+        LOG(ERROR, "Failed to update epoll events for backend FD %d.", up->fd);
+        return -1;
+    }
+    return OK;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file    proxy.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Non-blocking reverse proxy driven by the worker's epoll loop.
+ *
+ */
+
+#ifndef HTTPPROXY_H
+#define HTTPPROXY_H
+
+#include "server.h"
+#include "backend.h"
+#include "balancer.h"
+
+#define PROXY_CHUNK_SIZE 16384        // bytes read from an upstream per recv()
+#define PROXY_OUTPUT_HIGH_WATER 65536 // pause the upstream above this much unsent client output
+#define PROXY_MAX_HEAD 16384          // largest response head we accept from a backend
+
+typedef enum
+{
+    UPSTREAM_CONNECTING, // non-blocking connect() in progress
+    UPSTREAM_SENDING,    // writing the request head, then its body, to the backend
+    UPSTREAM_RECEIVING,  // relaying the response to the client
+    UPSTREAM_CLOSED      // finished, waiting for proxy_reap()
+} UpstreamState;
+
+typedef enum
+{
+    BODY_NONE,       // HEAD, 1xx, 204 and 304 responses
+    BODY_LENGTH,     // Content-Length framed
+    BODY_CHUNKED,    // Transfer-Encoding: chunked
+    BODY_UNTIL_CLOSE // neither, the backend closes to end the body
+} BodyMode;
+
+typedef struct Upstream
+{
+    EventKind kind;        // EV_UPSTREAM, must stay the first member
+    int fd;                // backend socket
+    UpstreamState state;   // where the exchange is
+    int paused;            // reading stopped because the client is slow
+    Connection *client;    // client waiting for the response
+    Backend *backend;      // pool the fd belongs to
+    Balancer *balancer;    // of the config the request runs under
+    int reused;            // fd came from the keep-alive pool
+    int retried;           // already replayed once on a fresh connection
+    int retryable;         // request is idempotent
+    uint32_t tried;        // balancer_mask() of every backend tried so far
+    char *req_buf;         // serialized request for the backend
+    size_t req_len;        // bytes in req_buf
+    size_t req_sent;       // bytes of req_buf already sent
+    size_t body_sent;      // request body bytes relayed from the client's buffer
+    size_t resp_bytes;     // response bytes relayed so far
+    uint64_t started_us;   // monotonic us the request was first handed to a backend
+
+    size_t relayed;        // response bytes queued for the client
+    ProxyCacheFill *fill;  // cache entry the response is copied into, if any
+
+    // Response framing, tracked so the connection can be pooled again
+    int head_request;      // HEAD responses carry no body
+    ResponseParser parser; // current response head
+    char *head;            // head split across reads, gathered until it parses
+    size_t head_len;       // bytes in head
+    int head_done;         // final head relayed, body_mode is valid
+    int backend_close;     // backend won't keep the connection open
+    BodyMode body_mode;    // how the end of the body is found
+    size_t body_remaining; // BODY_LENGTH bytes still expected
+    ChunkedState chunked;  // BODY_CHUNKED decoder state
+
+    struct Upstream *next; // link in Worker.closed_upstreams
+} Upstream;
+
+int proxy_request(Worker *worker, Connection *conn);
+void proxy_handle_event(Worker *worker, Upstream *up, uint32_t events);
+void proxy_resume(Worker *worker, Upstream *up);
+void proxy_abort(Worker *worker, Upstream *up);
+void proxy_cancel_wait(Worker *worker, Connection *conn);
+void proxy_reap(Worker *worker);
+
+#endif
@@ -0,0 +1,717 @@
+/**
+ * @file    proxycache.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   LRU cache of proxied responses implementations.
+ *
+ * @details Only GET requests without a body or credentials are looked up,
+ *          keyed on Host and the request target, and an entry also has to
+ *          match the request headers its Vary names. Responses are stored
+ *          when the backend makes them explicitly fresh for shared caches
+ *          with Cache-Control s-maxage / max-age or Expires; no-store,
+ *          no-cache, private and Set-Cookie keep them out. Request
+ *          Cache-Control is ignored, so clients can't force a refetch.
+ *
+ *          A miss starts a fill: the response is copied into a new entry
+ *          while it is relayed, and other misses on the same key wait for
+ *          it instead of going to the backend themselves. An expired entry
+ *          within its stale-while-revalidate window is refreshed the same
+ *          way by the first request that finds it; the others are answered
+ *          stale until the refresh lands.
+ *
+ *          A PUT, POST, DELETE or other unsafe request the backend answers
+ *          without error invalidates the target (RFC 9111 section 4.4),
+ *          in every worker's cache: the key is purged here and posted to
+ *          the other workers.
+ */
+
+#include <strings.h>
+#include <time.h>
+#include "proxycache.h"
+#include "conditional.h"
+#include "utils/clock.h"
+
+static int request_cacheable(const HTTPRequest *req);
+static size_t request_key(const HTTPRequest *req, char *key, size_t capacity);
+static uint64_t hash_key(const char *key, size_t len);
+static const HTTPHeader *find_header(const HTTPHeader *headers, int count, const char *name,
+                                     size_t name_len);
+static long vary_values(const HTTPRequest *req, const char *names, size_t names_len, char *out,
+                        size_t capacity);
+static int response_freshness(const ResponseParser *parser, ProxyCacheEntry *entry);
+static int header_is(const HTTPHeader *header, const char *name);
+static int parse_seconds(const char *value, size_t len, uint64_t *out);
+static int entry_append(ProxyCacheFill *fill, const char *data, size_t len);
+static void entry_link(ProxyCache *cache, ProxyCacheEntry *entry);
+static void proxycache_evict(ProxyCache *cache, ProxyCacheEntry *entry);
+static void lru_unlink(ProxyCache *cache, ProxyCacheEntry *entry);
+static void lru_push_front(ProxyCache *cache, ProxyCacheEntry *entry);
+static void entry_free(ProxyCacheEntry *entry);
+
+/**
+ * @brief   Prepares an empty cache holding at most @p budget bytes.
+ *
+ * @returns OK. A budget of 0 disables caching.
+ */
+int proxycache_init(ProxyCache *cache, size_t budget, const Config *cfg)
+{
+    memset(cache, 0, sizeof(ProxyCache));
+    cache->budget    = budget;
+    cache->max_entry = cfg->proxy_cache_max_entry;
+    return OK;
+}
+
+/**
+ * @brief   Applies reloaded settings, evicting least recently used entries
+ *          down to the new budget.
+ */
+void proxycache_configure(ProxyCache *cache, size_t budget, const Config *cfg)
+{
+    cache->budget    = budget;
+    cache->max_entry = cfg->proxy_cache_max_entry;
+
+    while (cache->lru_tail && cache->bytes > cache->budget)
+        proxycache_evict(cache, cache->lru_tail);
+}
+
+/**
+ * @brief   Frees every entry. Fills have to be finished before, they belong
+ *          to upstreams.
+ */
+void proxycache_destroy(ProxyCache *cache)
+{
+    while (cache->lru_head)
+        proxycache_evict(cache, cache->lru_head);
+}
+
+/**
+ * @brief   Decides how @p req is answered.
+ *
+ * @returns PROXYCACHE_HIT with @p entry set to a fresh (or stale, while it
+ *          is being refreshed) entry to answer with, PROXYCACHE_WAIT with
+ *          @p fill set to the fetch of the same response already running,
+ *          PROXYCACHE_FETCH with @p fill set to a new fetch the request has
+ *          to feed, or PROXYCACHE_BYPASS if the cache doesn't apply.
+ */
+ProxyCacheResult proxycache_lookup(ProxyCache *cache, const HTTPRequest *req,
+                                   ProxyCacheEntry **entry, ProxyCacheFill **fill)
+{
+    if (cache->budget == 0 || !request_cacheable(req)) return PROXYCACHE_BYPASS;
+
+    char key[PROXYCACHE_MAX_KEY];
+    size_t key_len = request_key(req, key, sizeof(key));
+    if (key_len == 0) return PROXYCACHE_BYPASS;
+    uint64_t hash = hash_key(key, key_len);
+
+    ProxyCacheEntry *stale = NULL;
+    ProxyCacheEntry *found = cache->buckets[hash & (PROXYCACHE_BUCKETS - 1)];
+    while (found)
+    {
+        ProxyCacheEntry *next = found->hnext;
+        if (found->hash == hash && found->key_len == key_len &&
+            memcmp(found->key, key, key_len) == 0 && proxycache_entry_matches(found, req))
+        {
+            uint64_t age = monotonic_ms() - found->stored_ms;
+            if (age < found->fresh_ms)
+            {
+                lru_unlink(cache, found);
+                lru_push_front(cache, found);
+                cache->hits++;
+                *entry = found;
+                return PROXYCACHE_HIT;
+            }
+            if (age < found->fresh_ms + found->stale_ms)
+            {
+                if (found->refresh)
+                {
+                    cache->hits++;
+                    cache->stale_hits++;
+                    *entry = found;
+                    return PROXYCACHE_HIT;
+                }
+                stale = found;
+                break;
+            }
+            proxycache_evict(cache, found); // too old to be of any use
+        }
+        found = next;
+    }
+
+    // Another request already fetches it
+    if (!stale)
+    {
+        for (ProxyCacheFill *running = cache->fills; running; running = running->next)
+        {
+            ProxyCacheEntry *pending = running->entry;
+            if (pending->hash == hash && pending->key_len == key_len &&
+                memcmp(pending->key, key, key_len) == 0)
+            {
+                cache->coalesced++;
+                *fill = running;
+                return PROXYCACHE_WAIT;
+            }
+        }
+    }
+
+    ProxyCacheFill *created = calloc(1, sizeof(ProxyCacheFill));
+    if (!created) return PROXYCACHE_BYPASS;
+    created->entry = calloc(1, sizeof(ProxyCacheEntry));
+    if (!created->entry || !(created->entry->key = malloc(key_len)))
+    {
+        free(created->entry);
+        free(created);
+        return PROXYCACHE_BYPASS;
+    }
+    memcpy(created->entry->key, key, key_len);
+    created->entry->key_len = key_len;
+    created->entry->hash    = hash;
+    created->storable       = 1;
+
+    if (stale)
+    {
+        created->stale = stale;
+        stale->refresh = created;
+    }
+    created->next = cache->fills;
+    if (cache->fills) cache->fills->prev = created;
+    cache->fills = created;
+
+    cache->misses++;
+    *fill = created;
+    return PROXYCACHE_FETCH;
+}
+
+/**
+ * @returns Length of the key written to @p key if @p req has an unsafe
+ *          method, whose success invalidates what is stored for its target.
+ *          0 for safe methods or a key that doesn't fit.
+ */
+size_t proxycache_invalidation_key(const HTTPRequest *req, char *key, size_t capacity)
+{
+    static const char *safe[] = {"GET", "HEAD", "OPTIONS", "TRACE"};
+
+    const HTTPRequestLine *line = &req->request_line;
+    for (size_t i = 0; i < sizeof(safe) / sizeof(safe[0]); i++)
+    {
+        if (line->method_len == strlen(safe[i]) &&
+            memcmp(line->method, safe[i], line->method_len) == 0)
+            return 0;
+    }
+    return request_key(req, key, capacity);
+}
+
+/**
+ * @brief   Drops every stored variant of @p key. Fetches of it already
+ *          running may carry the old representation, they aren't stored.
+ */
+void proxycache_purge(ProxyCache *cache, const char *key, size_t len)
+{
+    uint64_t hash = hash_key(key, len);
+
+    ProxyCacheEntry *entry = cache->buckets[hash & (PROXYCACHE_BUCKETS - 1)];
+    while (entry)
+    {
+        ProxyCacheEntry *next = entry->hnext;
+        if (entry->hash == hash && entry->key_len == len && memcmp(entry->key, key, len) == 0)
+            proxycache_evict(cache, entry);
+        entry = next;
+    }
+
+    for (ProxyCacheFill *fill = cache->fills; fill; fill = fill->next)
+    {
+        const ProxyCacheEntry *pending = fill->entry;
+        if (pending->hash == hash && pending->key_len == len && memcmp(pending->key, key, len) == 0)
+            fill->storable = 0;
+    }
+}
+
+/**
+ * @returns Whether the headers @p entry varies on have the same values in
+ *          @p req as in the request it was stored for.
+ */
+int proxycache_entry_matches(const ProxyCacheEntry *entry, const HTTPRequest *req)
+{
+    char values[PROXYCACHE_MAX_VARY];
+    long len = vary_values(req, entry->vary_names, entry->vary_names_len, values, sizeof(values));
+
+    return len >= 0 && (size_t)len == entry->vary_values_len &&
+           memcmp(values, entry->vary_values, len) == 0;
+}
+
+/**
+ * @returns Seconds since the backend produced @p entry, for its Age header.
+ */
+uint64_t proxycache_age(const ProxyCacheEntry *entry)
+{
+    return entry->age_s + (monotonic_ms() - entry->stored_ms) / 1000;
+}
+
+/**
+ * @brief   Starts the entry of @p fill from the final response head: works
+ *          out whether and for how long it may be stored and copies its
+ *          status line and headers, minus the @p skip_headers (HDR_BIT()
+ *          mask) and Age.
+ *
+ * @returns OK, or -1 if the response isn't cacheable. The fill is then no
+ *          longer storable and should be finished.
+ */
+int proxycache_fill_head(ProxyCache *cache, ProxyCacheFill *fill, const HTTPRequest *req,
+                         const ResponseParser *parser, uint32_t skip_headers)
+{
+    ProxyCacheEntry *entry = fill->entry;
+
+    if (!fill->storable || response_freshness(parser, entry) < 0)
+    {
+        fill->storable = 0;
+        return -1;
+    }
+
+    long values = vary_values(req, entry->vary_names, entry->vary_names_len, entry->vary_values,
+                              sizeof(entry->vary_values));
+    if (values < 0)
+    {
+        fill->storable = 0;
+        return -1;
+    }
+    entry->vary_values_len = values;
+
+    size_t head_len = 13 + parser->reason_len + 2;
+    for (int i = 0; i < parser->header_count; i++)
+        head_len += parser->headers[i].name_len + parser->headers[i].value_len + 4;
+    size_t expected = parser->has_length ? parser->content_length : 0;
+    fill->capacity  = head_len + (expected < cache->max_entry ? expected : 0);
+    if (head_len > cache->max_entry || !(entry->data = malloc(fill->capacity)))
+    {
+        fill->storable = 0;
+        return -1;
+    }
+
+    char *head = entry->data;
+    size_t len = snprintf(head, head_len, "HTTP/1.1 %03d %.*s\r\n", parser->status_code,
+                          (int)parser->reason_len, parser->reason);
+    for (int i = 0; i < parser->header_count; i++)
+    {
+        const HTTPHeader *header = &parser->headers[i];
+        if (header->id != HDR_OTHER && (skip_headers & HDR_BIT(header->id))) continue;
+        if (header_is(header, "Age")) continue;
+
+        memcpy(head + len, header->name, header->name_len);
+        len += header->name_len;
+        head[len++] = ':';
+        head[len++] = ' ';
+        memcpy(head + len, header->value, header->value_len);
+        len += header->value_len;
+        head[len++] = '\r';
+        head[len++] = '\n';
+    }
+    entry->head_len    = len;
+    entry->status_code = parser->status_code;
+
+    return OK;
+}
+
+/**
+ * @brief   Appends relayed body bytes to the entry of @p fill.
+ *
+ * @returns OK, or -1 once the response is too large to be stored.
+ */
+int proxycache_fill_body(ProxyCache *cache, ProxyCacheFill *fill, const char *data, size_t len)
+{
+    ProxyCacheEntry *entry = fill->entry;
+
+    if (!fill->storable || entry->head_len + entry->body_len + len > cache->max_entry ||
+        entry_append(fill, data, len) < 0)
+    {
+        fill->storable = 0;
+        return -1;
+    }
+    return OK;
+}
+
+/**
+ * @brief   Ends @p fill and frees it. Its waiters have to be taken off
+ *          before, they are the caller's to answer.
+ *
+ * @param   complete  The whole response was received.
+ *
+ * @returns The new entry, replacing the one it refreshes, or NULL if
+ *          nothing was stored.
+ */
+ProxyCacheEntry *proxycache_fill_finish(ProxyCache *cache, ProxyCacheFill *fill, int complete)
+{
+    ProxyCacheEntry *entry = fill->entry;
+
+    if (fill->prev)
+        fill->prev->next = fill->next;
+    else
+        cache->fills = fill->next;
+    if (fill->next) fill->next->prev = fill->prev;
+
+    if (fill->stale) fill->stale->refresh = NULL;
+
+    if (complete && fill->storable && entry->head_len + entry->body_len <= cache->budget)
+    {
+        entry->stored_ms = monotonic_ms();
+        entry_link(cache, entry);
+    }
+    else
+    {
+        entry_free(entry);
+        entry = NULL;
+    }
+
+    free(fill);
+    return entry;
+}
+
+/**
+ * @brief   Keeps @p entry's data alive while an output queue references it.
+ */
+void proxycache_retain(ProxyCacheEntry *entry)
+{
+    entry->refs++;
+}
+
+/**
+ * @brief   Drops a reference taken with proxycache_retain(). Takes a void
+ *          pointer so it can be used as an output segment release callback.
+ */
+void proxycache_release(void *entry)
+{
+    ProxyCacheEntry *cached = entry;
+    if (--cached->refs == 0 && cached->evicted) entry_free(cached);
+}
+
+// ---------- UTILS ----------
+
+/**
+ * @brief   GET requests without a body or credentials. Responses to
+ *          authorized requests are private unless the backend says
+ *          otherwise, which is not worth telling apart here.
+ */
+static int request_cacheable(const HTTPRequest *req)
+{
+    const HTTPRequestLine *line = &req->request_line;
+    if (line->method_len != 3 || memcmp(line->method, "GET", 3) != 0) return 0;
+
+    const HTTPHeader *length = get_http_header(req, HDR_CONTENT_LENGTH);
+    if (get_http_header(req, HDR_TRANSFER_ENCODING) ||
+        (length && !(length->value_len == 1 && length->value[0] == '0')))
+        return 0;
+
+    return find_header(req->headers, req->header_count, "Authorization", 13) == NULL;
+}
+
+/**
+ * @returns Length of the key written to @p key, 0 if it doesn't fit.
+ */
+static size_t request_key(const HTTPRequest *req, char *key, size_t capacity)
+{
+    const HTTPHeader *host = get_http_header(req, HDR_HOST);
+    size_t host_len        = host ? host->value_len : 0;
+    size_t uri_len         = req->request_line.uri_len;
+    if (host_len + 1 + uri_len > capacity) return 0;
+
+    if (host_len > 0) memcpy(key, host->value, host_len);
+    key[host_len] = '\n';
+    memcpy(key + host_len + 1, req->request_line.uri, uri_len);
+    return host_len + 1 + uri_len;
+}
+
+static uint64_t hash_key(const char *key, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)key[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static const HTTPHeader *find_header(const HTTPHeader *headers, int count, const char *name,
+                                     size_t name_len)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (headers[i].name_len == name_len && strncasecmp(headers[i].name, name, name_len) == 0)
+            return &headers[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief   Writes the values of the request headers listed in @p names (a
+ *          Vary header value), one per line, to @p out.
+ *
+ * @returns Bytes written, -1 if they don't fit.
+ */
+static long vary_values(const HTTPRequest *req, const char *names, size_t names_len, char *out,
+                        size_t capacity)
+{
+    const char *p   = names;
+    const char *end = names + names_len;
+    size_t len      = 0;
+
+    while (p < end)
+    {
+        const char *comma    = memchr(p, ',', end - p);
+        const char *name     = p;
+        const char *name_end = comma ? comma : end;
+        p                    = comma ? comma + 1 : end;
+
+        while (name < name_end && (*name == ' ' || *name == '\t'))
+            name++;
+        while (name_end > name && (name_end[-1] == ' ' || name_end[-1] == '\t'))
+            name_end--;
+        if (name == name_end) continue;
+
+        const HTTPHeader *header =
+            find_header(req->headers, req->header_count, name, name_end - name);
+        size_t value_len = header ? header->value_len : 0;
+        if (len + value_len + 1 > capacity) return -1;
+
+        if (value_len > 0) memcpy(out + len, header->value, value_len);
+        len += value_len;
+        out[len++] = '\n';
+    }
+    return len;
+}
+
+/**
+ * @brief   Sets the freshness lifetime, stale-while-revalidate window, Age
+ *          and Vary names of @p entry from the response.
+ *
+ * @returns OK, or -1 if the response mustn't be stored or isn't explicitly
+ *          fresh.
+ */
+static int response_freshness(const ResponseParser *parser, ProxyCacheEntry *entry)
+{
+    int code = parser->status_code;
+    if (code != 200 && code != 203 && code != 301 && code != 404 && code != 410) return -1;
+
+    uint64_t max_age = 0, shared_max_age = 0, stale = 0, age = 0;
+    int has_max_age = 0, has_shared_max_age = 0;
+    time_t expires = 0, date = time(NULL);
+    int has_expires = 0;
+
+    entry->vary_names_len = 0;
+    for (int i = 0; i < parser->header_count; i++)
+    {
+        const HTTPHeader *header = &parser->headers[i];
+
+        if (header_is(header, "Set-Cookie")) return -1;
+        if (header_is(header, "Age"))
+        {
+            parse_seconds(header->value, header->value_len, &age);
+        }
+        else if (header_is(header, "Expires"))
+        {
+            // An invalid date means already expired
+            has_expires = 1;
+            if (parse_http_date(header->value, header->value_len, &expires) < 0) expires = 0;
+        }
+        else if (header_is(header, "Date"))
+        {
+            time_t parsed;
+            if (parse_http_date(header->value, header->value_len, &parsed) == OK) date = parsed;
+        }
+        else if (header_is(header, "Vary"))
+        {
+            size_t used = entry->vary_names_len;
+            if (memchr(header->value, '*', header->value_len) ||
+                used + header->value_len + 1 > sizeof(entry->vary_names))
+                return -1;
+            if (used > 0) entry->vary_names[used++] = ',';
+            memcpy(entry->vary_names + used, header->value, header->value_len);
+            entry->vary_names_len = used + header->value_len;
+        }
+        else if (header_is(header, "Cache-Control"))
+        {
+            const char *p   = header->value;
+            const char *end = p + header->value_len;
+            while (p < end)
+            {
+                const char *comma = memchr(p, ',', end - p);
+                const char *item  = p;
+                const char *stop  = comma ? comma : end;
+                p                 = comma ? comma + 1 : end;
+
+                while (item < stop && (*item == ' ' || *item == '\t'))
+                    item++;
+                const char *eq   = memchr(item, '=', stop - item);
+                size_t name_len  = (eq ? eq : stop) - item;
+                const char *val  = eq ? eq + 1 : stop;
+                size_t value_len = stop - val;
+                while (value_len > 0 && (val[value_len - 1] == ' ' || val[value_len - 1] == '\t'))
+                    value_len--;
+                while (name_len > 0 && (item[name_len - 1] == ' ' || item[name_len - 1] == '\t'))
+                    name_len--;
+
+                if ((name_len == 8 && strncasecmp(item, "no-store", 8) == 0) ||
+                    (name_len == 8 && strncasecmp(item, "no-cache", 8) == 0) ||
+                    (name_len == 7 && strncasecmp(item, "private", 7) == 0))
+                    return -1;
+                if (name_len == 8 && strncasecmp(item, "s-maxage", 8) == 0)
+                    has_shared_max_age = parse_seconds(val, value_len, &shared_max_age) == OK;
+                else if (name_len == 7 && strncasecmp(item, "max-age", 7) == 0)
+                    has_max_age = parse_seconds(val, value_len, &max_age) == OK;
+                else if (name_len == 22 && strncasecmp(item, "stale-while-revalidate", 22) == 0)
+                    parse_seconds(val, value_len, &stale);
+            }
+        }
+    }
+
+    // s-maxage wins for shared caches, then max-age, then Expires
+    uint64_t lifetime;
+    if (has_shared_max_age)
+        lifetime = shared_max_age;
+    else if (has_max_age)
+        lifetime = max_age;
+    else if (has_expires && expires > date)
+        lifetime = expires - date;
+    else
+        return -1;
+    if (lifetime <= age) return -1;
+
+    entry->fresh_ms = (lifetime - age) * 1000;
+    entry->stale_ms = stale * 1000;
+    entry->age_s    = age;
+    return OK;
+}
+
+static int header_is(const HTTPHeader *header, const char *name)
+{
+    size_t len = strlen(name);
+    return header->name_len == len && strncasecmp(header->name, name, len) == 0;
+}
+
+/**
+ * @brief   Reads a delta-seconds value, clamped to a year. Quotes are
+ *          tolerated.
+ */
+static int parse_seconds(const char *value, size_t len, uint64_t *out)
+{
+    if (len >= 2 && value[0] == '"' && value[len - 1] == '"')
+    {
+        value++;
+        len -= 2;
+    }
+    if (len == 0) return -1;
+
+    uint64_t seconds = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (value[i] < '0' || value[i] > '9') return -1;
+        if (seconds < 31536000) seconds = seconds * 10 + (value[i] - '0');
+    }
+    *out = seconds < 31536000 ? seconds : 31536000;
+    return OK;
+}
+
+static int entry_append(ProxyCacheFill *fill, const char *data, size_t len)
+{
+    ProxyCacheEntry *entry = fill->entry;
+    size_t used            = entry->head_len + entry->body_len;
+
+    if (used + len > fill->capacity)
+    {
+        size_t capacity = fill->capacity * 2 > used + len ? fill->capacity * 2 : used + len;
+        char *grown     = realloc(entry->data, capacity);
+        if (!grown) return -1;
+        entry->data    = grown;
+        fill->capacity = capacity;
+    }
+    memcpy(entry->data + used, data, len);
+    entry->body_len += len;
+    return OK;
+}
+
+/**
+ * @brief   Puts a new entry into the cache, replacing the variant it is a
+ *          newer version of and evicting least recently used entries to stay
+ *          within the budget.
+ */
+static void entry_link(ProxyCache *cache, ProxyCacheEntry *entry)
+{
+    size_t bucket = entry->hash & (PROXYCACHE_BUCKETS - 1);
+
+    ProxyCacheEntry *old = cache->buckets[bucket];
+    while (old)
+    {
+        ProxyCacheEntry *next = old->hnext;
+        if (old->hash == entry->hash && old->key_len == entry->key_len &&
+            memcmp(old->key, entry->key, entry->key_len) == 0 &&
+            old->vary_values_len == entry->vary_values_len &&
+            memcmp(old->vary_values, entry->vary_values, entry->vary_values_len) == 0)
+            proxycache_evict(cache, old);
+        old = next;
+    }
+
+    size_t need = entry->head_len + entry->body_len;
+    while (cache->lru_tail && cache->bytes + need > cache->budget)
+        proxycache_evict(cache, cache->lru_tail);
+
+    entry->hnext           = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    lru_push_front(cache, entry);
+    cache->bytes += need;
+    cache->count++;
+}
+
+/**
+ * @brief   Removes an entry from the cache. It is freed right away unless a
+ *          connection is still sending it, then on its last release.
+ */
+static void proxycache_evict(ProxyCache *cache, ProxyCacheEntry *entry)
+{
+    ProxyCacheEntry **link = &cache->buckets[entry->hash & (PROXYCACHE_BUCKETS - 1)];
+    while (*link && *link != entry)
+        link = &(*link)->hnext;
+    if (*link) *link = entry->hnext;
+
+    lru_unlink(cache, entry);
+    cache->bytes -= entry->head_len + entry->body_len;
+    cache->count--;
+
+    // A refresh still running replaces nothing now
+    if (entry->refresh)
+    {
+        entry->refresh->stale = NULL;
+        entry->refresh        = NULL;
+    }
+
+    entry->evicted = 1;
+    if (entry->refs == 0) entry_free(entry);
+}
+
+static void lru_unlink(ProxyCache *cache, ProxyCacheEntry *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else if (cache->lru_head == entry)
+        cache->lru_head = entry->next;
+
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else if (cache->lru_tail == entry)
+        cache->lru_tail = entry->prev;
+
+    entry->prev = entry->next = NULL;
+}
+
+static void lru_push_front(ProxyCache *cache, ProxyCacheEntry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->prev = entry;
+    cache->lru_head = entry;
+    if (!cache->lru_tail) cache->lru_tail = entry;
+}
+
+static void entry_free(ProxyCacheEntry *entry)
+{
+    free(entry->key);
+    free(entry->data);
+    free(entry);
+}
@@ -0,0 +1,117 @@
+/**
+ * @file    proxycache.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   LRU cache of proxied responses, with request coalescing.
+ *
+ */
+
+#ifndef HTTPPROXYCACHE_H
+#define HTTPPROXYCACHE_H
+
+#include "common.h"
+#include "parsers.h"
+#include "request.h"
+#include "utils/config.h"
+
+#define PROXYCACHE_BUCKETS 1024 // hash buckets, power of two
+#define PROXYCACHE_MAX_KEY 2048 // longer Host + URI keys aren't cached
+#define PROXYCACHE_MAX_VARY 512 // longer Vary names or values aren't cached
+
+struct Connection;
+
+/**
+ * @brief   A stored response. data holds its head without the terminating
+ *          blank line, so Age and Connection can be appended per client,
+ *          immediately followed by the body in its original framing.
+ */
+typedef struct ProxyCacheEntry
+{
+    char *key;                             // Host, a newline and the request target
+    size_t key_len;
+    uint64_t hash;                         // hash of key
+    char vary_names[PROXYCACHE_MAX_VARY];  // the response's Vary header
+    size_t vary_names_len;
+    char vary_values[PROXYCACHE_MAX_VARY]; // request values of those headers, one per line
+    size_t vary_values_len;
+
+    char *data;      // head lines followed by the body
+    size_t head_len; // bytes of data that are the head
+    size_t body_len; // bytes of data that are the body
+    int status_code;
+
+    uint64_t stored_ms;             // monotonic ms the response arrived
+    uint64_t fresh_ms;              // freshness lifetime from stored_ms
+    uint64_t stale_ms;              // stale-while-revalidate window after that
+    uint64_t age_s;                 // Age the backend reported
+    struct ProxyCacheFill *refresh; // fetch of its replacement, if one runs
+    int refs;                       // output queues still sending data
+    int evicted;                    // out of the cache, freed when refs drops to 0
+
+    struct ProxyCacheEntry *hnext; // bucket chain
+    struct ProxyCacheEntry *prev;  // LRU list, most recently used first
+    struct ProxyCacheEntry *next;
+} ProxyCacheEntry;
+
+/**
+ * @brief   A response being fetched for the cache. Concurrent misses on the
+ *          same key wait on it instead of going to the backend themselves.
+ */
+typedef struct ProxyCacheFill
+{
+    ProxyCacheEntry *entry;      // built while the response is relayed
+    ProxyCacheEntry *stale;      // entry this fetch refreshes, if any
+    size_t capacity;             // bytes allocated for entry->data
+    int storable;                // still going to be cached
+    struct Connection *waiters;  // requests coalesced onto this fetch
+    struct ProxyCacheFill *prev; // ProxyCache.fills
+    struct ProxyCacheFill *next;
+} ProxyCacheFill;
+
+/**
+ * @brief   One cache per worker, so lookups, fills and LRU updates need no lock.
+ */
+typedef struct ProxyCache
+{
+    ProxyCacheEntry *buckets[PROXYCACHE_BUCKETS];
+    ProxyCacheEntry *lru_head;
+    ProxyCacheEntry *lru_tail;
+    ProxyCacheFill *fills; // fetches in flight
+    size_t bytes;          // sum of entry data sizes
+    size_t budget;         // evict least recently used entries above this
+    size_t max_entry;      // responses larger than this are never cached
+    size_t count;          // entries in the cache
+    uint64_t hits;         // requests answered from the cache, stale ones included
+    uint64_t stale_hits;   // of those, answered stale while a refresh was running
+    uint64_t coalesced;    // misses that waited for another request's fetch
+    uint64_t misses;       // cacheable requests that went to the backend
+} ProxyCache;
+
+typedef enum
+{
+    PROXYCACHE_BYPASS, // not cacheable, proxy as usual
+    PROXYCACHE_HIT,    // answer with *entry
+    PROXYCACHE_WAIT,   // wait on *fill
+    PROXYCACHE_FETCH   // fetch the response into *fill
+} ProxyCacheResult;
+
+int proxycache_init(ProxyCache *cache, size_t budget, const Config *cfg);
+void proxycache_configure(ProxyCache *cache, size_t budget, const Config *cfg);
+void proxycache_destroy(ProxyCache *cache);
+
+ProxyCacheResult proxycache_lookup(ProxyCache *cache, const HTTPRequest *req,
+                                   ProxyCacheEntry **entry, ProxyCacheFill **fill);
+size_t proxycache_invalidation_key(const HTTPRequest *req, char *key, size_t capacity);
+void proxycache_purge(ProxyCache *cache, const char *key, size_t len);
+int proxycache_entry_matches(const ProxyCacheEntry *entry, const HTTPRequest *req);
+uint64_t proxycache_age(const ProxyCacheEntry *entry);
+
+int proxycache_fill_head(ProxyCache *cache, ProxyCacheFill *fill, const HTTPRequest *req,
+                         const ResponseParser *parser, uint32_t skip_headers);
+int proxycache_fill_body(ProxyCache *cache, ProxyCacheFill *fill, const char *data, size_t len);
+ProxyCacheEntry *proxycache_fill_finish(ProxyCache *cache, ProxyCacheFill *fill, int complete);
+
+void proxycache_retain(ProxyCacheEntry *entry);
+void proxycache_release(void *entry);
+
+#endif
@@ -28,12 +28,86 @@ HTTPRequest *create_http_request(void)
     return req;
 }
 
+/**
+ * @brief   Frees a request created by create_http_request().
+ *
+ * Request line, header and body pointers borrow from the connection buffer
+ * the request was parsed from, so only the header array is owned.
+ */
 void free_http_request(HTTPRequest *req)
 {
-    free(req->request_line.method);
-    free(req->request_line.uri);
-    free(req->request_line.protocol);
-    free(req->headers);
-    free(req->body);
+    if (!req) return;
+    clear_http_request(req);
     free(req);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief   Releases the memory owned by a request embedded in another struct
+ *          (e.g. Connection) and zeroes it.
+ */
+void clear_http_request(HTTPRequest *req)
+{
+    if (!req) return;
+    free(req->headers);
+    memset(req, 0, sizeof(HTTPRequest));
+}
+
+/**
+ * @brief   Forgets the parsed request but keeps the header array, so the
+ *          next request on the connection can reuse it.
+ */
+void reset_http_request(HTTPRequest *req)
+{
+    HTTPHeader *headers = req->headers;
+    memset(req, 0, sizeof(HTTPRequest));
+    req->headers = headers;
+}
+
+/**
+ * @brief   Moves every pointer into the request's source buffer from
+ *          @p old_base to the same offset from @p new_base, after the
+ *          buffer was reallocated or compacted.
+ */
+void rebase_http_request(HTTPRequest *req, uintptr_t old_base, char *new_base)
+{
+#define REBASE(ptr)                                                \
+    do                                                             \
+    {                                                              \
+        if (ptr) ptr = new_base + ((uintptr_t)(ptr) - old_base);   \
+    } while (0)
+
+    REBASE(req->request_line.method);
+    REBASE(req->request_line.uri);
+    REBASE(req->request_line.protocol);
+    for (int i = 0; i < req->header_count; i++)
+    {
+        REBASE(req->headers[i].name);
+        REBASE(req->headers[i].value);
+    }
+    REBASE(req->body);
+
+#undef REBASE
+}
+
+/**
+ * @brief   Records req->headers[@p index] in the well-known header table.
+ *          The parser calls it for every header in order.
+ */
+void index_http_header(HTTPRequest *req, int index)
+{
+    HeaderId id = req->headers[index].id;
+    if (id == HDR_OTHER) return;
+
+    if (req->known[id])
+        req->repeated |= HDR_BIT(id);
+    else
+        req->known[id] = (uint8_t)(index + 1);
+}
+
+/**
+ * @returns The first header with @p id, or NULL if the request has none.
+ */
+const HTTPHeader *get_http_header(const HTTPRequest *req, HeaderId id)
+{
+    return req->known[id] ? &req->headers[req->known[id] - 1] : NULL;
+}
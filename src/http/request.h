@@ -21,12 +21,38 @@ typedef struct HTTPRequestLine
     size_t protocol_len;
 } HTTPRequestLine;
 
+/**
+ * @brief   Headers the server acts on itself, recognized once while parsing
+ *          so later lookups don't compare names again.
+ */
+typedef enum
+{
+    HDR_OTHER = 0,
+    HDR_HOST,
+    HDR_CONNECTION,
+    HDR_KEEP_ALIVE,
+    HDR_CONTENT_LENGTH,
+    HDR_TRANSFER_ENCODING,
+    HDR_PROXY_CONNECTION,
+    HDR_TE,
+    HDR_UPGRADE,
+    HDR_ACCEPT_ENCODING,
+    HDR_IF_NONE_MATCH,
+    HDR_IF_MODIFIED_SINCE,
+    HDR_IF_RANGE,
+    HDR_RANGE,
+    HDR_COUNT
+} HeaderId;
+
+#define HDR_BIT(id) (1u << (id))
+
 typedef struct HTTPHeader
 {
     char *name;
     char *value;
     size_t name_len;
     size_t value_len;
+    HeaderId id;
 } HTTPHeader;
 
 typedef struct HTTPRequest
@@ -34,11 +60,18 @@ typedef struct HTTPRequest
     HTTPRequestLine request_line;
     HTTPHeader *headers;
     int header_count;
+    uint8_t known[HDR_COUNT]; // 1 + index of the first header with each id, 0 if absent
+    uint32_t repeated;        // HDR_BIT() of every id that occurred more than once
     char *body;
     size_t body_len;
 } HTTPRequest;
 
 HTTPRequest *create_http_request();
 void free_http_request(HTTPRequest *req);
+void clear_http_request(HTTPRequest *req);
+void reset_http_request(HTTPRequest *req);
+void rebase_http_request(HTTPRequest *req, uintptr_t old_base, char *new_base);
+void index_http_header(HTTPRequest *req, int index);
+const HTTPHeader *get_http_header(const HTTPRequest *req, HeaderId id);
 
 #endif
\ No newline at end of file
@@ -6,147 +6,275 @@
  *
  */
 
+#include <strings.h>
 #include "response.h"
 
-HTTPResponse *httpresponse_constructor()
+static int head_append(HTTPResponse *res, const char *key, size_t key_len, const char *value,
+                       size_t value_len);
+static int head_reserve(HTTPResponse *res, size_t extra);
+static size_t put_status_line(char *dst, int status_code, const char *phrase, size_t phrase_len);
+
+/**
+ * @brief   Starts a response with its status line.
+ *
+ * @returns The response, NULL if @p status_code isn't three digits or the
+ *          arena is exhausted.
+ */
+HTTPResponse *httpresponse_start(Arena *arena, int status_code, const char *phrase)
 {
-    HTTPResponse *res = malloc(sizeof(HTTPResponse));
+    if (status_code < 100 || status_code > 999 || !phrase) return NULL;
+
+    HTTPResponse *res = arena_alloc(arena, sizeof(HTTPResponse));
     if (!res) return NULL;
+    memset(res, 0, sizeof(HTTPResponse));
+    res->arena       = arena;
+    res->status_code = status_code;
 
-    res->status_code    = 200;
-    res->version        = NULL;
-    res->reason_phrase  = NULL;
-    res->headers        = NULL;
-    res->body           = NULL;
-    res->content_type   = NULL;
-    res->header_count   = 0;
-    res->body_length    = 0;
-    res->content_length = 0;
+    size_t phrase_len = strlen(phrase);
+    res->head_cap     = RESPONSE_HEAD_SIZE > phrase_len + 16 ? RESPONSE_HEAD_SIZE : phrase_len + 16;
+    res->head         = arena_alloc(arena, res->head_cap);
+    if (!res->head) return NULL;
+    res->head_len = put_status_line(res->head, status_code, phrase, phrase_len);
 
     return res;
 }
 
-void httpresponse_free(HTTPResponse *res)
+/**
+ * @brief   Appends "key: value" to the header block.
+ *
+ * @returns OK, or -1 if the block could not grow or the response is
+ *          already finished.
+ */
+int httpresponse_add_header(HTTPResponse *res, const char *key, const char *value)
 {
-    if (!res) return;
+    if (!res || !key || !value) return -1;
+    return head_append(res, key, strlen(key), value, strlen(value));
+}
 
-    free(res->version);
-    free(res->reason_phrase);
+/**
+ * @brief   httpresponse_add_header() for a decimal value.
+ */
+int httpresponse_add_header_uint(HTTPResponse *res, const char *key, uint64_t value)
+{
+    if (!res || !key) return -1;
 
-    for (int i = 0; i < res->header_count; ++i)
-    {
-        free(res->headers[i]);
-    }
-    free(res->headers);
+    char digits[20];
+    size_t len = format_uint(digits, value);
+    return head_append(res, key, strlen(key), digits, len);
+}
 
-    free(res->body);
-    free(res->content_type);
-    free(res);
+/**
+ * @brief   Sets the body, which is referenced, not copied. Content-Type
+ *          and Content-Length are derived from it unless set as headers.
+ */
+void httpresponse_set_body(HTTPResponse *res, const char *body, size_t body_length,
+                           const char *content_type)
+{
+    res->body         = body;
+    res->body_length  = body ? body_length : 0;
+    res->content_type = content_type;
 }
 
 /**
- * @brief Helper functions:
- * - Dynamically Add Headers with realloc()
- * - Serialize HTTPResponse to raw string
+ * @brief   Adds the framing headers and the blank line, and points @p iov at
+ *          the header block and the body. Neither is copied, so the cost
+ *          doesn't depend on the body size. Can be called again, the
+ *          response doesn't change any more.
  *
+ * @returns Number of iovecs used (1 without a body, 2 with), or -1 if the
+ *          header block could not grow.
  */
-
-int httpresponse_add_header(HTTPResponse *res, const char *key, const char *value)
+int httpresponse_finish(HTTPResponse *res, struct iovec iov[2])
 {
-    if (!res || !key || !value) return -1;
+    if (!res) return -1;
 
-    char *header = NULL;
-    if (asprintf(&header, "%s: %s", key, value) == -1) return -1;
-
-    char **new_headers = realloc(res->headers, sizeof(char *) * (res->header_count + 1));
-    if (!new_headers)
+    if (!res->finished)
     {
-        free(header);
-        return -1;
-    }
+        int bodiless = res->status_code < 200 || res->status_code == 204 ||
+                       res->status_code == 304;
+        if (res->content_type && !res->has_content_type &&
+            head_append(res, "Content-Type", 12, res->content_type, strlen(res->content_type)) < 0)
+            return -1;
+        if (!bodiless && !res->has_content_length &&
+            httpresponse_add_header_uint(res, "Content-Length", res->body_length) < 0)
+            return -1;
 
-    res->headers                      = new_headers;
-    res->headers[res->header_count++] = header;
+        if (head_reserve(res, 2) < 0) return -1;
+        memcpy(res->head + res->head_len, "\r\n", 2);
+        res->head_len += 2;
+        res->finished = 1;
+    }
 
-    return OK;
+    iov[0].iov_base = res->head;
+    iov[0].iov_len  = res->head_len;
+    if (res->body_length == 0) return 1;
+    iov[1].iov_base = (void *)res->body;
+    iov[1].iov_len  = res->body_length;
+    return 2;
 }
 
 /**
- * @brief   Serialize an HTTPResponse struct to a raw string.
- *
- * This function takes an HTTPResponse struct and allocates a new string buffer
- * to contain its serialized form. The caller is responsible for freeing the
- * allocated memory.
+ * @brief   Finishes the response and copies it into one buffer from its
+ *          arena. Sending goes through httpresponse_finish() instead, this
+ *          is for callers that need the bytes in one piece.
  *
- * @param   res  The HTTPResponse struct to serialize.
- * @param   out_len  A pointer to a size_t to store the length of the serialized
- *                   string.
- *
- * @returns A pointer to the serialized string. NULL if memory allocation fails.
+ * @param   out_len  Set to the length of the serialized response.
  *
+ * @returns The serialized response, NULL if memory allocation fails.
  */
 char *httpresponse_serialize(HTTPResponse *res, size_t *out_len)
 {
-    if (!res || !out_len) return NULL;
+    struct iovec iov[2];
+    int count = httpresponse_finish(res, iov);
+    if (count < 0 || !out_len) return NULL;
 
-    size_t capacity = INITIAL_RESPONSE_SIZE;
-    char *buffer    = malloc(capacity); // transferring ownership, caller frees the memory
+    size_t len   = res->head_len + res->body_length;
+    char *buffer = arena_alloc(res->arena, len);
     if (!buffer) return NULL;
 
-    size_t len = 0;
+    memcpy(buffer, res->head, res->head_len);
+    if (res->body_length > 0) memcpy(buffer + res->head_len, res->body, res->body_length);
+    *out_len = len;
+    return buffer;
+}
 
-    // Status line
-    len += snprintf(buffer + len, capacity - len, "%s %d %s\r\n", res->version, res->status_code,
-                    res->reason_phrase);
+/**
+ * @brief   Writes a status line and the framing headers into @p buf.
+ *
+ * Used when the body is sent separately (e.g. with sendfile()), so the
+ * head is the only part that has to be formatted and copied.
+ *
+ * @param   extra_headers  Complete "Name: value\r\n" lines to append, or NULL.
+ *
+ * @returns Length of the head, -1 if it doesn't fit into @p capacity.
+ */
+int httpresponse_write_head(char *buf, size_t capacity, int status_code, const char *phrase,
+                            const char *content_type, size_t content_length,
+                            const char *extra_headers)
+{
+    if (status_code < 100 || status_code > 999) return -1;
 
-    // Headers
-    for (int i = 0; i < res->header_count; ++i)
-    {
-        len += snprintf(buffer + len, capacity - len, "%s\r\n", res->headers[i]);
-    }
+    char digits[20];
+    size_t digits_len = format_uint(digits, content_length);
+    size_t phrase_len = strlen(phrase);
+    size_t type_len   = strlen(content_type);
+    size_t extra_len  = extra_headers ? strlen(extra_headers) : 0;
 
-    // Header/body separator
-    len += snprintf(buffer + len, capacity - len, "\r\n");
+    // "HTTP/1.1 200 " phrase CRLF "Content-Type: " CRLF "Content-Length: " CRLF extra CRLF
+    size_t len = 13 + phrase_len + 2 + 14 + type_len + 2 + 16 + digits_len + 2 + extra_len + 2;
+    if (len >= capacity) return -1;
 
-    // Body
-    if (res->body && res->body_length > 0)
-    {
-        if (len + res->body_length >= capacity)
-        {
-            buffer = realloc(buffer, len + res->body_length + 1);
-            if (!buffer) return NULL;
-        }
-        memcpy(buffer + len, res->body, res->body_length);
-        len += res->body_length;
-        buffer[len] = '\0';
-    }
+    char *p = buf + put_status_line(buf, status_code, phrase, phrase_len);
+    memcpy(p, "Content-Type: ", 14);
+    p += 14;
+    memcpy(p, content_type, type_len);
+    p += type_len;
+    memcpy(p, "\r\nContent-Length: ", 18);
+    p += 18;
+    memcpy(p, digits, digits_len);
+    p += digits_len;
+    memcpy(p, "\r\n", 2);
+    p += 2;
+    if (extra_len > 0) memcpy(p, extra_headers, extra_len);
+    p += extra_len;
+    memcpy(p, "\r\n", 2);
+    p += 2;
+    *p = '\0';
 
-    if (out_len) *out_len = len;
-    return buffer;
+    return (int)len;
 }
 
-HTTPResponse *response_builder(int status_code, const char *phrase, const char *body,
-                               size_t body_length, const char *content_type)
+/**
+ * @brief   Writes @p value in decimal, without a terminator.
+ *
+ * @returns Number of digits written, at most 20.
+ */
+size_t format_uint(char *dst, uint64_t value)
 {
-    if (!phrase || !body || !content_type) return NULL;
-    HTTPResponse *response = httpresponse_constructor();
+    char tmp[20];
+    size_t len = 0;
 
-    // Ownership moves: caller frees memory
-    response->body = (char *)malloc(body_length);
-    if (!response->body)
+    do
     {
-        httpresponse_free(response);
-        return NULL;
-    }
+        tmp[len++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
 
-    memset(response->body, 0, body_length);
+    for (size_t i = 0; i < len; i++)
+        dst[i] = tmp[len - 1 - i];
+    return len;
+}
 
-    response->status_code   = status_code;
-    response->version       = strdup("HTTP/1.1");
-    response->reason_phrase = strdup(phrase);
-    memcpy(response->body, body, body_length);
-    response->body_length  = body_length;
-    response->content_type = strdup(content_type);
+/**
+ * @brief   A complete response in one call. @p body is borrowed, see
+ *          HTTPResponse.
+ */
+HTTPResponse *response_builder(Arena *arena, int status_code, const char *phrase,
+                               const char *body, size_t body_length, const char *content_type)
+{
+    if (!phrase || !body || !content_type) return NULL;
+
+    HTTPResponse *response = httpresponse_start(arena, status_code, phrase);
+    if (!response) return NULL;
+    httpresponse_set_body(response, body, body_length, content_type);
 
     return response;
-}
\ No newline at end of file
+}
+
+// ---------- UTILS ----------
+
+static int head_append(HTTPResponse *res, const char *key, size_t key_len, const char *value,
+                       size_t value_len)
+{
+    if (res->finished || head_reserve(res, key_len + 2 + value_len + 2) < 0) return -1;
+
+    char *p = res->head + res->head_len;
+    memcpy(p, key, key_len);
+    p += key_len;
+    memcpy(p, ": ", 2);
+    p += 2;
+    memcpy(p, value, value_len);
+    p += value_len;
+    memcpy(p, "\r\n", 2);
+    res->head_len += key_len + 2 + value_len + 2;
+
+    if (key_len == 12 && strncasecmp(key, "Content-Type", 12) == 0) res->has_content_type = 1;
+    if (key_len == 14 && strncasecmp(key, "Content-Length", 14) == 0) res->has_content_length = 1;
+    return OK;
+}
+
+/**
+ * @brief   Grows the header block until @p extra more bytes fit. The block
+ *          is usually the arena's latest allocation and grows in place.
+ */
+static int head_reserve(HTTPResponse *res, size_t extra)
+{
+    if (res->head_len + extra <= res->head_cap) return OK;
+
+    size_t cap = res->head_cap * 2;
+    while (cap < res->head_len + extra)
+        cap *= 2;
+
+    char *head = arena_realloc(res->arena, res->head, res->head_cap, cap);
+    if (!head) return -1;
+    res->head     = head;
+    res->head_cap = cap;
+    return OK;
+}
+
+/**
+ * @brief   "HTTP/1.1 <code> <phrase>\r\n" for a three digit @p status_code.
+ *
+ * @returns Bytes written, 15 + @p phrase_len.
+ */
+static size_t put_status_line(char *dst, int status_code, const char *phrase, size_t phrase_len)
+{
+    memcpy(dst, "HTTP/1.1 ", 9);
+    dst[9]  = (char)('0' + status_code / 100);
+    dst[10] = (char)('0' + status_code / 10 % 10);
+    dst[11] = (char)('0' + status_code % 10);
+    dst[12] = ' ';
+    memcpy(dst + 13, phrase, phrase_len);
+    memcpy(dst + 13 + phrase_len, "\r\n", 2);
+    return 15 + phrase_len;
+}
@@ -9,28 +9,47 @@
 #ifndef HTTPRESPONSE_H
 #define HTTPRESPONSE_H
 
+#include <sys/uio.h>
 #include "common.h"
+#include "utils/arena.h"
 
+#define RESPONSE_HEAD_SIZE 256 // initial header block, grown in the arena as needed
+
+/**
+ * @brief   A response under construction. The status line and headers are
+ *          appended to one contiguous block in the arena; the body is only
+ *          referenced and has to stay valid until the response is sent, so
+ *          it should live in the same arena or in static memory.
+ */
 typedef struct
 {
+    Arena *arena;
     int status_code;
-    char *version;
-    char *reason_phrase;
-    char **headers;
-    char *body;
-    char *content_type;
-    int header_count;
-    int body_length;
-    int content_length;
+    char *head;               // status line and headers, ends with CRLF once finished
+    size_t head_len;
+    size_t head_cap;
+    const char *body;         // borrowed
+    size_t body_length;
+    const char *content_type; // emitted by httpresponse_finish() unless set as a header
+    int has_content_type;     // Content-Type already in head
+    int has_content_length;   // Content-Length already in head
+    int finished;             // head is terminated, nothing can be added
 } HTTPResponse;
 
-HTTPResponse *httpresponse_constructor();
-void httpresponse_free(HTTPResponse *httpresponse_ptr);
-
+HTTPResponse *httpresponse_start(Arena *arena, int status_code, const char *phrase);
 int httpresponse_add_header(HTTPResponse *res, const char *key, const char *value);
+int httpresponse_add_header_uint(HTTPResponse *res, const char *key, uint64_t value);
+void httpresponse_set_body(HTTPResponse *res, const char *body, size_t body_length,
+                           const char *content_type);
+int httpresponse_finish(HTTPResponse *res, struct iovec iov[2]);
 char *httpresponse_serialize(HTTPResponse *res, size_t *out_len);
 
-HTTPResponse *response_builder(int status_code, const char *phrase, const char *body,
-                               size_t body_length, const char *content_type);
+int httpresponse_write_head(char *buf, size_t capacity, int status_code, const char *phrase,
+                            const char *content_type, size_t content_length,
+                            const char *extra_headers);
+size_t format_uint(char *dst, uint64_t value);
+
+HTTPResponse *response_builder(Arena *arena, int status_code, const char *phrase,
+                               const char *body, size_t body_length, const char *content_type);
 
-#endif
\ No newline at end of file
+#endif
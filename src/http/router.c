@@ -0,0 +1,503 @@
+/**
+ * @file    router.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Radix trie of configured routes implementations.
+ *
+ * @details Routes come from "route=" lines in the config, or from the
+ *          built-in defaults if there are none, and are compiled once at
+ *          startup. The trie is read-only afterwards and shared by every
+ *          worker. A lookup walks the path once, comparing whole edge
+ *          labels, so its cost depends on the path length and not on the
+ *          number of routes; it only backtracks where a ":name" segment or
+ *          a wildcard route competes with a static edge.
+ */
+
+#include <ctype.h>
+#include "router.h"
+#include "canned.h"
+#include "stats.h"
+
+static const char *default_routes[] = {
+    STATS_PATH " stats",
+    "/static/* static",
+    "/api/* proxy",
+};
+
+static int parse_route(Route *route, const char *spec, char **backends, int backend_count);
+static int check_pattern(const char *pattern);
+static int trie_insert(RouteNode *root, const Route *route);
+static RouteNode *insert_static(RouteNode *node, const char *text, size_t len);
+static RouteNode *node_create(const char *label, size_t len);
+static void node_free(RouteNode *node);
+static const Route *match_node(const RouteNode *node, const char *path, size_t len,
+                               RouteMatch *match);
+static size_t expand_location(const Route *route, const RouteMatch *match, char *out);
+
+/**
+ * @brief   Parses and compiles @p specs, or the default routes if there
+ *          are none.
+ *
+ * @param   backends  Configured backend specs, which ROUTE_PROXY groups
+ *                    name their members by.
+ *
+ * @returns OK, or -1 if a route is invalid or conflicts with another one.
+ */
+int router_init(Router *router, char **specs, int spec_count, char **backends,
+                int backend_count)
+{
+    memset(router, 0, sizeof(Router));
+
+    const char **lines = (const char **)specs;
+    if (spec_count == 0)
+    {
+        lines      = default_routes;
+        spec_count = sizeof(default_routes) / sizeof(default_routes[0]);
+    }
+
+    router->routes = calloc(spec_count, sizeof(Route));
+    router->root   = node_create("", 0);
+    if (!router->routes || !router->root)
+    {
+        router_destroy(router);
+        return -1;
+    }
+
+    for (int i = 0; i < spec_count; i++)
+    {
+        Route *route = &router->routes[i];
+        router->route_count++;
+        if (parse_route(route, lines[i], backends, backend_count) < 0 ||
+            trie_insert(router->root, route) < 0)
+        {
+            LOG(ERROR, "Invalid route '%s'.", lines[i]);
+            router_destroy(router);
+            return -1;
+        }
+        LOG(DEBUG, "Route %s compiled.", route->pattern);
+    }
+
+    return OK;
+}
+
+void router_destroy(Router *router)
+{
+    for (int i = 0; i < router->route_count; i++)
+    {
+        free(router->routes[i].pattern);
+        free(router->routes[i].target);
+    }
+    free(router->routes);
+    node_free(router->root);
+
+    router->routes      = NULL;
+    router->route_count = 0;
+    router->root        = NULL;
+}
+
+/**
+ * @brief   Finds the most specific route for @p path (without the query).
+ *
+ * @returns The route, with @p match holding its ":name" values and what a
+ *          wildcard route matched below its prefix, or NULL if none matches.
+ */
+const Route *router_match(const Router *router, const char *path, size_t len, RouteMatch *match)
+{
+    match->param_count = 0;
+    match->rest        = path + len;
+    match->rest_len    = 0;
+    return match_node(router->root, path, len, match);
+}
+
+/**
+ * @brief   Builds the Location of a ROUTE_REDIRECT match in @p arena. In the
+ *          target, ":name" is replaced by that segment of the path and "*"
+ *          by what the wildcard route matched below its prefix.
+ *
+ * @returns The NUL terminated location, NULL if the arena is exhausted.
+ */
+char *router_redirect_location(Arena *arena, const Route *route, const RouteMatch *match)
+{
+    size_t len     = expand_location(route, match, NULL);
+    char *location = arena_alloc(arena, len + 1);
+    if (!location) return NULL;
+
+    expand_location(route, match, location);
+    location[len] = '\0';
+    return location;
+}
+
+// ---------- UTILS ----------
+
+/**
+ * @brief   Parses "<pattern> <handler> [args]":
+ *          - static [directory]: files below the directory, the path after
+ *            the route's prefix appended; without one the whole path is
+ *            appended to the server root, as /static always was
+ *          - proxy [host:port ...]: only these configured backends
+ *          - redirect <301|302|303|307|308> <location>
+ *          - canned <status>: a canned 4xx or 5xx reply
+ *          - stats
+ */
+static int parse_route(Route *route, const char *spec, char **backends, int backend_count)
+{
+    char *copy = strdup(spec);
+    if (!copy) return -1;
+
+    char *args[ROUTE_MAX_PARAMS + 3];
+    int argc = 0;
+    char *save;
+    for (char *tok = strtok_r(copy, " \t", &save); tok; tok = strtok_r(NULL, " \t", &save))
+    {
+        if (argc == (int)(sizeof(args) / sizeof(args[0]))) goto invalid;
+        args[argc++] = tok;
+    }
+    if (argc < 2 || check_pattern(args[0]) < 0) goto invalid;
+
+    route->pattern = strdup(args[0]);
+    if (!route->pattern) goto invalid;
+
+    size_t pattern_len = strlen(args[0]);
+    route->wildcard    = pattern_len >= 2 && strcmp(args[0] + pattern_len - 2, "/*") == 0;
+    route->prefix_len  = route->wildcard ? pattern_len - 2 : pattern_len;
+    for (const char *p = args[0]; *p; p++)
+        route->params += *p == ':';
+
+    const char *handler = args[1];
+    if (strcmp(handler, "static") == 0)
+    {
+        route->handler = ROUTE_STATIC;
+        if (argc > 3 || (argc == 3 && route->params > 0)) goto invalid;
+        if (argc == 3 && !(route->target = realpath(args[2], NULL)))
+        {
+            LOG(ERROR, "Static route directory %s doesn't exist.", args[2]);
+            goto invalid;
+        }
+    }
+    else if (strcmp(handler, "proxy") == 0)
+    {
+        route->handler = ROUTE_PROXY;
+        for (int i = 2; i < argc; i++)
+        {
+            int found = -1;
+            for (int b = 0; b < backend_count && found < 0; b++)
+                if (strcmp(backends[b], args[i]) == 0) found = b;
+            if (found < 0 && backend_count == 0 && strcmp(args[i], DEFAULT_BACKEND) == 0)
+                found = 0;
+            if (found < 0)
+            {
+                LOG(ERROR, "Route backend %s isn't a configured backend.", args[i]);
+                goto invalid;
+            }
+            route->backends |= 1u << found;
+        }
+    }
+    else if (strcmp(handler, "redirect") == 0)
+    {
+        route->handler = ROUTE_REDIRECT;
+        if (argc != 4) goto invalid;
+        route->status = atoi(args[2]);
+        if (route->status != 301 && route->status != 302 && route->status != 303 &&
+            route->status != 307 && route->status != 308)
+            goto invalid;
+        if (!(route->target = strdup(args[3]))) goto invalid;
+    }
+    else if (strcmp(handler, "canned") == 0)
+    {
+        route->handler = ROUTE_CANNED;
+        if (argc != 3) goto invalid;
+        route->status = atoi(args[2]);
+        if (canned_init() < 0 || !canned_response(route->status, 1)) goto invalid;
+    }
+    else if (strcmp(handler, "stats") == 0)
+    {
+        route->handler = ROUTE_STATS;
+        if (argc != 2) goto invalid;
+    }
+    else
+    {
+        goto invalid;
+    }
+
+    free(copy);
+    return OK;
+
+invalid:
+    free(copy);
+    return -1;
+}
+
+/**
+ * @brief   Patterns start with '/', a ":name" follows a '/' and is a whole
+ *          segment, and '*' only appears as the wildcard segment ending a pattern.
+ */
+static int check_pattern(const char *pattern)
+{
+    size_t len = strlen(pattern);
+    if (len == 0 || pattern[0] != '/') return -1;
+
+    int params = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (pattern[i] == '*' && (i != len - 1 || pattern[i - 1] != '/')) return -1;
+        if (pattern[i] != ':') continue;
+
+        if (pattern[i - 1] != '/' || i + 1 == len || pattern[i + 1] == '/' ||
+            ++params > ROUTE_MAX_PARAMS)
+            return -1;
+        while (i + 1 < len && pattern[i + 1] != '/')
+        {
+            char c = pattern[++i];
+            if (!isalnum((unsigned char)c) && c != '_') return -1;
+        }
+    }
+    return OK;
+}
+
+/**
+ * @returns OK, or -1 if the pattern is already taken or names a ":name"
+ *          segment differently than another route at the same place.
+ */
+static int trie_insert(RouteNode *root, const Route *route)
+{
+    const char *pattern = route->pattern;
+    size_t len          = route->wildcard ? route->prefix_len : strlen(pattern);
+
+    RouteNode *node = root;
+    size_t i        = 0;
+    while (i < len)
+    {
+        size_t end = i;
+        if (pattern[i] == ':')
+        {
+            while (end < len && pattern[end] != '/')
+                end++;
+            const char *name = pattern + i + 1;
+            size_t name_len  = end - i - 1;
+
+            if (!node->param)
+            {
+                node->param = node_create("", 0);
+                if (!node->param || !(node->param->param_name = strndup(name, name_len)))
+                    return -1;
+                node->param->param_name_len = name_len;
+            }
+            else if (node->param->param_name_len != name_len ||
+                     memcmp(node->param->param_name, name, name_len) != 0)
+            {
+                LOG(ERROR, "Route %s names a segment differently than an earlier route.",
+                    pattern);
+                return -1;
+            }
+            node = node->param;
+        }
+        else
+        {
+            while (end < len && pattern[end] != ':')
+                end++;
+            node = insert_static(node, pattern + i, end - i);
+            if (!node) return -1;
+        }
+        i = end;
+    }
+
+    const Route **slot = route->wildcard ? &node->subtree : &node->exact;
+    if (*slot)
+    {
+        LOG(ERROR, "Route %s is configured twice.", pattern);
+        return -1;
+    }
+    *slot = route;
+    return OK;
+}
+
+/**
+ * @brief   Walks or extends the static edges below @p node by @p text,
+ *          splitting an edge where the text leaves it.
+ *
+ * @returns The node @p text ends at, NULL if memory allocation fails.
+ */
+static RouteNode *insert_static(RouteNode *node, const char *text, size_t len)
+{
+    while (len > 0)
+    {
+        int c = 0;
+        while (c < node->child_count && node->children[c]->label[0] != text[0])
+            c++;
+
+        if (c == node->child_count)
+        {
+            RouteNode **children =
+                realloc(node->children, (node->child_count + 1) * sizeof(RouteNode *));
+            if (!children) return NULL;
+            node->children = children;
+
+            RouteNode *leaf = node_create(text, len);
+            if (!leaf) return NULL;
+            node->children[node->child_count++] = leaf;
+            return leaf;
+        }
+
+        RouteNode *child = node->children[c];
+        size_t common    = 0;
+        while (common < child->label_len && common < len && child->label[common] == text[common])
+            common++;
+
+        if (common < child->label_len)
+        {
+            // The text leaves the edge midway: split it there
+            RouteNode *mid = node_create(child->label, common);
+            char *rest     = strndup(child->label + common, child->label_len - common);
+            if (!mid || !rest || !(mid->children = malloc(sizeof(RouteNode *))))
+            {
+                node_free(mid);
+                free(rest);
+                return NULL;
+            }
+            free(child->label);
+            child->label       = rest;
+            child->label_len  -= common;
+            mid->children[0]   = child;
+            mid->child_count   = 1;
+            node->children[c]  = mid;
+            child              = mid;
+        }
+
+        node = child;
+        text += common;
+        len -= common;
+    }
+    return node;
+}
+
+static RouteNode *node_create(const char *label, size_t len)
+{
+    RouteNode *node = calloc(1, sizeof(RouteNode));
+    if (!node) return NULL;
+
+    node->label = strndup(label, len);
+    if (!node->label)
+    {
+        free(node);
+        return NULL;
+    }
+    node->label_len = len;
+    return node;
+}
+
+static void node_free(RouteNode *node)
+{
+    if (!node) return;
+
+    for (int i = 0; i < node->child_count; i++)
+        node_free(node->children[i]);
+    node_free(node->param);
+    free(node->children);
+    free(node->label);
+    free(node->param_name);
+    free(node);
+}
+
+/**
+ * @brief   Matches the rest of the path below @p node, whose label is
+ *          already consumed. Static edges first, then a ":name" segment,
+ *          then a wildcard route ending here.
+ */
+static const Route *match_node(const RouteNode *node, const char *path, size_t len,
+                               RouteMatch *match)
+{
+    if (len == 0 && node->exact) return node->exact;
+
+    if (len > 0)
+    {
+        for (int i = 0; i < node->child_count; i++)
+        {
+            const RouteNode *child = node->children[i];
+            if (child->label[0] != path[0]) continue;
+
+            if (child->label_len <= len && memcmp(child->label, path, child->label_len) == 0)
+            {
+                const Route *route =
+                    match_node(child, path + child->label_len, len - child->label_len, match);
+                if (route) return route;
+            }
+            break; // no other child starts with this byte
+        }
+    }
+
+    if (node->param && len > 0 && path[0] != '/' && match->param_count < ROUTE_MAX_PARAMS)
+    {
+        const char *slash = memchr(path, '/', len);
+        size_t segment    = slash ? (size_t)(slash - path) : len;
+
+        RouteParam *param = &match->params[match->param_count++];
+        param->name       = node->param->param_name;
+        param->name_len   = node->param->param_name_len;
+        param->value      = path;
+        param->value_len  = segment;
+
+        const Route *route = match_node(node->param, path + segment, len - segment, match);
+        if (route) return route;
+        match->param_count--;
+    }
+
+    if (node->subtree && (len == 0 || path[0] == '/'))
+    {
+        match->rest     = path;
+        match->rest_len = len;
+        return node->subtree;
+    }
+    return NULL;
+}
+
+/**
+ * @brief   Substitutes the match into the redirect target.
+ *
+ * @returns Length of the location, written to @p out unless it is NULL.
+ */
+static size_t expand_location(const Route *route, const RouteMatch *match, char *out)
+{
+    const char *p = route->target;
+    size_t len    = 0;
+
+    while (*p)
+    {
+        const char *value = NULL;
+        size_t value_len  = 0;
+        size_t skip       = 1;
+
+        if (*p == '*')
+        {
+            // The rest starts with the '/' a target like "/new/*" already has
+            value     = match->rest_len > 0 ? match->rest + 1 : "";
+            value_len = match->rest_len > 0 ? match->rest_len - 1 : 0;
+        }
+        else if (*p == ':')
+        {
+            size_t name_len = 0;
+            while (isalnum((unsigned char)p[1 + name_len]) || p[1 + name_len] == '_')
+                name_len++;
+            for (int i = 0; i < match->param_count && !value; i++)
+            {
+                if (match->params[i].name_len == name_len &&
+                    memcmp(match->params[i].name, p + 1, name_len) == 0)
+                {
+                    value     = match->params[i].value;
+                    value_len = match->params[i].value_len;
+                    skip      = 1 + name_len;
+                }
+            }
+        }
+
+        if (!value)
+        {
+            // Not a placeholder, e.g. the colon of a scheme or port
+            value     = p;
+            value_len = 1;
+        }
+        if (out) memcpy(out + len, value, value_len);
+        len += value_len;
+        p += skip;
+    }
+    return len;
+}
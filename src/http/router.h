@@ -0,0 +1,96 @@
+/**
+ * @file    router.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Radix trie of configured routes.
+ *
+ */
+
+#ifndef HTTPROUTER_H
+#define HTTPROUTER_H
+
+#include "common.h"
+#include "utils/arena.h"
+
+#define ROUTE_MAX_PARAMS 8 // ":name" segments in one pattern
+
+typedef enum
+{
+    ROUTE_STATIC,   // file below a directory
+    ROUTE_PROXY,    // a backend group
+    ROUTE_REDIRECT, // Location built from the route's target
+    ROUTE_CANNED,   // fixed error status
+    ROUTE_STATS     // metrics of every worker
+} RouteHandler;
+
+/**
+ * @brief   One "route=<pattern> <handler> [args]" line of the config.
+ *
+ * Patterns are exact ("/healthz"), have ":name" segments matching one path
+ * segment ("/users/:id"), or are wildcard routes ending in a "*" segment
+ * that match a path and everything below it (with the prefix "/static",
+ * "/static" and "/static/a" match but "/staticfoo" doesn't).
+ */
+typedef struct Route
+{
+    char *pattern;
+    RouteHandler handler;
+    int status;        // ROUTE_REDIRECT and ROUTE_CANNED status code
+    char *target;      // redirect Location template or resolved static directory, may be NULL
+    size_t prefix_len; // pattern bytes before a final "*" segment and its slash
+    int params;        // ":name" segments in pattern
+    int wildcard;      // pattern ends in a "*" segment
+    uint32_t backends; // balancer_mask() bits of a ROUTE_PROXY group, 0 = every backend
+} Route;
+
+typedef struct RouteParam
+{
+    const char *name; // without the colon
+    size_t name_len;
+    const char *value;
+    size_t value_len;
+} RouteParam;
+
+/**
+ * @brief   Where a path matched. Values point into the path and the route.
+ */
+typedef struct RouteMatch
+{
+    RouteParam params[ROUTE_MAX_PARAMS];
+    int param_count;
+    const char *rest; // what a wildcard route matched below its prefix, starting with '/' or empty
+    size_t rest_len;
+} RouteMatch;
+
+/**
+ * @brief   Edge compressed trie node. Static children are tried before the
+ *          ":name" child, and both before a wildcard route ending here, so the
+ *          most specific route wins.
+ */
+typedef struct RouteNode
+{
+    char *label; // static path bytes of the edge leading here
+    size_t label_len;
+    struct RouteNode **children; // static children, first bytes all differ
+    int child_count;
+    struct RouteNode *param; // ":name" child
+    char *param_name;
+    size_t param_name_len;
+    const Route *exact;   // route for a path ending here
+    const Route *subtree; // wildcard route for this path and everything below
+} RouteNode;
+
+typedef struct Router
+{
+    Route *routes;
+    int route_count;
+    RouteNode *root;
+} Router;
+
+int router_init(Router *router, char **specs, int spec_count, char **backends,
+                int backend_count);
+void router_destroy(Router *router);
+const Route *router_match(const Router *router, const char *path, size_t len, RouteMatch *match);
+char *router_redirect_location(Arena *arena, const Route *route, const RouteMatch *match);
+
+#endif
@@ -7,15 +7,138 @@
  */
 
 #include "server.h"
+#include "proxy.h"
+#include "static.h"
+#include "tokenizer.h"
+#include "uring.h"
+#include "utils/clock.h"
+#include "utils/numa.h"
+
+static Worker *create_worker(HTTPServer *self, int id, int cpu, int node, int *status);
+static int request_keep_alive(const HTTPRequest *req);
+static void compact_input(Connection *conn);
+static int reserve_input(Worker *self, Connection *conn, size_t extra, size_t limit);
+static void finish_input(Worker *self, Connection *conn, int peer_closed);
+static int reject_request(Worker *self, Connection *conn, int status_code);
+static int stream_body(Worker *self, Connection *conn);
+static long discard_body(Worker *self, Connection *conn, const char *data, size_t len, int last);
+static void set_deadline(Worker *self, Connection *conn, ConnDeadline deadline);
+static void refresh_deadline(Worker *self, Connection *conn);
+static void expire_connection(TimerNode *node, void *arg);
+static void finish_request(Worker *self, Connection *conn, int aborted);
+static int redirect_handler(Connection *conn, const Route *route, const RouteMatch *match);
 
 int launch(HTTPServer *self)
 {
-    char s[INET6_ADDRSTRLEN];
+    self->workers = calloc(self->worker_count, sizeof(Worker *));
+    if (!self->workers)
+    {
+        LOG(ERROR, "Failed to allocate memory for workers.");
+        return -1;
+    }
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu <= 0) ncpu = 1;
+
+    int cpus[MAX_WORKERS], nodes[MAX_WORKERS];
+    int numa = self->numa && numa_place_workers(self->worker_count, cpus, nodes) > 0;
+    if (self->numa && !numa) LOG(WARNING, "No NUMA topology found, numa=on only pins workers.");
+
+    // With numa=on the main thread moves to each worker's CPU while it builds
+    // the worker, so the pages it touches first are on the worker's node
+    cpu_set_t home;
+    if (numa) pthread_getaffinity_np(pthread_self(), sizeof(home), &home);
+
+    int status = OK;
+    for (int i = 0; i < self->worker_count && status == OK; i++)
+    {
+        int cpu  = numa ? cpus[i] : (self->cpu_affinity || self->numa) ? (int)(i % ncpu) : -1;
+        int node = numa ? nodes[i] : -1;
+        self->workers[i] = create_worker(self, i, cpu, node, &status);
+        if (status < 0) LOG(ERROR, "Failed to initialize worker %d.", i);
+    }
+
+    if (numa)
+    {
+        pthread_setaffinity_np(pthread_self(), sizeof(home), &home);
+        numa_prefer_node(-1);
+    }
+    if (status < 0)
+    {
+        for (int i = 0; i < self->worker_count; i++)
+        {
+            if (!self->workers[i]) continue;
+            worker_destroy(self->workers[i]);
+            free(self->workers[i]);
+        }
+        free(self->workers);
+        self->workers = NULL;
+        return status;
+    }
 
-    if (bind(self->server->socket, (struct sockaddr *)&self->server->address,
-             sizeof(self->server->address)) < 0)
+    LOG(INFO, "Waiting for connections on port %d with %d worker(s), %s tokenizer",
+        self->port, self->worker_count, tokenizer_backend());
+
+    int started   = 0;
+    self->running = self->worker_count;
+    for (int i = 0; i < self->worker_count; i++)
     {
-        return SOCKET_BIND_ERROR;
+        if (pthread_create(&self->workers[i]->thread, NULL, worker_loop, self->workers[i]) != 0)
+        {
+            LOG(ERROR, "Failed to start worker %d thread.", i);
+            __atomic_sub_fetch(&self->running, self->worker_count - started, __ATOMIC_RELEASE);
+            __atomic_store_n(&self->draining, DRAIN_NOW, __ATOMIC_RELAXED);
+            break;
+        }
+        started++;
+    }
+
+    // Signals are taken here until every worker has drained
+    if (started == self->worker_count) httpserver_supervise(self);
+    for (int i = 0; i < started; i++)
+        pthread_join(self->workers[i]->thread, NULL);
+
+    // Mail posted to a worker that has exited is freed with it
+    for (int i = 0; i < self->worker_count; i++)
+    {
+        worker_destroy(self->workers[i]);
+        free(self->workers[i]);
+    }
+    free(self->workers);
+    self->workers = NULL;
+
+    return started == self->worker_count ? 0 : -1;
+}
+
+/**
+ * @brief   Creates the worker's own SO_REUSEPORT listener, epoll instance and
+ *          connection pool.
+ *
+ * @returns OK on success, a negative ErrorCode otherwise.
+ */
+int worker_init(Worker *self)
+{
+    HTTPServer *httpserver = self->httpserver;
+
+    // An upgrade hands over the old binary's listeners, with their accept queues
+    Config *cfg     = httpserver->config;
+    int inherited   = httpserver_take_listener(httpserver, self->id);
+    if (inherited >= 0)
+    {
+        self->server = server_from_socket(inherited, httpserver->port, cfg->listen_backlog);
+        if (!self->server) return -1;
+    }
+    else
+    {
+        self->server = server_constructor(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+                                          INADDR_ANY, httpserver->port, cfg->listen_backlog);
+        if (!self->server) return -1;
+
+        if (bind(self->server->socket, (struct sockaddr *)&self->server->address,
+                 sizeof(self->server->address)) < 0)
+        {
+            return SOCKET_BIND_ERROR;
+        }
     }
     if ((listen(self->server->socket, self->server->queue)) < 0)
     {
@@ -26,457 +149,640 @@ int launch(HTTPServer *self)
     self->epoll_fd = epoll_create1(0);
     if (self->epoll_fd == -1)
     {
-        LOG("ERROR", "Failed to initialize epoll instance.");
-        exit(1);
+        LOG(ERROR, "Failed to initialize epoll instance.");
+        return -1;
     }
-
-    // Initialize connections
-    self->connections = calloc(MAX_CONNECTIONS, sizeof(Connection));
-    if (!self->connections)
+    if (mailbox_init(&self->mailbox) < 0)
     {
-        LOG("ERROR", "Failed to allocate memory for connections.");
-        close(self->epoll_fd);
+        LOG(ERROR, "Failed to create the worker's mailbox.");
         return -1;
     }
-    self->active_count = 0;
 
-    // Add server socket to epoll
-    struct epoll_event ev, events[MAX_EPOLL_EVENTS];
-    ev.events  = EPOLLIN;
-    ev.data.fd = self->server->socket;
+    // Initialize connections, slots are allocated as clients arrive
+    if (connpool_init(&self->connections, cfg->max_connections) < 0)
+    {
+        LOG(ERROR, "Failed to allocate memory for connections.");
+        return -1;
+    }
+    self->active_count     = 0;
+    self->closed_upstreams = NULL;
+
+    // Backends and balancer, replaced on every reload
+    self->config = worker_config_create(httpserver->startup);
+    if (!self->config) return -1;
+    self->generation       = httpserver->startup->generation;
+    self->last_maintenance = 0;
+    timerwheel_init(&self->timers, monotonic_ms());
+    accesslog_init(&self->access_log, cfg, self->id);
+
+    // Split the static cache budget so the total stays what was configured
+    size_t cache_budget = cfg->static_cache_size / httpserver->worker_count;
+    if (filecache_init(&self->cache, cache_budget, cfg) < 0) return -1;
+    proxycache_init(&self->proxy_cache, cfg->proxy_cache_size / httpserver->worker_count, cfg);
+
+    // Add server socket to epoll. The listener is never modified, so edge-triggered
+    // mode can add EPOLLEXCLUSIVE, which stops a shared listener waking every waiter
+    struct epoll_event ev;
+    self->epoll_flags   = cfg->edge_triggered ? EPOLLET : 0;
+    self->listener_kind = EV_LISTENER;
+    ev.events           = EPOLLIN | (cfg->edge_triggered ? EPOLLET | EPOLLEXCLUSIVE : 0);
+    ev.data.ptr         = &self->listener_kind;
     if (epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, self->server->socket, &ev) == -1)
     {
-        close(self->epoll_fd);
-        close(self->server->socket);
-        LOG("ERROR", "Failed to add server socket to epoll event loop.");
+        LOG(ERROR, "Failed to add server socket to epoll event loop.");
         return -1;
     }
 
-    LOG("INFO", "Waiting for connections on port %d", self->server->port);
+    // Level-triggered, the eventfd is read before the mail is taken
+    self->mailbox_kind = EV_MAILBOX;
+    ev.events          = EPOLLIN;
+    ev.data.ptr        = &self->mailbox_kind;
+    if (epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, self->mailbox.wake_fd, &ev) == -1)
+    {
+        LOG(ERROR, "Failed to add the mailbox to epoll event loop.");
+        return -1;
+    }
 
-    while (1)
+    if (self->cache.inotify_fd >= 0)
     {
-        int n_ready = epoll_wait(self->epoll_fd, events, MAX_EPOLL_EVENTS, 60);
-        if (n_ready == -1)
+        self->cache_kind = EV_INOTIFY;
+        ev.events        = EPOLLIN;
+        ev.data.ptr      = &self->cache_kind;
+        if (epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, self->cache.inotify_fd, &ev) == -1)
         {
-            LOG("ERROR", "Failed to wait for epoll events.");
-            continue;
+            LOG(ERROR, "Failed to add inotify fd to epoll event loop.");
+            return -1;
         }
+    }
+
+    return OK;
+}
+
+/**
+ * @brief   Releases everything worker_init() created. Safe on a partially
+ *          initialized worker.
+ */
+void worker_destroy(Worker *self)
+{
+    for (size_t i = 0; i < self->connections.capacity; i++)
+    {
+        Connection *conn = connpool_at(&self->connections, i);
+        if (conn->socket > 0) close_connection(self, conn);
+    }
+    uring_destroy(self);
+    connpool_destroy(&self->connections);
+    proxy_reap(self);
+    while (self->retired)
+    {
+        WorkerConfig *retired = self->retired;
+        self->retired         = retired->next;
+        worker_config_destroy(retired);
+    }
+    if (self->config)
+    {
+        worker_config_destroy(self->config);
+        self->config = NULL;
+    }
+    filecache_destroy(&self->cache);
+    proxycache_destroy(&self->proxy_cache);
+    worker_drop_mail(self);
+    mailbox_destroy(&self->mailbox);
+    if (self->epoll_fd >= 0)
+    {
+        close(self->epoll_fd);
+        self->epoll_fd = -1;
+    }
+    if (self->server)
+    {
+        server_destructor(self->server);
+        self->server = NULL;
+    }
+}
+
+/**
+ * @brief   Event loop of a single worker, runs on its own thread.
+ */
+void *worker_loop(void *arg)
+{
+    Worker *self = (Worker *)arg;
+
+    if (self->cpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(self->cpu, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+            LOG(WARNING, "Failed to pin worker %d to CPU %d.", self->id, self->cpu);
+    }
+    if (self->node >= 0 && numa_prefer_node(self->node) < 0)
+        LOG(WARNING, "Failed to keep worker %d's memory on node %d.", self->id, self->node);
+    log_attach_thread(); // on its node too, the shared ring stays in use if it fails
 
-        for (int i = 0; i < n_ready; i++)
+    if (self->httpserver->config->io_uring)
+    {
+        if (uring_run(self) == OK) goto drained; // -1 if io_uring can't be set up
+        LOG(WARNING, "Worker %d falls back to epoll.", self->id);
+    }
+
+    while (1)
+    {
+        handle_epoll_events(self, 60);
+        if (end_worker_batch(self)) break;
+    }
+
+drained:
+    LOG(INFO, "Worker %d drained.", self->id);
+    __atomic_sub_fetch(&self->httpserver->running, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * @brief   Waits up to @p timeout_ms for epoll events and dispatches them.
+ */
+void handle_epoll_events(Worker *self, int timeout_ms)
+{
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+
+    int n_ready = epoll_wait(self->epoll_fd, events, MAX_EPOLL_EVENTS, timeout_ms);
+    if (n_ready == -1)
+    {
+        if (errno != EINTR) LOG(ERROR, "Failed to wait for epoll events.");
+        return;
+    }
+
+    for (int i = 0; i < n_ready; i++)
+    {
+        // Every registered object starts with its EventKind tag
+        EventKind kind = *(EventKind *)events[i].data.ptr;
+
+        switch (kind)
         {
-            if (events[i].data.fd == self->server->socket)
-            {
-                // Accept a new connection
-                struct sockaddr_in client_addr;
-                socklen_t client_len = sizeof(client_addr);
-
-                int client_fd =
-                    accept(self->server->socket, (struct sockaddr *)&client_addr, &client_len);
-                if (client_fd == -1)
-                {
-                    LOG("ERROR", "Failed to accept a new connection.");
-                    close(client_fd);
-                    continue;
-                }
-
-                // Find free connection slot from connections pool
-                Connection *conn = NULL;
-                for (size_t j = 0; j < MAX_CONNECTIONS; j++)
-                {
-                    if (self->connections[j].socket == 0)
-                    {
-                        conn = &self->connections[j];
-                        break;
-                    }
-                }
-                if (!conn || self->active_count >= MAX_CONNECTIONS)
-                {
-                    LOG("ERROR", "No free connection slots available.");
-                    close(client_fd);
-                    continue;
-                }
-
-                // Initialize a connection
-
-                if (init_connection(conn, client_fd, self->epoll_fd) < 0)
-                {
-                    LOG("ERROR", "Failed to initialize a connection.");
-                    close(client_fd);
-                    continue;
-                }
-                self->active_count++;
-
-                // Set socket nonblocking
-                int flags = fcntl(client_fd, F_GETFL, 0);
-                if (flags == -1 || fcntl(client_fd, F_SETFL, flags | O_NONBLOCK))
-                {
-                    LOG("ERROR", "Failed to set socket nonblocking.");
-                    free(conn->buffer);
-                    close(client_fd);
-                    conn->socket = 0;
-                    self->active_count--;
-                    continue;
-                }
-
-                // Add to epoll
-                ev.events   = EPOLLIN;
-                ev.data.ptr = conn;
-                if (epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) == -1)
-                {
-                    LOG("ERROR", "Failed to add client socket to epoll event loop.");
-                    free(conn->buffer);
-                    close(client_fd);
-                    conn->socket = 0;
-                    self->active_count--;
-                    continue;
-                }
-
-                inet_ntop(AF_INET, &client_addr.sin_addr, s, sizeof(s));
-                LOG("INFO", "Connected: %s:%d, FD: %d", s, ntohs(client_addr.sin_port), client_fd);
-            }
-            else
-            {
-                // Handle client data
-                Connection *conn = (Connection *)events[i].data.ptr;
-                int client_fd    = conn->socket;
-
-                // Read data in loop (considering partial reads)
-                while (1)
-                {
-                    LOG("WARNING", "Check if buffer reallocation is working correctly.");
-                    // TODO: Check if buffer is full
-                    if (conn->len >= conn->buffer_size)
-                    {
-                        size_t new_size  = conn->buffer_size * 2;
-                        char *new_buffer = realloc(conn->buffer, new_size);
-                        if (!new_buffer)
-                        {
-                            LOG("ERROR", "Failed to reallocate buffer for FD %d.", client_fd);
-                            conn->state = PARSE_ERROR;
-                            break;
-                        }
-                        conn->buffer      = new_buffer;
-                        conn->buffer_size = new_size;
-                    }
-
-                    int bytes_read =
-                        recv(client_fd, conn->buffer + conn->len, conn->buffer_size - conn->len, 0);
-                    if (bytes_read < 0)
-                    {
-                        if (errno == EAGAIN || errno == EWOULDBLOCK)
-                        {
-                            // All data read
-                            break;
-                        }
-                        else
-                        {
-                            LOG("ERROR", "Failed to read data from client using recv().");
-                            conn->state = PARSE_ERROR;
-                            break;
-                        }
-                    }
-                    else if (bytes_read == 0)
-                    {
-                        // Client closed connection
-                        if (conn->len > 0)
-                        {
-                            // Data in buffer, try parsing
-                            LOG("INFO",
-                                "Socket FD %d closed with successful read, %zu bytes in buffer",
-                                client_fd, conn->len);
-                        }
-                        else
-                        {
-                            // No data, treat as error
-                            LOG("ERROR", "Socket FD %d closed with no data", client_fd);
-                            conn->state = PARSE_ERROR;
-                        }
-                        break;
-                    }
-                    else
-                    {
-                        conn->len += bytes_read;
-                        LOG("DEBUG", "Read %d bytes from socket FD %d", bytes_read, client_fd);
-                    }
-                }
-                conn->buffer[conn->len] = '\0';
-
-                // Parse request if data available
-                if (conn->len > conn->parsed_bytes && conn->state != PARSE_DONE)
-                {
-                    // HTTPRequest *req = create_http_request();
-                    int consumed = parse_http_request(conn->buffer, conn->len, &conn->request);
-                    if (consumed < 0)
-                    {
-                        LOG("ERROR", "Failed to parse HTTP request.");
-                        conn->state = PARSE_ERROR;
-                    }
-                    else
-                    {
-                        LOG("DEBUG", "Successfully parsed HTTP request.");
-                        conn->state        = PARSE_DONE;
-                        conn->parsed_bytes = conn->len;
-                    }
-                }
-
-                // Handle request if fully parsed
-                if (conn->state == PARSE_DONE)
-                {
-                    LOG("DEBUG", "Fully parsed HTTP request below:");
-                    // print_request(&conn->request);
-
-                    HTTPResponse *response = request_handler(&conn->request);
-                    if (!response)
-                    {
-                        LOG("ERROR", "Failed to handle HTTP request (no response generated).");
-                        conn->state = PARSE_ERROR;
-                    }
-                    else
-                    {
-                        size_t response_len;
-                        char *response_str = httpresponse_serialize(response, &response_len);
-                        httpresponse_free(response);
-                        if (!response_str)
-                        {
-                            LOG("ERROR", "Failed to serialize HTTP response.");
-                            conn->state = PARSE_ERROR;
-                        }
-                        else
-                        {
-                            // Send response
-                            size_t total_sent = 0;
-                            while (total_sent < response_len)
-                            {
-                                int bytes_sent = send(client_fd, response_str + total_sent,
-                                                      response_len - total_sent, 0);
-                                if (bytes_sent <= 0)
-                                {
-                                    LOG("ERROR", "Error while sending response to client socket.");
-                                    break;
-                                }
-                                total_sent += bytes_sent;
-                            }
-
-                            LOG("DEBUG", "Sent %ld bytes response to client FD %d.", total_sent,
-                                client_fd);
-                        }
-                        // LOG("DEBUG", "Response string: %s", response_str);
-                        free(response_str);
-                    }
-                }
-
-                if (conn->state == PARSE_ERROR)
-                {
-                    const char *error_response =
-                        "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
-                    send(client_fd, error_response, strlen(error_response), 0);
-
-                    free_connection(conn, client_fd, self->epoll_fd);
-                    self->active_count--;
-
-                    LOG("ERROR", "Connection with client FD %d closed due to parse error.",
-                        client_fd);
-                }
-
-                // Check for keep-alive
-                int keep_alive = 0;
-                for (int j = 0; j < conn->request.header_count; j++)
-                {
-                    if (strncmp(conn->request.headers[j].name, "Connection",
-                                conn->request.headers[j].name_len) == 0 &&
-                        strncmp(conn->request.headers[j].value, "keep-alive",
-                                conn->request.headers[j].value_len) == 0)
-                    {
-                        keep_alive = 1;
-                        break;
-                    }
-                }
-
-                if (keep_alive)
-                {
-                    // Reset for next request
-                    reset_connection(conn);
-                    LOG("DEBUG", "Connection is keep-alive for client FD %d", client_fd);
-                }
-                else
-                {
-                    // Close connection
-                    LOG("DEBUG",
-                        "Connection is not keep-alive for client FD %d, closing connection...",
-                        client_fd);
-                    free_connection(conn, client_fd, self->epoll_fd);
-                    self->active_count--;
-                }
-            }
+        case EV_LISTENER:
+            accept_connection(self);
+            break;
+        case EV_CLIENT:
+            handle_client_event(self, (Connection *)events[i].data.ptr, events[i].events);
+            break;
+        case EV_UPSTREAM:
+            proxy_handle_event(self, (Upstream *)events[i].data.ptr, events[i].events);
+            break;
+        case EV_INOTIFY:
+            filecache_handle_inotify(&self->cache);
+            break;
+        case EV_MAILBOX:
+            mailbox_clear_wakeup(&self->mailbox); // mail is handled by worker_sync()
+            break;
         }
     }
+}
 
-    close(self->epoll_fd);
-    return 0;
+/**
+ * @brief   Runs after every batch of events, whichever backend produced it.
+ *
+ * @returns 1 once the worker has drained and its loop should end, 0 otherwise.
+ */
+int end_worker_batch(Worker *self)
+{
+    timerwheel_advance(&self->timers, monotonic_ms(), expire_connection, self);
+    int drained = worker_sync(self);
+
+    // Upstreams and clients closed during this batch may still have had stale events queued
+    proxy_reap(self);
+    connpool_recycle(&self->connections);
+    maintain_worker(self);
+    return drained;
 }
 
-HTTPResponse *request_handler(HTTPRequest *request_ptr)
+/**
+ * @brief   Housekeeping run between batches of events, at most once a second:
+ *          expires idle upstream connections and keeps pools warm.
+ */
+void maintain_worker(Worker *self)
 {
-    if (request_ptr == NULL) return NULL;
-    if (request_ptr->request_line.uri == NULL) return NULL;
+    uint64_t now = monotonic_ms();
+    if (now - self->last_maintenance < 1000) return;
+    stats_tick(&self->stats, now - self->last_maintenance);
+    self->last_maintenance = now;
+
+    for (int i = 0; i < self->config->backend_count; i++)
+        backend_maintain(&self->config->backends[i], now);
+}
 
-    if (request_ptr->request_line.uri_len > 0)
+/**
+ * @brief   Accepts every pending client on the worker's listener and
+ *          registers them in the worker's epoll instance.
+ *
+ * The backlog is drained until EAGAIN, so a connection storm costs one
+ * epoll_wait() round trip instead of one per client, and edge-triggered
+ * listeners never miss a wakeup.
+ */
+void accept_connection(Worker *self)
+{
+    while (1)
     {
-        if (strncmp(request_ptr->request_line.uri, "/static", 7) == 0)
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+
+        int client_fd = accept4(self->server->socket, (struct sockaddr *)&client_addr,
+                                &client_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd == -1)
         {
-            char filepath[PATH_MAX];
-            if (snprintf(filepath, sizeof(filepath), "%s%.*s", realpath(BASE_DIR, NULL),
-                         (int)request_ptr->request_line.uri_len, request_ptr->request_line.uri) < 0)
-            {
-                LOG("ERROR", "Failed to build filepath.");
-                char response_buffer[] = "<h1>404 Not Found</h1>";
-                HTTPResponse *response = response_builder(404, "Not Found", response_buffer,
-                                                          sizeof(response_buffer), "text/html");
-                return response;
-            };
-
-            int fd = open(filepath, O_RDONLY);
-            if (fd == -1)
-            {
-                LOG("ERROR", "Failed to open file.");
-                char response_buffer[] = "<h1>404 Not Found</h1>";
-                HTTPResponse *response = response_builder(404, "Not Found", response_buffer,
-                                                          sizeof(response_buffer), "text/html");
-                return response;
-            }
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                LOG(ERROR, "Failed to accept a new connection: %s", strerror(errno));
+            return;
+        }
+
+        add_client(self, client_fd, &client_addr);
+    }
+}
+
+/**
+ * @brief   Takes a pool slot for an accepted, already non-blocking client and
+ *          starts watching it. The client is closed if that fails.
+ *
+ * @param   client_addr  Peer address for the log, NULL if unknown.
+ */
+void add_client(Worker *self, int client_fd, const struct sockaddr_in *client_addr)
+{
+    char s[INET6_ADDRSTRLEN];
+
+    // Take a free slot from the connection pool
+    Connection *conn = connpool_get(&self->connections);
+    if (!conn)
+    {
+        LOG(ERROR, "No free connection slots available.");
+        close(client_fd);
+        return;
+    }
 
-            // Get file size
-            struct stat st;
-            fstat(fd, &st);
-            size_t filesize = st.st_size;
+    // Initialize a connection
+    if (init_connection(conn, client_fd, self->epoll_fd) < 0)
+    {
+        LOG(ERROR, "Failed to initialize a connection.");
+        connpool_put(&self->connections, conn);
+        close(client_fd);
+        return;
+    }
+    self->active_count++;
+    self->stats.accepts++;
+
+    // Start receiving, on the ring or in epoll
+    struct epoll_event ev;
+    ev.events    = EPOLLIN | self->epoll_flags;
+    ev.data.ptr  = conn;
+    conn->events = ev.events;
+    if (self->ring)
+    {
+        uring_add_connection(self, conn);
+    }
+    else if (epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) == -1)
+    {
+        LOG(ERROR, "Failed to add client socket to epoll event loop.");
+        free(conn->buffer);
+        arena_destroy(&conn->arena);
+        close(client_fd);
+        connpool_put(&self->connections, conn);
+        self->active_count--;
+        return;
+    }
+    set_deadline(self, conn, DEADLINE_HEADER);
 
-            char *buffer = malloc(filesize);
-            memset(buffer, 0, filesize);
+    if (!client_addr)
+    {
+        LOG(INFO, "Connected: FD: %d", client_fd);
+        return;
+    }
+    inet_ntop(AF_INET, &client_addr->sin_addr, s, sizeof(s));
+    LOG(INFO, "Connected: %s:%d, FD: %d", s, ntohs(client_addr->sin_port), client_fd);
+}
+
+/**
+ * @brief   Drives a client connection through read -> handle -> write.
+ *
+ * The connection only listens for EPOLLIN while it is waiting for a request
+ * or streaming its body, and for EPOLLOUT while it has unsent output, so a
+ * proxied request parks the client until its upstream produces bytes.
+ */
+void handle_client_event(Worker *self, Connection *conn, uint32_t events)
+{
+    if (conn->socket <= 0) return; // closed earlier in this batch
 
-            if (!buffer)
+    if (events & (EPOLLERR | EPOLLHUP) && !(events & EPOLLIN))
+    {
+        LOG(DEBUG, "Client FD %d hung up.", conn->socket);
+        close_connection(self, conn);
+        return;
+    }
+
+    if (events & EPOLLOUT)
+    {
+        if (flush_connection(self, conn) < 0) return;
+    }
+
+    if ((events & EPOLLIN) && connection_reading(conn))
+    {
+        read_request(self, conn);
+    }
+}
+
+/**
+ * @brief   Reads everything available from the client and handles every
+ *          complete request in the buffer.
+ *
+ * The buffer grows up to client_buffer_size. Once it is full the input is
+ * handed on first, which frees the space a streamed body took, and reading
+ * goes on unless the body handler is still busy with it.
+ */
+void read_request(Worker *self, Connection *conn)
+{
+    const Config *cfg = self->httpserver->config;
+    int client_fd     = conn->socket;
+    int peer_closed   = 0;
+
+    compact_input(conn);
+
+    // Read data in loop (considering partial reads)
+    while (1)
+    {
+        int room = reserve_input(self, conn, 1, cfg->client_buffer_size);
+        if (room < 0) return;
+        if (room > 0)
+        {
+            // Full: hand the input on first, a streamed body frees its space
+            size_t len = conn->len;
+            finish_input(self, conn, 0);
+            if (conn->socket <= 0 || !connection_reading(conn)) return;
+            compact_input(conn);
+            if (conn->len >= len) return;
+            continue;
+        }
+
+        int bytes_read =
+            recv(client_fd, conn->buffer + conn->len, conn->buffer_size - conn->len - 1, 0);
+        if (bytes_read < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
             {
-                LOG("ERROR", "Failed to allocate buffer.");
-                close(fd);
-                char response_buffer[] = "<h1>Internal Server Error</h1>";
-                return response_builder(500, "Internal Server Error", response_buffer,
-                                        sizeof(response_buffer), "text/html");
+                // All data read
+                break;
             }
-
-            size_t total_read = 0;
-            while (total_read < filesize)
+            else if (errno == EINTR)
             {
-                size_t bytes = read(fd, buffer + total_read, filesize - total_read);
-                if (bytes <= 0)
-                {
-                    LOG("ERROR", "Failed to read file.");
-                    free(buffer);
-                    char response_buffer[] = "<h1>Internal Server Error</h1>";
-                    return response_builder(500, "Internal Server Error", response_buffer,
-                                            sizeof(response_buffer), "text/html");
-                }
-                total_read += bytes;
+                continue;
             }
-
-            LOG("DEBUG", "Read %zu bytes\nActual filesize: %zu", total_read, filesize);
-
-            if (total_read != filesize)
+            else
             {
-                LOG("ERROR", "Failed to read file.");
-                free(buffer);
-                char response_buffer[] = "<h1>Internal Server Error</h1>";
-                return response_builder(500, "Internal Server Error", response_buffer,
-                                        sizeof(response_buffer), "text/html");
+                LOG(ERROR, "Failed to read data from client using recv().");
+                close_connection(self, conn);
+                return;
             }
-
-            HTTPResponse *response =
-                response_builder(200, "OK", buffer, filesize, get_mime_type(filepath));
-
-            close(fd);
-            return response;
         }
-        else if (strncmp(request_ptr->request_line.uri, "/api", 4) == 0)
+        else if (bytes_read == 0)
         {
-            // TODO: Reverse proxy
-            char *api_path = request_ptr->request_line.uri + strlen("/api");
-            if (*api_path == '\0') api_path = "/";
-
-            char proxy_request[INITIAL_BUFFER_SIZE];
-            int proxy_request_len =
-                snprintf(proxy_request, sizeof(proxy_request),
-                         "%s %s HTTP/1.1\r\n"
-                         "Host: localhost\r\n"
-                         "Content-Length: %zu\r\n"
-                         "Connection: close\r\n"
-                         "\r\n",
-                         request_ptr->request_line.method, api_path, request_ptr->body_len);
-
-            if (proxy_request_len < 0)
+            // Client closed connection
+            if (conn->len > 0)
             {
-                LOG("ERROR", "Failed to build proxy request.");
-                char response_buffer[] = "<h1>Internal Server Error</h1>";
-                return response_builder(500, "Internal Server Error", response_buffer,
-                                        sizeof(response_buffer), "text/html");
+                // Data in buffer, try parsing
+                LOG(INFO, "Socket FD %d closed with successful read, %zu bytes in buffer",
+                    client_fd, conn->len);
             }
-
-            // Then, append the request body to the proxy_request string
-            strncat(proxy_request, request_ptr->body, request_ptr->body_len);
-
-            int backend_fd = connect_to_backend("localhost", "8000");
-            if (backend_fd == -1)
+            else
             {
-                LOG("ERROR", "Failed to connect to backend.");
-                char response_buffer[] = "<h1>502 Bad Gateway</h1>";
-                return response_builder(502, "Bad Gateway", response_buffer,
-                                        sizeof(response_buffer), "text/html");
+                // Nothing to answer, just drop the connection
+                LOG(DEBUG, "Socket FD %d closed with no data", client_fd);
+                close_connection(self, conn);
+                return;
             }
+            peer_closed = 1;
+            break;
+        }
+        else
+        {
+            conn->len += bytes_read;
+            self->stats.bytes_in += bytes_read;
+            LOG(DEBUG, "Read %d bytes from socket FD %d", bytes_read, client_fd);
+        }
+    }
 
-            send(backend_fd, proxy_request, proxy_request_len, 0);
+    finish_input(self, conn, peer_closed);
+}
 
-            // Receive response from backend
-            char proxy_response[INITIAL_BUFFER_SIZE];
-            int proxy_response_len = recv(backend_fd, proxy_response, sizeof(proxy_response), 0);
+/**
+ * @brief   Appends bytes received for the client by another backend (the
+ *          io_uring one). They are only parsed while the connection is
+ *          reading, otherwise they wait in the buffer like pipelined bytes.
+ *          Completions still in flight when reading paused may take the
+ *          buffer past client_buffer_size, a bounded overshoot.
+ */
+void receive_input(Worker *self, Connection *conn, const char *data, size_t len)
+{
+    if (conn->phase == CONN_READING) compact_input(conn);
+    if (reserve_input(self, conn, len, SIZE_MAX) < 0) return;
 
-            if (proxy_response_len < 0)
-            {
-                LOG("ERROR", "Failed to read from backend.");
-                char response_buffer[] = "<h1>502 Bad Gateway</h1>";
-                return response_builder(502, "Bad Gateway", response_buffer,
-                                        sizeof(response_buffer), "text/html");
-            }
+    memcpy(conn->buffer + conn->len, data, len);
+    conn->len += len;
+    self->stats.bytes_in += len;
+
+    if (connection_reading(conn))
+        finish_input(self, conn, 0);
+    else
+        conn->buffer[conn->len] = '\0';
+}
 
-            proxy_response[proxy_response_len] = '\0';
-            close(backend_fd);
+/**
+ * @brief   The client closed its side, reported by another backend while the
+ *          connection is reading.
+ */
+void receive_eof(Worker *self, Connection *conn)
+{
+    if (conn->len == 0)
+    {
+        LOG(DEBUG, "Socket FD %d closed with no data", conn->socket);
+        close_connection(self, conn);
+        return;
+    }
+    finish_input(self, conn, 1);
+}
 
-            LOG("DEBUG", "Received %d bytes response from backend.", proxy_response_len);
+/**
+ * @brief   Parses and dispatches buffered requests one after another.
+ *
+ * Pipelined requests are answered strictly in order: the next one is only
+ * parsed once the previous response is fully sent and the body of the
+ * previous request fully received, either right away or from
+ * flush_connection() when output drains later.
+ *
+ * A request is dispatched as soon as its head is complete. Its body is then
+ * streamed to conn->on_body as it arrives, so only the head and one buffer
+ * of body are ever held in memory.
+ *
+ * @returns OK while the connection is alive, -1 if it was closed.
+ */
+int process_requests(Worker *self, Connection *conn)
+{
+    if (conn->processing) return OK;
+    conn->processing = 1;
 
-            // TODO: parse response headers, here we directly return body
-            char *body = strstr(proxy_response, "\r\n\r\n");
-            if (!body)
-                body = proxy_response;
-            else
-                body += 4;
+    if (conn->body_streaming)
+    {
+        if (stream_body(self, conn) < 0) return -1;
 
-            HTTPResponse *response =
-                response_builder(200, "OK", body, proxy_request_len, "text/html");
-            return response;
+        // The response may have been waiting for the end of the body
+        if (!conn->body_streaming && conn->phase == CONN_WRITING &&
+            flush_connection(self, conn) < 0)
+            return -1;
+    }
+
+    while (conn->phase == CONN_READING && conn->request_start < conn->len)
+    {
+        uint64_t parse_start = monotonic_ns();
+        ParseState state =
+            parse_http_request_partial(&conn->parser, &conn->request,
+                                       conn->buffer + conn->request_start,
+                                       conn->len - conn->request_start);
+        conn->parse_ns += monotonic_ns() - parse_start;
+
+        if (state == PARSE_ERROR)
+        {
+            LOG(ERROR, "Failed to parse HTTP request from client FD %d.", conn->socket);
+            return reject_request(self, conn, 400);
         }
-        else
+        if (state != PARSE_DONE && state != PARSE_BODY) break; // wait for the rest of the head
+
+        const Config *cfg = self->config->cfg;
+        if (state == PARSE_BODY && cfg->max_body_size > 0 &&
+            conn->parser.content_length > cfg->max_body_size)
         {
-            LOG("DEBUG", "Request to unknown URI by proxy backend: %s",
-                request_ptr->request_line.uri);
-            char response_buffer[] = "<h1>404 Not Found</h1>";
-            HTTPResponse *response = response_builder(404, "Not Found", response_buffer,
-                                                      sizeof(response_buffer), "text/html");
-            return response;
+            LOG(INFO, "Client FD %d sent a %zu bytes body, the limit is %zu.", conn->socket,
+                conn->parser.content_length, cfg->max_body_size);
+            return reject_request(self, conn, 413);
         }
+
+        // No read deadline while the request is answered
+        timerwheel_cancel(&conn->timer);
+        conn->deadline = DEADLINE_NONE;
+        histogram_record(&self->stats.parse, conn->parse_ns);
+        conn->parse_ns = 0;
+
+        // Handlers only override what differs, e.g. the status of an error
+        conn->request_us  = monotonic_us();
+        conn->status      = 200;
+        conn->backend     = NULL;
+        conn->upstream_us = 0;
+        conn->keep_alive  = request_keep_alive(&conn->request) && !self->draining;
+
+        // Handlers that don't read the body get it drained
+        conn->on_body        = discard_body;
+        conn->body_raw       = 0;
+        conn->body_streaming = state == PARSE_BODY;
+        conn->body_blocked   = 0;
+        conn->body_pending   = 0;
+
+        worker_config_acquire(self, conn);
+        conn->phase            = CONN_WRITING;
+        uint64_t handler_start = monotonic_ns();
+        if (request_handler(self, conn) < 0)
+        {
+            LOG(ERROR, "Failed to handle HTTP request (no response generated).");
+            close_connection(self, conn);
+            return -1;
+        }
+        histogram_record(&self->stats.handler, monotonic_ns() - handler_start);
+
+        // Body bytes that came with the head
+        if (conn->body_streaming && stream_body(self, conn) < 0) return -1;
+
+        // Proxied requests finish when their upstream does
+        if (conn->phase == CONN_WRITING && flush_connection(self, conn) < 0) return -1;
+    }
+
+    conn->processing = 0;
+    return OK;
+}
+
+/**
+ * @returns Whether the client socket is read from: while waiting for a
+ *          request, and while a body streams in faster than it is taken.
+ */
+int connection_reading(const Connection *conn)
+{
+    return conn->phase == CONN_READING || (conn->body_streaming && !conn->body_blocked);
+}
+
+/**
+ * @brief   Offers the body again after conn->on_body took less than it was
+ *          given, once the handler can take more.
+ */
+void resume_body(Worker *self, Connection *conn)
+{
+    if (!conn->body_blocked) return;
+
+    conn->body_blocked = 0;
+    if (process_requests(self, conn) < 0) return;
+    refresh_deadline(self, conn);
+    update_connection_events(self, conn);
+}
+
+/**
+ * @brief   Stops receiving the body of the current request, e.g. when its
+ *          upstream failed. The next request can't be found anymore, so the
+ *          connection is closed after the response.
+ */
+void abandon_body(Worker *self, Connection *conn)
+{
+    if (!conn->body_streaming) return;
+
+    conn->body_streaming = 0;
+    conn->body_blocked   = 0;
+    conn->keep_alive     = 0;
+    timerwheel_cancel(&conn->timer);
+    conn->deadline = DEADLINE_NONE;
+    update_connection_events(self, conn);
+}
+
+/**
+ * @brief   Dispatches the request to the handler of the route its path
+ *          matches, 404 if none does.
+ */
+int request_handler(Worker *self, Connection *conn)
+{
+    HTTPRequest *request_ptr = &conn->request;
+    const char *uri          = request_ptr->request_line.uri;
+    size_t uri_len           = request_ptr->request_line.uri_len;
+
+    if (uri == NULL) return -1;
+
+    const char *query = memchr(uri, '?', uri_len);
+    size_t path_len   = query ? (size_t)(query - uri) : uri_len;
+
+    RouteMatch match;
+    const Route *route = router_match(&conn->config->shared->router, uri, path_len, &match);
+    if (!route)
+    {
+        LOG(DEBUG, "Request to unknown URI: %.*s", (int)uri_len, uri);
+        return queue_canned(conn, 404);
     }
 
-    LOG("DEBUG", "Request to unknown URI: %s", request_ptr->request_line.uri);
-    char response_buffer[] = "<h1>404 Not Found</h1>";
-    HTTPResponse *response =
-        response_builder(404, "Not Found", response_buffer, sizeof(response_buffer), "text/html");
-    return response;
+    // Handlers see a wildcard route's path below its prefix, exact routes the whole path
+    conn->route          = route;
+    conn->route_path     = route->wildcard ? match.rest : uri;
+    conn->route_path_len = uri_len - (conn->route_path - uri);
+
+    switch (route->handler)
+    {
+    case ROUTE_STATIC:
+        return static_file_handler(self, conn);
+    case ROUTE_PROXY:
+        return proxy_request(self, conn);
+    case ROUTE_REDIRECT:
+        return redirect_handler(conn, route, &match);
+    case ROUTE_CANNED:
+        return queue_canned(conn, route->status);
+    case ROUTE_STATS:
+        return stats_handler(self, conn);
+    }
+    return -1;
 }
 
 // ---------- UTILS ----------
@@ -485,26 +791,50 @@ int init_connection(Connection *conn, int client_fd, int epoll_fd)
 {
     if (!conn || client_fd < 0 || epoll_fd < 0) return -1;
 
+    conn->kind   = EV_CLIENT;
     conn->socket = client_fd;
     conn->buffer = (char *)calloc(INITIAL_BUFFER_SIZE, sizeof(char));
     if (!conn->buffer) return -1;
 
     conn->buffer_size  = INITIAL_BUFFER_SIZE;
-    conn->len          = 0;
-    conn->parsed_bytes = 0;
-    conn->state        = PARSE_REQUEST_LINE;
-
-    // Initialize HTTPRequest
+    conn->len           = 0;
+    conn->request_start = 0;
+    conn->processing    = 0;
+    conn->phase         = CONN_READING;
+    conn->keep_alive    = 0;
+    conn->events        = 0;
+    conn->upstream      = NULL;
+    conn->parse_ns      = 0;
+
+    conn->on_body        = discard_body;
+    conn->body_streaming = 0;
+    conn->body_blocked   = 0;
+    conn->body_pending   = 0;
+    conn->cache_fill     = NULL;
+    conn->wait_next      = NULL;
+    conn->config         = NULL;
+    conn->route          = NULL;
+    conn->route_path     = NULL;
+    conn->route_path_len = 0;
+    request_parser_init(&conn->parser);
+    conn->parser.stream_body = 1; // bodies go to on_body instead of the buffer
+    output_init(&conn->out);
+
+    // The header array is carved once and survives the per-request resets
+    if (arena_init(&conn->arena, CONNECTION_ARENA_SIZE) < 0)
+    {
+        free(conn->buffer);
+        return -1;
+    }
     memset(&conn->request, 0, sizeof(HTTPRequest));
-    conn->request.headers = malloc(MAX_HEADERS * sizeof(HTTPHeader));
+    conn->request.headers = arena_alloc(&conn->arena, MAX_HEADERS * sizeof(HTTPHeader));
     if (!conn->request.headers)
     {
+        arena_destroy(&conn->arena);
         free(conn->buffer);
         return -1;
     }
-    conn->request.header_count = 0;
-    conn->request.body         = NULL;
-    conn->request.body_len     = 0;
+    arena_set_floor(&conn->arena);
 
     return 0;
 }
@@ -526,53 +856,239 @@ int free_connection(Connection *conn, int client_fd, int epoll_fd)
         conn->buffer = NULL;
     }
 
-    free_http_request(&conn->request); // Must free headers, body, etc.
+    // Request headers live in the arena, the rest borrows from buffer
+    memset(&conn->request, 0, sizeof(HTTPRequest));
+    arena_destroy(&conn->arena);
+
+    output_free(&conn->out);
 
     conn->buffer_size  = 0;
-    conn->len          = 0;
-    conn->parsed_bytes = 0;
-    conn->state        = PARSE_REQUEST_LINE;
+    conn->len           = 0;
+    conn->request_start = 0;
+    conn->phase         = CONN_READING;
+    conn->events        = 0;
+
+    conn->body_streaming = 0;
+    conn->body_blocked   = 0;
+    request_parser_init(&conn->parser);
 
     return OK;
 }
 
+/**
+ * @brief   Prepares a keep-alive connection for its next request. Bytes of a
+ *          pipelined request already read stay in the buffer.
+ */
 int reset_connection(Connection *conn)
 {
-    memset(conn->buffer, 0, conn->buffer_size);
-    conn->len          = 0;
-    conn->parsed_bytes = 0;
-    conn->state        = PARSE_REQUEST_LINE;
+    conn->request_start += conn->parser.parsed;
+    if (conn->request_start >= conn->len)
+    {
+        conn->request_start = 0;
+        conn->len           = 0;
+    }
+
+    reset_http_request(&conn->request);
+    arena_reset(&conn->arena);
+    request_parser_init(&conn->parser);
+    conn->parser.stream_body = 1;
+    conn->phase              = CONN_READING;
+    conn->keep_alive         = 0;
+    conn->body_streaming     = 0;
+    conn->body_blocked       = 0;
+    conn->body_pending       = 0;
+    output_reset(&conn->out);
 
     return OK;
 }
 
-int connect_to_backend(const char *host, const char *port)
+/**
+ * @brief   Closes a client connection, aborting its upstream if a proxied
+ *          request is still in flight, and returns the slot to the pool.
+ */
+void close_connection(Worker *self, Connection *conn)
 {
-    struct addrinfo hints, *res;
-    memset(&hints, 0, sizeof(hints));
+    if (conn->socket <= 0) return;
 
-    hints.ai_family   = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
+    if (conn->upstream)
+    {
+        proxy_abort(self, conn->upstream);
+        conn->upstream = NULL;
+    }
+    if (conn->cache_fill) proxy_cancel_wait(self, conn);
+    finish_request(self, conn, 1); // only if a request was still being answered
+
+    if (self->ring) uring_remove_connection(self, conn);
+    timerwheel_cancel(&conn->timer);
+    free_connection(conn, conn->socket, self->epoll_fd);
+    connpool_put(&self->connections, conn);
+    self->active_count--;
+}
 
-    if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+/**
+ * @brief   Appends a copy of @p data to the connection's pending output.
+ *
+ * @returns OK on success, -1 if the output queue could not grow.
+ */
+int queue_output(Connection *conn, const char *data, size_t len)
+{
+    return output_append(&conn->out, data, len);
+}
 
-    int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (sock < 0)
+/**
+ * @brief   Queues a response built in the connection's arena. Its head and
+ *          body are referenced, not copied; both stay valid until the arena
+ *          is reset after the response was sent.
+ */
+int queue_response(Connection *conn, HTTPResponse *response)
+{
+    struct iovec iov[2];
+    int count = response ? httpresponse_finish(response, iov) : -1;
+    if (count < 0)
     {
-        LOG("ERROR", "Failed to create socket while connecting to proxy backend.");
-        freeaddrinfo(res);
+        LOG(ERROR, "Failed to serialize HTTP response.");
         return -1;
     }
 
-    if (connect(sock, res->ai_addr, res->ai_addrlen) != 0)
+    conn->status = response->status_code;
+    for (int i = 0; i < count; i++)
+    {
+        if (output_append_shared(&conn->out, iov[i].iov_base, iov[i].iov_len, NULL, NULL) < 0)
+            return -1;
+    }
+    return OK;
+}
+
+/**
+ * @brief   Queues the canned response for @p status_code by reference, the
+ *          variant that closes the connection if it isn't kept alive.
+ *
+ * @returns OK on success, -1 if there is no such canned response or the
+ *          output queue could not grow.
+ */
+int queue_canned(Connection *conn, int status_code)
+{
+    const CannedResponse *res = canned_response(status_code, conn->keep_alive);
+    if (!res)
+    {
+        LOG(ERROR, "No canned response for status %d.", status_code);
+        return -1;
+    }
+
+    conn->status = status_code;
+    return output_append_shared(&conn->out, res->data, res->len, NULL, NULL);
+}
+
+/**
+ * @brief   Queues @p length bytes of @p fd from @p offset to be sent with
+ *          sendfile() after the output queued so far. The connection takes
+ *          ownership of @p fd.
+ *
+ * @returns OK on success, -1 if the output queue is full.
+ */
+int queue_file(Connection *conn, int fd, off_t offset, size_t length)
+{
+    return output_append_file(&conn->out, fd, offset, length);
+}
+
+int has_pending_output(const Connection *conn)
+{
+    return output_pending(&conn->out);
+}
+
+/**
+ * @brief   Sends as much pending output as the socket accepts without
+ *          blocking.
+ *
+ * EPOLLOUT stays registered only while output is left over. When the
+ * output is drained in the CONN_WRITING phase and the request body is
+ * received the request is finished: the connection is either reset for the
+ * next keep-alive request or closed.
+ *
+ * @returns OK while the connection is alive, -1 if it was closed.
+ */
+int flush_connection(Worker *self, Connection *conn)
+{
+    int client_fd = conn->socket;
+
+    OutputStatus status = output_flush(&conn->out, client_fd);
+    if (status == OUTPUT_ERROR)
     {
-        LOG("ERROR", "Failed to connect to proxy backend.");
-        freeaddrinfo(res);
+        LOG(ERROR, "Error while sending response to client socket.");
+        close_connection(self, conn);
         return -1;
     }
+    if (status == OUTPUT_BLOCKED)
+    {
+        update_connection_events(self, conn);
+        return OK;
+    }
+
+    if (conn->out.truncated) conn->keep_alive = 0; // short body, framing is broken
+    if (self->draining) conn->keep_alive = 0;
+
+    LOG(DEBUG, "Sent %zu bytes response to client FD %d.", conn->out.sent_bytes, client_fd);
+
+    // Let a paused upstream continue now that the client caught up
+    if (conn->upstream) proxy_resume(self, conn->upstream);
+
+    if (conn->phase == CONN_WRITING && !conn->body_streaming)
+    {
+        finish_request(self, conn, 0);
+
+        if (conn->keep_alive)
+        {
+            // Reset for next request
+            reset_connection(conn);
+            LOG(DEBUG, "Connection is keep-alive for client FD %d", client_fd);
+
+            // A pipelined request may already be waiting in the buffer
+            if (process_requests(self, conn) < 0) return -1;
+            refresh_deadline(self, conn);
+        }
+        else
+        {
+            // Close connection
+            LOG(DEBUG, "Connection is not keep-alive for client FD %d, closing connection...",
+                client_fd);
+            close_connection(self, conn);
+            return -1;
+        }
+    }
 
-    freeaddrinfo(res);
-    return sock;
+    update_connection_events(self, conn);
+    return OK;
+}
+
+/**
+ * @brief   Re-arms the client fd so it only reports the events its current
+ *          phase can act on.
+ */
+void update_connection_events(Worker *self, Connection *conn)
+{
+    if (self->ring)
+    {
+        uring_update_connection(self, conn);
+        return;
+    }
+
+    // In edge-triggered mode a MOD that adds EPOLLIN back re-checks readiness,
+    // so bytes that arrived while the connection wasn't reading aren't missed
+    uint32_t wanted = self->epoll_flags;
+    if (connection_reading(conn)) wanted |= EPOLLIN;
+    if (has_pending_output(conn)) wanted |= EPOLLOUT;
+
+    if (wanted == conn->events) return;
+
+    struct epoll_event ev;
+    ev.events   = wanted;
+    ev.data.ptr = conn;
+    if (epoll_ctl(self->epoll_fd, EPOLL_CTL_MOD, conn->socket, &ev) == -1)
+    {
+        LOG(ERROR, "Failed to update epoll events for client FD %d.", conn->socket);
+        return;
+    }
+    conn->events = wanted;
 }
 
 void *get_in_addr(struct sockaddr *sa)
@@ -585,28 +1101,433 @@ void *get_in_addr(struct sockaddr *sa)
     return &(((struct sockaddr_in6 *)sa)->sin6_addr);
 }
 
-HTTPServer *httpserver_constructor(int port, char *static_dir, char **proxy_backends,
-                                   int backend_count)
+/**
+ * @brief   Creates the server for @p cfg, which it owns from now on.
+ *
+ * @returns The server, NULL if a route or the static bundle is invalid
+ *          (@p cfg stays the caller's then) or memory runs out.
+ */
+HTTPServer *httpserver_constructor(Config *cfg)
 {
-    HTTPServer *httpserver_ptr = (HTTPServer *)malloc(sizeof(HTTPServer));
+    if (canned_init() < 0) return NULL;
 
-    SocketServer *SockServer   = server_constructor(AF_INET, SOCK_STREAM, 0, INADDR_ANY, port, 10);
-    httpserver_ptr->server     = SockServer;
-    httpserver_ptr->static_dir = strdup(static_dir);
-    httpserver_ptr->proxy_backends = proxy_backends;
-    httpserver_ptr->backend_count  = backend_count;
-    httpserver_ptr->launch         = launch;
+    HTTPServer *httpserver_ptr = (HTTPServer *)calloc(1, sizeof(HTTPServer));
+    if (!httpserver_ptr) return NULL;
 
+    httpserver_ptr->startup = server_config_create(cfg, 1);
+    if (!httpserver_ptr->startup)
+    {
+        free(httpserver_ptr);
+        return NULL;
+    }
+    server_config_retain(httpserver_ptr->startup); // also the current one until a reload
+
+    httpserver_ptr->port         = cfg->port;
+    httpserver_ptr->worker_count = cfg->workers > 0 ? cfg->workers : 1;
+    httpserver_ptr->cpu_affinity = cfg->cpu_affinity;
+    httpserver_ptr->numa         = cfg->numa;
+    httpserver_ptr->workers      = NULL;
+    httpserver_ptr->static_dir   = strdup(cfg->static_dir ? cfg->static_dir : BASE_DIR);
+    httpserver_ptr->static_root  = realpath(BASE_DIR, NULL);
+    httpserver_ptr->config       = cfg;
+    httpserver_ptr->current      = httpserver_ptr->startup;
+    httpserver_ptr->exe_path     = realpath("/proc/self/exe", NULL);
+    httpserver_ptr->launch       = launch;
+
+    httpserver_inherit_listeners(httpserver_ptr);
     return httpserver_ptr;
 }
 
 void httpserver_destructor(HTTPServer *httpserver_ptr)
 {
-    if (httpserver_ptr->server != NULL)
+    if (httpserver_ptr->workers != NULL)
     {
-        server_destructor(httpserver_ptr->server);
+        for (int i = 0; i < httpserver_ptr->worker_count; i++)
+        {
+            if (!httpserver_ptr->workers[i]) continue;
+            worker_destroy(httpserver_ptr->workers[i]);
+            free(httpserver_ptr->workers[i]);
+        }
+        free(httpserver_ptr->workers);
     }
+    for (int i = 0; i < httpserver_ptr->listen_fd_count; i++)
+        if (httpserver_ptr->listen_fds[i] >= 0) close(httpserver_ptr->listen_fds[i]);
+    free(httpserver_ptr->listen_fds);
     free(httpserver_ptr->static_dir);
-    free(httpserver_ptr->proxy_backends);
+    free(httpserver_ptr->static_root);
+    free(httpserver_ptr->exe_path);
+    server_config_release(httpserver_ptr->current);
+    server_config_release(httpserver_ptr->startup);
     free(httpserver_ptr);
-}
\ No newline at end of file
+}
+
+// ---------- UTILS ----------
+
+/**
+ * @brief   Allocates worker @p id on its own cache lines and initializes it.
+ *
+ * @returns The worker, also when worker_init() fails (@p status < 0) so the
+ *          caller can destroy what was created. NULL if allocation fails.
+ */
+static Worker *create_worker(HTTPServer *self, int id, int cpu, int node, int *status)
+{
+    if (cpu >= 0 && node >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        numa_prefer_node(node);
+    }
+
+    Worker *worker = aligned_alloc(_Alignof(Worker), sizeof(Worker));
+    if (!worker)
+    {
+        *status = -1;
+        return NULL;
+    }
+    memset(worker, 0, sizeof(Worker));
+    worker->id               = id;
+    worker->cpu              = cpu;
+    worker->node             = node;
+    worker->httpserver       = self;
+    worker->epoll_fd         = -1;
+    worker->cache.inotify_fd = -1;
+    worker->mailbox.wake_fd  = -1;
+
+    *status = worker_init(worker);
+    return worker;
+}
+
+/**
+ * @brief   HTTP/1.1 connections persist unless the client sends
+ *          "Connection: close", HTTP/1.0 ones only with "keep-alive".
+ */
+static int request_keep_alive(const HTTPRequest *req)
+{
+    int keep_alive = req->request_line.protocol_len == 8 &&
+                     strncmp(req->request_line.protocol, "HTTP/1.1", 8) == 0;
+
+    const HTTPHeader *header = get_http_header(req, HDR_CONNECTION);
+    if (header && header->value_len == 5 && strncasecmp(header->value, "close", 5) == 0)
+        keep_alive = 0;
+    else if (header && header->value_len == 10 && strncasecmp(header->value, "keep-alive", 10) == 0)
+        keep_alive = 1;
+    return keep_alive;
+}
+
+/**
+ * @brief   Drops requests already answered from the front of the buffer.
+ */
+static void compact_input(Connection *conn)
+{
+    if (conn->request_start == 0) return;
+
+    uintptr_t old_base = (uintptr_t)(conn->buffer + conn->request_start);
+    memmove(conn->buffer, conn->buffer + conn->request_start, conn->len - conn->request_start);
+    conn->len -= conn->request_start;
+    conn->request_start = 0;
+    rebase_http_request(&conn->request, old_base, conn->buffer);
+}
+
+/**
+ * @brief   Grows the buffer until @p extra more bytes and the terminating NUL
+ *          fit, but not past @p limit bytes.
+ *
+ * @returns OK, 1 if the buffer is full at @p limit, or -1 if it could not
+ *          grow and the connection was closed.
+ */
+static int reserve_input(Worker *self, Connection *conn, size_t extra, size_t limit)
+{
+    while (conn->len + extra + 1 > conn->buffer_size)
+    {
+        if (conn->buffer_size >= limit) return 1;
+
+        uintptr_t old_base = (uintptr_t)conn->buffer;
+        size_t new_size    = conn->buffer_size * 2 < limit ? conn->buffer_size * 2 : limit;
+        char *new_buffer   = realloc(conn->buffer, new_size);
+        if (!new_buffer)
+        {
+            LOG(ERROR, "Failed to reallocate buffer for FD %d.", conn->socket);
+            close_connection(self, conn);
+            return -1;
+        }
+        conn->buffer      = new_buffer;
+        conn->buffer_size = new_size;
+
+        // Request line and headers parsed so far point into the old buffer
+        rebase_http_request(&conn->request, old_base, conn->buffer);
+    }
+    return OK;
+}
+
+/**
+ * @brief   Handles every complete request after new input arrived.
+ *
+ * @param   peer_closed  The client won't send more: answer what is
+ *                       complete, then close.
+ */
+static void finish_input(Worker *self, Connection *conn, int peer_closed)
+{
+    conn->buffer[conn->len] = '\0';
+
+    if (process_requests(self, conn) < 0) return;
+
+    if (peer_closed)
+    {
+        // Nothing more will arrive: answer what is complete, then close.
+        // A body cut short leaves nothing to answer.
+        conn->keep_alive = 0;
+        if (conn->phase == CONN_READING ||
+            (conn->body_streaming && conn->parser.state != PARSE_DONE))
+            close_connection(self, conn);
+        return;
+    }
+
+    refresh_deadline(self, conn);
+}
+
+/**
+ * @brief   Answers a request that can't be handled with a canned error and
+ *          closes the connection after it, as the rest of the input can't be
+ *          framed.
+ *
+ * @returns OK while the connection is alive, -1 if it was closed.
+ */
+static int reject_request(Worker *self, Connection *conn, int status_code)
+{
+    conn->keep_alive = 0;
+    conn->phase      = CONN_WRITING;
+    conn->request_us = monotonic_us();
+    if (queue_canned(conn, status_code) < 0)
+    {
+        close_connection(self, conn);
+        return -1;
+    }
+    conn->processing = 0;
+    return flush_connection(self, conn);
+}
+
+/**
+ * @brief   Passes the body bytes buffered after the request head to
+ *          conn->on_body and drops what it took.
+ *
+ * The head stays at request_start for the handler and the access log, the
+ * body is offered right after it: first the bytes offered before and not
+ * taken, then the ones parsed since. What the handler takes is removed from
+ * the buffer at once, so a body never occupies more than one buffer.
+ *
+ * @returns OK while the connection is alive, -1 if it was closed.
+ */
+static int stream_body(Worker *self, Connection *conn)
+{
+    const Config *cfg = self->config->cfg;
+    size_t body_at    = conn->request_start + conn->parser.parsed;
+
+    while (conn->body_streaming && !conn->body_blocked)
+    {
+        char *body      = conn->buffer + body_at;
+        size_t ready    = conn->body_pending;
+        size_t consumed = 0;
+
+        if (conn->parser.state == PARSE_BODY && conn->len > body_at + ready)
+        {
+            size_t decoded = 0;
+            long n = parse_request_body(&conn->parser, body + ready, conn->len - body_at - ready,
+                                        !conn->body_raw, &decoded);
+            if (n < 0 ||
+                (cfg->max_body_size > 0 && conn->parser.body_received > cfg->max_body_size))
+            {
+                // The handler already runs, the client can't get an error anymore
+                LOG(ERROR, "Client FD %d sent a malformed or oversized body.", conn->socket);
+                close_connection(self, conn);
+                return -1;
+            }
+            consumed = (size_t)n;
+            ready += decoded;
+        }
+
+        int last = conn->parser.state == PARSE_DONE;
+        if (ready == 0 && !last) break; // wait for more
+
+        long taken = conn->on_body(self, conn, body, ready, last);
+        if (taken < 0)
+        {
+            close_connection(self, conn);
+            return -1;
+        }
+        if (conn->socket <= 0) return -1; // the handler gave up on the client
+        if (!conn->body_streaming) break; // nor does it want the rest
+
+        // Keep what wasn't taken, then the bytes not parsed yet
+        size_t pending = ready - (size_t)taken;
+        size_t rest_at = body_at + conn->body_pending + consumed;
+        memmove(body, body + taken, pending);
+        memmove(body + pending, conn->buffer + rest_at, conn->len - rest_at);
+        conn->len -= rest_at - body_at - pending;
+        conn->buffer[conn->len] = '\0';
+        conn->body_pending      = pending;
+
+        if (pending > 0)
+            conn->body_blocked = 1;
+        else if (last)
+        {
+            conn->body_streaming = 0;
+            timerwheel_cancel(&conn->timer);
+            conn->deadline = DEADLINE_NONE;
+        }
+    }
+
+    update_connection_events(self, conn);
+    return OK;
+}
+
+/**
+ * @brief   Body handler of requests whose handler ignores the body, it is
+ *          received and dropped so the connection can be kept alive.
+ */
+static long discard_body(Worker *self, Connection *conn, const char *data, size_t len, int last)
+{
+    (void)self;
+    (void)conn;
+    (void)data;
+    (void)last;
+    return (long)len;
+}
+
+/**
+ * @brief   Arms the connection's timer for @p deadline, or stops it if that
+ *          timeout is disabled.
+ */
+static void set_deadline(Worker *self, Connection *conn, ConnDeadline deadline)
+{
+    const Config *cfg = self->config->cfg;
+    int seconds       = 0;
+
+    if (deadline == DEADLINE_IDLE) seconds = cfg->idle_timeout;
+    if (deadline == DEADLINE_HEADER) seconds = cfg->header_timeout;
+    if (deadline == DEADLINE_BODY) seconds = cfg->body_timeout;
+
+    conn->deadline = deadline;
+    if (seconds > 0)
+        timerwheel_arm(&self->timers, &conn->timer, (uint64_t)seconds * 1000);
+    else
+        timerwheel_cancel(&conn->timer);
+}
+
+/**
+ * @brief   Picks the read deadline after input arrived or a response
+ *          finished. A request head has to complete within header_timeout
+ *          of its first byte however slowly it trickles in, while a body
+ *          only has to keep moving.
+ */
+static void refresh_deadline(Worker *self, Connection *conn)
+{
+    if (conn->body_streaming)
+    {
+        // A body held up by its handler is not the client's fault
+        if (!conn->body_blocked)
+            set_deadline(self, conn, DEADLINE_BODY);
+        else if (conn->deadline != DEADLINE_NONE)
+            set_deadline(self, conn, DEADLINE_NONE);
+        return;
+    }
+    if (conn->phase != CONN_READING) return;
+
+    if (conn->parser.state == PARSE_BODY)
+        set_deadline(self, conn, DEADLINE_BODY);
+    else if (conn->request_start < conn->len || conn->deadline == DEADLINE_HEADER)
+    {
+        if (conn->deadline != DEADLINE_HEADER) set_deadline(self, conn, DEADLINE_HEADER);
+    }
+    else if (conn->deadline != DEADLINE_IDLE)
+        set_deadline(self, conn, DEADLINE_IDLE);
+}
+
+/**
+ * @brief   Timer wheel callback: a connection that sent nothing is just
+ *          closed, an unfinished request gets a 408 first.
+ */
+static void expire_connection(TimerNode *node, void *arg)
+{
+    Worker *self     = arg;
+    Connection *conn = (Connection *)((char *)node - offsetof(Connection, timer));
+
+    ConnDeadline deadline = conn->deadline;
+    conn->deadline        = DEADLINE_NONE;
+    if (conn->socket <= 0) return;
+
+    // The request is being answered already, too late for a 408
+    if (conn->body_streaming)
+    {
+        LOG(INFO, "Client FD %d timed out sending the request body.", conn->socket);
+        close_connection(self, conn);
+        return;
+    }
+    if (conn->phase != CONN_READING) return;
+
+    if (deadline == DEADLINE_IDLE || conn->request_start >= conn->len)
+    {
+        LOG(DEBUG, "Client FD %d idle for too long, closing.", conn->socket);
+        close_connection(self, conn);
+        return;
+    }
+
+    LOG(INFO, "Client FD %d timed out reading the request %s.", conn->socket,
+        deadline == DEADLINE_BODY ? "body" : "head");
+    conn->keep_alive = 0;
+    conn->phase      = CONN_WRITING;
+    conn->request_us = monotonic_us();
+    if (queue_canned(conn, 408) < 0)
+    {
+        close_connection(self, conn);
+        return;
+    }
+    flush_connection(self, conn);
+}
+
+/**
+ * @brief   Counts and logs the request being answered, once: after its last
+ *          byte is sent, or when the connection closes before that.
+ */
+static void finish_request(Worker *self, Connection *conn, int aborted)
+{
+    if (conn->request_us > 0)
+    {
+        stats_request(&self->stats, conn);
+        accesslog_request(self, conn, aborted);
+    }
+    worker_config_release(self, conn); // its backends may go with a replaced config
+}
+
+/**
+ * @brief   Queues the body-less redirect of a ROUTE_REDIRECT match.
+ */
+static int redirect_handler(Connection *conn, const Route *route, const RouteMatch *match)
+{
+    const char *phrase;
+    switch (route->status)
+    {
+    case 301:
+        phrase = "Moved Permanently";
+        break;
+    case 302:
+        phrase = "Found";
+        break;
+    case 303:
+        phrase = "See Other";
+        break;
+    case 307:
+        phrase = "Temporary Redirect";
+        break;
+    default:
+        phrase = "Permanent Redirect";
+        break;
+    }
+
+    char *location    = router_redirect_location(&conn->arena, route, match);
+    HTTPResponse *res = httpresponse_start(&conn->arena, route->status, phrase);
+    if (!location || !res || httpresponse_add_header(res, "Location", location) < 0) return -1;
+
+    return queue_response(conn, res);
+}
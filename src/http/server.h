@@ -9,45 +9,211 @@
 #ifndef HTTPSERVER_H
 #define HTTPSERVER_H
 
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include "sock/server.h"
 #include "parsers.h"
 #include "common.h"
 #include "request.h"
+#include "utils/config.h"
+#include "backend.h"
+#include "balancer.h"
+#include "filecache.h"
+#include "proxycache.h"
+#include "router.h"
+#include "lifecycle.h"
+#include "output.h"
+#include "connpool.h"
+#include "accesslog.h"
+#include "canned.h"
+#include "stats.h"
+#include "utils/arena.h"
+#include "utils/timerwheel.h"
+
+/**
+ * @brief   Tag stored as the first member of everything registered in a
+ *          worker's epoll instance, so events can be dispatched by type.
+ */
+typedef enum
+{
+    EV_LISTENER,
+    EV_CLIENT,
+    EV_UPSTREAM,
+    EV_INOTIFY,
+    EV_MAILBOX
+} EventKind;
+
+typedef enum
+{
+    CONN_READING,  // waiting for (the rest of) a request
+    CONN_PROXYING, // request handed to an upstream, waiting for its response
+    CONN_WRITING   // response complete, flushing output
+} ConnPhase;
+
+/**
+ * @brief   Which read deadline a connection's timer enforces.
+ */
+typedef enum
+{
+    DEADLINE_NONE,   // not reading, or the timeout is disabled
+    DEADLINE_IDLE,   // keep-alive, waiting for the next request
+    DEADLINE_HEADER, // receiving a request head, counted from its first byte
+    DEADLINE_BODY    // receiving a request body, restarted by every read
+} ConnDeadline;
+
+struct Upstream;
+struct Uring;
+struct Worker;
+struct Connection;
+
+/**
+ * @brief   Receives the next slice of a request body streamed through the
+ *          connection's input buffer. @p last is set on the slice ending it.
+ *
+ * @returns Bytes taken from the front of @p data, -1 to close the connection.
+ *          Taking fewer pauses reading from the client until resume_body().
+ */
+typedef long (*BodyHandler)(struct Worker *self, struct Connection *conn, const char *data,
+                            size_t len, int last);
 
 typedef struct Connection
 {
-    int socket;          // client socket
-    char *buffer;        // dynamic buffer for request
-    size_t buffer_size;  // allocated size for buffer
-    size_t len;          // current data length of buffer
-    size_t parsed_bytes; // bytes parsed
-    ParseState state;    // parsing state
-    HTTPRequest request; // parsed request
-} Connection;
+    EventKind kind;               // EV_CLIENT, must stay the first member
+    int socket;                   // client socket
+    char *buffer;                 // dynamic buffer for request
+    size_t buffer_size;           // allocated size for buffer
+    size_t len;                   // current data length of buffer
+    size_t request_start;         // offset of the request being parsed in buffer
+    RequestParser parser;         // progress parsing the current request
+    int processing;               // inside process_requests(), guards re-entry
+    HTTPRequest request;          // parsed request
+    Arena arena;                  // per-request allocations, reset with the connection
+    ConnPhase phase;              // lifecycle phase
+    int keep_alive;               // keep socket open after the response
+    uint32_t events;              // epoll events currently registered
+    OutputQueue out;              // pending response segments
+    struct Upstream *upstream;    // in-flight proxied request, if any
+    struct Connection *next_free; // free list link while the slot is unused
+    uint16_t generation;          // bumped per reuse of the slot, tags io_uring completions
+    uint8_t ring_state;           // io_uring operations in flight (RING_* flags)
+    uint8_t deadline;             // ConnDeadline the timer is armed for
+    TimerNode timer;              // read deadline in the worker's timer wheel
+    uint64_t request_us;          // monotonic us the current request was complete, 0 = none
+    int status;                   // status code of the response being sent
+    Backend *backend;             // backend that answered a proxied request
+    uint32_t upstream_us;         // time the backend took for it
+    uint64_t parse_ns;            // parser time spent on the current request so far
+    BodyHandler on_body;          // takes the request body, the handler may replace it
+    int body_raw;                 // on_body wants a chunked body with its framing
+    int body_streaming;           // request dispatched, its body still coming in
+    int body_blocked;             // on_body took less than offered, reading paused
+    size_t body_pending;          // bytes offered to on_body but not taken, after the head
+    ProxyCacheFill *cache_fill;   // cache fetch the request waits for, if any
+    struct Connection *wait_next; // next request waiting for the same fetch
+    WorkerConfig *config;         // config the current request runs under
+    const Route *route;           // route the current request matched
+    const char *route_path;       // its path below a wildcard route's prefix, and the query
+    size_t route_path_len;
+} __attribute__((aligned(CACHE_LINE_SIZE))) Connection;
 
 int init_connection(Connection *conn, int client_fd, int epoll_fd);
 int free_connection(Connection *conn, int client_fd, int epoll_fd);
 int reset_connection(Connection *conn);
 
+/**
+ * @brief   One event loop. Every worker owns its listener, epoll instance,
+ *          connection pool, caches, backend pools and stats, so workers never
+ *          share state on the hot path. Each is allocated on its own, on the
+ *          worker's NUMA node with numa=on, and other threads only reach it
+ *          through its mailbox.
+ */
+typedef struct Worker
+{
+    int id;                            // worker index
+    int cpu;                           // CPU to pin the thread to, -1 = no pinning
+    int node;                          // NUMA node its memory comes from, -1 = any
+    pthread_t thread;                  // thread running worker_loop()
+    struct HTTPServer *httpserver;     // owning HTTP server
+    SocketServer *server;              // SO_REUSEPORT listener
+    EventKind listener_kind;           // epoll tag of the listener
+    uint32_t epoll_flags;              // EPOLLET for client sockets in edge-triggered mode
+    ConnectionPool connections;        // client connection slots
+    size_t active_count;               // connections in use
+    int epoll_fd;                      // epoll instance
+    struct Upstream *closed_upstreams; // upstreams to free after the current batch
+    WorkerConfig *config;              // backends and routes new requests run under
+    WorkerConfig *retired;             // replaced configs requests still run under
+    unsigned generation;               // newest ServerConfig generation seen
+    int draining;                      // DrainMode the worker is in
+    uint64_t drain_deadline;           // monotonic ms remaining connections get closed at
+    uint64_t last_maintenance;         // monotonic ms of the last pool sweep
+    FileCache cache;                   // hot static files
+    EventKind cache_kind;              // epoll tag of the cache's inotify fd
+    ProxyCache proxy_cache;            // cacheable proxied responses
+    struct Uring *ring;                // io_uring backend, NULL when epoll drives clients
+    TimerWheel timers;                 // client read deadlines
+    AccessLog access_log;              // sampling state of the access log
+    WorkerStats stats;                 // counters and histograms for /__stats
+    EventKind mailbox_kind;            // epoll tag of the mailbox's eventfd
+    Mailbox mailbox;                   // config swaps and purges from other threads
+} Worker;
+
+int worker_init(Worker *self);
+void *worker_loop(void *arg);
+void worker_destroy(Worker *self);
+
+void handle_epoll_events(Worker *self, int timeout_ms);
+int end_worker_batch(Worker *self);
+void accept_connection(Worker *self);
+void add_client(Worker *self, int client_fd, const struct sockaddr_in *client_addr);
+void handle_client_event(Worker *self, Connection *conn, uint32_t events);
+void read_request(Worker *self, Connection *conn);
+void receive_input(Worker *self, Connection *conn, const char *data, size_t len);
+void receive_eof(Worker *self, Connection *conn);
+int process_requests(Worker *self, Connection *conn);
+int connection_reading(const Connection *conn);
+void resume_body(Worker *self, Connection *conn);
+void abandon_body(Worker *self, Connection *conn);
+void close_connection(Worker *self, Connection *conn);
+int queue_output(Connection *conn, const char *data, size_t len);
+int queue_response(Connection *conn, HTTPResponse *response);
+int queue_canned(Connection *conn, int status_code);
+int queue_file(Connection *conn, int fd, off_t offset, size_t length);
+int has_pending_output(const Connection *conn);
+int flush_connection(Worker *self, Connection *conn);
+void update_connection_events(Worker *self, Connection *conn);
+void maintain_worker(Worker *self);
+
 typedef struct HTTPServer
 {
-    SocketServer *server;
-    Connection *connections;
-    size_t active_count;
-    int epoll_fd;
+    int port;
+    Worker **workers; // allocated one by one, so no two share a cache line
+    int worker_count;
+    int cpu_affinity;
+    int numa; // place workers and their memory node by node
 
     char *static_dir;
-    char **proxy_backends;
-    int backend_count;
+    char *static_root; // resolved BASE_DIR that /static paths are appended to
+
+    Config *config;              // startup config, for the settings a reload can't change
+    ServerConfig *startup;       // owns config
+    ServerConfig *current;       // newest config, posted to every worker
+    int draining;                // DrainMode requested by the supervisor
+    int running;                 // worker threads that haven't exited
+
+    int *listen_fds;      // listeners inherited from the old binary, -1 once taken
+    int listen_fd_count;  // entries in listen_fds
+    pid_t upgrade_parent; // old binary to drain once the workers run, 0 = none
+    pid_t upgrade_pid;    // new binary started by SIGUSR2 until it takes over or exits
+    char *exe_path;       // binary SIGUSR2 starts, resolved at startup
 
     int (*launch)(struct HTTPServer *self);
 } HTTPServer;
 
-HTTPResponse *request_handler(HTTPRequest *request_ptr);
-int connect_to_backend(const char *host, const char *port);
+int request_handler(Worker *self, Connection *conn);
 
-HTTPServer *httpserver_constructor(int port, char *static_dir, char **proxy_backends,
-                                   int backend_count);
+HTTPServer *httpserver_constructor(Config *cfg);
 void httpserver_destructor(HTTPServer *httpserver_ptr);
 
 #endif
@@ -0,0 +1,803 @@
+/**
+ * @file    static.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Static file handler implementations.
+ *
+ * @details Small, hot files are kept in the worker's FileCache together with
+ *          their response head and are queued by reference, not copied.
+ *          Everything else only has its head formatted in memory, the body
+ *          is left in the page cache and sent by flush_connection() with
+ *          sendfile(), resuming on EPOLLOUT, so file size doesn't affect
+ *          heap usage.
+ *
+ *          Conditional requests get 304 from the validators the cache or
+ *          fstat() already has, and ranges are cut from the same cached
+ *          bytes or file by reference, as one part or multipart/byteranges.
+ *
+ *          With a static_bundle, paths below the directory it was packed
+ *          from are answered from its mapping alone, the same way as cache
+ *          hits: no filesystem call at all.
+ */
+
+#include <sys/mman.h>
+#include "bundle.h"
+#include "conditional.h"
+#include "static.h"
+#include "utils/compress.h"
+
+/**
+ * @brief   A version of the requested file a response can be made from.
+ */
+typedef struct StaticVariant
+{
+    const char *suffix; // appended to the file path, "" for the file itself
+    int encoding;       // ContentEncoding of the response
+} StaticVariant;
+
+/**
+ * @brief   The representation a request is answered with, cached or open.
+ */
+typedef struct StaticFile
+{
+    const char *mime;
+    int encoding;      // ContentEncoding of the body
+    int transformed;   // body was compressed here from the file, it has its own ETag
+    int vary;          // body depends on Accept-Encoding
+    ino_t ino;         // file the body is, or was made from
+    off_t file_size;
+    time_t mtime;
+    size_t size;       // body bytes
+    const char *etag;  // precomputed entity tag, or NULL to derive it
+    const char *data;  // head of a 200 followed by the body, NULL if not in memory
+    size_t head_len;   // bytes of data that are the head
+    CacheEntry *entry; // cache entry data belongs to, NULL for the bundle
+    int fd;            // body, when not in memory; owned until a response is queued
+} StaticFile;
+
+static int static_bundle_serve(Connection *conn, const Bundle *bundle, const char *path,
+                               size_t path_len);
+static int static_serve(Worker *self, Connection *conn, const char *path, size_t path_len,
+                        size_t suffix_len, int fd, const struct stat *st, const char *mime,
+                        int encoding, int vary);
+static CacheEntry *static_compress(Worker *self, const char *path, size_t path_len, int fd,
+                                   const struct stat *st, const char *mime);
+static void static_file_open(StaticFile *file, int fd, const struct stat *st, const char *mime,
+                             int encoding, int vary);
+static void static_file_cached(StaticFile *file, CacheEntry *entry, const char *mime,
+                               int transformed, int vary);
+static int static_respond(Connection *conn, StaticFile *file);
+static int static_respond_whole(Connection *conn, StaticFile *file);
+static int static_respond_ranges(Connection *conn, StaticFile *file, const ByteRange *ranges,
+                                 int count);
+static int static_respond_status(Connection *conn, StaticFile *file, int status_code,
+                                 const char *phrase);
+static int static_queue_slice(Connection *conn, const StaticFile *file, size_t start,
+                              size_t length);
+static int static_head(char *head, size_t capacity, const StaticFile *file);
+static int static_add_validators(HTTPResponse *res, const StaticFile *file);
+static size_t static_etag(char *etag, const StaticFile *file);
+static void static_last_modified(char *date, size_t capacity, time_t mtime);
+static int static_open_sibling(const char *path, struct stat *st);
+static unsigned static_siblings(const Worker *self, const char *path, size_t path_len);
+static int static_qvalue_zero(const char *params, const char *end);
+static int static_path_safe(const char *path, size_t len);
+
+/**
+ * @brief   Serves a file under BASE_DIR for a /static request, or under the
+ *          directory of the static route the request matched.
+ *
+ * Files up to static_cache_max_file are answered from the worker's cache,
+ * larger ones and cache misses that don't fit are sent with sendfile().
+ *
+ * Text files are content negotiated: a client accepting br or gzip gets
+ * a precompressed file.br or file.gz sibling if there is one, or, with
+ * static_compress, a gzipped copy made once and kept in the cache. Those
+ * responses all carry "Vary: Accept-Encoding".
+ *
+ * @returns OK once a response is queued, -1 on internal error.
+ */
+int static_file_handler(Worker *self, Connection *conn)
+{
+    const Config *cfg        = conn->config->cfg;
+    HTTPRequest *request_ptr = &conn->request;
+    const char *uri          = request_ptr->request_line.uri;
+    size_t uri_len           = request_ptr->request_line.uri_len;
+
+    // Query string doesn't name a different file
+    const char *query = memchr(uri, '?', uri_len);
+    if (query) uri_len = query - uri;
+
+    if (!static_path_safe(uri, uri_len)) return queue_canned(conn, 404);
+
+    // A route with its own directory maps the path below its prefix into it
+    const char *root     = self->httpserver->static_root;
+    const Bundle *bundle = &conn->config->shared->bundle;
+    if (conn->route && conn->route->target)
+    {
+        root    = conn->route->target;
+        uri_len = uri_len - (conn->route_path - uri);
+        uri     = conn->route_path;
+    }
+    else if (bundle_covers(bundle, uri, uri_len))
+    {
+        return static_bundle_serve(conn, bundle, uri, uri_len);
+    }
+
+    // Room for a ".br" or ".gz" suffix behind the path
+    char filepath[PATH_MAX];
+    int path_len = snprintf(filepath, sizeof(filepath), "%s%.*s", root, (int)uri_len, uri);
+    if (path_len < 0 || (size_t)path_len + 3 >= sizeof(filepath))
+    {
+        LOG(ERROR, "Failed to build filepath.");
+        return queue_canned(conn, 404);
+    };
+
+    const char *mime  = get_mime_type(filepath);
+    int negotiate     = (cfg->static_precompressed || cfg->static_compress) &&
+                        static_compressible(mime);
+    unsigned accepted = 0;
+    if (negotiate)
+        accepted = static_accepted_encodings(get_http_header(request_ptr, HDR_ACCEPT_ENCODING));
+
+    // Most preferred first, the file itself is always acceptable
+    StaticVariant variants[4];
+    int count = 0;
+    if (cfg->static_precompressed && (accepted & ENC_BIT(ENC_BR)))
+        variants[count++] = (StaticVariant){".br", ENC_BR};
+    if (cfg->static_precompressed && (accepted & ENC_BIT(ENC_GZIP)))
+        variants[count++] = (StaticVariant){".gz", ENC_GZIP};
+    int on_the_fly = cfg->static_compress && (accepted & ENC_BIT(ENC_GZIP));
+    if (on_the_fly) variants[count++] = (StaticVariant){"", ENC_GZIP};
+    variants[count++] = (StaticVariant){"", ENC_IDENTITY};
+
+    // Any cached variant first, so a hit costs no system call. A variant
+    // only answers if no preferred sibling was found when it was cached
+    unsigned missed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        size_t suffix_len = strlen(variants[i].suffix);
+        memcpy(filepath + path_len, variants[i].suffix, suffix_len + 1);
+
+        CacheEntry *entry = filecache_lookup(&self->cache, filepath, path_len + suffix_len,
+                                             variants[i].encoding);
+        if (entry && (entry->siblings & missed) == 0)
+        {
+            self->cache.hits++;
+            StaticFile file;
+            static_file_cached(&file, entry, mime,
+                               suffix_len == 0 && variants[i].encoding != ENC_IDENTITY, negotiate);
+            return static_respond(conn, &file);
+        }
+        if (suffix_len > 0) missed |= ENC_BIT(variants[i].encoding);
+    }
+    self->cache.misses++;
+
+    struct stat st;
+    for (int i = 0; i < count && variants[i].suffix[0]; i++)
+    {
+        size_t suffix_len = strlen(variants[i].suffix);
+        memcpy(filepath + path_len, variants[i].suffix, suffix_len + 1);
+
+        int fd = static_open_sibling(filepath, &st);
+        if (fd >= 0)
+            return static_serve(self, conn, filepath, path_len + suffix_len, suffix_len, fd, &st,
+                                mime, variants[i].encoding, 1);
+    }
+    filepath[path_len] = '\0';
+
+    int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        LOG(ERROR, "Failed to open file.");
+        return queue_canned(conn, 404);
+    }
+
+    // Get file size
+    if (fstat(fd, &st) < 0)
+    {
+        LOG(ERROR, "Failed to stat file.");
+        close(fd);
+        return queue_canned(conn, 500);
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return queue_canned(conn, 404);
+    }
+
+    if (on_the_fly && st.st_size >= STATIC_COMPRESS_MIN)
+    {
+        CacheEntry *entry = static_compress(self, filepath, path_len, fd, &st, mime);
+        if (entry)
+        {
+            close(fd);
+            StaticFile file;
+            static_file_cached(&file, entry, mime, 1, 1);
+            return static_respond(conn, &file);
+        }
+    }
+
+    return static_serve(self, conn, filepath, path_len, 0, fd, &st, mime, ENC_IDENTITY, negotiate);
+}
+
+/**
+ * @brief   Answers from the bundle, which has every file below the directory
+ *          it was packed from: a path it lacks is a 404. Variants follow the
+ *          same preference and settings as files on disk.
+ *
+ * @returns OK once a response is queued, -1 on internal error.
+ */
+static int static_bundle_serve(Connection *conn, const Bundle *bundle, const char *path,
+                               size_t path_len)
+{
+    const Config *cfg      = conn->config->cfg;
+    const BundleFile *item = bundle_lookup(bundle, path, path_len);
+    if (!item) return queue_canned(conn, 404);
+
+    unsigned accepted = 0;
+    if (item->vary && (cfg->static_precompressed || cfg->static_compress))
+        accepted = static_accepted_encodings(get_http_header(&conn->request, HDR_ACCEPT_ENCODING));
+
+    static const int preferred[] = {ENC_BR, ENC_GZIP};
+    const BundleVariant *variant = &item->variants[ENC_IDENTITY];
+    int encoding                 = ENC_IDENTITY;
+    for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]); i++)
+    {
+        const BundleVariant *candidate = &item->variants[preferred[i]];
+        if (candidate->offset && (accepted & ENC_BIT(preferred[i])) &&
+            (candidate->transformed ? cfg->static_compress : cfg->static_precompressed))
+        {
+            variant  = candidate;
+            encoding = preferred[i];
+            break;
+        }
+    }
+
+    StaticFile file;
+    file.mime        = bundle->map + item->mime;
+    file.encoding    = encoding;
+    file.transformed = variant->transformed;
+    file.vary        = item->vary;
+    file.ino         = variant->ino;
+    file.file_size   = variant->body_len;
+    file.mtime       = variant->mtime;
+    file.size        = variant->body_len;
+    file.etag        = variant->etag;
+    file.data        = bundle->map + variant->offset;
+    file.head_len    = variant->head_len;
+    file.entry       = NULL;
+    file.fd          = -1;
+    return static_respond(conn, &file);
+}
+
+/**
+ * @brief   Serves the open file @p fd as is, from the cache if it fits or
+ *          with sendfile(). Takes ownership of @p fd.
+ *
+ * @param   suffix_len  Length of the ".br" or ".gz" on @p path, 0 for none.
+ * @param   encoding    Content coding the file is in, ENC_IDENTITY for none.
+ * @param   vary        Whether the response depends on Accept-Encoding.
+ *
+ * @returns OK once a response is queued, -1 on internal error.
+ */
+static int static_serve(Worker *self, Connection *conn, const char *path, size_t path_len,
+                        size_t suffix_len, int fd, const struct stat *st, const char *mime,
+                        int encoding, int vary)
+{
+    StaticFile file;
+    static_file_open(&file, fd, st, mime, encoding, vary);
+
+    char head[STATIC_HEAD_SIZE];
+    int head_len = static_head(head, sizeof(head), &file);
+    if (head_len < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    CacheEntry *entry = filecache_insert(&self->cache, path, path_len, encoding, fd, st, head,
+                                         head_len);
+    if (entry)
+    {
+        close(fd);
+        if (vary) entry->siblings = static_siblings(self, path, path_len - suffix_len);
+        LOG(DEBUG, "Cached %s (%zu bytes).", path, file.size);
+        static_file_cached(&file, entry, mime, 0, vary);
+    }
+    else
+    {
+        LOG(DEBUG, "Serving %s (%zu bytes).", path, file.size);
+    }
+
+    return static_respond(conn, &file);
+}
+
+/**
+ * @brief   Gzips the open file @p fd into a new cache entry. Only files the
+ *          cache can hold are compressed, so each version is compressed once.
+ *
+ * @returns The entry, NULL if the file isn't cacheable or compression fails.
+ */
+static CacheEntry *static_compress(Worker *self, const char *path, size_t path_len, int fd,
+                                   const struct stat *st, const char *mime)
+{
+    size_t filesize = st->st_size;
+    if (self->cache.budget == 0 || filesize > self->cache.max_file) return NULL;
+
+    void *data = mmap(NULL, filesize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return NULL;
+
+    size_t gz_len;
+    char *gz = gzip_compress(data, filesize, &gz_len);
+    munmap(data, filesize);
+    if (!gz)
+    {
+        LOG(ERROR, "Failed to compress %s.", path);
+        return NULL;
+    }
+
+    StaticFile file;
+    static_file_open(&file, fd, st, mime, ENC_GZIP, 1);
+    file.transformed = 1;
+    file.size        = gz_len;
+
+    CacheEntry *entry = NULL;
+    char head[STATIC_HEAD_SIZE];
+    int head_len = static_head(head, sizeof(head), &file);
+    if (head_len >= 0)
+        entry = filecache_insert_data(&self->cache, path, path_len, ENC_GZIP, st, head, head_len,
+                                      gz, gz_len);
+    free(gz);
+    if (!entry) return NULL;
+
+    entry->siblings = static_siblings(self, path, path_len);
+    LOG(DEBUG, "Compressed %s (%zu to %zu bytes).", path, filesize, gz_len);
+    return entry;
+}
+
+static void static_file_open(StaticFile *file, int fd, const struct stat *st, const char *mime,
+                             int encoding, int vary)
+{
+    file->mime        = mime;
+    file->encoding    = encoding;
+    file->transformed = 0;
+    file->vary        = vary;
+    file->ino         = st->st_ino;
+    file->file_size   = st->st_size;
+    file->mtime       = st->st_mtim.tv_sec;
+    file->size        = st->st_size;
+    file->etag        = NULL;
+    file->data        = NULL;
+    file->head_len    = 0;
+    file->entry       = NULL;
+    file->fd          = fd;
+}
+
+static void static_file_cached(StaticFile *file, CacheEntry *entry, const char *mime,
+                               int transformed, int vary)
+{
+    file->mime        = mime;
+    file->encoding    = entry->encoding;
+    file->transformed = transformed;
+    file->vary        = vary;
+    file->ino         = entry->ino;
+    file->file_size   = entry->size;
+    file->mtime       = entry->mtime.tv_sec;
+    file->size        = entry->body_len;
+    file->etag        = NULL;
+    file->data        = entry->data;
+    file->head_len    = entry->head_len;
+    file->entry       = entry;
+    file->fd          = -1;
+}
+
+/**
+ * @brief   Answers with @p file: 304 if the client's copy is current, 206 or
+ *          416 for a Range request, the whole body otherwise. Requests
+ *          without any of those headers go straight to the whole body.
+ *
+ * @returns OK once a response is queued, -1 on internal error.
+ */
+static int static_respond(Connection *conn, StaticFile *file)
+{
+    const HTTPRequest *req = &conn->request;
+    if (!req->known[HDR_IF_NONE_MATCH] && !req->known[HDR_IF_MODIFIED_SINCE] &&
+        !req->known[HDR_RANGE])
+        return static_respond_whole(conn, file);
+
+    char etag[STATIC_ETAG_SIZE];
+    Validators validators = {etag, static_etag(etag, file), file->mtime};
+
+    if (request_not_modified(req, &validators))
+        return static_respond_status(conn, file, 304, "Not Modified");
+
+    ByteRange ranges[RANGES_MAX];
+    int count = request_ranges(req, &validators, file->size, ranges);
+    if (count < 0) return static_respond_status(conn, file, 416, "Range Not Satisfiable");
+    if (count > 0) return static_respond_ranges(conn, file, ranges, count);
+
+    return static_respond_whole(conn, file);
+}
+
+/**
+ * @brief   Queues a 200 response. One in memory is queued by reference: a
+ *          cache entry stays alive until it is sent, even if it's evicted
+ *          meanwhile, the bundle as long as the request's config.
+ */
+static int static_respond_whole(Connection *conn, StaticFile *file)
+{
+    if (file->data)
+    {
+        if (file->entry) filecache_retain(file->entry);
+        return output_append_shared(&conn->out, file->data, file->head_len + file->size,
+                                    file->entry ? filecache_release : NULL, file->entry);
+    }
+
+    char head[STATIC_HEAD_SIZE];
+    int head_len = static_head(head, sizeof(head), file);
+    if (head_len < 0 || queue_output(conn, head, head_len) < 0)
+    {
+        close(file->fd);
+        return -1;
+    }
+
+    if (file->size == 0)
+    {
+        close(file->fd);
+        return OK;
+    }
+    return queue_file(conn, file->fd, 0, file->size);
+}
+
+/**
+ * @brief   Queues a 206 response with @p ranges of the body, one range as
+ *          is and several as multipart/byteranges. The parts reference the
+ *          cached body or the file, nothing is copied.
+ */
+static int static_respond_ranges(Connection *conn, StaticFile *file, const ByteRange *ranges,
+                                 int count)
+{
+    char content_range[64];
+    char *parts[RANGES_MAX + 1];
+    size_t part_lens[RANGES_MAX + 1];
+    size_t content_length = 0;
+    int status            = -1;
+
+    HTTPResponse *res = httpresponse_start(&conn->arena, 206, "Partial Content");
+    if (!res || static_add_validators(res, file) < 0) goto out;
+
+    if (count == 1)
+    {
+        snprintf(content_range, sizeof(content_range), "bytes %zu-%zu/%zu", ranges[0].start,
+                 ranges[0].start + ranges[0].length - 1, file->size);
+        if (httpresponse_add_header(res, "Content-Type", file->mime) < 0 ||
+            httpresponse_add_header(res, "Content-Range", content_range) < 0 ||
+            httpresponse_add_header_uint(res, "Content-Length", ranges[0].length) < 0 ||
+            queue_response(conn, res) < 0)
+            goto out;
+        status = static_queue_slice(conn, file, ranges[0].start, ranges[0].length);
+        goto out;
+    }
+
+    // Boundary only has to be absent from the parts, the validators make it unlikely
+    char boundary[40];
+    snprintf(boundary, sizeof(boundary), "%016lx%016lx", (unsigned long)file->ino,
+             (unsigned long)file->mtime ^ (unsigned long)file->size);
+
+    for (int i = 0; i < count; i++)
+    {
+        parts[i] = arena_sprintf(&conn->arena,
+                                 "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %zu-%zu/%zu"
+                                 "\r\n\r\n",
+                                 boundary, file->mime, ranges[i].start,
+                                 ranges[i].start + ranges[i].length - 1, file->size);
+        if (!parts[i]) goto out;
+        part_lens[i] = strlen(parts[i]);
+        content_length += part_lens[i] + ranges[i].length;
+    }
+    parts[count] = arena_sprintf(&conn->arena, "\r\n--%s--\r\n", boundary);
+    if (!parts[count]) goto out;
+    part_lens[count] = strlen(parts[count]);
+    content_length += part_lens[count];
+
+    char *content_type = arena_sprintf(&conn->arena, "multipart/byteranges; boundary=%s", boundary);
+    if (!content_type || httpresponse_add_header(res, "Content-Type", content_type) < 0 ||
+        httpresponse_add_header_uint(res, "Content-Length", content_length) < 0 ||
+        queue_response(conn, res) < 0)
+        goto out;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (output_append_shared(&conn->out, parts[i], part_lens[i], NULL, NULL) < 0 ||
+            static_queue_slice(conn, file, ranges[i].start, ranges[i].length) < 0)
+            goto out;
+    }
+    status = output_append_shared(&conn->out, parts[count], part_lens[count], NULL, NULL);
+
+out:
+    if (file->fd >= 0) close(file->fd);
+    return status;
+}
+
+/**
+ * @brief   Queues a body-less 304 or 416 response for @p file.
+ */
+static int static_respond_status(Connection *conn, StaticFile *file, int status_code,
+                                 const char *phrase)
+{
+    if (file->fd >= 0) close(file->fd);
+
+    HTTPResponse *res = httpresponse_start(&conn->arena, status_code, phrase);
+    if (!res) return -1;
+
+    if (status_code == 304)
+    {
+        if (static_add_validators(res, file) < 0) return -1;
+    }
+    else
+    {
+        char content_range[40];
+        snprintf(content_range, sizeof(content_range), "bytes */%zu", file->size);
+        if (httpresponse_add_header(res, "Content-Range", content_range) < 0) return -1;
+    }
+
+    return queue_response(conn, res);
+}
+
+/**
+ * @brief   Queues @p length body bytes from @p start, referencing the bytes
+ *          in memory or a duplicate of the file descriptor for sendfile().
+ */
+static int static_queue_slice(Connection *conn, const StaticFile *file, size_t start,
+                              size_t length)
+{
+    if (file->data)
+    {
+        if (file->entry) filecache_retain(file->entry);
+        return output_append_shared(&conn->out, file->data + file->head_len + start, length,
+                                    file->entry ? filecache_release : NULL, file->entry);
+    }
+
+    int fd = dup(file->fd);
+    if (fd < 0) return -1;
+    return queue_file(conn, fd, start, length);
+}
+
+/**
+ * @brief   Formats the head of a 200 response for @p file.
+ *
+ * @returns Length of the head, -1 if it doesn't fit.
+ */
+static int static_head(char *head, size_t capacity, const StaticFile *file)
+{
+    // Validators identify this exact version of the file
+    char etag[STATIC_ETAG_SIZE];
+    static_etag(etag, file);
+    return static_write_head(head, capacity, file->mime, file->encoding, file->vary, file->size,
+                             etag, file->mtime);
+}
+
+/**
+ * @brief   Formats the head of a 200 static response: type, length,
+ *          validators, and Content-Encoding and Vary when they apply.
+ *
+ * @returns Length of the head, -1 if it doesn't fit.
+ */
+int static_write_head(char *head, size_t capacity, const char *mime, int encoding, int vary,
+                      size_t size, const char *etag, time_t mtime)
+{
+    static const char *codings[ENC_COUNT] = {[ENC_GZIP] = "gzip", [ENC_BR] = "br"};
+
+    char last_modified[64];
+    char extra[256];
+    static_last_modified(last_modified, sizeof(last_modified), mtime);
+    int len = snprintf(extra, sizeof(extra),
+                       "ETag: %s\r\n"
+                       "Last-Modified: %s\r\n"
+                       "Accept-Ranges: bytes\r\n",
+                       etag, last_modified);
+    if (encoding != ENC_IDENTITY)
+        len += snprintf(extra + len, sizeof(extra) - len, "Content-Encoding: %s\r\n",
+                        codings[encoding]);
+    if (vary) len += snprintf(extra + len, sizeof(extra) - len, "Vary: Accept-Encoding\r\n");
+
+    return httpresponse_write_head(head, capacity, 200, "OK", mime, size, extra);
+}
+
+/**
+ * @brief   Adds the headers describing the representation to a 206 or 304:
+ *          validators, Content-Encoding and Vary.
+ */
+static int static_add_validators(HTTPResponse *res, const StaticFile *file)
+{
+    static const char *codings[ENC_COUNT] = {[ENC_GZIP] = "gzip", [ENC_BR] = "br"};
+
+    char etag[STATIC_ETAG_SIZE];
+    char last_modified[64];
+    static_etag(etag, file);
+    static_last_modified(last_modified, sizeof(last_modified), file->mtime);
+
+    if (httpresponse_add_header(res, "ETag", etag) < 0 ||
+        httpresponse_add_header(res, "Last-Modified", last_modified) < 0)
+        return -1;
+    if (file->encoding != ENC_IDENTITY &&
+        httpresponse_add_header(res, "Content-Encoding", codings[file->encoding]) < 0)
+        return -1;
+    if (file->vary && httpresponse_add_header(res, "Vary", "Accept-Encoding") < 0) return -1;
+    return OK;
+}
+
+/**
+ * @brief   Writes the entity tag of @p file, the bundle's if it has one.
+ *
+ * @returns Length of the tag.
+ */
+static size_t static_etag(char *etag, const StaticFile *file)
+{
+    if (file->etag) return snprintf(etag, STATIC_ETAG_SIZE, "%s", file->etag);
+    return static_write_etag(etag, file->ino, file->file_size, file->mtime, file->transformed);
+}
+
+/**
+ * @brief   Writes the quoted entity tag of a file version: inode, size and
+ *          mtime of the file, plus "-gz" for a body gzipped from it by us.
+ *
+ * @returns Length of the tag.
+ */
+size_t static_write_etag(char *etag, ino_t ino, off_t file_size, time_t mtime, int transformed)
+{
+    return snprintf(etag, STATIC_ETAG_SIZE, "\"%lx-%lx-%lx%s\"", (unsigned long)ino,
+                    (unsigned long)file_size, (unsigned long)mtime, transformed ? "-gz" : "");
+}
+
+static void static_last_modified(char *date, size_t capacity, time_t mtime)
+{
+    struct tm tm;
+    gmtime_r(&mtime, &tm);
+    strftime(date, capacity, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+/**
+ * @brief   Opens a precompressed sibling, quietly, since most files have none.
+ *
+ * @returns The fd, -1 if there is no such regular file.
+ */
+static int static_open_sibling(const char *path, struct stat *st)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return -1;
+
+    if (fstat(fd, st) < 0 || !S_ISREG(st->st_mode))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief   Looks for the precompressed siblings of the file @p path names
+ *          with its first @p path_len bytes, for a variant about to be
+ *          cached, so hits on it know whether a preferred sibling exists.
+ *
+ * @returns ENC_BIT()s of the siblings found.
+ */
+static unsigned static_siblings(const Worker *self, const char *path, size_t path_len)
+{
+    if (!self->config->cfg->static_precompressed) return 0;
+
+    static const StaticVariant suffixes[] = {{".br", ENC_BR}, {".gz", ENC_GZIP}};
+    char sibling[PATH_MAX];
+    unsigned found = 0;
+
+    memcpy(sibling, path, path_len);
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++)
+    {
+        struct stat st;
+        memcpy(sibling + path_len, suffixes[i].suffix, 4);
+        if (stat(sibling, &st) == 0 && S_ISREG(st.st_mode)) found |= ENC_BIT(suffixes[i].encoding);
+    }
+    return found;
+}
+
+/**
+ * @brief   Whether a @p mime type is text that compresses well. Images and
+ *          archives are already compressed.
+ */
+int static_compressible(const char *mime)
+{
+    return strncmp(mime, "text/", 5) == 0 || strcmp(mime, "application/javascript") == 0 ||
+           strcmp(mime, "application/json") == 0 || strcmp(mime, "image/svg+xml") == 0;
+}
+
+/**
+ * @brief   Parses Accept-Encoding into ENC_BIT()s of the codings we serve.
+ *
+ * Codings with q=0 are refused, "*" stands for every coding not listed.
+ * Preference between accepted codings is ours (br over gzip), not the
+ * client's q-values.
+ *
+ * @returns The accepted codings, 0 without the header.
+ */
+unsigned static_accepted_encodings(const HTTPHeader *header)
+{
+    if (!header) return 0;
+
+    unsigned accepted = 0;
+    unsigned listed   = 0;
+    int wildcard      = 0;
+    const char *p     = header->value;
+    const char *end   = p + header->value_len;
+    while (p < end)
+    {
+        const char *comma    = memchr(p, ',', end - p);
+        const char *item_end = comma ? comma : end;
+
+        while (p < item_end && (*p == ' ' || *p == '\t'))
+            p++;
+        const char *token = p;
+        while (p < item_end && *p != ';' && *p != ' ' && *p != '\t')
+            p++;
+        size_t token_len = p - token;
+        int refused      = static_qvalue_zero(p, item_end);
+
+        unsigned bit = 0;
+        if (token_len == 2 && strncasecmp(token, "br", 2) == 0)
+            bit = ENC_BIT(ENC_BR);
+        else if ((token_len == 4 && strncasecmp(token, "gzip", 4) == 0) ||
+                 (token_len == 6 && strncasecmp(token, "x-gzip", 6) == 0))
+            bit = ENC_BIT(ENC_GZIP);
+        else if (token_len == 1 && *token == '*')
+            wildcard = !refused;
+
+        listed |= bit;
+        if (!refused) accepted |= bit;
+        p = comma ? comma + 1 : end;
+    }
+
+    if (wildcard) accepted |= (ENC_BIT(ENC_BR) | ENC_BIT(ENC_GZIP)) & ~listed;
+    return accepted;
+}
+
+/**
+ * @brief   Whether the parameters of an Accept-Encoding item set q=0.
+ */
+static int static_qvalue_zero(const char *params, const char *end)
+{
+    const char *p = params;
+    while (p < end)
+    {
+        const char *semi      = memchr(p, ';', end - p);
+        const char *param_end = semi ? semi : end;
+
+        while (p < param_end && (*p == ' ' || *p == '\t'))
+            p++;
+        if (param_end - p >= 2 && (*p | 0x20) == 'q' && p[1] == '=')
+        {
+            p += 2;
+            if (p == param_end || *p != '0') return 0;
+            for (p++; p < param_end && *p != ' ' && *p != '\t'; p++)
+            {
+                if (*p != '.' && *p != '0') return 0;
+            }
+            return 1;
+        }
+        p = semi ? semi + 1 : end;
+    }
+    return 0;
+}
+
+/**
+ * @brief   Rejects paths with a ".." segment, which could escape BASE_DIR.
+ */
+static int static_path_safe(const char *path, size_t len)
+{
+    for (size_t i = 0; i + 1 < len; i++)
+    {
+        if (path[i] == '.' && path[i + 1] == '.' && (i == 0 || path[i - 1] == '/') &&
+            (i + 2 == len || path[i + 2] == '/'))
+            return 0;
+    }
+    return 1;
+}
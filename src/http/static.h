@@ -0,0 +1,25 @@
+/**
+ * @file    static.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Static file handler prototypes.
+ *
+ */
+
+#ifndef HTTPSTATIC_H
+#define HTTPSTATIC_H
+
+#include "server.h"
+
+#define STATIC_HEAD_SIZE 512    // status line and headers of a static response
+#define STATIC_COMPRESS_MIN 256 // smaller files aren't worth gzipping on the fly
+#define STATIC_ETAG_SIZE 64     // quoted "ino-size-mtime-gz" entity tag
+
+int static_file_handler(Worker *self, Connection *conn);
+int static_write_head(char *head, size_t capacity, const char *mime, int encoding, int vary,
+                      size_t size, const char *etag, time_t mtime);
+size_t static_write_etag(char *etag, ino_t ino, off_t file_size, time_t mtime, int transformed);
+int static_compressible(const char *mime);
+unsigned static_accepted_encodings(const HTTPHeader *header);
+
+#endif
@@ -0,0 +1,315 @@
+/**
+ * @file    stats.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Metrics implementations.
+ *
+ * @details Every worker counts into its own WorkerStats, nothing is shared
+ *          while requests are served. A /__stats request, on whichever worker
+ *          gets it, sums all workers' stats and answers in the Prometheus
+ *          text format. Histograms are exported with a bucket per power of
+ *          two, the finer buckets are used for the quantiles.
+ */
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include "stats.h"
+#include "server.h"
+
+#define HIST_SUB_MASK ((1u << HIST_SUB_BITS) - 1)
+#define HIST_EXPORT_MIN_BITS 10 // first exported bucket is le 2^10 ns ~ 1 us
+#define STATS_TEXT_SIZE 16384   // initial body buffer, grown as needed
+
+typedef struct
+{
+    Arena *arena;
+    char *data;
+    size_t len;
+    size_t capacity;
+} StatsText;
+
+static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+static unsigned histogram_bucket(uint64_t ns);
+static uint64_t histogram_bucket_max(unsigned bucket);
+static uint64_t histogram_quantile(const Histogram *hist, double q);
+static void histogram_merge(Histogram *dst, const Histogram *src);
+static int write_histogram(StatsText *text, const char *stage, const Histogram *hist);
+static int text_append(StatsText *text, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void histogram_record(Histogram *hist, uint64_t ns)
+{
+    hist->counts[histogram_bucket(ns)]++;
+    hist->count++;
+    hist->sum_ns += ns;
+}
+
+/**
+ * @brief   Counts a finished (or aborted) request.
+ */
+void stats_request(WorkerStats *stats, const Connection *conn)
+{
+    int status = conn->status > 0 && conn->status < STATS_MAX_STATUS ? conn->status : 0;
+    stats->requests[status]++;
+    stats->bytes_out += conn->out.sent_bytes;
+    if (conn->backend) histogram_record(&stats->upstream, (uint64_t)conn->upstream_us * 1000);
+}
+
+/**
+ * @brief   Updates the per second rates, from maintain_worker().
+ */
+void stats_tick(WorkerStats *stats, uint64_t elapsed_ms)
+{
+    if (elapsed_ms == 0) return;
+    stats->accepts_per_sec = (stats->accepts - stats->last_accepts) * 1000 / elapsed_ms;
+    stats->last_accepts    = stats->accepts;
+}
+
+/**
+ * @brief   Answers GET /__stats with every worker's stats summed up.
+ *
+ * @returns OK once the response is queued, -1 on internal error.
+ */
+int stats_handler(Worker *self, Connection *conn)
+{
+    HTTPServer *httpserver = self->httpserver;
+
+    WorkerStats *total = arena_alloc(&conn->arena, sizeof(WorkerStats));
+    if (!total) return -1;
+    memset(total, 0, sizeof(WorkerStats));
+
+    size_t active = 0;
+    uint64_t hits = 0, misses = 0;
+    uint64_t proxy_hits = 0, proxy_stale = 0, proxy_coalesced = 0, proxy_misses = 0;
+    for (int i = 0; i < httpserver->worker_count; i++)
+    {
+        const Worker *worker     = httpserver->workers[i];
+        const WorkerStats *stats = &worker->stats;
+
+        active += worker->active_count;
+        hits += worker->cache.hits;
+        misses += worker->cache.misses;
+        proxy_hits += worker->proxy_cache.hits;
+        proxy_stale += worker->proxy_cache.stale_hits;
+        proxy_coalesced += worker->proxy_cache.coalesced;
+        proxy_misses += worker->proxy_cache.misses;
+        total->accepts += stats->accepts;
+        total->accepts_per_sec += stats->accepts_per_sec;
+        total->bytes_in += stats->bytes_in;
+        total->bytes_out += stats->bytes_out;
+        for (int s = 0; s < STATS_MAX_STATUS; s++)
+            total->requests[s] += stats->requests[s];
+        histogram_merge(&total->parse, &stats->parse);
+        histogram_merge(&total->handler, &stats->handler);
+        histogram_merge(&total->upstream, &stats->upstream);
+    }
+
+    StatsText text = {&conn->arena, arena_alloc(&conn->arena, STATS_TEXT_SIZE), 0,
+                      STATS_TEXT_SIZE};
+    if (!text.data) return -1;
+
+    int rc = text_append(&text,
+                         "# HELP cserver_workers Event loop threads.\n"
+                         "# TYPE cserver_workers gauge\n"
+                         "cserver_workers %d\n"
+                         "# HELP cserver_active_connections Client connections open.\n"
+                         "# TYPE cserver_active_connections gauge\n"
+                         "cserver_active_connections %zu\n"
+                         "# HELP cserver_accepts_total Client connections accepted.\n"
+                         "# TYPE cserver_accepts_total counter\n"
+                         "cserver_accepts_total %" PRIu64 "\n"
+                         "# HELP cserver_accepts_per_second Accepts during the last second.\n"
+                         "# TYPE cserver_accepts_per_second gauge\n"
+                         "cserver_accepts_per_second %" PRIu64 "\n"
+                         "# HELP cserver_received_bytes_total Bytes received from clients.\n"
+                         "# TYPE cserver_received_bytes_total counter\n"
+                         "cserver_received_bytes_total %" PRIu64 "\n"
+                         "# HELP cserver_sent_bytes_total Response bytes sent to clients.\n"
+                         "# TYPE cserver_sent_bytes_total counter\n"
+                         "cserver_sent_bytes_total %" PRIu64 "\n"
+                         "# HELP cserver_static_cache_hits_total Static lookups served cached.\n"
+                         "# TYPE cserver_static_cache_hits_total counter\n"
+                         "cserver_static_cache_hits_total %" PRIu64 "\n"
+                         "# HELP cserver_static_cache_misses_total Static lookups not cached.\n"
+                         "# TYPE cserver_static_cache_misses_total counter\n"
+                         "cserver_static_cache_misses_total %" PRIu64 "\n"
+                         "# HELP cserver_static_cache_hit_ratio Share of static lookups cached.\n"
+                         "# TYPE cserver_static_cache_hit_ratio gauge\n"
+                         "cserver_static_cache_hit_ratio %.4f\n",
+                         httpserver->worker_count, active, total->accepts, total->accepts_per_sec,
+                         total->bytes_in, total->bytes_out, hits, misses,
+                         hits + misses > 0 ? (double)hits / (double)(hits + misses) : 0.0);
+    if (rc == OK)
+        rc = text_append(&text,
+                         "# HELP cserver_proxy_cache_hits_total Proxied requests served cached.\n"
+                         "# TYPE cserver_proxy_cache_hits_total counter\n"
+                         "cserver_proxy_cache_hits_total %" PRIu64 "\n"
+                         "# HELP cserver_proxy_cache_stale_hits_total Cached answers served stale "
+                         "during a refresh.\n"
+                         "# TYPE cserver_proxy_cache_stale_hits_total counter\n"
+                         "cserver_proxy_cache_stale_hits_total %" PRIu64 "\n"
+                         "# HELP cserver_proxy_cache_coalesced_total Misses that waited for "
+                         "another request's fetch.\n"
+                         "# TYPE cserver_proxy_cache_coalesced_total counter\n"
+                         "cserver_proxy_cache_coalesced_total %" PRIu64 "\n"
+                         "# HELP cserver_proxy_cache_misses_total Cacheable requests fetched "
+                         "from a backend.\n"
+                         "# TYPE cserver_proxy_cache_misses_total counter\n"
+                         "cserver_proxy_cache_misses_total %" PRIu64 "\n"
+                         "# HELP cserver_requests_total Finished requests by status code.\n"
+                         "# TYPE cserver_requests_total counter\n",
+                         proxy_hits, proxy_stale, proxy_coalesced, proxy_misses);
+    for (int s = 0; s < STATS_MAX_STATUS && rc == OK; s++)
+    {
+        if (total->requests[s] == 0) continue;
+        if (s == 0)
+            rc = text_append(&text, "cserver_requests_total{code=\"other\"} %" PRIu64 "\n",
+                             total->requests[s]);
+        else
+            rc = text_append(&text, "cserver_requests_total{code=\"%d\"} %" PRIu64 "\n", s,
+                             total->requests[s]);
+    }
+
+    if (rc == OK)
+        rc = text_append(&text, "# HELP cserver_latency_seconds Time per request by stage.\n"
+                                "# TYPE cserver_latency_seconds histogram\n");
+    if (rc == OK) rc = write_histogram(&text, "parse", &total->parse);
+    if (rc == OK) rc = write_histogram(&text, "handler", &total->handler);
+    if (rc == OK) rc = write_histogram(&text, "upstream", &total->upstream);
+
+    if (rc == OK)
+        rc = text_append(&text, "# HELP cserver_latency_quantile_seconds Latency quantiles by "
+                                "stage, within 25%%.\n"
+                                "# TYPE cserver_latency_quantile_seconds gauge\n");
+    const char *stages[]     = {"parse", "handler", "upstream"};
+    const Histogram *hists[] = {&total->parse, &total->handler, &total->upstream};
+    for (int i = 0; i < 3 && rc == OK; i++)
+    {
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]) && rc == OK; q++)
+            rc = text_append(&text,
+                             "cserver_latency_quantile_seconds{stage=\"%s\",quantile=\"%g\"} "
+                             "%.9f\n",
+                             stages[i], quantiles[q],
+                             histogram_quantile(hists[i], quantiles[q]) / 1e9);
+    }
+    if (rc < 0) return -1;
+
+    HTTPResponse *res = httpresponse_start(&conn->arena, 200, "OK");
+    if (!res || httpresponse_add_header(res, "Cache-Control", "no-store") < 0) return -1;
+    httpresponse_set_body(res, text.data, text.len, "text/plain; version=0.0.4; charset=utf-8");
+
+    return queue_response(conn, res); // the scrape is counted too, once it's finished
+}
+
+// ---------- UTILS ----------
+
+static unsigned histogram_bucket(uint64_t ns)
+{
+    if (ns <= HIST_SUB_MASK) return (unsigned)ns;
+
+    unsigned msb = 63 - __builtin_clzll(ns);
+    if (msb >= HIST_MAX_BITS) return HIST_BUCKETS - 1;
+
+    unsigned shift = msb - HIST_SUB_BITS;
+    return ((msb - HIST_SUB_BITS + 1) << HIST_SUB_BITS) | ((ns >> shift) & HIST_SUB_MASK);
+}
+
+/**
+ * @returns The largest value that falls into @p bucket.
+ */
+static uint64_t histogram_bucket_max(unsigned bucket)
+{
+    if (bucket <= HIST_SUB_MASK) return bucket;
+
+    unsigned msb   = (bucket >> HIST_SUB_BITS) + HIST_SUB_BITS - 1;
+    unsigned shift = msb - HIST_SUB_BITS;
+    uint64_t sub   = bucket & HIST_SUB_MASK;
+    return (((uint64_t)(HIST_SUB_MASK + 1) + sub + 1) << shift) - 1;
+}
+
+/**
+ * @returns The upper bound of the bucket holding the @p q quantile, 0 if
+ *          nothing was recorded.
+ */
+static uint64_t histogram_quantile(const Histogram *hist, double q)
+{
+    if (hist->count == 0) return 0;
+
+    uint64_t rank = (uint64_t)(q * (double)hist->count);
+    if (rank >= hist->count) rank = hist->count - 1;
+
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < HIST_BUCKETS; b++)
+    {
+        seen += hist->counts[b];
+        if (seen > rank) return histogram_bucket_max(b);
+    }
+    return histogram_bucket_max(HIST_BUCKETS - 1);
+}
+
+static void histogram_merge(Histogram *dst, const Histogram *src)
+{
+    for (unsigned b = 0; b < HIST_BUCKETS; b++)
+        dst->counts[b] += src->counts[b];
+    dst->count += src->count;
+    dst->sum_ns += src->sum_ns;
+}
+
+/**
+ * @brief   Cumulative buckets at every power of two from 2^10 ns. A power
+ *          of two always ends a fine bucket, so the counts are exact.
+ */
+static int write_histogram(StatsText *text, const char *stage, const Histogram *hist)
+{
+    uint64_t cumulative = 0;
+    unsigned bucket     = 0;
+
+    // The last fine bucket also holds clamped values, it only goes into +Inf
+    for (unsigned bits = HIST_EXPORT_MIN_BITS; bits < HIST_MAX_BITS; bits++)
+    {
+        // Last fine bucket below 2^bits
+        unsigned last = ((bits - HIST_SUB_BITS) << HIST_SUB_BITS) | HIST_SUB_MASK;
+        for (; bucket <= last; bucket++)
+            cumulative += hist->counts[bucket];
+
+        if (text_append(text, "cserver_latency_seconds_bucket{stage=\"%s\",le=\"%.9g\"} %" PRIu64
+                              "\n",
+                        stage, (double)((uint64_t)1 << bits) / 1e9, cumulative) < 0)
+            return -1;
+    }
+
+    return text_append(text,
+                       "cserver_latency_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %" PRIu64 "\n"
+                       "cserver_latency_seconds_sum{stage=\"%s\"} %.9f\n"
+                       "cserver_latency_seconds_count{stage=\"%s\"} %" PRIu64 "\n",
+                       stage, hist->count, stage, hist->sum_ns / 1e9, stage, hist->count);
+}
+
+/**
+ * @brief   printf() onto the end of @p text, growing it in its arena.
+ *
+ * @returns OK, or -1 if it could not grow.
+ */
+static int text_append(StatsText *text, const char *fmt, ...)
+{
+    while (1)
+    {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(text->data + text->len, text->capacity - text->len, fmt, args);
+        va_end(args);
+        if (n < 0) return -1;
+        if ((size_t)n < text->capacity - text->len)
+        {
+            text->len += (size_t)n;
+            return OK;
+        }
+
+        size_t capacity = text->capacity * 2;
+        char *data      = arena_realloc(text->arena, text->data, text->capacity, capacity);
+        if (!data) return -1;
+        text->data     = data;
+        text->capacity = capacity;
+    }
+}
@@ -0,0 +1,61 @@
+/**
+ * @file    stats.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Per-worker counters and latency histograms behind /__stats.
+ *
+ */
+
+#ifndef HTTPSTATS_H
+#define HTTPSTATS_H
+
+#include <stdint.h>
+
+#define STATS_PATH "/__stats"
+
+#define HIST_SUB_BITS 2  // 4 buckets per power of two, under 25% error
+#define HIST_MAX_BITS 36 // 2^36 ns ~ 68 s, longer durations are clamped
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+#define STATS_MAX_STATUS 600 // status codes counted one by one
+
+/**
+ * @brief   HDR-style histogram of nanosecond durations: values below
+ *          2^HIST_SUB_BITS get a bucket each, then every power of two is
+ *          split into 2^HIST_SUB_BITS equal buckets, so the relative error
+ *          stays the same from nanoseconds to seconds.
+ */
+typedef struct Histogram
+{
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t count;  // values recorded
+    uint64_t sum_ns; // their sum
+} Histogram;
+
+/**
+ * @brief   Only the owning worker writes these, with plain stores, so
+ *          counting costs no atomic operation or shared cache line. A
+ *          scrape reads every worker's stats and may see them a few
+ *          events behind.
+ */
+typedef struct WorkerStats
+{
+    uint64_t accepts;                    // clients accepted
+    uint64_t accepts_per_sec;            // accepts during the last maintenance second
+    uint64_t last_accepts;               // accepts at the last maintenance sweep
+    uint64_t requests[STATS_MAX_STATUS]; // finished requests by status code, 0 = other
+    uint64_t bytes_in;                   // bytes received from clients
+    uint64_t bytes_out;                  // response bytes sent to clients
+    Histogram parse;                     // parser time per request
+    Histogram handler;                   // request_handler() time per request
+    Histogram upstream;                  // proxied request to last upstream byte
+} WorkerStats;
+
+struct Worker;
+struct Connection;
+
+void histogram_record(Histogram *hist, uint64_t ns);
+void stats_request(WorkerStats *stats, const struct Connection *conn);
+void stats_tick(WorkerStats *stats, uint64_t elapsed_ms);
+int stats_handler(struct Worker *self, struct Connection *conn);
+
+#endif
@@ -0,0 +1,175 @@
+/**
+ * @file    tokenizer.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Line scanner implementations.
+ *
+ * @details A request line or header line is scanned once, block by block,
+ *          for its LF and its first delimiter together, in the style of
+ *          picohttpparser, instead of one memchr()/memmem() per field. The
+ *          widest implementation the CPU supports is picked at startup. The
+ *          SIMD variants are compiled with per-function target attributes,
+ *          so the binary still runs on CPUs without them and no global -m
+ *          flags are needed.
+ */
+
+#include "tokenizer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TOKENIZER_X86 1
+#endif
+
+// PCMPESTRI: index of the first byte equal to any needle
+#define SSE42_ANY_MODE (_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT)
+
+static size_t line_scalar(const char *data, size_t len, char delim, size_t *delim_pos);
+#ifdef TOKENIZER_X86
+static size_t line_sse42(const char *data, size_t len, char delim, size_t *delim_pos);
+static size_t line_avx2(const char *data, size_t len, char delim, size_t *delim_pos);
+#endif
+
+TokenLineFn token_line          = line_scalar;
+static const char *backend_name = "scalar";
+
+/**
+ * @brief   Picks the fastest supported backend before main() runs, so
+ *          worker threads only ever read token_line.
+ */
+__attribute__((constructor)) static void tokenizer_init(void)
+{
+    tokenizer_select("auto");
+}
+
+/**
+ * @brief   Switches the backend: "auto", "avx2", "sse4.2" or "scalar".
+ *
+ * Meant for startup and benchmarks, not to be called while workers run.
+ *
+ * @returns OK, or -1 if the backend is unknown or the CPU lacks it.
+ */
+int tokenizer_select(const char *backend)
+{
+    int is_auto = strcmp(backend, "auto") == 0;
+
+#ifdef TOKENIZER_X86
+    __builtin_cpu_init();
+    if ((is_auto || strcmp(backend, "avx2") == 0) && __builtin_cpu_supports("avx2"))
+    {
+        token_line   = line_avx2;
+        backend_name = "avx2";
+        return OK;
+    }
+    if ((is_auto || strcmp(backend, "sse4.2") == 0) && __builtin_cpu_supports("sse4.2"))
+    {
+        token_line   = line_sse42;
+        backend_name = "sse4.2";
+        return OK;
+    }
+#endif
+
+    if (is_auto || strcmp(backend, "scalar") == 0)
+    {
+        token_line   = line_scalar;
+        backend_name = "scalar";
+        return OK;
+    }
+    return -1;
+}
+
+const char *tokenizer_backend(void)
+{
+    return backend_name;
+}
+
+// ---------- UTILS ----------
+
+static size_t line_scalar(const char *data, size_t len, char delim, size_t *delim_pos)
+{
+    *delim_pos = len;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (data[i] == '\n') return i;
+        if (data[i] == delim && *delim_pos == len) *delim_pos = i;
+    }
+    return len;
+}
+
+#ifdef TOKENIZER_X86
+
+/**
+ * @brief   16 bytes per step with PCMPESTRI in "equal any" mode over
+ *          {LF, delim}. Once the delimiter is found only LF is searched.
+ */
+__attribute__((target("sse4.2"))) static size_t line_sse42(const char *data, size_t len,
+                                                           char delim, size_t *delim_pos)
+{
+    __m128i needles = _mm_setr_epi8('\n', delim, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    int needle_count = 2;
+
+    *delim_pos = len;
+    size_t i   = 0;
+    // Only whole blocks are loaded, nothing past data + len is ever read
+    while (len - i >= 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+        int idx       = _mm_cmpestri(needles, needle_count, block, 16, SSE42_ANY_MODE);
+        if (idx >= 16)
+        {
+            i += 16;
+            continue;
+        }
+
+        size_t pos = i + idx;
+        if (data[pos] == '\n') return pos;
+
+        *delim_pos   = pos;
+        needle_count = 1;
+        i            = pos + 1;
+    }
+
+    // Tail shorter than a block
+    for (; i < len; i++)
+    {
+        if (data[i] == '\n') return i;
+        if (data[i] == delim && *delim_pos == len) *delim_pos = i;
+    }
+    return len;
+}
+
+/**
+ * @brief   32 bytes per step, one compare for LF and one for the delimiter.
+ */
+__attribute__((target("avx2"))) static size_t line_avx2(const char *data, size_t len, char delim,
+                                                        size_t *delim_pos)
+{
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i dl = _mm256_set1_epi8(delim);
+
+    *delim_pos = len;
+    size_t i   = 0;
+    while (len - i >= 32)
+    {
+        __m256i block    = _mm256_loadu_si256((const __m256i *)(data + i));
+        uint32_t lf_mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, lf));
+        uint32_t dl_mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, dl));
+
+        if (dl_mask && *delim_pos == len)
+        {
+            size_t pos = i + __builtin_ctz(dl_mask);
+            if (!lf_mask || pos < i + __builtin_ctz(lf_mask)) *delim_pos = pos;
+        }
+        if (lf_mask) return i + __builtin_ctz(lf_mask);
+        i += 32;
+    }
+
+    // Tail shorter than a block
+    for (; i < len; i++)
+    {
+        if (data[i] == '\n') return i;
+        if (data[i] == delim && *delim_pos == len) *delim_pos = i;
+    }
+    return len;
+}
+
+#endif
@@ -0,0 +1,32 @@
+/**
+ * @file    tokenizer.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Line scanner used by the HTTP parser, SIMD where available.
+ *
+ */
+
+#ifndef HTTPTOKENIZER_H
+#define HTTPTOKENIZER_H
+
+#include "common.h"
+
+/**
+ * @brief   Finds the end of the line starting at @p data in a single pass.
+ *
+ * @param   delim      Byte whose first occurrence is reported as well, e.g.
+ *                     ':' for header lines or ' ' for the request line.
+ * @param   delim_pos  Set to the index of the first @p delim, or @p len if
+ *                     there is none. Only meaningful when it is before the
+ *                     returned LF.
+ *
+ * @returns Index of the first LF, or @p len if the line is incomplete.
+ */
+typedef size_t (*TokenLineFn)(const char *data, size_t len, char delim, size_t *delim_pos);
+
+extern TokenLineFn token_line;
+
+int tokenizer_select(const char *backend);
+const char *tokenizer_backend(void);
+
+#endif
@@ -0,0 +1,616 @@
+/**
+ * @file    uring.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   io_uring backend implementations.
+ *
+ * @details Client sockets are served with a multishot accept on the
+ *          listener and a multishot recv per connection that picks buffers
+ *          from a provided buffer ring, so a busy connection costs no
+ *          syscall per read. Accepted sockets are put in a sparse registered
+ *          file table by a FILES_UPDATE linked in front of their first recv.
+ *          Responses are still written by output_flush(), which already
+ *          batches with writev() and sendfile(); the ring only waits for
+ *          POLLOUT when a socket is full. Upstream and inotify fds stay in
+ *          the worker's epoll instance, which the ring polls like any fd.
+ *
+ *          The ring is driven with raw syscalls, there is no liburing
+ *          dependency. Kernels without SINGLE_ISSUER/DEFER_TASKRUN (6.1)
+ *          make uring_run() fail and the worker falls back to epoll.
+ */
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/time_types.h>
+#include "uring.h"
+
+// What a completion belongs to, kept in the low bits of user_data. Connection
+// slots are cache-line aligned, so their address leaves these bits free.
+enum
+{
+    OP_IGNORE, // FILES_UPDATE and cancel results
+    OP_ACCEPT,
+    OP_RECV,
+    OP_POLLOUT,
+    OP_EPOLL, // the worker's epoll fd became readable
+};
+
+#define OP_MASK 0x3full
+#define GENERATION_SHIFT 48
+
+static const int no_file = -1;
+
+static int ring_setup(Uring *ring, int listener);
+static struct io_uring_sqe *get_sqe(Worker *self);
+static int submit_and_wait(Uring *ring, int timeout_ms);
+static void handle_completions(Worker *self);
+static void handle_cqe(Worker *self, const struct io_uring_cqe *cqe);
+static void handle_recv(Worker *self, Connection *conn, const struct io_uring_cqe *cqe);
+static void arm_accept(Worker *self);
+static void arm_epoll(Worker *self);
+static void arm_recv(Worker *self, Connection *conn, int link_update);
+static void arm_pollout(Worker *self, Connection *conn);
+static void cancel_op(Worker *self, Connection *conn, int op);
+static void set_fd(Uring *ring, struct io_uring_sqe *sqe, int fd);
+static void recycle_buffer(Uring *ring, unsigned bid);
+static uint64_t op_data(const Connection *conn, int op);
+
+/**
+ * @brief   Moves the worker's clients onto an io_uring and runs its loop.
+ *
+ * Must be called on the worker thread: the ring is created with
+ * SINGLE_ISSUER, which ties it to the first thread that submits.
+ *
+ * @returns -1 if the ring can't be set up, the caller then keeps using
+ *          epoll. OK once the worker has drained.
+ */
+int uring_run(Worker *self)
+{
+    Uring *ring = calloc(1, sizeof(Uring));
+    if (!ring) return -1;
+
+    if (ring_setup(ring, self->server->socket) < 0)
+    {
+        self->ring = ring;
+        uring_destroy(self);
+        return -1;
+    }
+    self->ring = ring;
+
+    // The listener is served by the multishot accept from now on
+    epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, self->server->socket, NULL);
+    arm_accept(self);
+    arm_epoll(self);
+
+    LOG(INFO, "Worker %d uses io_uring.", self->id);
+
+    while (1)
+    {
+        if (submit_and_wait(ring, 60) < 0) LOG(ERROR, "Failed to wait for io_uring events.");
+        handle_completions(self);
+        if (end_worker_batch(self)) break;
+    }
+
+    return OK;
+}
+
+/**
+ * @brief   Releases the ring. Connections must be closed first.
+ */
+void uring_destroy(Worker *self)
+{
+    Uring *ring = self->ring;
+    if (!ring) return;
+
+    if (ring->fd > 0) close(ring->fd); // also drops the registered files and buffers
+    if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    free(ring->buf_ring);
+    free(ring->bufs);
+    free(ring->files);
+    free(ring);
+    self->ring = NULL;
+}
+
+/**
+ * @brief   Stops accepting for a drain: cancels the multishot accept and
+ *          drops the listener from the file table, so closing it lets go of
+ *          the socket.
+ *
+ * Waits for the accept's last completion. Until then it may still take a
+ * wakeup for the listener, which with DEFER_TASKRUN only turns into a
+ * connection when this thread reaps, and a new binary waiting on the same
+ * socket is never told about it.
+ */
+void uring_stop_accept(Worker *self)
+{
+    Uring *ring  = self->ring;
+    int listener = ring->listener;
+    if (listener < 0) return;
+    ring->listener = -1; // not re-armed from here on
+
+    struct io_uring_sqe *sqe = get_sqe(self);
+    if (sqe)
+    {
+        sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+        sqe->fd        = -1;
+        sqe->addr      = OP_ACCEPT;
+        sqe->user_data = OP_IGNORE;
+    }
+    for (int i = 0; ring->accepting && i < 100; i++)
+    {
+        submit_and_wait(ring, 10);
+        handle_completions(self);
+    }
+
+    if (listener < ring->file_count && (sqe = get_sqe(self)) != NULL)
+    {
+        sqe->opcode    = IORING_OP_FILES_UPDATE;
+        sqe->fd        = -1;
+        sqe->addr      = (uintptr_t)&no_file;
+        sqe->len       = 1;
+        sqe->off       = listener;
+        sqe->user_data = OP_IGNORE;
+    }
+    submit_and_wait(ring, -1); // before the caller closes the listener
+}
+
+/**
+ * @brief   Handles the completions the kernel posted so far.
+ */
+static void handle_completions(Worker *self)
+{
+    Uring *ring   = self->ring;
+    unsigned head = *ring->cq_head;
+    while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        // Free the slot before handling, handlers may submit and wait
+        struct io_uring_cqe cqe = ring->cqes[head & ring->cq_mask];
+        __atomic_store_n(ring->cq_head, ++head, __ATOMIC_RELEASE);
+        handle_cqe(self, &cqe);
+    }
+}
+
+/**
+ * @brief   Fixes the accepted socket in the file table and starts receiving.
+ */
+void uring_add_connection(Worker *self, Connection *conn)
+{
+    conn->ring_state = 0;
+    arm_recv(self, conn, 1);
+}
+
+/**
+ * @brief   The ring counterpart of an epoll MOD: receives only while the
+ *          connection is reading and waits for POLLOUT while output is
+ *          pending.
+ */
+void uring_update_connection(Worker *self, Connection *conn)
+{
+    if (connection_reading(conn))
+    {
+        // A recv still being canceled is re-armed when its last CQE arrives
+        if (!(conn->ring_state & RING_RECV_ARMED)) arm_recv(self, conn, 0);
+    }
+    else if ((conn->ring_state & RING_RECV_ARMED) && !(conn->ring_state & RING_RECV_CANCELING))
+    {
+        cancel_op(self, conn, OP_RECV);
+        conn->ring_state |= RING_RECV_CANCELING;
+    }
+
+    if (has_pending_output(conn) && !(conn->ring_state & RING_POLLOUT_ARMED))
+        arm_pollout(self, conn);
+}
+
+/**
+ * @brief   Stops everything in flight for a connection about to be closed
+ *          and releases its file table slot, which would keep the socket
+ *          open after close().
+ */
+void uring_remove_connection(Worker *self, Connection *conn)
+{
+    Uring *ring = self->ring;
+
+    if ((conn->ring_state & RING_RECV_ARMED) && !(conn->ring_state & RING_RECV_CANCELING))
+        cancel_op(self, conn, OP_RECV);
+    if (conn->ring_state & RING_POLLOUT_ARMED) cancel_op(self, conn, OP_POLLOUT);
+    conn->ring_state = 0;
+
+    if (conn->socket >= ring->file_count) return;
+
+    struct io_uring_sqe *sqe = get_sqe(self);
+    if (!sqe) return;
+    sqe->opcode    = IORING_OP_FILES_UPDATE;
+    sqe->fd        = -1;
+    sqe->addr      = (uintptr_t)&no_file;
+    sqe->len       = 1;
+    sqe->off       = conn->socket;
+    sqe->user_data = OP_IGNORE;
+}
+
+// ---------- UTILS ----------
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args)
+{
+    return (int)syscall(SYS_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * @brief   Creates and maps the ring, then registers its fd, a sparse file
+ *          table holding the listener and the provided buffer ring.
+ */
+static int ring_setup(Uring *ring, int listener)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = URING_CQ_ENTRIES;
+
+    ring->fd = (int)syscall(SYS_io_uring_setup, URING_SQ_ENTRIES, &params);
+    if (ring->fd < 0)
+    {
+        LOG(WARNING, "io_uring_setup() failed: %s", strerror(errno));
+        ring->fd = 0;
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG))
+    {
+        LOG(WARNING, "io_uring lacks SINGLE_MMAP or EXT_ARG.");
+        return -1;
+    }
+    ring->enter_fd = ring->fd;
+
+    // SQ and CQ rings share one mapping, the SQEs have their own
+    size_t sq_size     = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size     = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sq_ring_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->sq_ring      = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED)
+    {
+        ring->sq_ring = NULL;
+        return -1;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes      = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        return -1;
+    }
+
+    char *base          = ring->sq_ring;
+    ring->sq_head       = (unsigned *)(base + params.sq_off.head);
+    ring->sq_tail       = (unsigned *)(base + params.sq_off.tail);
+    ring->sq_mask       = *(unsigned *)(base + params.sq_off.ring_mask);
+    ring->sq_entries    = params.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head       = (unsigned *)(base + params.cq_off.head);
+    ring->cq_tail       = (unsigned *)(base + params.cq_off.tail);
+    ring->cq_mask       = *(unsigned *)(base + params.cq_off.ring_mask);
+    ring->cqes          = (struct io_uring_cqe *)(base + params.cq_off.cqes);
+
+    // SQ slot i always holds SQE i
+    unsigned *array = (unsigned *)(base + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++)
+        array[i] = i;
+
+    // A registered ring fd skips the fd lookup on every io_uring_enter()
+    struct io_uring_rsrc_update ring_reg = {.offset = -1U, .data = (uint64_t)ring->fd};
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_RING_FDS, &ring_reg, 1) == 1)
+    {
+        ring->enter_fd    = (int)ring_reg.offset;
+        ring->enter_flags = IORING_ENTER_REGISTERED_RING;
+    }
+
+    // Sparse file table indexed by fd, so a socket's slot is its fd
+    struct rlimit limit;
+    ring->file_count = URING_MAX_FILES;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < URING_MAX_FILES)
+        ring->file_count = (int)limit.rlim_cur;
+    ring->files = malloc(ring->file_count * sizeof(int));
+    if (!ring->files) return -1;
+    for (int i = 0; i < ring->file_count; i++)
+        ring->files[i] = i;
+
+    struct io_uring_rsrc_register files_reg;
+    memset(&files_reg, 0, sizeof(files_reg));
+    files_reg.nr    = ring->file_count;
+    files_reg.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_FILES2, &files_reg, sizeof(files_reg)) < 0)
+    {
+        LOG(WARNING, "Failed to register the io_uring file table: %s", strerror(errno));
+        return -1;
+    }
+
+    ring->listener = listener;
+    if (listener < ring->file_count)
+    {
+        struct io_uring_files_update update = {.offset = listener, .fds = (uintptr_t)&listener};
+        if (sys_io_uring_register(ring->fd, IORING_REGISTER_FILES_UPDATE, &update, 1) != 1)
+            return -1;
+    }
+
+    // Receive buffers the kernel picks from when data arrives
+    size_t buf_ring_size = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+    if (posix_memalign((void **)&ring->buf_ring, 4096, buf_ring_size) != 0)
+    {
+        ring->buf_ring = NULL;
+        return -1;
+    }
+    memset(ring->buf_ring, 0, buf_ring_size);
+    if (posix_memalign((void **)&ring->bufs, 4096, URING_BUF_COUNT * URING_BUF_SIZE) != 0)
+    {
+        ring->bufs = NULL;
+        return -1;
+    }
+
+    struct io_uring_buf_reg buf_reg;
+    memset(&buf_reg, 0, sizeof(buf_reg));
+    buf_reg.ring_addr    = (uintptr_t)ring->buf_ring;
+    buf_reg.ring_entries = URING_BUF_COUNT;
+    buf_reg.bgid         = 0;
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &buf_reg, 1) < 0)
+    {
+        LOG(WARNING, "Failed to register io_uring receive buffers: %s", strerror(errno));
+        return -1;
+    }
+    for (unsigned bid = 0; bid < URING_BUF_COUNT; bid++)
+        recycle_buffer(ring, bid);
+
+    return OK;
+}
+
+/**
+ * @returns A zeroed SQE, submitting queued ones first if the SQ is full.
+ */
+static struct io_uring_sqe *get_sqe(Worker *self)
+{
+    Uring *ring = self->ring;
+
+    if (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries)
+    {
+        if (submit_and_wait(ring, -1) < 0 ||
+            ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >=
+                ring->sq_entries)
+        {
+            LOG(ERROR, "io_uring submission queue is full.");
+            return NULL;
+        }
+    }
+
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+/**
+ * @brief   Submits queued SQEs. Waits for a completion for up to
+ *          @p timeout_ms, or only submits if it is negative.
+ */
+static int submit_and_wait(Uring *ring, int timeout_ms)
+{
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    struct __kernel_timespec ts = {.tv_sec = timeout_ms / 1000,
+                                   .tv_nsec = (long long)(timeout_ms % 1000) * 1000000};
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts         = (uintptr_t)&ts;
+
+    unsigned flags  = ring->enter_flags | IORING_ENTER_EXT_ARG;
+    unsigned wanted = 0;
+    if (timeout_ms >= 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+        wanted = 1;
+    }
+
+    while (1)
+    {
+        int ret = (int)syscall(SYS_io_uring_enter, ring->enter_fd, to_submit, wanted, flags, &arg,
+                               sizeof(arg));
+        if (ret >= 0 || errno == ETIME) return OK;
+        if (errno == EINTR) continue;
+        // Full CQ: completions have to be reaped before more can be submitted
+        if (errno == EBUSY) return OK;
+        return -1;
+    }
+}
+
+static void handle_cqe(Worker *self, const struct io_uring_cqe *cqe)
+{
+    Uring *ring = self->ring;
+    int op      = (int)(cqe->user_data & OP_MASK);
+
+    if (op == OP_ACCEPT)
+    {
+        if (cqe->res >= 0)
+            add_client(self, cqe->res, NULL);
+        else if (cqe->res != -ECANCELED)
+            LOG(ERROR, "Failed to accept a connection: %s", strerror(-cqe->res));
+        if (cqe->flags & IORING_CQE_F_MORE) return;
+
+        ring->accepting = 0;
+        if (ring->listener >= 0) arm_accept(self);
+        return;
+    }
+    if (op == OP_EPOLL)
+    {
+        handle_epoll_events(self, 0);
+        arm_epoll(self);
+        return;
+    }
+    if (op != OP_RECV && op != OP_POLLOUT) return;
+
+    // Completions can outlive the client they were queued for
+    Connection *conn = (Connection *)(uintptr_t)(cqe->user_data & ~OP_MASK &
+                                                 ((1ull << GENERATION_SHIFT) - 1));
+    uint16_t generation = (uint16_t)(cqe->user_data >> GENERATION_SHIFT);
+    int stale           = conn->generation != generation || conn->socket <= 0;
+
+    if (op == OP_RECV)
+    {
+        if (!stale) handle_recv(self, conn, cqe);
+        if (cqe->flags & IORING_CQE_F_BUFFER)
+            recycle_buffer(ring, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        return;
+    }
+
+    if (stale) return;
+    conn->ring_state &= ~RING_POLLOUT_ARMED;
+    if (cqe->res < 0)
+    {
+        if (cqe->res != -ECANCELED) close_connection(self, conn);
+        return;
+    }
+    // Poll masks and epoll events share their bit values
+    handle_client_event(self, conn, (uint32_t)cqe->res);
+}
+
+static void handle_recv(Worker *self, Connection *conn, const struct io_uring_cqe *cqe)
+{
+    Uring *ring         = self->ring;
+    uint16_t generation = conn->generation;
+
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+        conn->ring_state &= ~(RING_RECV_ARMED | RING_RECV_CANCELING);
+
+    if (cqe->res > 0)
+    {
+        char *data = ring->bufs + (size_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT) * URING_BUF_SIZE;
+        LOG(DEBUG, "Read %d bytes from socket FD %d", cqe->res, conn->socket);
+        receive_input(self, conn, data, cqe->res);
+    }
+    else if (cqe->res == 0)
+    {
+        // Seen again by the next recv if the connection isn't reading now
+        if (connection_reading(conn)) receive_eof(self, conn);
+        return;
+    }
+    else if (cqe->res != -ENOBUFS && cqe->res != -ECANCELED)
+    {
+        LOG(ERROR, "Failed to read data from client: %s", strerror(-cqe->res));
+        close_connection(self, conn);
+        return;
+    }
+
+    // A finished multishot recv is re-armed if the connection still reads
+    if (conn->generation == generation && conn->socket > 0 && !(conn->ring_state & RING_RECV_ARMED))
+        uring_update_connection(self, conn);
+}
+
+static void arm_accept(Worker *self)
+{
+    struct io_uring_sqe *sqe = get_sqe(self);
+    if (!sqe) return;
+    sqe->opcode       = IORING_OP_ACCEPT;
+    sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data    = OP_ACCEPT;
+    set_fd(self->ring, sqe, self->ring->listener);
+    self->ring->accepting = 1;
+}
+
+/**
+ * @brief   Oneshot, so a partly drained epoll instance is reported again.
+ */
+static void arm_epoll(Worker *self)
+{
+    struct io_uring_sqe *sqe = get_sqe(self);
+    if (!sqe) return;
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = self->epoll_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data     = OP_EPOLL;
+}
+
+/**
+ * @param   link_update  Put the socket in the file table first, with a
+ *                       FILES_UPDATE linked to the recv.
+ */
+static void arm_recv(Worker *self, Connection *conn, int link_update)
+{
+    Uring *ring = self->ring;
+
+    if (link_update && conn->socket < ring->file_count)
+    {
+        struct io_uring_sqe *sqe = get_sqe(self);
+        if (!sqe) return;
+        sqe->opcode    = IORING_OP_FILES_UPDATE;
+        sqe->fd        = -1;
+        sqe->addr      = (uintptr_t)&ring->files[conn->socket];
+        sqe->len       = 1;
+        sqe->off       = conn->socket;
+        sqe->flags     = IOSQE_IO_LINK;
+        sqe->user_data = OP_IGNORE;
+    }
+
+    struct io_uring_sqe *sqe = get_sqe(self);
+    if (!sqe) return;
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->flags     = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = op_data(conn, OP_RECV);
+    set_fd(ring, sqe, conn->socket);
+    conn->ring_state |= RING_RECV_ARMED;
+}
+
+static void arm_pollout(Worker *self, Connection *conn)
+{
+    struct io_uring_sqe *sqe = get_sqe(self);
+    if (!sqe) return;
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->poll32_events = POLLOUT;
+    sqe->user_data     = op_data(conn, OP_POLLOUT);
+    set_fd(self->ring, sqe, conn->socket);
+    conn->ring_state |= RING_POLLOUT_ARMED;
+}
+
+static void cancel_op(Worker *self, Connection *conn, int op)
+{
+    struct io_uring_sqe *sqe = get_sqe(self);
+    if (!sqe) return;
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->fd        = -1;
+    sqe->addr      = op_data(conn, op);
+    sqe->user_data = OP_IGNORE;
+}
+
+/**
+ * @brief   Uses the socket's file table slot when it has one.
+ */
+static void set_fd(Uring *ring, struct io_uring_sqe *sqe, int fd)
+{
+    sqe->fd = fd;
+    if (fd < ring->file_count) sqe->flags |= IOSQE_FIXED_FILE;
+}
+
+/**
+ * @brief   Hands a provided buffer back to the kernel. Data is copied out as
+ *          soon as its CQE is seen, so buffers return right away.
+ */
+static void recycle_buffer(Uring *ring, unsigned bid)
+{
+    struct io_uring_buf_ring *br = ring->buf_ring;
+    unsigned short tail          = br->tail;
+
+    struct io_uring_buf *buf = &br->bufs[tail & (URING_BUF_COUNT - 1)];
+    buf->addr                = (uintptr_t)(ring->bufs + (size_t)bid * URING_BUF_SIZE);
+    buf->len                 = URING_BUF_SIZE;
+    buf->bid                 = (unsigned short)bid;
+    __atomic_store_n(&br->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+}
+
+static uint64_t op_data(const Connection *conn, int op)
+{
+    return (uintptr_t)conn | (uint64_t)op | ((uint64_t)conn->generation << GENERATION_SHIFT);
+}
@@ -0,0 +1,59 @@
+/**
+ * @file    uring.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   io_uring backend for client sockets, an alternative to epoll.
+ *
+ */
+
+#ifndef HTTPURING_H
+#define HTTPURING_H
+
+#include <linux/io_uring.h>
+#include "server.h"
+
+#define URING_SQ_ENTRIES 1024 // submission queue size
+#define URING_CQ_ENTRIES 4096 // completion queue size, multishot ops post many CQEs
+#define URING_BUF_COUNT 256   // provided receive buffers per worker, a power of two
+#define URING_BUF_SIZE 4096   // bytes per provided buffer
+#define URING_MAX_FILES 65536 // registered file table size at most
+
+// Connection.ring_state flags
+#define RING_RECV_ARMED 0x01     // multishot recv in flight
+#define RING_RECV_CANCELING 0x02 // cancel of that recv submitted
+#define RING_POLLOUT_ARMED 0x04  // oneshot POLLOUT in flight
+
+typedef struct Uring
+{
+    int fd;                             // io_uring instance
+    int enter_fd;                       // fd or registered index passed to io_uring_enter()
+    unsigned enter_flags;               // IORING_ENTER_REGISTERED_RING if the ring fd is registered
+    void *sq_ring;                      // SQ ring mapping, shared with the CQ ring
+    size_t sq_ring_size;                // bytes mapped at sq_ring
+    struct io_uring_sqe *sqes;          // SQE array
+    size_t sqes_size;                   // bytes mapped at sqes
+    unsigned *sq_head;                  // kernel consumer index
+    unsigned *sq_tail;                  // our producer index
+    unsigned sq_mask;                   // SQ entries - 1
+    unsigned sq_entries;                // SQ size
+    unsigned sq_local_tail;             // tail including SQEs not yet published
+    unsigned *cq_head;                  // our consumer index
+    unsigned *cq_tail;                  // kernel producer index
+    unsigned cq_mask;                   // CQ entries - 1
+    struct io_uring_cqe *cqes;          // CQE array
+    struct io_uring_buf_ring *buf_ring; // provided buffer ring, bgid 0
+    char *bufs;                         // URING_BUF_COUNT buffers of URING_BUF_SIZE
+    int *files;                         // files[fd] = fd, read by FILES_UPDATE when it runs
+    int file_count;                     // registered table size, larger fds aren't fixed
+    int listener;                       // listener fd, fixed at its own index, -1 once draining
+    int accepting;                      // multishot accept armed, its last CQE not seen yet
+} Uring;
+
+int uring_run(Worker *self);
+void uring_destroy(Worker *self);
+void uring_stop_accept(Worker *self);
+void uring_add_connection(Worker *self, Connection *conn);
+void uring_update_connection(Worker *self, Connection *conn);
+void uring_remove_connection(Worker *self, Connection *conn);
+
+#endif
@@ -8,76 +8,70 @@
 
 #include <unistd.h>
 #include <signal.h>
+#include <pthread.h>
 #include "common.h"
 #include "utils/config.h"
 #include "http/server.h"
 
 void handle_signal(int sig);
 
-HTTPServer *httpserver_ptr = NULL;
-
 int main(void)
 {
-    signal(SIGINT, handle_signal);
-    signal(SIGTERM, handle_signal);
     signal(SIGSEGV, handle_signal);
     signal(SIGPIPE, SIG_IGN);
 
-    Config *cfg = parse_config("cserver.ini");
+    // Blocked before any thread starts so every thread inherits the mask, the
+    // supervisor takes them with sigtimedwait (see lifecycle.c)
+    sigset_t control;
+    control_signals(&control);
+    pthread_sigmask(SIG_BLOCK, &control, NULL);
+
+    Config *cfg = parse_config(CONFIG_FILE);
     if (!cfg)
     {
-        LOG("ERROR", "Failed to parse config file.");
+        LOG(ERROR, "Failed to parse config file.");
         return EXIT_FAILURE;
     }
 
-    HTTPServer *httpserver_ptr =
-        httpserver_constructor(cfg->port, cfg->static_dir, cfg->backends, cfg->backend_count);
+    // Workers never wait for stdout, a background thread writes the log
+    __atomic_store_n(&log_level, cfg->log_level, __ATOMIC_RELAXED);
+    if (log_start() < 0) LOG(WARNING, "Failed to start the log thread, logging synchronously.");
+    if (cfg->access_log && log_open_access(cfg->access_log) < 0)
+    {
+        LOG(ERROR, "Failed to open access log %s, access logging is off.", cfg->access_log);
+        free(cfg->access_log);
+        cfg->access_log = NULL;
+    }
+
+    // Owns cfg from here on, a reload replaces it
+    HTTPServer *httpserver_ptr = httpserver_constructor(cfg);
     if (!httpserver_ptr)
     {
-        LOG("ERROR", "Failed to create HTTPServer instance.");
+        LOG(ERROR, "Failed to create HTTPServer instance.");
+        free_config(cfg);
         return EXIT_FAILURE;
     }
 
     int is_launched = httpserver_ptr->launch(httpserver_ptr);
     if (is_launched < 0)
     {
-        LOG("ERROR", "HTTPServer launch function faced an error, with code %d.", is_launched);
+        LOG(ERROR, "HTTPServer launch function faced an error, with code %d.", is_launched);
         httpserver_destructor(httpserver_ptr);
         return EXIT_FAILURE;
     }
 
     httpserver_destructor(httpserver_ptr);
-    free_config(cfg);
 
     return EXIT_SUCCESS;
 }
 
 void handle_signal(int sig)
 {
-    switch (sig)
-    {
-    case SIGINT:
-        fprintf(stderr, "\n\033[31m[!] SIGINT received. Cleaning up...\033[0m\n");
-        break;
-    case SIGSEGV:
-        fprintf(
-            stderr,
-            "\n\033[31m[!] SIGSEGV received. Possible segmentation fault. Cleaning up...\033[0m\n");
-        break;
-    case SIGTERM:
-        fprintf(stderr, "\n\033[31m[!] SIGTERM received. Terminating gracefully...\033[0m\n");
-        break;
-    default:
-        fprintf(stderr, "\n\03[33m[!] Signal %d received. Cleaning up...\033[0m\n", sig);
-    }
-
-    if (httpserver_ptr)
-    {
-        httpserver_destructor(httpserver_ptr);
-        httpserver_ptr = NULL;
-    }
+    if (sig == SIGSEGV)
+        fprintf(stderr,
+                "\n\033[31m[!] SIGSEGV received. Possible segmentation fault.\033[0m\n");
+    else
+        fprintf(stderr, "\n\033[33m[!] Signal %d received.\033[0m\n", sig);
 
-    exit(EXIT_FAILURE);
+    _exit(EXIT_FAILURE);
 }
-
-void init_config(void) {}
\ No newline at end of file
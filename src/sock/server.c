@@ -27,7 +27,7 @@ SocketServer *server_constructor(int domain, int service, int protocol, uint32_t
 
     server_ptr->socket = socket(domain, service, protocol);
 
-    if (server_ptr->socket == 0)
+    if (server_ptr->socket < 0)
     {
         perror("Failed to connect socket...");
         exit(1);
@@ -41,6 +41,37 @@ SocketServer *server_constructor(int domain, int service, int protocol, uint32_t
         exit(1);
     }
 
+    // Every worker binds its own listener to the same port, kernel spreads accepts between them
+    if (setsockopt(server_ptr->socket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+    {
+        perror("setsockopt(SO_REUSEPORT) failed");
+        close(server_ptr->socket);
+        exit(1);
+    }
+
+    return server_ptr;
+}
+
+/**
+ * @brief   Wraps a listening socket inherited from the binary this one
+ *          replaces. It is already bound, listen() only applies @p queue.
+ */
+SocketServer *server_from_socket(int socket, int port, int queue)
+{
+    SocketServer *server_ptr = (SocketServer *)calloc(1, sizeof(SocketServer));
+    if (!server_ptr) return NULL;
+
+    socklen_t address_len = sizeof(server_ptr->address);
+    getsockname(socket, (struct sockaddr *)&server_ptr->address, &address_len);
+    server_ptr->domain    = AF_INET;
+    server_ptr->service   = SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC;
+    server_ptr->port      = port;
+    server_ptr->interface = ntohl(server_ptr->address.sin_addr.s_addr);
+    server_ptr->queue     = queue;
+    server_ptr->socket    = socket;
+
+    // The file status flags are shared with the old process, which set O_NONBLOCK
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK);
     return server_ptr;
 }
 
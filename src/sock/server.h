@@ -40,5 +40,6 @@ typedef struct Server
 
 SocketServer *server_constructor(int domain, int service, int protocol, uint32_t interface,
                                  int port, int queue);
+SocketServer *server_from_socket(int socket, int port, int queue);
 void server_destructor(SocketServer *server);
 #endif /* SERVER_H */
\ No newline at end of file
@@ -0,0 +1,153 @@
+/**
+ * @file    arena.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   Bump allocator implementations.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+
+static ArenaBlock *arena_grow(Arena *arena, size_t size);
+
+/**
+ * @brief   Allocates the first block up front.
+ *
+ * @returns 0 on success, -1 if it could not be allocated.
+ */
+int arena_init(Arena *arena, size_t block_size)
+{
+    arena->head       = NULL;
+    arena->first      = NULL;
+    arena->block_size = block_size;
+    arena->floor      = 0;
+
+    arena->first = arena_grow(arena, block_size);
+    return arena->first ? 0 : -1;
+}
+
+void arena_destroy(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    while (block)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    memset(arena, 0, sizeof(Arena));
+}
+
+/**
+ * @brief   Frees everything allocated since arena_set_floor(). Blocks added
+ *          for overflow are returned to the system, the first one is kept.
+ */
+void arena_reset(Arena *arena)
+{
+    while (arena->head && arena->head != arena->first)
+    {
+        ArenaBlock *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+    if (arena->first) arena->first->used = arena->floor;
+}
+
+/**
+ * @brief   Makes the allocations so far permanent, e.g. per-connection
+ *          arrays set up once. Only valid while the first block is current.
+ */
+void arena_set_floor(Arena *arena)
+{
+    if (arena->head == arena->first && arena->first) arena->floor = arena->first->used;
+}
+
+/**
+ * @returns @p size bytes aligned to 16, or NULL if a new block could not be
+ *          allocated.
+ */
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    ArenaBlock *block = arena->head;
+    if (!block || block->size - block->used < size)
+    {
+        block = arena_grow(arena, size > arena->block_size ? size : arena->block_size);
+        if (!block) return NULL;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+/**
+ * @brief   Grows the latest allocation in place when possible, otherwise
+ *          copies it. The old space is only reclaimed on reset.
+ */
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t size)
+{
+    ArenaBlock *block = arena->head;
+    size_t aligned    = (old_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if (ptr && block && (char *)ptr + aligned == block->data + block->used)
+    {
+        size_t grown = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+        if ((char *)ptr + grown <= block->data + block->size)
+        {
+            block->used = (char *)ptr + grown - block->data;
+            return ptr;
+        }
+    }
+
+    void *copy = arena_alloc(arena, size);
+    if (copy && ptr) memcpy(copy, ptr, old_size < size ? old_size : size);
+    return copy;
+}
+
+char *arena_strdup(Arena *arena, const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *copy = arena_alloc(arena, len);
+    if (copy) memcpy(copy, str, len);
+    return copy;
+}
+
+char *arena_sprintf(Arena *arena, const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (len < 0) return NULL;
+
+    char *str = arena_alloc(arena, len + 1);
+    if (!str) return NULL;
+
+    va_start(args, fmt);
+    vsnprintf(str, len + 1, fmt, args);
+    va_end(args);
+    return str;
+}
+
+// ---------- UTILS ----------
+
+static ArenaBlock *arena_grow(Arena *arena, size_t size)
+{
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (!block) return NULL;
+
+    block->next = arena->head;
+    block->size = size;
+    block->used = 0;
+    arena->head = block;
+    return block;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file    arena.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   Bump allocator for objects that share one lifetime.
+ */
+
+#ifndef UTILS_ARENA_H
+#define UTILS_ARENA_H
+
+#include <stddef.h>
+
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next; // older block
+    size_t size;             // usable bytes in data
+    size_t used;             // bytes handed out
+    char data[] __attribute__((aligned(16)));
+} ArenaBlock;
+
+/**
+ * @brief   Allocations are never freed one by one. arena_reset() drops all
+ *          of them at once except those made before arena_set_floor(), and
+ *          keeps the first block so the next round doesn't call malloc().
+ */
+typedef struct Arena
+{
+    ArenaBlock *head;  // block allocations are carved from
+    ArenaBlock *first; // block kept across resets
+    size_t block_size; // size of regular blocks
+    size_t floor;      // bytes of the first block that survive a reset
+} Arena;
+
+int arena_init(Arena *arena, size_t block_size);
+void arena_destroy(Arena *arena);
+void arena_reset(Arena *arena);
+void arena_set_floor(Arena *arena);
+
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t size);
+char *arena_strdup(Arena *arena, const char *str);
+char *arena_sprintf(Arena *arena, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#endif /* UTILS_ARENA_H */
@@ -0,0 +1,40 @@
+/**
+ * @file    clock.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   Monotonic time helpers implementations.
+ */
+
+#include "clock.h"
+
+/**
+ * @brief   Milliseconds since an arbitrary point, unaffected by wall clock
+ *          changes. Use it for deadlines and durations only.
+ */
+uint64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief   monotonic_ms() in microseconds, for latencies.
+ */
+uint64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief   monotonic_ms() in nanoseconds, for timing short sections.
+ */
+uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
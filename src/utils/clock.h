@@ -0,0 +1,19 @@
+/**
+ * @file    clock.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   Monotonic time helpers.
+ */
+
+#ifndef UTILS_CLOCK_H
+#define UTILS_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+uint64_t monotonic_ms(void);
+uint64_t monotonic_us(void);
+uint64_t monotonic_ns(void);
+
+#endif /* UTILS_CLOCK_H */
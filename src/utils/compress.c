@@ -0,0 +1,53 @@
+/**
+ * @file    compress.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   gzip compression implementations.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <zlib.h>
+#include "compress.h"
+
+#define GZIP_LEVEL 6         // zlib's default, compression is done once per file version
+#define GZIP_WINDOW (15 + 16) // 32 KiB window, gzip wrapper instead of zlib's
+
+/**
+ * @brief   Compresses @p data in one go into a gzip stream.
+ *
+ * @param   out_len  Set to the length of the stream.
+ *
+ * @returns The stream, allocated with malloc(), NULL on failure.
+ */
+char *gzip_compress(const char *data, size_t len, size_t *out_len)
+{
+    z_stream stream = {0};
+    if (len > UINT_MAX) return NULL; // avail_in is an unsigned int
+    if (deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, GZIP_WINDOW, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return NULL;
+
+    size_t cap = deflateBound(&stream, len);
+    char *out  = malloc(cap);
+    if (!out)
+    {
+        deflateEnd(&stream);
+        return NULL;
+    }
+
+    stream.next_in   = (Bytef *)data;
+    stream.avail_in  = len;
+    stream.next_out  = (Bytef *)out;
+    stream.avail_out = cap;
+    int status       = deflate(&stream, Z_FINISH);
+    *out_len         = stream.total_out;
+    deflateEnd(&stream);
+
+    if (status != Z_STREAM_END)
+    {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
@@ -0,0 +1,29 @@
+/**
+ * @file    compress.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   Content codings and gzip compression prototypes.
+ */
+
+#ifndef UTILS_COMPRESS_H
+#define UTILS_COMPRESS_H
+
+#include <stddef.h>
+
+/**
+ * @brief   Content-Encoding of a response body.
+ */
+typedef enum
+{
+    ENC_IDENTITY = 0,
+    ENC_GZIP,
+    ENC_BR,
+    ENC_COUNT
+} ContentEncoding;
+
+#define ENC_BIT(enc) (1u << (enc))
+
+char *gzip_compress(const char *data, size_t len, size_t *out_len);
+
+#endif /* UTILS_COMPRESS_H */
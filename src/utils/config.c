@@ -22,12 +22,35 @@
  * - root
  * - static_dir
  * - backend
+ * - workers (0 or missing = number of online CPUs)
+ * - cpu_affinity (on/off)
+ * - numa (on/off)
+ * - max_connections (per worker), listen_backlog
+ * - edge_triggered (on/off)
+ * - io_backend (epoll or io_uring)
+ * - idle_timeout, header_timeout, body_timeout (seconds, 0 disables)
+ * - shutdown_timeout (seconds a drain waits for in-flight requests)
+ * - max_body_size (0 = unlimited), client_buffer_size (bytes, K/M/G allowed)
+ * - log_level (debug, info, warning, error)
+ * - access_log (file path or off), access_log_format (json, binary),
+ *   access_log_sample (0 to 1)
+ * - upstream_min_idle, upstream_max_idle, upstream_idle_timeout (seconds)
+ * - balance (round_robin, least_conn, hash) and balance_key (uri or header name)
+ * - backend_max_fails, backend_fail_timeout (seconds)
+ * - static_cache_size, static_cache_max_file (bytes, K/M/G suffixes allowed)
+ * - static_cache_revalidate (ms), static_cache_inotify (on/off)
+ * - static_precompressed, static_compress (on/off)
+ * - static_bundle (file made by cserver-pack, or off)
+ * - proxy_cache_size, proxy_cache_max_entry (bytes, K/M/G suffixes allowed)
+ * - route (<pattern> <handler> [args], see router.c)
  *
  * If a key is not recognized, it will be ignored.
  *
  * If a key is repeated, the last value will be used.
  *
- * The backend key can be repeated multiple times to specify multiple backends.
+ * The backend key can be repeated multiple times to specify multiple backends,
+ * and the route key to declare a routing table, which replaces the default
+ * routes to the stats page, /static and /api.
  *
  * The function returns a pointer to a Config struct if the config file is
  * parsed successfully, otherwise it returns NULL.
@@ -46,6 +69,40 @@ Config *parse_config(const char *filename)
     Config *cfg        = calloc(1, sizeof(Config));
     cfg->backends      = calloc(MAX_BACKENDS, sizeof(char *));
     cfg->backend_count = 0;
+    cfg->routes        = calloc(MAX_ROUTES, sizeof(char *));
+    cfg->route_count   = 0;
+
+    cfg->max_connections  = DEFAULT_MAX_CONNECTIONS;
+    cfg->listen_backlog   = DEFAULT_LISTEN_BACKLOG;
+    cfg->idle_timeout     = DEFAULT_IDLE_TIMEOUT;
+    cfg->header_timeout   = DEFAULT_HEADER_TIMEOUT;
+    cfg->body_timeout     = DEFAULT_BODY_TIMEOUT;
+    cfg->shutdown_timeout = DEFAULT_SHUTDOWN_TIMEOUT;
+    cfg->log_level        = LOG_LEVEL_INFO;
+
+    cfg->max_body_size      = DEFAULT_MAX_BODY_SIZE;
+    cfg->client_buffer_size = DEFAULT_CLIENT_BUFFER_SIZE;
+
+    cfg->access_log        = NULL;
+    cfg->access_log_binary = 0;
+    cfg->access_log_sample = 1.0;
+
+    cfg->upstream_min_idle     = 0;
+    cfg->upstream_max_idle     = DEFAULT_UPSTREAM_MAX_IDLE;
+    cfg->upstream_idle_timeout = DEFAULT_UPSTREAM_IDLE_TIMEOUT;
+    cfg->backend_max_fails     = DEFAULT_BACKEND_MAX_FAILS;
+    cfg->backend_fail_timeout  = DEFAULT_BACKEND_FAIL_TIMEOUT;
+
+    cfg->static_cache_size       = DEFAULT_STATIC_CACHE_SIZE;
+    cfg->static_cache_max_file   = DEFAULT_STATIC_CACHE_MAX_FILE;
+    cfg->static_cache_revalidate = DEFAULT_STATIC_CACHE_REVALIDATE;
+    cfg->static_cache_inotify    = 1;
+    cfg->static_precompressed    = 1;
+    cfg->static_compress         = 0;
+    cfg->static_bundle           = NULL;
+
+    cfg->proxy_cache_size      = DEFAULT_PROXY_CACHE_SIZE;
+    cfg->proxy_cache_max_entry = DEFAULT_PROXY_CACHE_MAX_ENTRY;
 
     char line[512];
     while (fgets(line, sizeof(line), f))
@@ -77,9 +134,181 @@ Config *parse_config(const char *filename)
                 cfg->backends[cfg->backend_count++] = strdup(value);
             }
         }
+        else if (strcmp(key, "route") == 0)
+        {
+            if (cfg->route_count < MAX_ROUTES)
+            {
+                cfg->routes[cfg->route_count++] = strdup(value);
+            }
+        }
+        else if (strcmp(key, "workers") == 0)
+        {
+            cfg->workers = atoi(value);
+        }
+        else if (strcmp(key, "cpu_affinity") == 0)
+        {
+            cfg->cpu_affinity = parse_bool(value);
+        }
+        else if (strcmp(key, "numa") == 0)
+        {
+            cfg->numa = parse_bool(value);
+        }
+        else if (strcmp(key, "max_connections") == 0)
+        {
+            cfg->max_connections = atoi(value);
+        }
+        else if (strcmp(key, "listen_backlog") == 0)
+        {
+            cfg->listen_backlog = atoi(value);
+        }
+        else if (strcmp(key, "edge_triggered") == 0)
+        {
+            cfg->edge_triggered = parse_bool(value);
+        }
+        else if (strcmp(key, "io_backend") == 0)
+        {
+            cfg->io_uring = strcasecmp(value, "io_uring") == 0;
+        }
+        else if (strcmp(key, "idle_timeout") == 0)
+        {
+            cfg->idle_timeout = atoi(value);
+        }
+        else if (strcmp(key, "header_timeout") == 0)
+        {
+            cfg->header_timeout = atoi(value);
+        }
+        else if (strcmp(key, "body_timeout") == 0)
+        {
+            cfg->body_timeout = atoi(value);
+        }
+        else if (strcmp(key, "shutdown_timeout") == 0)
+        {
+            cfg->shutdown_timeout = atoi(value);
+        }
+        else if (strcmp(key, "max_body_size") == 0)
+        {
+            cfg->max_body_size = parse_size(value);
+        }
+        else if (strcmp(key, "client_buffer_size") == 0)
+        {
+            cfg->client_buffer_size = parse_size(value);
+        }
+        else if (strcmp(key, "log_level") == 0)
+        {
+            int level = log_level_from_name(value);
+            if (level < 0)
+                fprintf(stderr, "Unknown log_level \"%s\", keeping info.\n", value);
+            else
+                cfg->log_level = level;
+        }
+        else if (strcmp(key, "access_log") == 0)
+        {
+            free(cfg->access_log);
+            cfg->access_log = strcasecmp(value, "off") == 0 ? NULL : strdup(value);
+        }
+        else if (strcmp(key, "access_log_format") == 0)
+        {
+            cfg->access_log_binary = strcasecmp(value, "binary") == 0;
+        }
+        else if (strcmp(key, "access_log_sample") == 0)
+        {
+            cfg->access_log_sample = atof(value);
+        }
+        else if (strcmp(key, "upstream_min_idle") == 0)
+        {
+            cfg->upstream_min_idle = atoi(value);
+        }
+        else if (strcmp(key, "upstream_max_idle") == 0)
+        {
+            cfg->upstream_max_idle = atoi(value);
+        }
+        else if (strcmp(key, "upstream_idle_timeout") == 0)
+        {
+            cfg->upstream_idle_timeout = atoi(value);
+        }
+        else if (strcmp(key, "balance") == 0)
+        {
+            free(cfg->balance);
+            cfg->balance = strdup(value);
+        }
+        else if (strcmp(key, "balance_key") == 0)
+        {
+            free(cfg->balance_key);
+            cfg->balance_key = strdup(value);
+        }
+        else if (strcmp(key, "backend_max_fails") == 0)
+        {
+            cfg->backend_max_fails = atoi(value);
+        }
+        else if (strcmp(key, "backend_fail_timeout") == 0)
+        {
+            cfg->backend_fail_timeout = atoi(value);
+        }
+        else if (strcmp(key, "static_cache_size") == 0)
+        {
+            cfg->static_cache_size = parse_size(value);
+        }
+        else if (strcmp(key, "static_cache_max_file") == 0)
+        {
+            cfg->static_cache_max_file = parse_size(value);
+        }
+        else if (strcmp(key, "static_cache_revalidate") == 0)
+        {
+            cfg->static_cache_revalidate = atoi(value);
+        }
+        else if (strcmp(key, "static_cache_inotify") == 0)
+        {
+            cfg->static_cache_inotify = parse_bool(value);
+        }
+        else if (strcmp(key, "static_precompressed") == 0)
+        {
+            cfg->static_precompressed = parse_bool(value);
+        }
+        else if (strcmp(key, "proxy_cache_size") == 0)
+        {
+            cfg->proxy_cache_size = parse_size(value);
+        }
+        else if (strcmp(key, "proxy_cache_max_entry") == 0)
+        {
+            cfg->proxy_cache_max_entry = parse_size(value);
+        }
+        else if (strcmp(key, "static_compress") == 0)
+        {
+            cfg->static_compress = parse_bool(value);
+        }
+        else if (strcmp(key, "static_bundle") == 0)
+        {
+            free(cfg->static_bundle);
+            cfg->static_bundle = strcasecmp(value, "off") == 0 ? NULL : strdup(value);
+        }
     }
 
     fclose(f);
+
+    if (cfg->workers <= 0)
+    {
+        long ncpu    = sysconf(_SC_NPROCESSORS_ONLN);
+        cfg->workers = ncpu > 0 ? (int)ncpu : 1;
+    }
+    if (cfg->workers > MAX_WORKERS) cfg->workers = MAX_WORKERS;
+    if (cfg->max_connections <= 0) cfg->max_connections = DEFAULT_MAX_CONNECTIONS;
+    if (cfg->listen_backlog <= 0) cfg->listen_backlog = DEFAULT_LISTEN_BACKLOG;
+    if (cfg->idle_timeout < 0) cfg->idle_timeout = 0;
+    if (cfg->header_timeout < 0) cfg->header_timeout = 0;
+    if (cfg->body_timeout < 0) cfg->body_timeout = 0;
+    if (cfg->shutdown_timeout < 0) cfg->shutdown_timeout = 0;
+    // A whole request head has to fit, with room left to stream its body
+    if (cfg->client_buffer_size < 2 * MAX_REQUEST_HEAD)
+        cfg->client_buffer_size = 2 * MAX_REQUEST_HEAD;
+    if (cfg->access_log_sample < 0) cfg->access_log_sample = 0;
+    if (cfg->access_log_sample > 1) cfg->access_log_sample = 1;
+
+    if (cfg->upstream_max_idle < 0) cfg->upstream_max_idle = 0;
+    if (cfg->upstream_min_idle > cfg->upstream_max_idle)
+        cfg->upstream_min_idle = cfg->upstream_max_idle;
+    if (cfg->upstream_idle_timeout <= 0)
+        cfg->upstream_idle_timeout = DEFAULT_UPSTREAM_IDLE_TIMEOUT;
+
     return cfg;
 }
 
@@ -111,6 +340,42 @@ char *strip_whitespace(char *str)
     return str;
 }
 
+/**
+ * @brief   Interprets a config value as a boolean flag.
+ *
+ * Accepts "1", "on", "yes" and "true" (case-insensitive) as true, anything
+ * else is false.
+ */
+int parse_bool(const char *value)
+{
+    return strcmp(value, "1") == 0 || strcasecmp(value, "on") == 0 ||
+           strcasecmp(value, "yes") == 0 || strcasecmp(value, "true") == 0;
+}
+
+/**
+ * @brief   Interprets a config value as a byte count with an optional K, M
+ *          or G suffix (powers of 1024).
+ */
+size_t parse_size(const char *value)
+{
+    char *end;
+    unsigned long long size = strtoull(value, &end, 10);
+
+    switch (toupper((unsigned char)*end))
+    {
+    case 'G':
+        size *= 1024;
+        /* fall through */
+    case 'M':
+        size *= 1024;
+        /* fall through */
+    case 'K':
+        size *= 1024;
+        break;
+    }
+    return (size_t)size;
+}
+
 void free_config(Config *cfg)
 {
     for (size_t i = 0; i < cfg->backend_count; ++i)
@@ -118,7 +383,16 @@ void free_config(Config *cfg)
         free(cfg->backends[i]);
     }
     free(cfg->backends);
+    for (size_t i = 0; i < cfg->route_count; ++i)
+    {
+        free(cfg->routes[i]);
+    }
+    free(cfg->routes);
     free(cfg->root);
     free(cfg->static_dir);
+    free(cfg->static_bundle);
+    free(cfg->balance);
+    free(cfg->balance_key);
+    free(cfg->access_log);
     free(cfg);
 }
\ No newline at end of file
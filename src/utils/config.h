@@ -10,6 +10,7 @@
 #define CONFIGS_CONFIG_H
 
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
 #include <stdlib.h>
 #include <fcntl.h>
@@ -24,9 +25,52 @@ typedef struct
     char *static_dir;
     char **backends;
     size_t backend_count;
+    char **routes; // "<pattern> <handler> [args]" specs, see router.c
+    size_t route_count;
+    int workers;          // number of event loops, 0 = one per online CPU
+    int cpu_affinity;     // pin each worker to its own CPU when non-zero
+    int numa;             // spread pinned workers over NUMA nodes, memory on their node
+    int max_connections;  // client connections per worker
+    int listen_backlog;   // pending connections queued per listener
+    int edge_triggered;   // EPOLLET for listener and client sockets when non-zero
+    int io_uring;         // drive client sockets with io_uring instead of epoll
+    int idle_timeout;     // seconds a keep-alive connection may wait for its next request
+    int header_timeout;   // seconds to receive a whole request head
+    int body_timeout;     // seconds allowed between two reads of a request body
+    int shutdown_timeout; // seconds a drain waits before closing busy connections
+    int log_level;        // LOG_LEVEL_* records below it are skipped
+
+    size_t max_body_size;      // largest request body accepted, 0 = unlimited
+    size_t client_buffer_size; // input buffer cap per connection, bodies stream through it
+
+    char *access_log;         // access log file, NULL = no access log
+    int access_log_binary;    // packed binary records instead of JSON lines
+    double access_log_sample; // fraction of requests logged, errors always are
+
+    int upstream_min_idle;     // idle connections kept open per backend and worker
+    int upstream_max_idle;     // idle connections pooled at most per backend and worker
+    int upstream_idle_timeout; // seconds before an idle upstream connection is closed
+
+    char *balance;            // round_robin, least_conn or hash
+    char *balance_key;        // hash input: "uri" or a request header name
+    int backend_max_fails;    // consecutive failures before a backend is ejected
+    int backend_fail_timeout; // seconds an ejected backend is skipped
+
+    size_t static_cache_size;     // byte budget of the static file cache, shared by all workers
+    size_t static_cache_max_file; // larger files are always sent with sendfile()
+    int static_cache_revalidate;  // ms between stat() checks of a cached file without inotify
+    int static_cache_inotify;     // invalidate cached files with inotify instead of stat()
+    int static_precompressed;     // serve file.br / file.gz siblings to clients accepting them
+    int static_compress;          // gzip cacheable text files once and cache the result
+    char *static_bundle;          // cserver-pack bundle serving its directory, NULL = disk only
+
+    size_t proxy_cache_size;      // byte budget of the proxy response cache, shared by all workers
+    size_t proxy_cache_max_entry; // larger responses are never cached
 } Config;
 
 char *strip_whitespace(char *str);
+int parse_bool(const char *value);
+size_t parse_size(const char *value);
 Config *parse_config(const char *filename);
 void free_config(Config *cfg);
 
@@ -1,20 +1,421 @@
+/**
+ * @file    logger.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   Asynchronous logger implementations.
+ *
+ * @details Callers format a record into a slot of a bounded lock-free ring
+ *          (Vyukov's MPMC queue, used with a single consumer) and go on; a
+ *          background thread drains the ring and writes whole batches to
+ *          stdout with one write() each. When the ring is full records are
+ *          dropped and counted instead of blocking a worker. Timestamps are
+ *          formatted at most once a second per thread.
+ *
+ *          A thread that logs a lot (every worker) calls log_attach_thread()
+ *          and gets a ring of its own, which it fills without an atomic
+ *          read-modify-write, so workers don't contend for the shared
+ *          ring's position. The flusher sweeps all rings: the records of
+ *          one thread stay in order, those of different threads are in
+ *          sweep order, by the timestamp they carry.
+ *
+ *          The access log shares the ring: its records are tagged with
+ *          their own sink and the flusher writes them to the access log
+ *          file instead of stdout.
+ *
+ *          Before log_start() and after log_stop() records are written
+ *          synchronously, so tools and tests that never start the thread
+ *          still see them.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
 #include "logger.h"
 
-void log_message(const char *level, const char *file, int line, const char *fmt, ...)
+#define LOG_BATCH_SIZE 65536  // bytes written per write() at most
+#define LOG_IDLE_SLEEP_MS 10  // flusher pause when the rings are empty
+#define LOG_THREAD_SLOTS 1024 // slots of a thread's own ring, a power of two
+#define LOG_MAX_RINGS 256     // threads with their own ring, later ones share
+
+typedef enum
+{
+    SINK_STDOUT, // LOG() records
+    SINK_ACCESS, // log_access() records
+    SINK_COUNT
+} LogSink;
+
+typedef struct
+{
+    atomic_size_t seq; // ring position the slot is ready for
+    LogSink sink;      // where the record goes
+    size_t len;        // bytes in line
+    char line[LOG_LINE_MAX];
+} LogSlot;
+
+/**
+ * @brief   Producers and the flusher work on opposite ends, each on its own
+ *          cache line.
+ */
+typedef struct LogRing
+{
+    _Alignas(64) atomic_size_t enqueue_pos; // next position a producer claims
+    _Alignas(64) size_t dequeue_pos;        // next position the flusher reads
+    LogSlot *slots;
+    size_t mask;  // slots - 1
+    int multiple; // several producers, positions are claimed with a CAS
+} LogRing;
+
+int log_level = LOG_LEVEL_INFO;
+
+static const char *level_names[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+
+static LogRing shared_ring;
+static LogRing *_Atomic thread_rings[LOG_MAX_RINGS];
+static atomic_int thread_ring_count;
+static __thread LogRing *own_ring;
+static atomic_size_t dropped;
+static atomic_int running;
+static pthread_t flusher;
+static int sink_fds[SINK_COUNT] = {STDOUT_FILENO, -1};
+
+static LogRing *ring_create(LogRing *ring, size_t slots, int multiple);
+static LogSlot *claim_slot(LogRing *ring, size_t *pos);
+static void *flush_loop(void *arg);
+static size_t flush_rings(char *batch);
+static size_t drain(LogRing *ring, char *batch, size_t size, LogSink *sink);
+static void write_all(int fd, const char *data, size_t len);
+static size_t format_record(char *dst, size_t size, int level, const char *file, int line,
+                            const char *fmt, va_list args);
+
+/**
+ * @returns The LOG_LEVEL_* for "debug", "info", "warning" or "error", or -1.
+ */
+int log_level_from_name(const char *name)
+{
+    for (int i = 0; i < (int)(sizeof(level_names) / sizeof(level_names[0])); i++)
+    {
+        if (strcasecmp(name, level_names[i]) == 0) return i;
+    }
+    if (strcasecmp(name, "warn") == 0) return LOG_LEVEL_WARNING;
+    return -1;
+}
+
+/**
+ * @brief   Starts the flusher thread. Records logged before are already out.
+ *
+ * @returns 0 on success, -1 if the logger stays synchronous.
+ */
+int log_start(void)
+{
+    if (atomic_load(&running)) return 0;
+    if (!shared_ring.slots && !ring_create(&shared_ring, LOG_RING_SLOTS, 1)) return -1;
+
+    atomic_store(&running, 1);
+    if (pthread_create(&flusher, NULL, flush_loop, NULL) != 0)
+    {
+        atomic_store(&running, 0);
+        return -1;
+    }
+    atexit(log_stop);
+    return 0;
+}
+
+/**
+ * @brief   Writes out everything buffered and stops the flusher thread.
+ */
+void log_stop(void)
 {
-    time_t now   = time(NULL);
-    struct tm *t = localtime(&now);
+    if (!atomic_exchange(&running, 0)) return;
+    pthread_join(flusher, NULL);
 
-    char buf[64];
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", t);
+    // Producers that raced with the stop may have finished a record since
+    char *batch = malloc(LOG_BATCH_SIZE);
+    if (batch)
+    {
+        while (flush_rings(batch) > 0)
+            ;
+        free(batch);
+    }
+}
+
+/**
+ * @brief   Gives the calling thread a ring of its own, allocated on its NUMA
+ *          node if the thread is pinned. Rings stay until the process exits,
+ *          so records of a thread that ended are still written.
+ *
+ * @returns 0 on success, -1 if the thread keeps using the shared ring.
+ */
+int log_attach_thread(void)
+{
+    if (own_ring) return 0;
 
-    fprintf(stdout, "[%s] [%s] (%s:%d) ", buf, level, file, line);
+    LogRing *ring = aligned_alloc(_Alignof(LogRing), sizeof(LogRing));
+    if (!ring) return -1;
+    if (!ring_create(ring, LOG_THREAD_SLOTS, 0))
+    {
+        free(ring);
+        return -1;
+    }
 
+    int index = atomic_fetch_add(&thread_ring_count, 1);
+    if (index >= LOG_MAX_RINGS)
+    {
+        free(ring->slots);
+        free(ring);
+        return -1;
+    }
+    atomic_store_explicit(&thread_rings[index], ring, memory_order_release);
+    own_ring = ring;
+    return 0;
+}
+
+void log_message(int level, const char *file, int line, const char *fmt, ...)
+{
     va_list args;
     va_start(args, fmt);
-    vfprintf(stdout, fmt, args);
+
+    if (!atomic_load_explicit(&running, memory_order_acquire))
+    {
+        char record[LOG_LINE_MAX];
+        size_t len = format_record(record, sizeof(record), level, file, line, fmt, args);
+        va_end(args);
+        write_all(STDOUT_FILENO, record, len);
+        return;
+    }
+
+    size_t pos;
+    LogSlot *slot = claim_slot(own_ring ? own_ring : &shared_ring, &pos);
+    if (slot)
+    {
+        slot->sink = SINK_STDOUT;
+        slot->len  = format_record(slot->line, sizeof(slot->line), level, file, line, fmt, args);
+        atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    }
     va_end(args);
+}
+
+/**
+ * @brief   Opens (appends to) the file log_access() records go to.
+ *
+ * @returns 0 on success, -1 if it can't be opened.
+ */
+int log_open_access(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    if (sink_fds[SINK_ACCESS] >= 0) close(sink_fds[SINK_ACCESS]);
+    sink_fds[SINK_ACCESS] = fd;
+    return 0;
+}
+
+/**
+ * @brief   Queues an already formatted access log record, written as is.
+ *          Records longer than LOG_LINE_MAX are dropped.
+ */
+void log_access(const void *record, size_t len)
+{
+    if (sink_fds[SINK_ACCESS] < 0 || len > LOG_LINE_MAX) return;
+
+    if (!atomic_load_explicit(&running, memory_order_acquire))
+    {
+        write_all(sink_fds[SINK_ACCESS], record, len);
+        return;
+    }
+
+    size_t pos;
+    LogSlot *slot = claim_slot(own_ring ? own_ring : &shared_ring, &pos);
+    if (!slot) return;
+    slot->sink = SINK_ACCESS;
+    slot->len  = len;
+    memcpy(slot->line, record, len);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+// ---------- UTILS ----------
+
+/**
+ * @returns @p ring with @p slots empty slots, NULL if memory runs out.
+ */
+static LogRing *ring_create(LogRing *ring, size_t slots, int multiple)
+{
+    ring->slots = malloc(slots * sizeof(LogSlot));
+    if (!ring->slots) return NULL;
+    for (size_t i = 0; i < slots; i++)
+        atomic_init(&ring->slots[i].seq, i);
+    atomic_init(&ring->enqueue_pos, 0);
+    ring->dequeue_pos = 0;
+    ring->mask        = slots - 1;
+    ring->multiple    = multiple;
+    return ring;
+}
+
+/**
+ * @brief   Claims the next ring slot for the caller to fill and publish by
+ *          storing pos + 1 in its seq.
+ *
+ * @returns The slot, or NULL (record dropped) if the flusher is behind.
+ */
+static LogSlot *claim_slot(LogRing *ring, size_t *pos_out)
+{
+    size_t pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    while (1)
+    {
+        LogSlot *slot = &ring->slots[pos & ring->mask];
+        size_t seq    = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0 && !ring->multiple)
+        {
+            // The owning thread is the only producer, a plain store claims it
+            atomic_store_explicit(&ring->enqueue_pos, pos + 1, memory_order_relaxed);
+            *pos_out = pos;
+            return slot;
+        }
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                *pos_out = pos;
+                return slot;
+            }
+        }
+        else if (diff < 0)
+        {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return NULL;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static void *flush_loop(void *arg)
+{
+    (void)arg;
+    char *batch = malloc(LOG_BATCH_SIZE);
+    if (!batch) return NULL;
+
+    while (atomic_load(&running))
+    {
+        if (flush_rings(batch) > 0) continue;
+
+        size_t lost = atomic_exchange_explicit(&dropped, 0, memory_order_relaxed);
+        if (lost > 0)
+        {
+            char note[96];
+            int n = snprintf(note, sizeof(note), "[logger] %zu records dropped, ring full\n", lost);
+            write_all(STDOUT_FILENO, note, (size_t)n);
+        }
+
+        struct timespec pause = {0, LOG_IDLE_SLEEP_MS * 1000000L};
+        nanosleep(&pause, NULL);
+    }
+
+    free(batch);
+    return NULL;
+}
+
+/**
+ * @brief   Writes one batch from every ring that has records.
+ *
+ * @returns Bytes written over all rings, 0 once they are all empty.
+ */
+static size_t flush_rings(char *batch)
+{
+    size_t total = 0;
+    int count    = atomic_load(&thread_ring_count);
+    if (count > LOG_MAX_RINGS) count = LOG_MAX_RINGS;
+
+    for (int i = -1; i < count; i++)
+    {
+        LogRing *ring = i < 0 ? &shared_ring
+                              : atomic_load_explicit(&thread_rings[i], memory_order_acquire);
+        if (!ring || !ring->slots) continue; // registered, not published yet
+
+        LogSink sink = SINK_STDOUT;
+        size_t len   = drain(ring, batch, LOG_BATCH_SIZE, &sink);
+        if (len == 0) continue;
+        write_all(sink_fds[sink], batch, len);
+        total += len;
+    }
+    return total;
+}
+
+/**
+ * @brief   Copies finished records of one sink into @p batch until it is
+ *          full, the next record isn't complete yet or goes elsewhere. Only
+ *          the flusher (or log_stop() once it has exited) calls this.
+ *
+ * @returns Bytes copied, and the sink they go to in @p sink.
+ */
+static size_t drain(LogRing *ring, char *batch, size_t size, LogSink *sink)
+{
+    size_t len = 0;
+    while (1)
+    {
+        LogSlot *slot = &ring->slots[ring->dequeue_pos & ring->mask];
+        size_t seq    = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != ring->dequeue_pos + 1 || len + slot->len > size) break;
+        if (len > 0 && slot->sink != *sink) break;
+        *sink = slot->sink;
+
+        memcpy(batch + len, slot->line, slot->len);
+        len += slot->len;
+        atomic_store_explicit(&slot->seq, ring->dequeue_pos + ring->mask + 1,
+                              memory_order_release);
+        ring->dequeue_pos++;
+    }
+    return len;
+}
+
+static void write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+/**
+ * @brief   "[date time] [LEVEL] (file:line) message\n", truncated to fit.
+ *          The date is reformatted only when the second changes.
+ */
+static size_t format_record(char *dst, size_t size, int level, const char *file, int line,
+                            const char *fmt, va_list args)
+{
+    static __thread time_t cached_sec = -1;
+    static __thread char cached_time[32];
+
+    time_t now = time(NULL);
+    if (now != cached_sec)
+    {
+        struct tm t;
+        localtime_r(&now, &t);
+        strftime(cached_time, sizeof(cached_time), "%Y-%m-%d %H:%M:%S", &t);
+        cached_sec = now;
+    }
+
+    int n = snprintf(dst, size, "[%s] [%s] (%s:%d) ", cached_time, level_names[level], file, line);
+    size_t len = n < 0 ? 0 : (size_t)n < size - 1 ? (size_t)n : size - 1;
+
+    n = vsnprintf(dst + len, size - len, fmt, args);
+    if (n > 0) len = len + (size_t)n < size - 1 ? len + (size_t)n : size - 1;
 
-    fprintf(stdout, "\n");
-    fflush(stdout);
+    dst[len++] = '\n';
+    return len;
 }
@@ -1,7 +1,58 @@
+/**
+ * @file    logger.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   Leveled logging through an asynchronous ring buffer.
+ */
+
+#ifndef UTILS_LOGGER_H
+#define UTILS_LOGGER_H
+
 #include <stdio.h>
 #include <time.h>
 #include <stdarg.h>
+#include <stdint.h>
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR 3
+
+// Records below this level are compiled out, arguments included.
+// Build with -DLOG_COMPILE_LEVEL=0 (make LOG_DEBUG=1) to keep DEBUG.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SLOTS 4096 // records buffered before new ones are dropped, a power of two
+#define LOG_LINE_MAX 512    // longer records are truncated
+
+/**
+ * @brief   LOG(INFO, "fmt", ...). The level is one of DEBUG, INFO, WARNING
+ *          and ERROR, checked against LOG_COMPILE_LEVEL by the compiler and
+ *          against log_level at runtime before anything is formatted.
+ *          log_level changes on reload while workers log, so it's read
+ *          with a relaxed atomic load.
+ */
+#define LOG(level, fmt, ...)                                                                   \
+    do                                                                                         \
+    {                                                                                          \
+        if (LOG_LEVEL_##level >= LOG_COMPILE_LEVEL &&                                          \
+            LOG_LEVEL_##level >= __atomic_load_n(&log_level, __ATOMIC_RELAXED))                \
+            log_message(LOG_LEVEL_##level, __FILE__, __LINE__, fmt, ##__VA_ARGS__);            \
+    } while (0)
+
+extern int log_level;
+
+int log_level_from_name(const char *name);
+int log_start(void);
+void log_stop(void);
+int log_attach_thread(void);
+void log_message(int level, const char *file, int line, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
 
-#define LOG(level, fmt, ...) log_message(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__)
+int log_open_access(const char *path);
+void log_access(const void *record, size_t len);
 
-void log_message(const char *level, const char *file, int line, const char *fmt, ...);
\ No newline at end of file
+#endif /* UTILS_LOGGER_H */
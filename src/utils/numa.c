@@ -0,0 +1,123 @@
+/**
+ * @file    numa.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   NUMA placement implementations.
+ *
+ * @details The topology comes from /sys/devices/system/node and the memory
+ *          policy is set with the raw syscall, so there is no libnuma
+ *          dependency. A kernel without NUMA support has no node directory
+ *          and the caller falls back to plain CPU pinning.
+ */
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include "numa.h"
+
+#define NODE_MASK_WORDS (NUMA_MAX_NODES / (8 * sizeof(unsigned long)))
+
+static int read_node_cpus(int node, const cpu_set_t *allowed, int *cpus, int capacity);
+
+/**
+ * @brief   Spreads @p count workers over the NUMA nodes, one node after the
+ *          other, and gives each a CPU of its node. Only CPUs the process may
+ *          run on (taskset, cpuset cgroup) are used; more workers than CPUs
+ *          share them.
+ *
+ * @returns Nodes used, with the CPU and node of worker i in @p cpus[i] and
+ *          @p nodes[i], or -1 if the topology can't be read.
+ */
+int numa_place_workers(int count, int *cpus, int *nodes)
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) return -1;
+
+    int node_ids[NUMA_MAX_NODES];
+    int *node_cpus[NUMA_MAX_NODES];
+    int node_cpu_count[NUMA_MAX_NODES];
+    int node_count = 0;
+    for (int node = 0; node < NUMA_MAX_NODES; node++)
+    {
+        int *list = malloc(CPU_SETSIZE * sizeof(int));
+        if (!list) break;
+
+        int n = read_node_cpus(node, &allowed, list, CPU_SETSIZE);
+        if (n <= 0)
+        {
+            free(list);
+            continue;
+        }
+        node_ids[node_count]       = node;
+        node_cpus[node_count]      = list;
+        node_cpu_count[node_count] = n;
+        node_count++;
+    }
+
+    for (int i = 0; i < count && node_count > 0; i++)
+    {
+        int n    = i % node_count;
+        cpus[i]  = node_cpus[n][(i / node_count) % node_cpu_count[n]];
+        nodes[i] = node_ids[n];
+    }
+
+    for (int n = 0; n < node_count; n++)
+        free(node_cpus[n]);
+    return node_count > 0 ? node_count : -1;
+}
+
+/**
+ * @brief   Makes the calling thread's new pages come from @p node while it
+ *          has free memory, or from the default local node again if
+ *          @p node is negative. An inherited policy, e.g. numactl
+ *          --interleave, is replaced.
+ *
+ * @returns 0 on success, -1 if the kernel refuses.
+ */
+int numa_prefer_node(int node)
+{
+    if (node < 0) return (int)syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+    if (node >= NUMA_MAX_NODES) return -1;
+
+    unsigned long mask[NODE_MASK_WORDS] = {0};
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    return (int)syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, NUMA_MAX_NODES + 1);
+}
+
+// ---------- UTILS ----------
+
+/**
+ * @brief   Parses the node's cpulist ("0-15,32-47") into the CPUs of it the
+ *          process may use.
+ *
+ * @returns CPUs written to @p cpus, -1 if the node doesn't exist.
+ */
+static int read_node_cpus(int node, const cpu_set_t *allowed, int *cpus, int capacity)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+
+    char list[4096];
+    int ok = fgets(list, sizeof(list), file) != NULL;
+    fclose(file);
+    if (!ok) return -1;
+
+    int count = 0;
+    char *p   = list;
+    while (*p >= '0' && *p <= '9')
+    {
+        long first = strtol(p, &p, 10);
+        long last  = first;
+        if (*p == '-') last = strtol(p + 1, &p, 10);
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE && count < capacity; cpu++)
+            if (CPU_ISSET(cpu, allowed)) cpus[count++] = (int)cpu;
+        if (*p == ',') p++;
+    }
+    return count;
+}
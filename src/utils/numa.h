@@ -0,0 +1,17 @@
+/**
+ * @file    numa.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   NUMA placement of worker threads and their memory.
+ */
+
+#ifndef UTILS_NUMA_H
+#define UTILS_NUMA_H
+
+#define NUMA_MAX_NODES 64 // nodes looked at, higher ones are ignored
+
+int numa_place_workers(int count, int *cpus, int *nodes);
+int numa_prefer_node(int node);
+
+#endif /* UTILS_NUMA_H */
@@ -0,0 +1,97 @@
+/**
+ * @file    timerwheel.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   Hashed timer wheel implementations.
+ */
+
+#include "timerwheel.h"
+
+static void link_node(TimerNode *head, TimerNode *node);
+
+void timerwheel_init(TimerWheel *wheel, uint64_t now)
+{
+    for (size_t i = 0; i < TIMER_WHEEL_SLOTS; i++)
+    {
+        wheel->slots[i].next = &wheel->slots[i];
+        wheel->slots[i].prev = &wheel->slots[i];
+    }
+    wheel->tick = now / TIMER_TICK_MS;
+    wheel->now  = now;
+}
+
+/**
+ * @brief   (Re)arms @p node to fire @p delay_ms after the last advance.
+ */
+void timerwheel_arm(TimerWheel *wheel, TimerNode *node, uint64_t delay_ms)
+{
+    timerwheel_cancel(node);
+    node->expires = wheel->now + delay_ms;
+
+    // Never behind the tick being expired, or it would wait a whole turn
+    uint64_t tick = node->expires / TIMER_TICK_MS;
+    if (tick < wheel->tick) tick = wheel->tick;
+    link_node(&wheel->slots[tick & (TIMER_WHEEL_SLOTS - 1)], node);
+}
+
+void timerwheel_cancel(TimerNode *node)
+{
+    if (!timer_armed(node)) return;
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->next       = NULL;
+    node->prev       = NULL;
+}
+
+/**
+ * @brief   Calls @p fn for every timer due at @p now, already unlinked.
+ *          The callback may arm or cancel any timer, itself included.
+ */
+void timerwheel_advance(TimerWheel *wheel, uint64_t now, TimerFn fn, void *arg)
+{
+    // Only whole ticks are expired, so everything in their slot for this
+    // turn is due. Timers fire up to one tick late.
+    uint64_t end = now / TIMER_TICK_MS;
+    wheel->now   = now;
+
+    // After a long stall one turn visits every slot
+    if (end > wheel->tick + TIMER_WHEEL_SLOTS) wheel->tick = end - TIMER_WHEEL_SLOTS;
+
+    while (wheel->tick < end)
+    {
+        TimerNode *head = &wheel->slots[wheel->tick & (TIMER_WHEEL_SLOTS - 1)];
+        wheel->tick++; // timers armed by fn land from the next tick on
+
+        if (head->next == head) continue;
+
+        // Detach the slot so callbacks can't make the walk revisit nodes
+        TimerNode pending;
+        pending.next       = head->next;
+        pending.prev       = head->prev;
+        pending.next->prev = &pending;
+        pending.prev->next = &pending;
+        head->next         = head;
+        head->prev         = head;
+
+        while (pending.next != &pending)
+        {
+            TimerNode *node = pending.next;
+            timerwheel_cancel(node);
+            if (node->expires <= now)
+                fn(node, arg);
+            else
+                link_node(head, node); // due in a later turn
+        }
+    }
+}
+
+// ---------- UTILS ----------
+
+static void link_node(TimerNode *head, TimerNode *node)
+{
+    node->prev       = head->prev;
+    node->next       = head;
+    head->prev->next = node;
+    head->prev       = node;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file    timerwheel.h
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ *
+ * @brief   Hashed timer wheel for per-connection deadlines.
+ */
+
+#ifndef UTILS_TIMERWHEEL_H
+#define UTILS_TIMERWHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_SLOTS 1024 // a power of two
+#define TIMER_TICK_MS 100      // resolution, one slot per tick
+
+/**
+ * @brief   Embedded in the object it times. Unlinked while not armed.
+ */
+typedef struct TimerNode
+{
+    struct TimerNode *next;
+    struct TimerNode *prev;
+    uint64_t expires; // monotonic ms
+} TimerNode;
+
+typedef void (*TimerFn)(TimerNode *node, void *arg);
+
+/**
+ * @brief   Timers hash into a slot by their expiry tick. Deadlines further
+ *          than one turn of the wheel stay in their slot until a later turn,
+ *          so arming and canceling are O(1) for any delay.
+ */
+typedef struct TimerWheel
+{
+    TimerNode slots[TIMER_WHEEL_SLOTS]; // circular list heads
+    uint64_t tick;                      // next tick to expire
+    uint64_t now;                       // monotonic ms of the last advance
+} TimerWheel;
+
+void timerwheel_init(TimerWheel *wheel, uint64_t now);
+void timerwheel_arm(TimerWheel *wheel, TimerNode *node, uint64_t delay_ms);
+void timerwheel_cancel(TimerNode *node);
+void timerwheel_advance(TimerWheel *wheel, uint64_t now, TimerFn fn, void *arg);
+
+static inline int timer_armed(const TimerNode *node)
+{
+    return node->next != NULL;
+}
+
+#endif /* UTILS_TIMERWHEEL_H */
@@ -2,102 +2,2333 @@
  * @file    http_request_response.c
  * @author  Samandar Komil
  * @date    25 April 2025
- * @brief   Tests for http/server.c, request.c and response.c implementations
+ * @brief   Tests for http/parsers.c and request.c implementations
  *
  */
 
 #include <check.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <zlib.h>
 #include "common.h"
 #include "http/server.h"
 #include "http/parsers.h"
+#include "http/tokenizer.h"
+#include "http/bundle.h"
+#include "http/mailbox.h"
+#include "http/connpool.h"
+#include "http/conditional.h"
+#include "http/balancer.h"
+#include "http/proxycache.h"
+#include "http/output.h"
+#include "utils/arena.h"
+#include "utils/timerwheel.h"
+#include "http/accesslog.h"
+#include "utils/clock.h"
+#include "http/canned.h"
+#include "http/static.h"
+#include "utils/compress.h"
+#include "http/lifecycle.h"
+#include "http/filecache.h"
+#include "http/stats.h"
 
 HTTPRequest *req;
+RequestParser parser;
 
 void setup(void)
 {
-    req = httprequest_constructor();
+    req = create_http_request();
+    request_parser_init(&parser);
 }
 
 void teardown(void)
 {
-    httprequest_free(req);
+    free_http_request(req);
 }
 
 START_TEST(test_parse_request_line_valid)
 {
-    char line[]  = "GET /index.html HTTP/1.1";
-    int res_code = parse_request_line(req, line);
+    char line[]  = "GET /index.html HTTP/1.1\r\n";
+    int res_code = parse_request_line(req, line, strlen(line));
 
-    ck_assert_str_eq(req->method, "GET");
-    ck_assert_str_eq(req->path, "/index.html");
-    ck_assert_str_eq(req->version, "HTTP/1.1");
-    ck_assert_int_eq(res_code, OK);
+    ck_assert_int_eq(req->request_line.method_len, 3);
+    ck_assert_int_eq(strncmp(req->request_line.method, "GET", 3), 0);
+    ck_assert_int_eq(req->request_line.uri_len, 11);
+    ck_assert_int_eq(strncmp(req->request_line.uri, "/index.html", 11), 0);
+    ck_assert_int_eq(strncmp(req->request_line.protocol, "HTTP/1.1", 8), 0);
+    ck_assert_int_eq(res_code, (int)strlen(line));
 }
 END_TEST
 
 START_TEST(test_parse_request_line_invalid)
 {
-    char line1[] = "INVALID / HTTP/1.1";
-    char line2[] = "GET INVALID HTTP/1.1";
-    char line3[] = "INVALID_WHATEVER";
+    char line1[] = "INVALID_WHATEVER\r\n";
+    char line2[] = "GET /index.html\r\n";
 
-    int res_code_method  = parse_request_line(req, line1);
-    int res_code_path    = parse_request_line(req, line2);
-    int res_code_invalid = parse_request_line(req, line3);
-
-    ck_assert_int_eq(res_code_method, INVALID_METHOD);
-    ck_assert_int_eq(res_code_path, INVALID_PATH);
-    ck_assert_int_eq(res_code_invalid, INVALID_REQUEST_LINE);
+    ck_assert_int_lt(parse_request_line(req, line1, strlen(line1)), 0);
+    ck_assert_int_lt(parse_request_line(req, line2, strlen(line2)), 0);
 }
 END_TEST
 
 START_TEST(test_parse_headers_single)
 {
     char headers[] = "Host: localhost\r\n";
-    parse_headers(req, headers);
+    int consumed   = parse_header(&req->headers[0], headers, strlen(headers));
+
+    ck_assert_int_eq(consumed, (int)strlen(headers));
+    ck_assert_int_eq(strncmp(req->headers[0].name, "Host", req->headers[0].name_len), 0);
+    ck_assert_int_eq(strncmp(req->headers[0].value, "localhost", req->headers[0].value_len), 0);
+}
+END_TEST
+
+START_TEST(test_parse_headers_colon_missing)
+{
+    char headers[] = "InvalidHeader\r\n";
+
+    ck_assert_int_lt(parse_header(&req->headers[0], headers, strlen(headers)), 0);
+}
+END_TEST
+
+START_TEST(test_parse_headers_name_invalid)
+{
+    // Whitespace before the colon, leading whitespace, an empty name and
+    // control characters would let a backend read a different header
+    const char *lines[] = {
+        "Host : x\r\n", "Transfer-Encoding\t: chunked\r\n", " Host: x\r\n", "\tfolded\r\n",
+        ": x\r\n",      "Ho\x01st: x\r\n",                 "Ho st: x\r\n", "Host\x7f: x\r\n",
+    };
+
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++)
+        ck_assert_int_lt(parse_header(&req->headers[0], lines[i], strlen(lines[i])), 0);
+
+    char name_nul[] = "Ho\0st: x\r\n";
+    ck_assert_int_lt(parse_header(&req->headers[0], name_nul, sizeof(name_nul) - 1), 0);
 
+    const char *token = "X-My_Header.v1!#$%&'*+^`|~: ok\r\n";
+    ck_assert_int_eq(parse_header(&req->headers[0], token, strlen(token)), (int)strlen(token));
+}
+END_TEST
+
+START_TEST(test_parse_partial_rejects_smuggling)
+{
+    const char *requests[] = {
+        "POST / HTTP/1.1\r\nHost: x\r\nTransfer-Encoding : chunked\r\n\r\n0\r\n\r\n",
+        "GET / HTTP/1.1\r\nHost: x\r\nX-A: 1\r\n continued\r\n\r\n",
+        "GET / HTTP/1.1\r\n Host: x\r\n\r\n",
+    };
+
+    for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); i++)
+    {
+        char data[256];
+        size_t len = strlen(requests[i]);
+        memcpy(data, requests[i], len);
+        request_parser_init(&parser);
+        ck_assert_int_eq(parse_http_request_partial(&parser, req, data, len), PARSE_ERROR);
+    }
+}
+END_TEST
+
+START_TEST(test_parse_partial_resumes)
+{
+    char data[] = "GET /a HTTP/1.1\r\nHost: x\r\n\r\n";
+    size_t len  = strlen(data);
+
+    // Feed the request one byte at a time, as slow clients would
+    for (size_t i = 1; i < len; i++)
+        ck_assert_int_ne(parse_http_request_partial(&parser, req, data, i), PARSE_DONE);
+
+    ck_assert_int_eq(parse_http_request_partial(&parser, req, data, len), PARSE_DONE);
+    ck_assert_int_eq(parser.parsed, len);
     ck_assert_int_eq(req->header_count, 1);
-    ck_assert_str_eq(req->headers[0].key, "Host");
-    ck_assert_str_eq(req->headers[0].value, "localhost");
+    ck_assert_int_eq(req->body_len, 0);
 }
 END_TEST
 
-START_TEST(test_parse_headers_multiple)
+START_TEST(test_parse_partial_pipelined)
 {
-    char headers[] = "Host: localhost\r\nContent-Type: text/html\r\n";
-    parse_headers(req, headers);
+    char data[] = "POST /a HTTP/1.1\r\nContent-Length: 5\r\n\r\nhelloGET /b HTTP/1.1\r\n\r\n";
 
-    ck_assert_int_eq(req->header_count, 2);
-    ck_assert_str_eq(req->headers[1].key, "Content-Type");
-    ck_assert_str_eq(req->headers[1].value, "text/html");
+    ck_assert_int_eq(parse_http_request_partial(&parser, req, data, strlen(data)), PARSE_DONE);
+    ck_assert_int_eq(req->body_len, 5);
+    ck_assert_int_eq(strncmp(req->body, "hello", 5), 0);
+
+    // The next request starts right after the body
+    size_t next = parser.parsed;
+    ck_assert_int_eq(strncmp(data + next, "GET /b", 6), 0);
+
+    request_parser_init(&parser);
+    ck_assert_int_eq(
+        parse_http_request_partial(&parser, req, data + next, strlen(data) - next), PARSE_DONE);
+    ck_assert_int_eq(strncmp(req->request_line.uri, "/b", 2), 0);
 }
 END_TEST
 
-START_TEST(test_parse_headers_colon_missing)
+START_TEST(test_parse_partial_chunked)
 {
-    char headers[] = "InvalidHeader\r\n";
-    parse_headers(req, headers);
+    char data[] = "POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                  "5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\n\r\nNEXT";
+    size_t len  = strlen(data);
+
+    ck_assert_int_eq(parse_http_request_partial(&parser, req, data, len - 20), PARSE_BODY);
+    ck_assert_int_eq(parse_http_request_partial(&parser, req, data, len), PARSE_DONE);
+    ck_assert_int_eq(req->body_len, 11);
+    ck_assert_int_eq(strncmp(req->body, "hello world", 11), 0);
+    ck_assert_int_eq(strcmp(data + parser.parsed, "NEXT"), 0);
+}
+END_TEST
+
+START_TEST(test_parse_partial_ambiguous_framing)
+{
+    char data[] = "POST /a HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n";
+
+    ck_assert_int_eq(parse_http_request_partial(&parser, req, data, strlen(data)), PARSE_ERROR);
+
+    // chunked has to be the last coding, as a token of its own
+    const char *codings[] = {"xchunked", "gzipchunked", "chunked, gzip", "chunked, chunked",
+                             "chunked,", "chunked;q=1", ""};
+    char head[128];
+    for (size_t i = 0; i < sizeof(codings) / sizeof(codings[0]); i++)
+    {
+        int len = snprintf(head, sizeof(head), "POST /a HTTP/1.1\r\nTransfer-Encoding: %s\r\n\r\n",
+                           codings[i]);
+        reset_http_request(req);
+        request_parser_init(&parser);
+        ck_assert_int_eq(parse_http_request_partial(&parser, req, head, len), PARSE_ERROR);
+    }
+
+    int len = snprintf(head, sizeof(head), "POST /a HTTP/1.1\r\nTransfer-Encoding: gzip ,\tChunked "
+                                           "\r\n\r\n0\r\n\r\n");
+    reset_http_request(req);
+    request_parser_init(&parser);
+    ck_assert_int_eq(parse_http_request_partial(&parser, req, head, len), PARSE_DONE);
+}
+END_TEST
+
+START_TEST(test_parse_known_headers_indexed)
+{
+    char data[] = "GET /a HTTP/1.1\r\nconn: close\r\nHOST: x\r\nConnection: close\r\n"
+                  "X-Host: y\r\nHost: z\r\n\r\n";
+
+    ck_assert_int_eq(parse_http_request_partial(&parser, req, data, strlen(data)), PARSE_DONE);
+    ck_assert_int_eq(req->headers[0].id, HDR_OTHER);
+    ck_assert_int_eq(req->headers[3].id, HDR_OTHER);
+
+    const HTTPHeader *host = get_http_header(req, HDR_HOST);
+    ck_assert_ptr_nonnull(host);
+    ck_assert_int_eq(strncmp(host->value, "x", host->value_len), 0);
+    ck_assert_int_ne(req->repeated & HDR_BIT(HDR_HOST), 0);
+
+    ck_assert_ptr_eq(get_http_header(req, HDR_CONNECTION), &req->headers[2]);
+    ck_assert_ptr_null(get_http_header(req, HDR_CONTENT_LENGTH));
+}
+END_TEST
+
+START_TEST(test_parse_response_head)
+{
+    char data[] = "HTTP/1.0 201 Created\r\nContent-Length: 4\r\nConnection: keep-alive\r\n"
+                  "X-Backend: a\r\n\r\nbody";
+    size_t len  = strlen(data);
+    ResponseParser res;
+
+    response_parser_init(&res);
+    ck_assert_int_eq(parse_http_response_partial(&res, data, len - 10), PARSE_HEADERS);
+    response_parser_init(&res);
+    ck_assert_int_eq(parse_http_response_partial(&res, data, len), PARSE_DONE);
+    ck_assert_int_eq(res.status_code, 201);
+    ck_assert_int_eq(strncmp(res.reason, "Created", res.reason_len), 0);
+    ck_assert_int_eq(res.header_count, 3);
+    ck_assert_int_eq(res.has_length, 1);
+    ck_assert_int_eq(res.content_length, 4);
+    ck_assert_int_eq(res.close, 0);
+    ck_assert_int_eq(strcmp(data + res.parsed, "body"), 0);
+}
+END_TEST
+
+START_TEST(test_parse_response_framing)
+{
+    char chunked[]   = "HTTP/1.1 200\r\nTransfer-Encoding: gzip, chunked\r\n\r\n";
+    char ambiguous[] = "HTTP/1.1 200 OK\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\n";
+    char invalid[]   = "HTTP/1.1 2x0 OK\r\n\r\n";
+    ResponseParser res;
+
+    response_parser_init(&res);
+    ck_assert_int_eq(parse_http_response_partial(&res, chunked, strlen(chunked)), PARSE_DONE);
+    ck_assert_int_eq(res.chunked, 1);
+    ck_assert_int_eq(res.reason_len, 0);
+
+    // Any other final coding is delimited by the close
+    char suffixed[] = "HTTP/1.1 200 OK\r\nTransfer-Encoding: xchunked\r\n\r\n";
+    response_parser_init(&res);
+    ck_assert_int_eq(parse_http_response_partial(&res, suffixed, strlen(suffixed)), PARSE_DONE);
+    ck_assert_int_eq(res.chunked, 0);
+
+    response_parser_init(&res);
+    ck_assert_int_eq(parse_http_response_partial(&res, ambiguous, strlen(ambiguous)), PARSE_ERROR);
+    response_parser_init(&res);
+    ck_assert_int_eq(parse_http_response_partial(&res, invalid, strlen(invalid)), PARSE_ERROR);
+}
+END_TEST
+
+START_TEST(test_tokenizer_backends_agree)
+{
+    const char *backends[] = {"scalar", "sse4.2", "avx2"};
+    char data[200];
+    size_t delim = 0;
+    memset(data, 'a', sizeof(data));
 
-    ck_assert_int_eq(req->header_count, 0);
+    // LF and delimiter at every position, crossing 16 and 32 byte block boundaries
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+    {
+        if (tokenizer_select(backends[b]) < 0) continue; // CPU lacks it
+
+        for (size_t pos = 0; pos < sizeof(data); pos++)
+        {
+            data[pos] = ':';
+            ck_assert_int_eq(token_line(data, sizeof(data), ':', &delim), sizeof(data));
+            ck_assert_int_eq(delim, pos);
+            ck_assert_int_eq(token_line(data, pos, ':', &delim), pos);
+            ck_assert_int_eq(delim, pos);
+            data[pos] = 'a';
+
+            data[pos] = '\n';
+            ck_assert_int_eq(token_line(data, sizeof(data), ':', &delim), pos);
+            ck_assert_int_eq(delim, sizeof(data));
+            if (pos > 0)
+            {
+                data[pos - 1] = ':';
+                ck_assert_int_eq(token_line(data, sizeof(data), ':', &delim), pos);
+                ck_assert_int_eq(delim, pos - 1);
+                data[pos - 1] = 'a';
+            }
+            data[pos] = 'a';
+        }
+    }
+    tokenizer_select("auto");
 }
 END_TEST
 
-START_TEST(test_parse_body_non_empty)
+START_TEST(test_tokenizer_stays_in_bounds)
 {
-    char *body = "This is the body.";
-    parse_body(req, body, strlen(body));
+    const char *backends[] = {"scalar", "sse4.2", "avx2"};
+    long page = sysconf(_SC_PAGESIZE);
+    char *map = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ck_assert_ptr_ne(map, MAP_FAILED);
+    ck_assert_int_eq(mprotect(map + page, page, PROT_NONE), 0);
+    memset(map, 'a', page);
 
-    ck_assert_str_eq(req->body, "This is the body.");
-    ck_assert_int_eq(req->body_length, strlen(body));
+    // Lines ending right before an unreadable page, a read past the end faults
+    size_t delim = 0;
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+    {
+        if (tokenizer_select(backends[b]) < 0) continue;
+
+        for (size_t len = 0; len <= 64; len++)
+        {
+            const char *data = map + page - len;
+            ck_assert_int_eq(token_line(data, len, ':', &delim), len);
+            ck_assert_int_eq(delim, len);
+        }
+    }
+    tokenizer_select("auto");
+    munmap(map, 2 * page);
 }
 END_TEST
 
-START_TEST(test_parse_body_empty)
+START_TEST(test_router_match)
 {
-    parse_body(req, NULL, 0);
+    char *specs[] = {
+        "/static/* static", "/api/* proxy", "/api/users/:id proxy", "/api/users/me canned 403",
+        "/old/:id/* redirect 301 /new/:id/*", "/healthz canned 503",
+    };
+    Router router;
+    RouteMatch match;
+    const Route *route;
+    ck_assert_int_eq(router_init(&router, specs, sizeof(specs) / sizeof(specs[0]), NULL, 0), 0);
+
+    ck_assert_ptr_eq(router_match(&router, "/static", 7, &match), &router.routes[0]);
+    ck_assert_ptr_eq(router_match(&router, "/static/a.css", 13, &match), &router.routes[0]);
+    ck_assert_int_eq(match.rest_len, 6);
+    ck_assert_ptr_null(router_match(&router, "/staticfoo", 10, &match));
 
-    ck_assert_ptr_null(req->body);
-    ck_assert_int_eq(req->body_length, 0);
+    // Static segments beat parameters, which beat wildcards
+    ck_assert_ptr_eq(router_match(&router, "/api/users/me", 13, &match), &router.routes[3]);
+    route = router_match(&router, "/api/users/42", 13, &match);
+    ck_assert_ptr_eq(route, &router.routes[2]);
+    ck_assert_int_eq(match.param_count, 1);
+    ck_assert_int_eq(match.params[0].value_len, 2);
+    ck_assert_ptr_eq(router_match(&router, "/api/users/42/x", 15, &match), &router.routes[1]);
+    ck_assert_ptr_eq(router_match(&router, "/api/users/", 11, &match), &router.routes[1]);
+    ck_assert_ptr_null(router_match(&router, "/healthz/", 9, &match));
+
+    Arena arena;
+    ck_assert_int_eq(arena_init(&arena, 1024), 0);
+    route = router_match(&router, "/old/7/a/b", 10, &match);
+    ck_assert_ptr_eq(route, &router.routes[4]);
+    ck_assert_str_eq(router_redirect_location(&arena, route, &match), "/new/7/a/b");
+    arena_destroy(&arena);
+    router_destroy(&router);
+
+    // Duplicate patterns and differently named parameters don't compile
+    char *dup[] = {"/a/:id canned 404", "/a/:name/b canned 404"};
+    ck_assert_int_eq(router_init(&router, dup, 2, NULL, 0), -1);
+    char *bad[] = {"/a/* redirect 200 /b"};
+    ck_assert_int_eq(router_init(&router, bad, 1, NULL, 0), -1);
+}
+END_TEST
+
+START_TEST(test_bundle_roundtrip)
+{
+    char dir[] = "bundle_test_XXXXXX";
+    char path[PATH_MAX], bundle_path[PATH_MAX];
+    ck_assert_ptr_nonnull(mkdtemp(dir));
+
+    // A compressible file gets a gzip variant, a binary one only itself
+    char css[1024];
+    memset(css, 'a', sizeof(css));
+    snprintf(path, sizeof(path), "%s/sub", dir);
+    ck_assert_int_eq(mkdir(path, 0755), 0);
+    snprintf(path, sizeof(path), "%s/sub/app.css", dir);
+    FILE *f = fopen(path, "w");
+    fwrite(css, 1, sizeof(css), f);
+    fclose(f);
+    snprintf(path, sizeof(path), "%s/logo.png", dir);
+    f = fopen(path, "w");
+    fwrite("\x89PNG", 1, 4, f);
+    fclose(f);
+
+    snprintf(bundle_path, sizeof(bundle_path), "%s.pack", dir);
+    ck_assert_int_eq(bundle_pack(dir, bundle_path), 0);
+    Bundle bundle;
+    ck_assert_int_eq(bundle_open(&bundle, bundle_path), 0);
+    ck_assert_int_eq(bundle.header->file_count, 2);
+
+    char request[PATH_MAX];
+    int len = snprintf(request, sizeof(request), "/%s/sub/app.css", dir);
+    ck_assert(bundle_covers(&bundle, request, len));
+    ck_assert(!bundle_covers(&bundle, "/other/app.css", 14));
+    const BundleFile *file = bundle_lookup(&bundle, request, len);
+    ck_assert_ptr_nonnull(file);
+    ck_assert_str_eq(bundle.map + file->mime, "text/css");
+
+    const BundleVariant *identity = &file->variants[ENC_IDENTITY];
+    ck_assert_uint_eq(identity->body_len, sizeof(css));
+    ck_assert_int_eq(strncmp(bundle.map + identity->offset, "HTTP/1.1 200 OK\r\n", 17), 0);
+    ck_assert_int_eq(memcmp(bundle.map + identity->offset + identity->head_len, css, sizeof(css)),
+                     0);
+    ck_assert_uint_ne(file->variants[ENC_GZIP].offset, 0);
+    ck_assert_uint_eq(file->variants[ENC_GZIP].transformed, 1);
+    ck_assert_uint_eq(file->variants[ENC_BR].offset, 0);
+
+    len = snprintf(request, sizeof(request), "/%s/logo.png", dir);
+    file = bundle_lookup(&bundle, request, len);
+    ck_assert_ptr_nonnull(file);
+    ck_assert_uint_eq(file->variants[ENC_GZIP].offset, 0);
+    ck_assert_ptr_null(bundle_lookup(&bundle, request, len - 1));
+    bundle_close(&bundle);
+
+    // A truncated bundle doesn't map
+    ck_assert_int_eq(truncate(bundle_path, 100), 0);
+    ck_assert_int_eq(bundle_open(&bundle, bundle_path), -1);
+
+    unlink(bundle_path);
+    snprintf(path, sizeof(path), "%s/sub/app.css", dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/logo.png", dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/sub", dir);
+    rmdir(path);
+    rmdir(dir);
+}
+END_TEST
+
+#define MAIL_SENDERS 4
+#define MAIL_PER_SENDER 10000
+
+typedef struct
+{
+    Mailbox *box;
+    int id;
+} MailSender;
+
+static void *post_mail(void *arg)
+{
+    const MailSender *sender = arg;
+    for (int i = 0; i < MAIL_PER_SENDER; i++)
+    {
+        int payload[2] = {sender->id, i};
+        Mail *mail     = mail_create(0, NULL, payload, sizeof(payload));
+        if (mail) mailbox_post(sender->box, mail);
+    }
+    return NULL;
+}
+
+START_TEST(test_mailbox_senders)
+{
+    Mailbox box;
+    ck_assert_int_eq(mailbox_init(&box), 0);
+    ck_assert(!mailbox_pending(&box));
+    ck_assert_ptr_null(mailbox_take(&box));
+
+    pthread_t threads[MAIL_SENDERS];
+    MailSender senders[MAIL_SENDERS];
+    for (int i = 0; i < MAIL_SENDERS; i++)
+    {
+        senders[i] = (MailSender){&box, i};
+        ck_assert_int_eq(pthread_create(&threads[i], NULL, post_mail, &senders[i]), 0);
+    }
+
+    // Every sender's mail arrives complete and in the order it was posted
+    int received = 0, next_seq[MAIL_SENDERS] = {0};
+    while (received < MAIL_SENDERS * MAIL_PER_SENDER)
+    {
+        Mail *mail = mailbox_take(&box);
+        while (mail)
+        {
+            Mail *next = mail->next;
+            int payload[2];
+            memcpy(payload, mail->data, sizeof(payload));
+            ck_assert_int_eq(payload[1], next_seq[payload[0]]);
+            next_seq[payload[0]]++;
+            received++;
+            free(mail);
+            mail = next;
+        }
+    }
+    for (int i = 0; i < MAIL_SENDERS; i++)
+        pthread_join(threads[i], NULL);
+    ck_assert(!mailbox_pending(&box));
+
+    // Only the post into an empty box writes the eventfd
+    uint64_t count;
+    mailbox_clear_wakeup(&box);
+    ck_assert_int_eq(read(box.wake_fd, &count, sizeof(count)), -1);
+    mailbox_post(&box, mail_create(1, NULL, "key", 3));
+    mailbox_post(&box, mail_create(2, NULL, NULL, 0));
+    ck_assert_int_eq(read(box.wake_fd, &count, sizeof(count)), sizeof(count));
+    ck_assert_uint_eq(count, 1);
+
+    Mail *mail = mailbox_take(&box);
+    ck_assert_int_eq(mail->kind, 1);
+    ck_assert_int_eq(memcmp(mail->data, "key", 3), 0);
+    ck_assert_int_eq(mail->next->kind, 2);
+    ck_assert_ptr_null(mail->next->next);
+    free(mail->next);
+    free(mail);
+    mailbox_destroy(&box);
+}
+END_TEST
+
+START_TEST(test_connpool_batch_reuse)
+{
+    ConnectionPool pool;
+    ck_assert_int_eq(connpool_init(&pool, 2), 0);
+
+    Connection *a = connpool_get(&pool);
+    Connection *b = connpool_get(&pool);
+    ck_assert_ptr_nonnull(a);
+    ck_assert_ptr_nonnull(b);
+    ck_assert_ptr_null(connpool_get(&pool));
+
+    // A slot released at the limit stays out until the batch ends
+    uint16_t generation = a->generation;
+    connpool_put(&pool, a);
+    ck_assert_ptr_null(connpool_get(&pool));
+    connpool_recycle(&pool);
+    ck_assert_ptr_eq(connpool_get(&pool), a);
+    ck_assert_int_eq(a->generation, (uint16_t)(generation + 1));
+    connpool_destroy(&pool);
+}
+END_TEST
+
+static char head_buf[512];
+
+// Parses a request for /f with the given header lines into req
+static void parse_head(const char *method, const char *headers)
+{
+    snprintf(head_buf, sizeof(head_buf), "%s /f HTTP/1.1\r\nHost: x\r\n%s\r\n", method, headers);
+    reset_http_request(req);
+    request_parser_init(&parser);
+    ck_assert_int_eq(parse_http_request_partial(&parser, req, head_buf, strlen(head_buf)),
+                     PARSE_DONE);
+}
+
+// Sun, 06 Nov 1994 08:49:37 GMT
+static const Validators validators = {"\"abc\"", 5, 784111777};
+
+static int ranges_of(const char *headers, ByteRange ranges[RANGES_MAX])
+{
+    parse_head("GET", headers);
+    return request_ranges(req, &validators, 100, ranges);
+}
+
+START_TEST(test_request_ranges)
+{
+    ByteRange r[RANGES_MAX];
+
+    // Suffix, open-ended and clipped ranges of a 100 byte body
+    ck_assert_int_eq(ranges_of("Range: bytes=-5\r\n", r), 1);
+    ck_assert_uint_eq(r[0].start, 95);
+    ck_assert_uint_eq(r[0].length, 5);
+    ck_assert_int_eq(ranges_of("Range: bytes=5-\r\n", r), 1);
+    ck_assert_uint_eq(r[0].start, 5);
+    ck_assert_uint_eq(r[0].length, 95);
+    ck_assert_int_eq(ranges_of("Range: bytes=90-200\r\n", r), 1);
+    ck_assert_uint_eq(r[0].length, 10);
+    ck_assert_int_eq(ranges_of("Range: bytes=-500\r\n", r), 1);
+    ck_assert_uint_eq(r[0].start, 0);
+    ck_assert_uint_eq(r[0].length, 100);
+
+    // Overlapping and adjacent ranges are merged, the client's order is kept
+    ck_assert_int_eq(ranges_of("Range: bytes=50-59, 0-9,5-19,20-29\r\n", r), 2);
+    ck_assert_uint_eq(r[0].start, 50);
+    ck_assert_uint_eq(r[0].length, 10);
+    ck_assert_uint_eq(r[1].start, 0);
+    ck_assert_uint_eq(r[1].length, 30);
+    ck_assert_int_eq(ranges_of("Range: bytes=0-9,40-49,20-29,10-19\r\n", r), 2);
+    ck_assert_uint_eq(r[0].start, 0);
+    ck_assert_uint_eq(r[0].length, 30);
+    ck_assert_uint_eq(r[1].start, 40);
+    ck_assert_int_eq(ranges_of("Range: bytes=0-,0-,0-,0-,0-,0-,0-,0-\r\n", r), 1);
+
+    // Nothing overlaps the body: 416, unless another range does
+    ck_assert_int_eq(ranges_of("Range: bytes=100-\r\n", r), -1);
+    ck_assert_int_eq(ranges_of("Range: bytes=200-300,-0\r\n", r), -1);
+    ck_assert_int_eq(ranges_of("Range: bytes=200-300,0-0\r\n", r), 1);
+
+    // Malformed, too many or not applicable: the whole body
+    const char *ignored[] = {
+        "Range: bytes=5\r\n",
+        "Range: bytes=9-5\r\n",
+        "Range: bytes=a-9\r\n",
+        "Range: bytes=--5\r\n",
+        "Range: bytes=0-1,x\r\n",
+        "Range: items=0-5\r\n",
+        "Range: bytes=0-0,2-2,4-4,6-6,8-8,10-10,12-12\r\n",
+        "Range: bytes=0-1\r\nRange: bytes=2-3\r\n",
+        "Range: bytes=0-1\r\nIf-Range: \"abd\"\r\n",
+        "Range: bytes=0-1\r\nIf-Range: W/\"abc\"\r\n",
+        "Range: bytes=0-1\r\nIf-Range: Sun, 06 Nov 1994 08:49:38 GMT\r\n",
+        "Range: bytes=0-1\r\nIf-Range: yesterday\r\n",
+    };
+    for (size_t i = 0; i < sizeof(ignored) / sizeof(ignored[0]); i++)
+        ck_assert_int_eq(ranges_of(ignored[i], r), 0);
+    ck_assert_int_eq(ranges_of("", r), 0);
+    ck_assert_int_eq(ranges_of("Range: bytes=0-0,2-2,4-4,6-6,8-8,10-10\r\n", r), RANGES_MAX);
+
+    parse_head("HEAD", "Range: bytes=0-1\r\n");
+    ck_assert_int_eq(request_ranges(req, &validators, 100, r), 0);
+
+    // If-Range with the strong entity tag or the exact date
+    ck_assert_int_eq(ranges_of("Range: bytes=0-1\r\nIf-Range: \"abc\"\r\n", r), 1);
+    const char *dated = "Range: bytes=0-1\r\nIf-Range: Sun, 06 Nov 1994 08:49:37 GMT\r\n";
+    ck_assert_int_eq(ranges_of(dated, r), 1);
+}
+END_TEST
+
+static int not_modified(const char *method, const char *headers)
+{
+    parse_head(method, headers);
+    return request_not_modified(req, &validators);
+}
+
+START_TEST(test_request_not_modified)
+{
+    // If-None-Match compares weakly, "*" matches any
+    ck_assert_int_eq(not_modified("GET", "If-None-Match: \"abc\"\r\n"), 1);
+    ck_assert_int_eq(not_modified("HEAD", "If-None-Match: W/\"abc\"\r\n"), 1);
+    ck_assert_int_eq(not_modified("GET", "If-None-Match: \"x\", W/\"y\" ,\"abc\"\r\n"), 1);
+    ck_assert_int_eq(not_modified("GET", "If-None-Match: *\r\n"), 1);
+    ck_assert_int_eq(not_modified("GET", "If-None-Match: \"abcd\", abc\r\n"), 0);
+    ck_assert_int_eq(not_modified("POST", "If-None-Match: \"abc\"\r\n"), 0);
+
+    // If-Modified-Since in all three date formats
+    ck_assert_int_eq(not_modified("GET", "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n"),
+                     1);
+    ck_assert_int_eq(not_modified("GET", "If-Modified-Since: Sunday, 06-Nov-94 08:49:37 GMT\r\n"),
+                     1);
+    ck_assert_int_eq(not_modified("GET", "If-Modified-Since: Sun Nov  6 08:49:37 1994\r\n"), 1);
+    ck_assert_int_eq(not_modified("GET", "If-Modified-Since: Sun, 06 Nov 1994 08:49:36 GMT\r\n"),
+                     0);
+    ck_assert_int_eq(not_modified("GET", "If-Modified-Since: recently\r\n"), 0);
+    ck_assert_int_eq(not_modified("GET", ""), 0);
+
+    // If-None-Match takes precedence, If-Modified-Since is ignored with it
+    ck_assert_int_eq(not_modified("GET", "If-None-Match: \"xyz\"\r\n"
+                                         "If-Modified-Since: Mon, 07 Nov 1994 00:00:00 GMT\r\n"),
+                     0);
+    ck_assert_int_eq(not_modified("GET", "If-None-Match: \"abc\"\r\n"
+                                         "If-Modified-Since: Sat, 05 Nov 1994 00:00:00 GMT\r\n"),
+                     1);
+}
+END_TEST
+
+#define TEST_BACKENDS 3
+
+// Unresolved backends 10.0.0.1-3:80, ejected after 2 failures for 10 s
+static void balancer_setup(Balancer *balancer, Backend *backends, const char *policy,
+                           const char *key)
+{
+    Config cfg               = {0};
+    cfg.balance              = (char *)policy;
+    cfg.balance_key          = (char *)key;
+    cfg.backend_max_fails    = 2;
+    cfg.backend_fail_timeout = 10;
+
+    memset(backends, 0, TEST_BACKENDS * sizeof(Backend));
+    for (int i = 0; i < TEST_BACKENDS; i++)
+    {
+        snprintf(backends[i].host, sizeof(backends[i].host), "10.0.0.%d", i + 1);
+        snprintf(backends[i].port, sizeof(backends[i].port), "80");
+    }
+    ck_assert_int_eq(balancer_init(balancer, backends, TEST_BACKENDS, &cfg), 0);
+}
+
+static int picked(Balancer *balancer, uint32_t exclude)
+{
+    Backend *backend = balancer_pick(balancer, req, exclude);
+    return backend ? (int)(backend - balancer->backends) : -1;
+}
+
+START_TEST(test_balancer_round_robin)
+{
+    Balancer balancer;
+    Backend backends[TEST_BACKENDS];
+    balancer_setup(&balancer, backends, "round_robin", NULL);
+
+    for (int i = 0; i < 2 * TEST_BACKENDS; i++)
+        ck_assert_int_eq(picked(&balancer, 0), i % TEST_BACKENDS);
+    ck_assert_uint_eq(balancer_mask(&balancer, &backends[2]), 1u << 2);
+
+    // Backends already tried are skipped, with all of them tried there is none
+    ck_assert_int_eq(picked(&balancer, balancer_mask(&balancer, &backends[0])), 1);
+    ck_assert_int_eq(picked(&balancer, 0x3), 2);
+    ck_assert_int_eq(picked(&balancer, 0x7), -1);
+
+    // Ejected after max_fails consecutive failures, a success in between resets the count
+    balancer_report(&balancer, &backends[0], 0);
+    balancer_report(&balancer, &backends[0], 1);
+    balancer_report(&balancer, &backends[0], 0);
+    ck_assert_uint_eq(backends[0].ejected_until, 0);
+    balancer_report(&balancer, &backends[0], 0);
+    ck_assert_uint_ne(backends[0].ejected_until, 0);
+    for (int i = 0; i < 2 * TEST_BACKENDS; i++)
+        ck_assert_int_ne(picked(&balancer, 0), 0);
+
+    // With every usable backend ejected, ejection is ignored rather than failing
+    ck_assert_int_eq(picked(&balancer, 0x6), 0);
+    balancer_report(&balancer, &backends[1], 0);
+    balancer_report(&balancer, &backends[1], 0);
+    balancer_report(&balancer, &backends[2], 0);
+    balancer_report(&balancer, &backends[2], 0);
+    ck_assert_int_ge(picked(&balancer, 0), 0);
+    ck_assert_int_eq(picked(&balancer, 0x5), 1);
+
+    // Back after fail_timeout, and the next failure ejects it again
+    balancer_report(&balancer, &backends[1], 1);
+    balancer_report(&balancer, &backends[2], 1);
+    balancer.fail_timeout_ms = 20;
+    balancer_report(&balancer, &backends[0], 0);
+    for (int i = 0; i < 2 * TEST_BACKENDS; i++)
+        ck_assert_int_ne(picked(&balancer, 0), 0);
+    usleep(30000);
+    balancer.next = 0;
+    ck_assert_int_eq(picked(&balancer, 0), 0);
+    balancer_report(&balancer, &backends[0], 0);
+    balancer.next = 0;
+    ck_assert_int_ne(picked(&balancer, 0), 0);
+
+    balancer_report(&balancer, &backends[0], 1);
+    ck_assert_int_eq(backends[0].fails, 0);
+    ck_assert_uint_eq(backends[0].ejected_until, 0);
+    balancer_destroy(&balancer);
+}
+END_TEST
+
+START_TEST(test_balancer_least_conn)
+{
+    Balancer balancer;
+    Backend backends[TEST_BACKENDS];
+    balancer_setup(&balancer, backends, "least_conn", NULL);
+
+    // Ties rotate over every backend
+    uint32_t seen = 0;
+    for (int i = 0; i < TEST_BACKENDS; i++)
+        seen |= 1u << picked(&balancer, 0);
+    ck_assert_uint_eq(seen, 0x7);
+
+    backends[0].active = 5;
+    backends[1].active = 1;
+    backends[2].active = 3;
+    for (int i = 0; i < TEST_BACKENDS; i++)
+        ck_assert_int_eq(picked(&balancer, 0), 1);
+    ck_assert_int_eq(picked(&balancer, 0x2), 2);
+
+    balancer_report(&balancer, &backends[1], 0);
+    balancer_report(&balancer, &backends[1], 0);
+    ck_assert_int_eq(picked(&balancer, 0), 2);
+    ck_assert_int_eq(picked(&balancer, 0x5), 1);
+    balancer_destroy(&balancer);
+}
+END_TEST
+
+START_TEST(test_balancer_hash)
+{
+    Balancer balancer, other;
+    Backend backends[TEST_BACKENDS];
+    char uri[16];
+    int owner[64];
+    ck_assert_int_eq(balancer_init(&balancer, backends, TEST_BACKENDS,
+                                   &(Config){.balance = "random"}),
+                     -1);
+
+    // Every worker builds the same ring, and keys spread over all backends
+    balancer_setup(&balancer, backends, "hash", "uri");
+    balancer_setup(&other, backends, "hash", NULL);
+    uint32_t seen = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        req->request_line.uri_len = snprintf(uri, sizeof(uri), "/item/%d", i);
+        req->request_line.uri     = uri;
+        owner[i]                  = picked(&balancer, 0);
+        ck_assert_int_eq(picked(&balancer, 0), owner[i]);
+        ck_assert_int_eq(picked(&other, 0), owner[i]);
+        ck_assert_int_ne(picked(&balancer, 1u << owner[i]), owner[i]);
+        seen |= 1u << owner[i];
+    }
+    ck_assert_uint_eq(seen, 0x7);
+
+    // Ejecting a backend only moves the keys it owned
+    balancer_report(&balancer, &backends[0], 0);
+    balancer_report(&balancer, &backends[0], 0);
+    for (int i = 0; i < 64; i++)
+    {
+        req->request_line.uri_len = snprintf(uri, sizeof(uri), "/item/%d", i);
+        req->request_line.uri     = uri;
+        if (owner[i] != 0)
+            ck_assert_int_eq(picked(&balancer, 0), owner[i]);
+        else
+            ck_assert_int_ne(picked(&balancer, 0), 0);
+    }
+    balancer_destroy(&other);
+    balancer_destroy(&balancer);
+
+    // A header key ignores the URI, the URI is hashed without the header
+    balancer_setup(&balancer, backends, "hash", "x-user");
+    parse_head("GET", "X-User: 42\r\n");
+    int user = picked(&balancer, 0);
+    for (int i = 0; i < 16; i++)
+    {
+        req->request_line.uri_len = snprintf(uri, sizeof(uri), "/item/%d", i);
+        req->request_line.uri     = uri;
+        ck_assert_int_eq(picked(&balancer, 0), user);
+    }
+    parse_head("GET", "");
+    int plain = picked(&balancer, 0);
+    balancer_setup(&other, backends, "hash", NULL);
+    ck_assert_int_eq(picked(&other, 0), plain);
+    balancer_destroy(&other);
+    balancer_destroy(&balancer);
+}
+END_TEST
+
+static void proxycache_setup(ProxyCache *cache)
+{
+    Config cfg                = {0};
+    cfg.proxy_cache_max_entry = 4096;
+    ck_assert_int_eq(proxycache_init(cache, 65536, &cfg), 0);
+}
+
+// Relays a response head and a 4 byte body into fill, finished complete
+static ProxyCacheEntry *fill_response(ProxyCache *cache, ProxyCacheFill *fill, const char *head)
+{
+    char data[512];
+    ResponseParser res;
+    int len = snprintf(data, sizeof(data), "%sContent-Length: 4\r\n\r\n", head);
+
+    response_parser_init(&res);
+    ck_assert_int_eq(parse_http_response_partial(&res, data, len), PARSE_DONE);
+    if (proxycache_fill_head(cache, fill, req, &res, 0) == OK)
+        ck_assert_int_eq(proxycache_fill_body(cache, fill, "body", 4), 0);
+    return proxycache_fill_finish(cache, fill, 1);
+}
+
+// Looks req up, which has to miss, and stores the response if it may be
+static ProxyCacheEntry *store_response(ProxyCache *cache, const char *head)
+{
+    ProxyCacheEntry *entry = NULL;
+    ProxyCacheFill *fill   = NULL;
+    ck_assert_int_eq(proxycache_lookup(cache, req, &entry, &fill), PROXYCACHE_FETCH);
+    return fill_response(cache, fill, head);
+}
+
+START_TEST(test_proxycache_storable)
+{
+    ProxyCache cache;
+    proxycache_setup(&cache);
+    parse_head("GET", "");
+
+    const char *refused[] = {
+        "HTTP/1.1 200 OK\r\nCache-Control: no-store, max-age=60\r\n",
+        "HTTP/1.1 200 OK\r\nCache-Control: max-age=60, private\r\n",
+        "HTTP/1.1 200 OK\r\nCache-Control: no-cache\r\nExpires: Fri, 01 Jan 2999 00:00:00 GMT\r\n",
+        "HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\nSet-Cookie: id=1\r\n",
+        "HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\nVary: *\r\n",
+        "HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\nAge: 60\r\n",
+        "HTTP/1.1 200 OK\r\nExpires: Sun, 06 Nov 1994 08:49:37 GMT\r\n",
+        "HTTP/1.1 200 OK\r\nExpires: soon\r\n",
+        "HTTP/1.1 200 OK\r\nLast-Modified: Sun, 06 Nov 1994 08:49:37 GMT\r\n",
+        "HTTP/1.1 500 Internal Server Error\r\nCache-Control: max-age=60\r\n",
+    };
+    for (size_t i = 0; i < sizeof(refused) / sizeof(refused[0]); i++)
+        ck_assert_ptr_null(store_response(&cache, refused[i]));
+    ck_assert_uint_eq(cache.count, 0);
+
+    // s-maxage over max-age over Expires, less the Age the backend reports
+    ProxyCacheEntry *entry = store_response(
+        &cache, "HTTP/1.1 200 OK\r\nCache-Control: max-age=60, s-maxage=10\r\n"
+                "Expires: Fri, 01 Jan 2999 00:00:00 GMT\r\n");
+    ck_assert_ptr_nonnull(entry);
+    ck_assert_uint_eq(entry->fresh_ms, 10000);
+    proxycache_purge(&cache, "x\n/f", 4);
+
+    entry = store_response(&cache, "HTTP/1.1 200 OK\r\nExpires: Fri, 01 Jan 2999 00:00:00 GMT\r\n"
+                                   "Cache-Control: max-age=60\r\n");
+    ck_assert_uint_eq(entry->fresh_ms, 60000);
+    proxycache_purge(&cache, "x\n/f", 4);
+
+    entry = store_response(&cache, "HTTP/1.1 200 OK\r\nDate: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+                                   "Expires: Sun, 06 Nov 1994 08:51:37 GMT\r\n");
+    ck_assert_uint_eq(entry->fresh_ms, 120000);
+    proxycache_purge(&cache, "x\n/f", 4);
+
+    entry = store_response(&cache, "HTTP/1.1 404 Not Found\r\nAge: 15\r\n"
+                                   "Cache-Control: max-age=60, stale-while-revalidate=30\r\n");
+    ck_assert_int_eq(entry->status_code, 404);
+    ck_assert_uint_eq(entry->fresh_ms, 45000);
+    ck_assert_uint_eq(entry->stale_ms, 30000);
+    ck_assert_uint_eq(entry->age_s, 15);
+    ck_assert_ptr_null(memmem(entry->data, entry->head_len, "Age:", 4));
+    ck_assert_uint_eq(entry->body_len, 4);
+    ck_assert_int_eq(memcmp(entry->data + entry->head_len, "body", 4), 0);
+    ck_assert_uint_eq(cache.count, 1);
+    proxycache_destroy(&cache);
+}
+END_TEST
+
+START_TEST(test_proxycache_lookup)
+{
+    ProxyCache cache;
+    ProxyCacheEntry *entry = NULL;
+    ProxyCacheFill *fill = NULL, *waited = NULL;
+    const char *fresh    = "HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\n";
+    proxycache_setup(&cache);
+
+    // Unsafe methods, credentials and bodies bypass the cache. parse_head()
+    // adds the final CRLF, which ends the bodies here
+    const char *bypassed[][2] = {
+        {"POST", ""},
+        {"HEAD", ""},
+        {"GET", "Authorization: Basic eDp5\r\n"},
+        {"GET", "Content-Length: 4\r\n\r\n{}"},
+        {"GET", "Transfer-Encoding: chunked\r\n\r\n0\r\n"},
+    };
+    for (size_t i = 0; i < sizeof(bypassed) / sizeof(bypassed[0]); i++)
+    {
+        parse_head(bypassed[i][0], bypassed[i][1]);
+        ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_BYPASS);
+    }
+
+    // A cut-off response isn't stored
+    parse_head("GET", "");
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_FETCH);
+    ck_assert_ptr_null(proxycache_fill_finish(&cache, fill, 0));
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_FETCH);
+    ck_assert_ptr_null(proxycache_fill_finish(&cache, fill, 0));
+
+    // The first miss fetches, the next ones wait for it, then it hits
+    parse_head("GET", "Content-Length: 0\r\n");
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_FETCH);
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &waited), PROXYCACHE_WAIT);
+    ck_assert_ptr_eq(waited, fill);
+    ProxyCacheEntry *stored = fill_response(&cache, fill, fresh);
+    ck_assert_ptr_nonnull(stored);
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_HIT);
+    ck_assert_ptr_eq(entry, stored);
+    ck_assert_uint_eq(cache.misses, 3);
+    ck_assert_uint_eq(cache.coalesced, 1);
+    ck_assert_uint_eq(cache.hits, 1);
+
+    // Unsafe methods invalidate their target
+    char key[PROXYCACHE_MAX_KEY];
+    ck_assert_uint_eq(proxycache_invalidation_key(req, key, sizeof(key)), 0);
+    parse_head("DELETE", "");
+    ck_assert_uint_eq(proxycache_invalidation_key(req, key, sizeof(key)), 4);
+    ck_assert_int_eq(memcmp(key, "x\n/f", 4), 0);
+
+    // A purge frees unreferenced entries now and referenced ones on release,
+    // and a fetch already running isn't stored
+    proxycache_retain(stored);
+    proxycache_purge(&cache, key, 4);
+    ck_assert_uint_eq(cache.count, 0);
+    ck_assert_int_eq(stored->evicted, 1);
+    proxycache_release(stored);
+    parse_head("GET", "");
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_FETCH);
+    proxycache_purge(&cache, key, 4);
+    ck_assert_ptr_null(fill_response(&cache, fill, fresh));
+
+    // Disabled with a budget of 0
+    cache.budget = 0;
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_BYPASS);
+    proxycache_destroy(&cache);
+}
+END_TEST
+
+START_TEST(test_proxycache_vary)
+{
+    ProxyCache cache;
+    ProxyCacheEntry *entry = NULL;
+    ProxyCacheFill *fill   = NULL;
+    const char *varied     = "HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\n"
+                             "Vary: Accept-Encoding\r\nVary: Accept-Language\r\n";
+    proxycache_setup(&cache);
+
+    parse_head("GET", "Accept-Encoding: gzip\r\nAccept-Language: en\r\n");
+    ProxyCacheEntry *gzip = store_response(&cache, varied);
+    ck_assert_ptr_nonnull(gzip);
+    ck_assert_int_eq(proxycache_entry_matches(gzip, req), 1);
+
+    // Another value of a varied header is another variant, stored alongside
+    parse_head("GET", "Accept-Language: en\r\nAccept-Encoding: br\r\nX-Other: 1\r\n");
+    ck_assert_int_eq(proxycache_entry_matches(gzip, req), 0);
+    ProxyCacheEntry *br = store_response(&cache, varied);
+    ck_assert_ptr_nonnull(br);
+    ck_assert_uint_eq(cache.count, 2);
+
+    parse_head("GET", "accept-encoding: gzip\r\nAccept-Language: en\r\n");
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_HIT);
+    ck_assert_ptr_eq(entry, gzip);
+    parse_head("GET", "Accept-Encoding: br\r\nAccept-Language: en\r\n");
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_HIT);
+    ck_assert_ptr_eq(entry, br);
+
+    // A missing header only matches a variant stored without it
+    parse_head("GET", "Accept-Encoding: gzip\r\n");
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_FETCH);
+    ck_assert_ptr_null(proxycache_fill_finish(&cache, fill, 0));
+
+    // A purge drops every variant
+    proxycache_purge(&cache, "x\n/f", 4);
+    ck_assert_uint_eq(cache.count, 0);
+    ck_assert_uint_eq(cache.bytes, 0);
+    proxycache_destroy(&cache);
+}
+END_TEST
+
+START_TEST(test_proxycache_stale_while_revalidate)
+{
+    ProxyCache cache;
+    ProxyCacheEntry *entry = NULL;
+    ProxyCacheFill *fill = NULL, *refresh = NULL;
+    proxycache_setup(&cache);
+    parse_head("GET", "");
+
+    ProxyCacheEntry *old = store_response(
+        &cache, "HTTP/1.1 200 OK\r\nCache-Control: max-age=60, stale-while-revalidate=30\r\n");
+    ck_assert_ptr_nonnull(old);
+
+    // Expired within the window: the first request refreshes, the others get it stale
+    old->fresh_ms = 0;
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &refresh), PROXYCACHE_FETCH);
+    ck_assert_ptr_eq(refresh->stale, old);
+    ck_assert_ptr_eq(old->refresh, refresh);
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_HIT);
+    ck_assert_ptr_eq(entry, old);
+    ck_assert_uint_eq(cache.stale_hits, 1);
+
+    // The refresh replaces it
+    ProxyCacheEntry *fresh = fill_response(&cache, refresh, "HTTP/1.1 200 OK\r\n"
+                                                            "Cache-Control: max-age=60\r\n");
+    ck_assert_ptr_nonnull(fresh);
+    ck_assert_uint_eq(cache.count, 1);
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_HIT);
+    ck_assert_ptr_eq(entry, fresh);
+
+    // Past the window it is dropped and fetched like a miss
+    fresh->fresh_ms = 0;
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &fill), PROXYCACHE_FETCH);
+    ck_assert_ptr_null(fill->stale);
+    ck_assert_uint_eq(cache.count, 0);
+    ck_assert_int_eq(proxycache_lookup(&cache, req, &entry, &refresh), PROXYCACHE_WAIT);
+    ck_assert_ptr_null(proxycache_fill_finish(&cache, fill, 0));
+    proxycache_destroy(&cache);
+}
+END_TEST
+
+// Writes text to a temporary file and parses it as the config
+static Config *config_from(const char *text)
+{
+    char path[] = "config_test_XXXXXX";
+    int fd      = mkstemp(path);
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq(write(fd, text, strlen(text)), (ssize_t)strlen(text));
+    close(fd);
+
+    Config *cfg = parse_config(path);
+    unlink(path);
+    ck_assert_ptr_nonnull(cfg);
+    return cfg;
+}
+
+START_TEST(test_config_strings)
+{
+    // Every string key owns its value, whichever keys follow it
+    Config *cfg = config_from("access_log=/tmp/x.log\nbalance=round_robin\n"
+                              "balance_key=X-User\naccess_log_sample=0.25\n");
+    ck_assert_str_eq(cfg->access_log, "/tmp/x.log");
+    ck_assert_str_eq(cfg->balance, "round_robin");
+    ck_assert_str_eq(cfg->balance_key, "X-User");
+    ck_assert(cfg->access_log_sample == 0.25);
+    free_config(cfg);
+
+    cfg = config_from("balance=hash\naccess_log=/tmp/a.log\naccess_log=/tmp/b.log\n"
+                      "balance=least_conn\n");
+    ck_assert_str_eq(cfg->access_log, "/tmp/b.log");
+    ck_assert_str_eq(cfg->balance, "least_conn");
+    free_config(cfg);
+
+    cfg = config_from("access_log=/tmp/x.log\naccess_log=off\naccess_log_sample=3\n");
+    ck_assert_ptr_null(cfg->access_log);
+    ck_assert(cfg->access_log_sample == 1);
+    free_config(cfg);
+}
+END_TEST
+
+// Decodes a whole chunked stream, in one call and then one byte at a time
+static long decode_chunked(const char *stream, char *out, size_t *out_len)
+{
+    ChunkedState st = {0};
+    size_t len      = strlen(stream);
+    long whole      = chunked_decode(&st, stream, len, out, out_len);
+
+    ChunkedState bytewise = {0};
+    long consumed = 0, result = 0;
+    for (size_t i = 0; i < len && bytewise.phase != CHUNK_DONE && result >= 0; i++)
+    {
+        result = chunked_decode(&bytewise, stream + i, 1, NULL, NULL);
+        consumed += result;
+    }
+    ck_assert_int_eq(result < 0 ? -1 : consumed, whole);
+    ck_assert_int_eq(bytewise.phase, st.phase);
+    return whole < 0 || st.phase != CHUNK_DONE ? -1 : whole;
+}
+
+START_TEST(test_chunked_decode_strict)
+{
+    char out[64];
+    size_t out_len = 0;
+
+    const char *valid[] = {
+        "5\r\nhello\r\n0\r\n\r\n",
+        "5;a\r\nhello\r\n0;b=c\r\n\r\n",
+        "5 ; a = b ;c=\"x\\\" ;y\"\r\nhello\r\n0\r\n\r\n",
+        "5\t;a;b=\"\"\r\nhello\r\n0\r\nX-Sum: 1\r\nY: 2\r\n\r\n",
+        "A\r\nhello\nwrld\r\n0\r\n\r\n",
+    };
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++)
+    {
+        ck_assert_int_eq(decode_chunked(valid[i], out, &out_len), strlen(valid[i]));
+        ck_assert_uint_eq(out_len, strncmp(valid[i], "A", 1) == 0 ? 10 : 5);
+        ck_assert_int_eq(memcmp(out, "hello", 5), 0);
+    }
+
+    // Anything but a strict CRLF, or extensions that aren't tokens and quoted strings
+    const char *malformed[] = {
+        "5\nhello\r\n0\r\n\r\n",
+        "5\rX\nhello\r\n0\r\n\r\n",
+        "5\r\r\nhello\r\n0\r\n\r\n",
+        "5\r\nhello\n0\r\n\r\n",
+        "5\r\nhello\r\r\n0\r\n\r\n",
+        "5\r\nhelloX0\r\n\r\n",
+        "5\r\nhello\r\n0\r\n\n",
+        "5\r\nhello\r\n0\r\nX: 1\n\r\n",
+        "5\r\nhello\r\n0\r\nX: 1\rY\r\n\r\n",
+        "5 \r\nhello\r\n0\r\n\r\n",
+        "5 5\r\nhello\r\n0\r\n\r\n",
+        "5;\r\nhello\r\n0\r\n\r\n",
+        "5;a=\r\nhello\r\n0\r\n\r\n",
+        "5;a b\r\nhello\r\n0\r\n\r\n",
+        "5;a=b c\r\nhello\r\n0\r\n\r\n",
+        "5;a=\"b\r\nhello\r\n0\r\n\r\n",
+        "5;a=\"b\"c\r\nhello\r\n0\r\n\r\n",
+        "5;a@b\r\nhello\r\n0\r\n\r\n",
+        "5;a \r\nhello\r\n0\r\n\r\n",
+        "x\r\nhello\r\n0\r\n\r\n",
+        "\r\n",
+    };
+    for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++)
+        ck_assert_int_eq(decode_chunked(malformed[i], out, &out_len), -1);
+}
+END_TEST
+
+// Non-blocking socket pair whose sending side only buffers a few KB
+static void small_socketpair(int fds[2])
+{
+    int size = 4096;
+    ck_assert_int_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ck_assert_int_eq(setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)), 0);
+    ck_assert_int_eq(setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)), 0);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+}
+
+// Flushes the queue, reading the peer whenever it blocks, until it drains
+static size_t drain_output(OutputQueue *queue, int fds[2], char *out, size_t cap, int *blocked)
+{
+    size_t received = 0;
+    *blocked        = 0;
+    for (;;)
+    {
+        OutputStatus status = output_flush(queue, fds[0]);
+        ck_assert_int_ne(status, OUTPUT_ERROR);
+
+        ssize_t n;
+        while ((n = recv(fds[1], out + received, cap - received, MSG_DONTWAIT)) > 0)
+            received += n;
+        if (status == OUTPUT_DRAINED) return received;
+        (*blocked)++;
+    }
+}
+
+static int released;
+
+static void count_release(void *ctx)
+{
+    released += *(int *)ctx;
+}
+
+START_TEST(test_output_sendfile_progress)
+{
+    OutputQueue queue;
+    int fds[2], blocked, one = 1;
+    static char body[150000], out[200000];
+    for (size_t i = 0; i < sizeof(body); i++)
+        body[i] = 'A' + i % 23;
+
+    char path[] = "output_test_XXXXXX";
+    int fd      = mkstemp(path);
+    ck_assert_int_ge(fd, 0);
+    unlink(path);
+    ck_assert_int_eq(write(fd, body, sizeof(body)), sizeof(body));
+    small_socketpair(fds);
+    output_init(&queue);
+
+    // A head, a file range sent over many sendfile() calls, then a shared tail
+    released = 0;
+    ck_assert_int_eq(output_append(&queue, "head", 4), 0);
+    ck_assert_int_eq(output_append_file(&queue, dup(fd), 100, sizeof(body) - 200), 0);
+    ck_assert_int_eq(output_append_shared(&queue, "tail", 4, count_release, &one), 0);
+    ck_assert_uint_eq(queue.pending_bytes, 8);
+
+    size_t received = drain_output(&queue, fds, out, sizeof(out), &blocked);
+    ck_assert_int_gt(blocked, 0);
+    ck_assert_uint_eq(received, 4 + sizeof(body) - 200 + 4);
+    ck_assert_int_eq(memcmp(out, "head", 4), 0);
+    ck_assert_int_eq(memcmp(out + 4, body + 100, sizeof(body) - 200), 0);
+    ck_assert_int_eq(memcmp(out + received - 4, "tail", 4), 0);
+    ck_assert_uint_eq(queue.sent_bytes, received);
+    ck_assert_int_eq(released, 1);
+    ck_assert_int_eq(queue.truncated, 0);
+
+    // A file that ends before its range is reported, the rest still goes out
+    ck_assert_int_eq(output_append_file(&queue, dup(fd), sizeof(body) - 10, 100), 0);
+    ck_assert_int_eq(output_append(&queue, "next", 4), 0);
+    received = drain_output(&queue, fds, out, sizeof(out), &blocked);
+    ck_assert_uint_eq(received, 14);
+    ck_assert_int_eq(memcmp(out, body + sizeof(body) - 10, 10), 0);
+    ck_assert_int_eq(memcmp(out + 10, "next", 4), 0);
+    ck_assert_int_eq(queue.truncated, 1);
+
+    output_free(&queue);
+    close(fd);
+    close(fds[0]);
+    close(fds[1]);
+}
+END_TEST
+
+START_TEST(test_output_writev_partial)
+{
+    OutputQueue queue;
+    int fds[2], blocked, one = 1;
+    static char big[200000], out[300000];
+    for (size_t i = 0; i < sizeof(big); i++)
+        big[i] = 'a' + i % 26;
+    small_socketpair(fds);
+    output_init(&queue);
+
+    // Small copies share the tail buffer
+    ck_assert_int_eq(output_append(&queue, "HTTP/1.1 200 OK\r\n", 17), 0);
+    ck_assert_int_eq(output_append(&queue, "\r\n", 2), 0);
+    ck_assert_int_eq(queue.count, 1);
+    ck_assert_uint_eq(queue.pending_bytes, 19);
+
+    // A large shared body needs many partial writev() calls, resumed mid-segment
+    released = 0;
+    ck_assert_int_eq(output_append_shared(&queue, big, sizeof(big), count_release, &one), 0);
+    ck_assert_int_eq(output_append(&queue, "tail", 4), 0);
+    ck_assert_int_eq(queue.count, 3);
+    size_t received = drain_output(&queue, fds, out, sizeof(out), &blocked);
+    ck_assert_int_gt(blocked, 0);
+    ck_assert_uint_eq(received, 19 + sizeof(big) + 4);
+    ck_assert_int_eq(memcmp(out, "HTTP/1.1 200 OK\r\n\r\n", 19), 0);
+    ck_assert_int_eq(memcmp(out + 19, big, sizeof(big)), 0);
+    ck_assert_int_eq(memcmp(out + 19 + sizeof(big), "tail", 4), 0);
+    ck_assert_int_eq(released, 1);
+    ck_assert_uint_eq(queue.pending_bytes, 0);
+    ck_assert_uint_eq(queue.sent_bytes, received);
+    ck_assert(!output_pending(&queue));
+
+    // The drained buffer is reused, and a full queue copies into its tail
+    char *spare = queue.spare;
+    ck_assert_ptr_nonnull(spare);
+    for (int i = 1; i < OUTPUT_MAX_SEGMENTS; i++)
+        ck_assert_int_eq(output_append_shared(&queue, "s", 1, count_release, &one), 0);
+    ck_assert_int_eq(output_append(&queue, "x", 1), 0);
+    ck_assert_int_eq(queue.count, OUTPUT_MAX_SEGMENTS);
+    OutSegment *tail = &queue.segments[(queue.head + queue.count - 1) % OUTPUT_MAX_SEGMENTS];
+    ck_assert_ptr_eq(tail->data, spare);
+    ck_assert_int_eq(output_append_shared(&queue, "!", 1, count_release, &one), 0);
+    ck_assert_int_eq(queue.count, OUTPUT_MAX_SEGMENTS);
+    ck_assert_uint_eq(tail->len, 2);
+    ck_assert_int_eq(released, 2);
+    ck_assert_int_eq(output_append_file(&queue, dup(fds[1]), 0, 1), -1);
+
+    // Dropping the queue releases what wasn't sent
+    output_reset(&queue);
+    ck_assert_int_eq(released, 2 + OUTPUT_MAX_SEGMENTS - 1);
+    ck_assert_uint_eq(queue.pending_bytes, 0);
+    output_free(&queue);
+    close(fds[0]);
+    close(fds[1]);
+}
+END_TEST
+
+START_TEST(test_arena_alloc_reset)
+{
+    Arena arena;
+    ck_assert_int_eq(arena_init(&arena, 256), 0);
+
+    // Allocations are 16-byte aligned and carved one after the other
+    char *a = arena_alloc(&arena, 3);
+    char *b = arena_alloc(&arena, 20);
+    ck_assert_uint_eq((uintptr_t)a % 16, 0);
+    ck_assert_ptr_eq(b, a + 16);
+    ck_assert_uint_eq(arena.first->used, 48);
+
+    // The permanent part survives resets
+    ck_assert_str_eq(arena_strdup(&arena, "kept"), "kept");
+    arena_set_floor(&arena);
+    size_t floor = arena.first->used;
+    char *line   = arena_sprintf(&arena, "%s %d", "status", 200);
+    ck_assert_str_eq(line, "status 200");
+
+    // The latest allocation grows in place while the block has room
+    char *grown = arena_realloc(&arena, line, 11, 40);
+    ck_assert_ptr_eq(grown, line);
+    char *moved = arena_realloc(&arena, a, 3, 64);
+    ck_assert_ptr_ne(moved, a);
+    ck_assert_int_eq(memcmp(moved, a, 3), 0);
+
+    // Overflow and oversized requests get their own blocks, dropped on reset
+    char *big = arena_alloc(&arena, 1000);
+    ck_assert_ptr_nonnull(big);
+    ck_assert_ptr_ne(arena.head, arena.first);
+    memset(big, 'x', 1000);
+    arena_reset(&arena);
+    ck_assert_ptr_eq(arena.head, arena.first);
+    ck_assert_uint_eq(arena.first->used, floor);
+    ck_assert_str_eq((char *)arena.first->data + 48, "kept");
+    ck_assert_ptr_eq(arena_alloc(&arena, 1), arena.first->data + floor);
+
+    // The floor can't be raised from an overflow block
+    arena_alloc(&arena, 300);
+    arena_set_floor(&arena);
+    arena_reset(&arena);
+    ck_assert_uint_eq(arena.first->used, floor);
+    arena_destroy(&arena);
+    ck_assert_ptr_null(arena.head);
+}
+END_TEST
+
+typedef struct TestTimer
+{
+    TimerNode node;
+    int fired;
+    int rearm_ms; // arms itself again with this delay when it fires, if set
+} TestTimer;
+
+static void fire_timer(TimerNode *node, void *arg)
+{
+    TestTimer *timer = (TestTimer *)node;
+    timer->fired++;
+    if (timer->rearm_ms) timerwheel_arm(arg, node, timer->rearm_ms);
+}
+
+START_TEST(test_timerwheel_expiry)
+{
+    static TimerWheel wheel;
+    TestTimer soon = {0}, later = {0}, canceled = {0}, far = {0};
+    uint64_t start = 1000000;
+    timerwheel_init(&wheel, start);
+
+    timerwheel_arm(&wheel, &soon.node, 250);
+    timerwheel_arm(&wheel, &later.node, 1000);
+    timerwheel_arm(&wheel, &canceled.node, 250);
+    ck_assert(timer_armed(&soon.node));
+    timerwheel_cancel(&canceled.node);
+    ck_assert(!timer_armed(&canceled.node));
+
+    // Due timers fire within a tick of their deadline, never early
+    timerwheel_advance(&wheel, start + 249, fire_timer, &wheel);
+    ck_assert_int_eq(soon.fired, 0);
+    timerwheel_advance(&wheel, start + 250 + TIMER_TICK_MS, fire_timer, &wheel);
+    ck_assert_int_eq(soon.fired, 1);
+    ck_assert(!timer_armed(&soon.node));
+    ck_assert_int_eq(later.fired, 0);
+    ck_assert_int_eq(canceled.fired, 0);
+
+    // Rearming moves the deadline out
+    timerwheel_arm(&wheel, &later.node, 1000);
+    timerwheel_advance(&wheel, start + 1000 + TIMER_TICK_MS, fire_timer, &wheel);
+    ck_assert_int_eq(later.fired, 0);
+    timerwheel_advance(&wheel, start + 1350 + TIMER_TICK_MS, fire_timer, &wheel);
+    ck_assert_int_eq(later.fired, 1);
+
+    // Beyond one turn of the wheel a timer waits for its own turn
+    uint64_t now = start + 1350 + TIMER_TICK_MS;
+    uint64_t turn = (uint64_t)TIMER_WHEEL_SLOTS * TIMER_TICK_MS;
+    timerwheel_arm(&wheel, &far.node, turn + 500);
+    for (uint64_t t = now + TIMER_TICK_MS; t < now + turn + 500; t += TIMER_TICK_MS)
+        timerwheel_advance(&wheel, t, fire_timer, &wheel);
+    ck_assert_int_eq(far.fired, 0);
+    now += turn + 500 + TIMER_TICK_MS;
+    timerwheel_advance(&wheel, now, fire_timer, &wheel);
+    ck_assert_int_eq(far.fired, 1);
+
+    // A callback may rearm its own timer, which fires again on a later tick
+    soon.rearm_ms = 100;
+    timerwheel_arm(&wheel, &soon.node, 0);
+    timerwheel_advance(&wheel, now + TIMER_TICK_MS, fire_timer, &wheel);
+    ck_assert_int_eq(soon.fired, 2);
+    ck_assert(timer_armed(&soon.node));
+    timerwheel_advance(&wheel, now + 3 * TIMER_TICK_MS, fire_timer, &wheel);
+    ck_assert_int_eq(soon.fired, 3);
+
+    // A long stall still expires everything that was due
+    soon.rearm_ms = 0;
+    timerwheel_arm(&wheel, &later.node, 5000);
+    timerwheel_advance(&wheel, now + 10 * turn, fire_timer, &wheel);
+    ck_assert_int_eq(soon.fired, 4);
+    ck_assert_int_eq(later.fired, 2);
+}
+END_TEST
+
+START_TEST(test_log_level_names)
+{
+    ck_assert_int_eq(log_level_from_name("debug"), LOG_LEVEL_DEBUG);
+    ck_assert_int_eq(log_level_from_name("INFO"), LOG_LEVEL_INFO);
+    ck_assert_int_eq(log_level_from_name("Warning"), LOG_LEVEL_WARNING);
+    ck_assert_int_eq(log_level_from_name("warn"), LOG_LEVEL_WARNING);
+    ck_assert_int_eq(log_level_from_name("error"), LOG_LEVEL_ERROR);
+    ck_assert_int_eq(log_level_from_name("verbose"), -1);
+    ck_assert_int_eq(log_level_from_name(""), -1);
+}
+END_TEST
+
+// Points stdout at a pipe, returns the read end
+static int capture_stdout(void)
+{
+    int fds[2];
+    ck_assert_int_eq(pipe(fds), 0);
+    ck_assert_int_ge(dup2(fds[1], STDOUT_FILENO), 0);
+    close(fds[1]);
+    return fds[0];
+}
+
+START_TEST(test_log_sync_records)
+{
+    // Without the flusher records are written straight away
+    int out   = capture_stdout();
+    log_level = LOG_LEVEL_WARNING;
+    LOG(INFO, "skipped");
+    LOG(ERROR, "kept %d", 7);
+
+    char long_message[2 * LOG_LINE_MAX];
+    memset(long_message, 'a', sizeof(long_message) - 1);
+    long_message[sizeof(long_message) - 1] = '\0';
+    LOG(WARNING, "%s", long_message);
+
+    char buf[4 * LOG_LINE_MAX];
+    ssize_t n = read(out, buf, sizeof(buf) - 1);
+    ck_assert_int_gt(n, 0);
+    buf[n] = '\0';
+
+    char *first = strchr(buf, '\n');
+    ck_assert_ptr_nonnull(first);
+    *first = '\0';
+    ck_assert_ptr_null(strstr(buf, "skipped"));
+    ck_assert_ptr_nonnull(strstr(buf, "] [ERROR] ("));
+    ck_assert_int_eq(strcmp(first - strlen(") kept 7"), ") kept 7"), 0);
+
+    // A long record is cut to LOG_LINE_MAX, still ending in a newline
+    char *second = first + 1;
+    ck_assert_int_eq(buf + n - second, LOG_LINE_MAX);
+    ck_assert_int_eq(buf[n - 1], '\n');
+    ck_assert_int_eq(buf[n - 2], 'a');
+    close(out);
+}
+END_TEST
+
+// Sums the "[logger] N records dropped" notes and counts the other lines
+static void count_log_lines(const char *buf, size_t len, size_t *records, size_t *dropped_total)
+{
+    *records = *dropped_total = 0;
+    const char *line          = buf;
+    const char *end;
+    while ((end = memchr(line, '\n', buf + len - line)))
+    {
+        size_t lost;
+        if (sscanf(line, "[logger] %zu records dropped", &lost) == 1)
+            *dropped_total += lost;
+        else
+            (*records)++;
+        line = end + 1;
+    }
+}
+
+START_TEST(test_log_ring_overflow)
+{
+    // Nobody reads stdout, so the flusher blocks and the ring fills up
+    enum { TOTAL = 4 * LOG_RING_SLOTS };
+    int out = capture_stdout();
+    ck_assert_int_eq(log_start(), 0);
+    for (int i = 0; i < TOTAL; i++)
+        LOG(INFO, "record %d", i);
+
+    // Every record is either written or counted as dropped, none block
+    size_t cap = (size_t)TOTAL * 128, len = 0, records = 0, lost = 0;
+    char *buf  = malloc(cap);
+    struct pollfd pfd = {.fd = out, .events = POLLIN};
+    while (records + lost < TOTAL && poll(&pfd, 1, 5000) == 1)
+    {
+        ssize_t n = read(out, buf + len, cap - len);
+        ck_assert_int_gt(n, 0);
+        len += (size_t)n;
+        count_log_lines(buf, len, &records, &lost);
+    }
+    ck_assert_uint_eq(records + lost, TOTAL);
+    ck_assert_uint_gt(lost, 0);
+    ck_assert_uint_ge(records, LOG_RING_SLOTS);
+
+    // What made it out is in order, starting with the first record
+    int last = -1;
+    for (const char *p = buf; (p = strstr(p, ") record ")); p++)
+    {
+        int seen = atoi(p + strlen(") record "));
+        ck_assert_int_eq(last < 0 ? seen : 0, 0);
+        ck_assert_int_gt(seen, last);
+        last = seen;
+    }
+    free(buf);
+    log_stop();
+    close(out);
+}
+END_TEST
+
+typedef struct
+{
+    Worker *worker;
+    Connection *conn;
+    char path[32];
+} AccessFixture;
+
+// A worker logging to a fresh file, and a connection with "GET <uri>" answered
+static void access_setup(AccessFixture *fx, const char *options, char *uri)
+{
+    strcpy(fx->path, "access_test_XXXXXX");
+    int fd = mkstemp(fx->path);
+    ck_assert_int_ge(fd, 0);
+    close(fd);
+    ck_assert_int_eq(log_open_access(fx->path), 0);
+
+    char text[256];
+    snprintf(text, sizeof(text), "access_log=%s\n%s", fx->path, options);
+    Config *cfg = config_from(text);
+    fx->worker  = calloc(1, sizeof(Worker));
+    accesslog_init(&fx->worker->access_log, cfg, 1);
+    free_config(cfg);
+
+    fx->conn                                  = calloc(1, sizeof(Connection));
+    fx->conn->request.request_line.method     = "GET";
+    fx->conn->request.request_line.method_len = 3;
+    fx->conn->request.request_line.uri        = uri;
+    fx->conn->request.request_line.uri_len    = strlen(uri);
+    fx->conn->status                          = 200;
+}
+
+// Logs the connection's request as if it had just been answered
+static void access_log_request(AccessFixture *fx, int status, int aborted)
+{
+    fx->conn->status     = status;
+    fx->conn->request_us = monotonic_us() - 1500;
+    accesslog_request(fx->worker, fx->conn, aborted);
+}
+
+static size_t access_read(AccessFixture *fx, char *out, size_t cap)
+{
+    int fd = open(fx->path, O_RDONLY);
+    ck_assert_int_ge(fd, 0);
+    ssize_t n = read(fd, out, cap - 1);
+    close(fd);
+    ck_assert_int_ge(n, 0);
+    out[n] = '\0';
+    return (size_t)n;
+}
+
+static void access_teardown(AccessFixture *fx)
+{
+    unlink(fx->path);
+    free(fx->conn);
+    free(fx->worker);
+}
+
+START_TEST(test_accesslog_json)
+{
+    AccessFixture fx;
+    char uri[] = "/a\"b\\c\x01";
+    access_setup(&fx, "", uri);
+    fx.conn->out.sent_bytes = 42;
+    access_log_request(&fx, 200, 0);
+
+    // The request is logged once, however often the connection is seen
+    ck_assert_uint_eq(fx.conn->request_us, 0);
+    accesslog_request(fx.worker, fx.conn, 0);
+
+    char buf[2 * LOG_LINE_MAX];
+    access_read(&fx, buf, sizeof(buf));
+    ck_assert_int_eq(strncmp(buf, "{\"time\":\"", 9), 0);
+    ck_assert_ptr_nonnull(strstr(buf, "Z\",\"method\":\"GET\",\"uri\":\"/a\\\"b\\\\c\\u0001\","
+                                      "\"status\":200,\"bytes\":42,"
+                                      "\"upstream\":null,\"upstream_ms\":null,\"total_ms\":"));
+    ck_assert_ptr_null(strstr(buf, "aborted"));
+    char *end = strchr(buf, '\n');
+    ck_assert_ptr_nonnull(end);
+    ck_assert_int_eq(end[-1], '}');
+    ck_assert_int_eq(end[1], '\0');
+    access_teardown(&fx);
+}
+END_TEST
+
+START_TEST(test_accesslog_json_long_uri)
+{
+    // A URI too long for the record is cut, the record still closes
+    static char uri[2 * LOG_LINE_MAX];
+    memset(uri, 'u', sizeof(uri) - 1);
+    uri[0] = '/';
+
+    AccessFixture fx;
+    access_setup(&fx, "", uri);
+    Backend backend      = {.host = "10.0.0.1", .port = "8000"};
+    fx.conn->backend     = &backend;
+    fx.conn->upstream_us = 2500;
+    access_log_request(&fx, 502, 1);
+
+    char buf[2 * LOG_LINE_MAX];
+    size_t len = access_read(&fx, buf, sizeof(buf));
+    ck_assert_uint_le(len, LOG_LINE_MAX);
+    ck_assert_ptr_nonnull(strstr(buf, "uuu\",\"status\":502,"));
+    ck_assert_ptr_nonnull(strstr(buf, "\"upstream\":\"10.0.0.1:8000\",\"upstream_ms\":2.500,"));
+    ck_assert_ptr_nonnull(strstr(buf, ",\"aborted\":true}\n"));
+    access_teardown(&fx);
+}
+END_TEST
+
+START_TEST(test_accesslog_sampling)
+{
+    // Nothing is sampled, but errors and aborted requests are still logged
+    AccessFixture fx;
+    char uri[] = "/s";
+    access_setup(&fx, "access_log_sample=0\n", uri);
+    access_log_request(&fx, 200, 0);
+    access_log_request(&fx, 404, 0);
+    access_log_request(&fx, 503, 0);
+    access_log_request(&fx, 200, 1);
+
+    char buf[4 * LOG_LINE_MAX];
+    access_read(&fx, buf, sizeof(buf));
+    char *second = strchr(buf, '\n');
+    ck_assert_ptr_nonnull(second);
+    ck_assert_ptr_nonnull(strstr(buf, "\"status\":503"));
+    ck_assert_ptr_nonnull(strstr(second, "\"status\":200"));
+    ck_assert_ptr_nonnull(strstr(second, "\"aborted\":true}\n"));
+    ck_assert_int_eq(strchr(second + 1, '\n')[1], '\0');
+    ck_assert_ptr_null(strstr(buf, "\"status\":404"));
+    access_teardown(&fx);
+
+    // Half the requests, give or take, at a sample of 0.5
+    access_setup(&fx, "access_log_sample=0.5\n", uri);
+    for (int i = 0; i < 1000; i++)
+        access_log_request(&fx, 200, 0);
+    static char many[1000 * 200];
+    size_t len = access_read(&fx, many, sizeof(many));
+    int records = 0;
+    for (size_t i = 0; i < len; i++)
+        records += many[i] == '\n';
+    ck_assert_int_gt(records, 400);
+    ck_assert_int_lt(records, 600);
+    access_teardown(&fx);
+}
+END_TEST
+
+START_TEST(test_accesslog_binary)
+{
+    AccessFixture fx;
+    char uri[] = "/bin?x=1";
+    access_setup(&fx, "access_log_format=binary\n", uri);
+    Backend backend         = {.host = "b", .port = "80"};
+    fx.conn->backend        = &backend;
+    fx.conn->upstream_us    = 777;
+    fx.conn->out.sent_bytes = 1234;
+    access_log_request(&fx, 201, 0);
+
+    char buf[LOG_LINE_MAX];
+    size_t len = access_read(&fx, buf, sizeof(buf));
+    AccessRecord rec;
+    ck_assert_uint_ge(len, sizeof(rec));
+    memcpy(&rec, buf, sizeof(rec));
+    ck_assert_uint_eq(rec.length, len);
+    ck_assert_uint_eq(rec.status, 201);
+    ck_assert_uint_eq(rec.flags, 0);
+    ck_assert_uint_eq(rec.bytes, 1234);
+    ck_assert_uint_eq(rec.upstream_us, 777);
+    ck_assert_uint_ge(rec.total_us, 1500);
+    ck_assert_uint_eq(rec.method_len + rec.uri_len + rec.upstream_len, len - sizeof(rec));
+    ck_assert_int_eq(memcmp(buf + sizeof(rec), "GET/bin?x=1b:80", len - sizeof(rec)), 0);
+    access_teardown(&fx);
+}
+END_TEST
+
+START_TEST(test_canned_responses)
+{
+    ck_assert_int_eq(canned_init(), OK);
+    ck_assert_int_eq(canned_init(), OK);
+
+    const CannedResponse *res = canned_response(404, 1);
+    ck_assert_ptr_nonnull(res);
+    const char expected[] = "HTTP/1.1 404 Not Found\r\n"
+                            "Content-Type: text/html\r\n"
+                            "Content-Length: 22\r\n"
+                            "\r\n"
+                            "<h1>404 Not Found</h1>";
+    ck_assert_uint_eq(res->len, strlen(expected));
+    ck_assert_int_eq(memcmp(res->data, expected, res->len), 0);
+
+    // Statuses without a canned response, and those out of range
+    ck_assert_ptr_null(canned_response(200, 1));
+    ck_assert_ptr_null(canned_response(418, 0));
+    ck_assert_ptr_null(canned_response(CANNED_MIN_STATUS - 1, 1));
+    ck_assert_ptr_null(canned_response(CANNED_MAX_STATUS + 1, 0));
+
+    // Every response frames its body, only the close variant says so
+    int found = 0;
+    for (int status = CANNED_MIN_STATUS; status <= CANNED_MAX_STATUS; status++)
+    {
+        for (int keep_alive = 0; keep_alive < 2; keep_alive++)
+        {
+            res = canned_response(status, keep_alive);
+            if (!res) continue;
+            found++;
+
+            char text[512];
+            ck_assert_uint_lt(res->len, sizeof(text));
+            memcpy(text, res->data, res->len);
+            text[res->len] = '\0';
+
+            char status_line[16];
+            snprintf(status_line, sizeof(status_line), "HTTP/1.1 %d ", status);
+            ck_assert_int_eq(strncmp(text, status_line, strlen(status_line)), 0);
+            char *body = strstr(text, "\r\n\r\n");
+            ck_assert_ptr_nonnull(body);
+            *body = '\0';
+            body += 4;
+            char *length = strstr(text, "\r\nContent-Length: ");
+            ck_assert_ptr_nonnull(length);
+            ck_assert_uint_eq(strtoul(length + 18, NULL, 10), strlen(body));
+            ck_assert_int_eq(strstr(text, "\r\nConnection: close") != NULL, !keep_alive);
+        }
+        if (canned_response(status, 0))
+            ck_assert_ptr_ne(canned_response(status, 0)->data, canned_response(status, 1)->data);
+    }
+    ck_assert_int_eq(found, 2 * 15);
+}
+END_TEST
+
+START_TEST(test_response_write_head)
+{
+    char buf[256];
+    const char plain[] = "HTTP/1.1 200 OK\r\n"
+                         "Content-Type: text/plain\r\n"
+                         "Content-Length: 0\r\n"
+                         "\r\n";
+    int len = httpresponse_write_head(buf, sizeof(buf), 200, "OK", "text/plain", 0, NULL);
+    ck_assert_int_eq(len, (int)strlen(plain));
+    ck_assert_str_eq(buf, plain);
+
+    const char extra[] = "HTTP/1.1 206 Partial Content\r\n"
+                         "Content-Type: image/png\r\n"
+                         "Content-Length: 18446744073709551615\r\n"
+                         "ETag: \"x\"\r\nAccept-Ranges: bytes\r\n"
+                         "\r\n";
+    len = httpresponse_write_head(buf, sizeof(buf), 206, "Partial Content", "image/png",
+                                  UINT64_MAX, "ETag: \"x\"\r\nAccept-Ranges: bytes\r\n");
+    ck_assert_int_eq(len, (int)strlen(extra));
+    ck_assert_str_eq(buf, extra);
+
+    // The head and its terminator have to fit
+    size_t need = strlen(plain) + 1;
+    ck_assert_int_eq(httpresponse_write_head(buf, need, 200, "OK", "text/plain", 0, ""),
+                     (int)need - 1);
+    ck_assert_int_eq(httpresponse_write_head(buf, need - 1, 200, "OK", "text/plain", 0, ""), -1);
+    ck_assert_int_eq(httpresponse_write_head(buf, sizeof(buf), 99, "OK", "text/plain", 0, NULL),
+                     -1);
+    ck_assert_int_eq(httpresponse_write_head(buf, sizeof(buf), 1000, "OK", "text/plain", 0, NULL),
+                     -1);
+}
+END_TEST
+
+// Codings accepted by a request with the given Accept-Encoding, NULL for none
+static unsigned accepted_for(const char *value)
+{
+    char headers[128] = "";
+    if (value) snprintf(headers, sizeof(headers), "Accept-Encoding: %s\r\n", value);
+    parse_head("GET", headers);
+    return static_accepted_encodings(get_http_header(req, HDR_ACCEPT_ENCODING));
+}
+
+START_TEST(test_static_encoding_negotiation)
+{
+    const unsigned gzip = ENC_BIT(ENC_GZIP), br = ENC_BIT(ENC_BR);
+
+    ck_assert_uint_eq(accepted_for(NULL), 0);
+    ck_assert_uint_eq(accepted_for("identity"), 0);
+    ck_assert_uint_eq(accepted_for("gzip, deflate, br"), gzip | br);
+    ck_assert_uint_eq(accepted_for("GZIP"), gzip);
+    ck_assert_uint_eq(accepted_for("x-gzip"), gzip);
+    ck_assert_uint_eq(accepted_for("gzipx, brotli"), 0);
+
+    // q=0 refuses a coding, any other q-value accepts it
+    ck_assert_uint_eq(accepted_for("gzip;q=0, br"), br);
+    ck_assert_uint_eq(accepted_for("gzip ; Q=0.000, br;q=0.001"), br);
+    ck_assert_uint_eq(accepted_for("gzip;level=1;q=0.5,br;q=1.0"), gzip | br);
+    ck_assert_uint_eq(accepted_for("br;q=0.0, gzip;q=0.01"), gzip);
+
+    // "*" stands for every coding not listed
+    ck_assert_uint_eq(accepted_for("*"), gzip | br);
+    ck_assert_uint_eq(accepted_for("br;q=0, *"), gzip);
+    ck_assert_uint_eq(accepted_for("*;q=0"), 0);
+    ck_assert_uint_eq(accepted_for("gzip, *;q=0"), gzip);
+
+    ck_assert(static_compressible("text/css"));
+    ck_assert(static_compressible("application/javascript"));
+    ck_assert(static_compressible("image/svg+xml"));
+    ck_assert(!static_compressible("image/png"));
+    ck_assert(!static_compressible("application/octet-stream"));
+}
+END_TEST
+
+START_TEST(test_static_encoded_head)
+{
+    char head[STATIC_HEAD_SIZE];
+    int len = static_write_head(head, sizeof(head), "text/css", ENC_GZIP, 1, 10, "\"e\"", 0);
+    ck_assert_int_gt(len, 0);
+    ck_assert_int_eq(strncmp(head, "HTTP/1.1 200 OK\r\nContent-Type: text/css\r\n", 41), 0);
+    ck_assert_ptr_nonnull(strstr(head, "\r\nContent-Length: 10\r\n"));
+    ck_assert_ptr_nonnull(strstr(head, "\r\nETag: \"e\"\r\n"));
+    ck_assert_ptr_nonnull(strstr(head, "\r\nLast-Modified: Thu, 01 Jan 1970 00:00:00 GMT\r\n"));
+    ck_assert_ptr_nonnull(strstr(head, "\r\nContent-Encoding: gzip\r\nVary: Accept-Encoding\r\n"));
+
+    // The identity variant of a negotiated file still varies
+    len = static_write_head(head, sizeof(head), "text/css", ENC_IDENTITY, 1, 10, "\"e\"", 0);
+    ck_assert_int_gt(len, 0);
+    ck_assert_ptr_null(strstr(head, "Content-Encoding"));
+    ck_assert_ptr_nonnull(strstr(head, "\r\nVary: Accept-Encoding\r\n"));
+    len = static_write_head(head, sizeof(head), "image/png", ENC_IDENTITY, 0, 10, "\"e\"", 0);
+    ck_assert_ptr_null(strstr(head, "Vary"));
+
+    // Gzipped copies and the file they come from have different tags
+    char etag[STATIC_ETAG_SIZE], gz_etag[STATIC_ETAG_SIZE];
+    static_write_etag(etag, 0x1f, 100, 0x5f, 0);
+    static_write_etag(gz_etag, 0x1f, 100, 0x5f, 1);
+    ck_assert_str_eq(etag, "\"1f-64-5f\"");
+    ck_assert_str_eq(gz_etag, "\"1f-64-5f-gz\"");
+}
+END_TEST
+
+START_TEST(test_gzip_compress)
+{
+    char text[4096];
+    for (size_t i = 0; i < sizeof(text); i++)
+        text[i] = "body { color: red; }\n"[i % 21];
+
+    size_t len;
+    char *gz = gzip_compress(text, sizeof(text), &len);
+    ck_assert_ptr_nonnull(gz);
+    ck_assert_uint_lt(len, sizeof(text) / 4);
+    ck_assert_uint_eq((unsigned char)gz[0], 0x1f); // gzip magic, not a zlib header
+    ck_assert_uint_eq((unsigned char)gz[1], 0x8b);
+
+    char back[sizeof(text)];
+    z_stream stream  = {0};
+    stream.next_in   = (Bytef *)gz;
+    stream.avail_in  = len;
+    stream.next_out  = (Bytef *)back;
+    stream.avail_out = sizeof(back);
+    ck_assert_int_eq(inflateInit2(&stream, 15 + 16), Z_OK);
+    ck_assert_int_eq(inflate(&stream, Z_FINISH), Z_STREAM_END);
+    ck_assert_uint_eq(stream.total_out, sizeof(text));
+    inflateEnd(&stream);
+    ck_assert_int_eq(memcmp(back, text, sizeof(text)), 0);
+    free(gz);
+}
+END_TEST
+
+// Parses the head of @p request with stream_body set, returns the head length
+static size_t stream_head(const char *request)
+{
+    snprintf(head_buf, sizeof(head_buf), "%s", request);
+    reset_http_request(req);
+    request_parser_init(&parser);
+    parser.stream_body = 1;
+    ck_assert_int_eq(parse_http_request_partial(&parser, req, head_buf, strlen(head_buf)),
+                     PARSE_BODY);
+    return parser.parsed;
+}
+
+// Feeds the body @p step bytes at a time, the way the input arrives
+static size_t stream_body_bytes(char *data, size_t len, size_t step, int decode, char *out)
+{
+    size_t at = 0, total = 0;
+    while (parser.state == PARSE_BODY && at < len)
+    {
+        size_t chunk = len - at < step ? len - at : step;
+        size_t ready;
+        long n = parse_request_body(&parser, data + at, chunk, decode, &ready);
+        ck_assert_int_ge(n, 0);
+        ck_assert_uint_le(ready, (size_t)n);
+        memcpy(out + total, data + at, ready);
+        total += ready;
+        at += (size_t)n;
+        if ((size_t)n < chunk) break; // the body ended inside this slice
+    }
+    ck_assert_int_eq(parser.state, PARSE_DONE);
+    return at;
+}
+
+START_TEST(test_stream_body_content_length)
+{
+    const char *request = "POST /f HTTP/1.1\r\nHost: x\r\nContent-Length: 10\r\n\r\n"
+                          "0123456789GET /next HTTP/1.1\r\n\r\n";
+    for (size_t step = 1; step <= 16; step += 5)
+    {
+        size_t head = stream_head(request);
+        ck_assert_uint_eq(head, strstr(request, "0123") - request);
+        ck_assert_uint_eq(parser.content_length, 10);
+
+        char out[64];
+        size_t used = stream_body_bytes(head_buf + head, strlen(head_buf) - head, step, 1, out);
+        ck_assert_uint_eq(used, 10);
+        ck_assert_int_eq(memcmp(out, "0123456789", 10), 0);
+        ck_assert_uint_eq(parser.body_received, 10);
+        ck_assert_uint_eq(parser.body_remaining, 0);
+
+        // The next request is left where it was
+        ck_assert_int_eq(strncmp(head_buf + head + used, "GET /next", 9), 0);
+        size_t ready = 1;
+        ck_assert_int_eq(parse_request_body(&parser, head_buf + head + used, 4, 1, &ready), 0);
+        ck_assert_uint_eq(ready, 0);
+    }
+}
+END_TEST
+
+START_TEST(test_stream_body_chunked)
+{
+    const char *request = "POST /f HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\n";
+    const char *body    = "4;x=1\r\nWiki\r\n5\r\npedia\r\n0\r\nX-Trailer: y\r\n\r\n";
+    char text[512];
+    snprintf(text, sizeof(text), "%s%sGET /next HTTP/1.1\r\n\r\n", request, body);
+
+    for (size_t step = 1; step <= 64; step *= 4)
+    {
+        // Decoded in place: the data comes out, the framing is dropped
+        size_t head = stream_head(text);
+        ck_assert_uint_eq(head, strlen(request));
+        char out[128];
+        size_t used = stream_body_bytes(head_buf + head, strlen(head_buf) - head, step, 1, out);
+        ck_assert_uint_eq(used, strlen(body));
+        ck_assert_uint_eq(parser.body_received, 9);
+        ck_assert_int_eq(memcmp(out, "Wikipedia", 9), 0);
+
+        // Passed on raw: the body is relayed as it was sent
+        head = stream_head(text);
+        used = stream_body_bytes(head_buf + head, strlen(head_buf) - head, step, 0, out);
+        ck_assert_uint_eq(used, strlen(body));
+        ck_assert_uint_eq(parser.body_received, 9);
+        ck_assert_int_eq(memcmp(out, body, used), 0);
+        ck_assert_int_eq(strncmp(head_buf + head + used, "GET /next", 9), 0);
+    }
+
+    // Malformed framing fails the request, whenever it shows up
+    size_t head = stream_head("POST /f HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\n"
+                              "3\r\nabc\r\nzz\r\n");
+    size_t ready;
+    ck_assert_int_ge(parse_request_body(&parser, head_buf + head, 8, 1, &ready), 0);
+    ck_assert_uint_eq(ready, 3);
+    ck_assert_int_eq(parse_request_body(&parser, head_buf + head + 8, 4, 1, &ready), -1);
+    ck_assert_int_eq(parser.state, PARSE_ERROR);
+}
+END_TEST
+
+START_TEST(test_config_reload)
+{
+    Config *cfg = config_from("shutdown_timeout=-5\nlog_level=warn\n"
+                              "backend=127.0.0.1:8000\nbackend=127.0.0.1:8001\n"
+                              "route=/healthz canned 503\nroute=/api/* proxy\n");
+    ck_assert_int_eq(cfg->shutdown_timeout, 0);
+    ck_assert_int_eq(cfg->log_level, LOG_LEVEL_WARNING);
+    ck_assert_uint_eq(cfg->route_count, 2);
+
+    // A reload publishes the config with the routes compiled from it
+    ServerConfig *shared = server_config_create(cfg, 2);
+    ck_assert_ptr_nonnull(shared);
+    ck_assert_ptr_eq(shared->config, cfg);
+    ck_assert_uint_eq(shared->generation, 2);
+    ck_assert_int_eq(shared->refs, 1);
+    RouteMatch match;
+    const Route *route = router_match(&shared->router, "/healthz", 8, &match);
+    ck_assert_ptr_nonnull(route);
+    ck_assert_int_eq(route->status, 503);
+    ck_assert_ptr_null(router_match(&shared->router, "/static/a.css", 13, &match));
+
+    // Each worker builds its own backends and holds a reference until done
+    WorkerConfig *a = worker_config_create(shared);
+    WorkerConfig *b = worker_config_create(shared);
+    ck_assert_ptr_nonnull(a);
+    ck_assert_ptr_nonnull(b);
+    ck_assert_int_eq(shared->refs, 3);
+    ck_assert_int_eq(a->backend_count, 2);
+    ck_assert_ptr_ne(a->backends, b->backends);
+    ck_assert_str_eq(a->backends[1].port, "8001");
+    worker_config_destroy(a);
+    ck_assert_int_eq(shared->refs, 2);
+    server_config_release(shared);
+    ck_assert_int_eq(shared->refs, 1);
+    worker_config_destroy(b); // the last reference frees the config
+
+    // Without routes the defaults are compiled, without backends the default one
+    cfg = config_from("port=8081\n");
+    ck_assert_int_eq(cfg->shutdown_timeout, DEFAULT_SHUTDOWN_TIMEOUT);
+    shared = server_config_create(cfg, 3);
+    ck_assert_ptr_nonnull(shared);
+    ck_assert_ptr_nonnull(router_match(&shared->router, "/static/a.css", 13, &match));
+    a = worker_config_create(shared);
+    ck_assert_ptr_nonnull(a);
+    ck_assert_int_eq(a->backend_count, 1);
+    worker_config_destroy(a);
+    server_config_release(shared);
+
+    // An invalid route rejects the reload, the config stays the caller's
+    cfg = config_from("route=/a/:id canned 404\nroute=/a/:name/b canned 404\n");
+    ck_assert_ptr_null(server_config_create(cfg, 4));
+    ck_assert_uint_eq(cfg->route_count, 2);
+    free_config(cfg);
+
+    // So does a backend spec without a host
+    cfg    = config_from("backend=:8000\n");
+    shared = server_config_create(cfg, 5);
+    ck_assert_ptr_nonnull(shared);
+    ck_assert_ptr_null(worker_config_create(shared));
+    ck_assert_int_eq(shared->refs, 1);
+    server_config_release(shared);
+}
+END_TEST
+
+typedef struct
+{
+    char dir[32];
+    Config cfg;
+    FileCache cache;
+} FileCacheFixture;
+
+static void filecache_setup(FileCacheFixture *fx, size_t budget, int inotify)
+{
+    strcpy(fx->dir, "filecache_test_XXXXXX");
+    ck_assert_ptr_nonnull(mkdtemp(fx->dir));
+    memset(&fx->cfg, 0, sizeof(fx->cfg));
+    fx->cfg.static_cache_max_file   = 200;
+    fx->cfg.static_cache_revalidate = 0;
+    fx->cfg.static_cache_inotify    = inotify;
+    ck_assert_int_eq(filecache_init(&fx->cache, budget, &fx->cfg), OK);
+    ck_assert_int_eq(fx->cache.inotify_fd >= 0, inotify);
+}
+
+// Writes @p size bytes of @p c to the file @p name of the fixture's directory
+static void write_file(FileCacheFixture *fx, const char *name, char c, size_t size, char *path)
+{
+    char data[512];
+    memset(data, c, size);
+    sprintf(path, "%s/%s", fx->dir, name);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq(write(fd, data, size), (ssize_t)size);
+    close(fd);
+}
+
+// Caches the file at @p path behind the head "H:" and returns its entry
+static CacheEntry *cache_file(FileCacheFixture *fx, const char *path, int encoding)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq(fstat(fd, &st), 0);
+    CacheEntry *entry =
+        filecache_insert(&fx->cache, path, strlen(path), encoding, fd, &st, "H:", 2);
+    close(fd);
+    return entry;
+}
+
+static CacheEntry *cached(FileCacheFixture *fx, const char *path, int encoding)
+{
+    return filecache_lookup(&fx->cache, path, strlen(path), encoding);
+}
+
+static void filecache_teardown(FileCacheFixture *fx)
+{
+    filecache_destroy(&fx->cache);
+    DIR *dir = opendir(fx->dir);
+    ck_assert_ptr_nonnull(dir);
+    for (struct dirent *file; (file = readdir(dir));)
+    {
+        if (file->d_name[0] != '.') unlinkat(dirfd(dir), file->d_name, 0);
+    }
+    closedir(dir);
+    ck_assert_int_eq(rmdir(fx->dir), 0);
+}
+
+START_TEST(test_filecache_lru)
+{
+    FileCacheFixture fx;
+    char a[64], b[64], c[64], big[64];
+    filecache_setup(&fx, 2 * 102 + 50, 0);
+    write_file(&fx, "a", 'a', 100, a);
+    write_file(&fx, "b", 'b', 100, b);
+    write_file(&fx, "c", 'c', 50, c);
+    write_file(&fx, "big", 'x', 201, big);
+
+    CacheEntry *entry = cache_file(&fx, a, ENC_IDENTITY);
+    ck_assert_ptr_nonnull(entry);
+    ck_assert_uint_eq(entry->head_len, 2);
+    ck_assert_uint_eq(entry->body_len, 100);
+    ck_assert_int_eq(memcmp(entry->data, "H:aaa", 5), 0);
+    ck_assert_ptr_nonnull(cache_file(&fx, b, ENC_IDENTITY));
+    ck_assert_ptr_null(cache_file(&fx, big, ENC_IDENTITY));
+    ck_assert_uint_eq(fx.cache.bytes, 204);
+
+    // Each coding is its own entry, the same path alone doesn't match
+    ck_assert_ptr_eq(cached(&fx, a, ENC_IDENTITY), entry);
+    ck_assert_ptr_null(cached(&fx, a, ENC_GZIP));
+    ck_assert_ptr_null(filecache_lookup(&fx.cache, a, strlen(a) - 1, ENC_IDENTITY));
+
+    // a was used last, so c pushes b out
+    ck_assert_ptr_nonnull(cache_file(&fx, c, ENC_IDENTITY));
+    ck_assert_ptr_null(cached(&fx, b, ENC_IDENTITY));
+    ck_assert_ptr_eq(cached(&fx, a, ENC_IDENTITY), entry);
+    ck_assert_ptr_nonnull(cached(&fx, c, ENC_IDENTITY));
+    ck_assert_uint_eq(fx.cache.count, 2);
+    ck_assert_uint_eq(fx.cache.bytes, 102 + 52);
+
+    // A new version replaces the old one, which lives on while it is sent
+    filecache_retain(entry);
+    write_file(&fx, "a", 'A', 100, a);
+    CacheEntry *fresh = cache_file(&fx, a, ENC_IDENTITY);
+    ck_assert_ptr_nonnull(fresh);
+    ck_assert_ptr_eq(cached(&fx, a, ENC_IDENTITY), fresh);
+    ck_assert_int_eq(entry->evicted, 1);
+    ck_assert_int_eq(entry->data[2], 'a');
+    filecache_release(entry);
+    ck_assert_uint_eq(fx.cache.count, 2);
+
+    // A smaller budget on reload evicts from the least recently used end
+    ck_assert_ptr_nonnull(cached(&fx, c, ENC_IDENTITY));
+    filecache_configure(&fx.cache, 100, &fx.cfg);
+    ck_assert_ptr_null(cached(&fx, a, ENC_IDENTITY));
+    ck_assert_ptr_nonnull(cached(&fx, c, ENC_IDENTITY));
+    filecache_teardown(&fx);
+}
+END_TEST
+
+START_TEST(test_filecache_invalidation)
+{
+    // Without inotify a lookup checks the file with stat()
+    FileCacheFixture fx;
+    char a[64], b[64], b_br[64];
+    filecache_setup(&fx, 4096, 0);
+    write_file(&fx, "a", 'a', 10, a);
+    ck_assert_ptr_nonnull(cache_file(&fx, a, ENC_IDENTITY));
+    ck_assert_ptr_nonnull(cached(&fx, a, ENC_IDENTITY));
+    write_file(&fx, "a", 'a', 11, a);
+    ck_assert_ptr_null(cached(&fx, a, ENC_IDENTITY));
+    ck_assert_uint_eq(fx.cache.count, 0);
+    filecache_teardown(&fx);
+
+    // With inotify a change to a file or a sibling evicts every variant
+    filecache_setup(&fx, 4096, 1);
+    write_file(&fx, "a", 'a', 10, a);
+    write_file(&fx, "b", 'b', 10, b);
+    ck_assert_ptr_nonnull(cache_file(&fx, a, ENC_IDENTITY));
+    ck_assert_ptr_nonnull(cache_file(&fx, a, ENC_GZIP));
+    ck_assert_ptr_nonnull(cache_file(&fx, b, ENC_IDENTITY));
+    ck_assert_ptr_nonnull(cache_file(&fx, b, ENC_GZIP));
+    ck_assert_uint_eq(fx.cache.watch_count, 1);
+
+    write_file(&fx, "b.br", 'z', 5, b_br);
+    filecache_handle_inotify(&fx.cache);
+    ck_assert_ptr_null(cached(&fx, b, ENC_IDENTITY));
+    ck_assert_ptr_null(cached(&fx, b, ENC_GZIP));
+    ck_assert_ptr_nonnull(cached(&fx, a, ENC_GZIP));
+
+    write_file(&fx, "a", 'a', 10, a);
+    filecache_handle_inotify(&fx.cache);
+    ck_assert_ptr_null(cached(&fx, a, ENC_IDENTITY));
+    ck_assert_ptr_null(cached(&fx, a, ENC_GZIP));
+    ck_assert_uint_eq(fx.cache.count, 0);
+    filecache_teardown(&fx);
+}
+END_TEST
+
+START_TEST(test_stats_histogram)
+{
+    // Small values get a bucket each, huge ones land in the last bucket
+    static Histogram hist;
+    for (uint64_t ns = 0; ns < 4; ns++)
+        histogram_record(&hist, ns);
+    histogram_record(&hist, 1ULL << 50);
+    for (unsigned b = 0; b < 4; b++)
+        ck_assert_uint_eq(hist.counts[b], 1);
+    ck_assert_uint_eq(hist.counts[HIST_BUCKETS - 1], 1);
+    ck_assert_uint_eq(hist.count, 5);
+    ck_assert_uint_eq(hist.sum_ns, 6 + (1ULL << 50));
+
+    // Larger values never land in an earlier bucket
+    unsigned last = 0;
+    for (uint64_t ns = 1; ns < (1ULL << 36); ns += ns / 3 + 1)
+    {
+        Histogram one = {0};
+        histogram_record(&one, ns);
+        unsigned bucket = 0;
+        while (one.counts[bucket] == 0)
+            bucket++;
+        ck_assert_uint_ge(bucket, last);
+        last = bucket;
+    }
+    ck_assert_uint_lt(last, HIST_BUCKETS);
+
+    WorkerStats stats = {0};
+    stats.accepts     = 30;
+    stats_tick(&stats, 0);
+    ck_assert_uint_eq(stats.accepts_per_sec, 0);
+    stats_tick(&stats, 1500);
+    ck_assert_uint_eq(stats.accepts_per_sec, 20);
+    stats_tick(&stats, 1000);
+    ck_assert_uint_eq(stats.accepts_per_sec, 0);
+}
+END_TEST
+
+START_TEST(test_stats_handler)
+{
+    HTTPServer server = {0};
+    Worker *workers[2];
+    Connection conn = {0};
+    for (int i = 0; i < 2; i++)
+    {
+        workers[i]             = calloc(1, sizeof(Worker));
+        workers[i]->httpserver = &server;
+    }
+    server.workers      = workers;
+    server.worker_count = 2;
+
+    // Requests finished on either worker are summed up
+    Backend backend = {.host = "b", .port = "80"};
+    int statuses[]  = {200, 404, 200, 0, 700};
+    for (int i = 0; i < 5; i++)
+    {
+        conn.status         = statuses[i];
+        conn.out.sent_bytes = 100;
+        conn.backend        = i == 2 ? &backend : NULL;
+        conn.upstream_us    = 2000;
+        stats_request(&workers[i % 2]->stats, &conn);
+    }
+    conn.backend = NULL;
+    histogram_record(&workers[0]->stats.upstream, 1ULL << 40);
+    for (int i = 0; i < 1000; i++)
+        histogram_record(&workers[i % 2]->stats.parse, 1000000);
+    workers[0]->stats.accepts = 10;
+    workers[1]->stats.accepts = 5;
+    stats_tick(&workers[0]->stats, 500);
+    workers[1]->cache.hits   = 3;
+    workers[1]->cache.misses = 1;
+
+    ck_assert_int_eq(arena_init(&conn.arena, 4096), 0);
+    output_init(&conn.out);
+    ck_assert_int_eq(stats_handler(workers[0], &conn), OK);
+    ck_assert_int_eq(conn.status, 200);
+
+    int fds[2], blocked;
+    static char out[1 << 16];
+    small_socketpair(fds);
+    size_t len = drain_output(&conn.out, fds, out, sizeof(out) - 1, &blocked);
+    out[len]   = '\0';
+    char *body = strstr(out, "\r\n\r\n");
+    ck_assert_ptr_nonnull(body);
+    ck_assert_ptr_nonnull(strstr(out, "\r\nCache-Control: no-store\r\n"));
+
+    const char *expected[] = {
+        "\ncserver_workers 2\n",
+        "\ncserver_accepts_total 15\n",
+        "\ncserver_accepts_per_second 20\n",
+        "\ncserver_sent_bytes_total 500\n",
+        "\ncserver_static_cache_hit_ratio 0.7500\n",
+        "\ncserver_requests_total{code=\"other\"} 2\n"
+        "cserver_requests_total{code=\"200\"} 2\n"
+        "cserver_requests_total{code=\"404\"} 1\n",
+        "\ncserver_latency_seconds_bucket{stage=\"parse\",le=\"0.000524288\"} 0\n"
+        "cserver_latency_seconds_bucket{stage=\"parse\",le=\"0.001048576\"} 1000\n",
+        "\ncserver_latency_seconds_sum{stage=\"parse\"} 1.000000000\n"
+        "cserver_latency_seconds_count{stage=\"parse\"} 1000\n",
+        "\ncserver_latency_seconds_bucket{stage=\"handler\",le=\"+Inf\"} 0\n",
+        // The clamped duration only shows in +Inf
+        "} 1\ncserver_latency_seconds_bucket{stage=\"upstream\",le=\"+Inf\"} 2\n",
+        "\ncserver_latency_quantile_seconds{stage=\"parse\",quantile=\"0.5\"} 0.001048575\n",
+        "\ncserver_latency_quantile_seconds{stage=\"handler\",quantile=\"0.99\"} 0.000000000\n",
+    };
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+        ck_assert_ptr_nonnull(strstr(body, expected[i]));
+
+    close(fds[0]);
+    close(fds[1]);
+    output_free(&conn.out);
+    arena_destroy(&conn.arena);
+    free(workers[0]);
+    free(workers[1]);
 }
 END_TEST
 
@@ -111,11 +2342,57 @@ Suite *http_parser_suite(void)
     tcase_add_test(tc_core, test_parse_request_line_valid);
     tcase_add_test(tc_core, test_parse_request_line_invalid);
     tcase_add_test(tc_core, test_parse_headers_single);
-    tcase_add_test(tc_core, test_parse_headers_multiple);
     tcase_add_test(tc_core, test_parse_headers_colon_missing);
-    tcase_add_test(tc_core, test_parse_body_non_empty);
-    tcase_add_test(tc_core, test_parse_body_empty);
+    tcase_add_test(tc_core, test_parse_headers_name_invalid);
+    tcase_add_test(tc_core, test_parse_partial_rejects_smuggling);
+    tcase_add_test(tc_core, test_parse_partial_resumes);
+    tcase_add_test(tc_core, test_parse_partial_pipelined);
+    tcase_add_test(tc_core, test_parse_partial_chunked);
+    tcase_add_test(tc_core, test_parse_partial_ambiguous_framing);
+    tcase_add_test(tc_core, test_parse_known_headers_indexed);
+    tcase_add_test(tc_core, test_parse_response_head);
+    tcase_add_test(tc_core, test_parse_response_framing);
+    tcase_add_test(tc_core, test_tokenizer_backends_agree);
+    tcase_add_test(tc_core, test_tokenizer_stays_in_bounds);
+    tcase_add_test(tc_core, test_router_match);
+    tcase_add_test(tc_core, test_bundle_roundtrip);
+    tcase_add_test(tc_core, test_mailbox_senders);
+    tcase_add_test(tc_core, test_connpool_batch_reuse);
+    tcase_add_test(tc_core, test_request_ranges);
+    tcase_add_test(tc_core, test_request_not_modified);
+    tcase_add_test(tc_core, test_balancer_round_robin);
+    tcase_add_test(tc_core, test_balancer_least_conn);
+    tcase_add_test(tc_core, test_balancer_hash);
+    tcase_add_test(tc_core, test_proxycache_storable);
+    tcase_add_test(tc_core, test_proxycache_lookup);
+    tcase_add_test(tc_core, test_proxycache_vary);
+    tcase_add_test(tc_core, test_proxycache_stale_while_revalidate);
+    tcase_add_test(tc_core, test_config_strings);
+    tcase_add_test(tc_core, test_chunked_decode_strict);
+    tcase_add_test(tc_core, test_output_sendfile_progress);
+    tcase_add_test(tc_core, test_output_writev_partial);
+    tcase_add_test(tc_core, test_arena_alloc_reset);
+    tcase_add_test(tc_core, test_timerwheel_expiry);
+    tcase_add_test(tc_core, test_log_level_names);
+    tcase_add_test(tc_core, test_log_sync_records);
+    tcase_add_test(tc_core, test_log_ring_overflow);
+    tcase_add_test(tc_core, test_accesslog_json);
+    tcase_add_test(tc_core, test_accesslog_json_long_uri);
+    tcase_add_test(tc_core, test_accesslog_sampling);
+    tcase_add_test(tc_core, test_accesslog_binary);
+    tcase_add_test(tc_core, test_canned_responses);
+    tcase_add_test(tc_core, test_response_write_head);
+    tcase_add_test(tc_core, test_static_encoding_negotiation);
+    tcase_add_test(tc_core, test_static_encoded_head);
+    tcase_add_test(tc_core, test_gzip_compress);
+    tcase_add_test(tc_core, test_stream_body_content_length);
+    tcase_add_test(tc_core, test_stream_body_chunked);
+    tcase_add_test(tc_core, test_config_reload);
+    tcase_add_test(tc_core, test_filecache_lru);
+    tcase_add_test(tc_core, test_filecache_invalidation);
+    tcase_add_test(tc_core, test_stats_histogram);
+    tcase_add_test(tc_core, test_stats_handler);
 
     suite_add_tcase(s, tc_core);
     return s;
-}
\ No newline at end of file
+}
@@ -0,0 +1,28 @@
+/**
+ * @file    cserver_pack.c
+ * @author  Samandar Komil
+ * @date    14 October 2026
+ * @brief   Packs a static directory into a bundle for static_bundle.
+ *
+ * @details Run from the directory cserver runs in, the files keep the
+ *          request paths they have there. Reload the server (SIGHUP) or
+ *          restart it to serve a new bundle.
+ *
+ *          Usage: cserver-pack [dir] [output]   (defaults: static static.pack)
+ */
+
+#include "common.h"
+#include "http/bundle.h"
+
+int main(int argc, char **argv)
+{
+    if (argc > 3 || (argc > 1 && argv[1][0] == '-'))
+    {
+        fprintf(stderr, "usage: %s [dir] [output]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char *dir    = argc > 1 ? argv[1] : "static";
+    const char *output = argc > 2 ? argv[2] : "static.pack";
+    return bundle_pack(dir, output) == OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}